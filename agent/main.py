@@ -1,4 +1,6 @@
 import asyncio
+import os
+import socket
 import websockets
 import struct
 import time
@@ -7,6 +9,7 @@ import shutil
 import sys
 import threading
 import re
+from collections import deque
 from dataclasses import dataclass
 from typing import Optional, Set
 
@@ -441,10 +444,124 @@ class FFmpegReader:
             self.proc = None
 
 
+# ---------------------------------------------------------------------------
+# EncoderReader: H.264 from distance_encoder's socket transport
+# ---------------------------------------------------------------------------
+
+ENCODER_SOCKET = os.environ.get('DISTANCE_VIDEO_SOCKET', '/tmp/distance_video.sock')
+
+
+class EncoderReader:
+    """
+    Reads H.264 access units from distance_encoder running with
+    `encoding.codec = "h264"` and `output.transport = "socket"`, so the
+    screen is captured and encoded once, in distance_encoder. Same callbacks
+    as FFmpegReader.
+
+    Each socket message is a 4-byte big-endian length plus one complete
+    Annex B access unit; keyframes carry SPS/PPS in-band.
+    """
+
+    def __init__(self, path: str = ENCODER_SOCKET):
+        self.path = path
+        self.sps: bytes = b''
+        self.pps: bytes = b''
+        self.width: int = 0
+        self.height: int = 0
+        self.running = False
+        self._sock: Optional[socket.socket] = None
+        self._on_init = None
+        self._on_frame = None
+
+    def set_callbacks(self, on_init, on_frame):
+        self._on_init = on_init
+        self._on_frame = on_frame
+
+    def start(self):
+        self.running = True
+        thread = threading.Thread(target=self._run, daemon=True)
+        thread.start()
+
+    def _recv_exact(self, n: int) -> Optional[bytes]:
+        buf = bytearray()
+        while len(buf) < n:
+            chunk = self._sock.recv(n - len(buf))
+            if not chunk:
+                return None
+            buf.extend(chunk)
+        return bytes(buf)
+
+    def _run(self):
+        while self.running:
+            try:
+                self._sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+                self._sock.connect(self.path)
+                print(f"[ENCODER] Connected to {self.path}")
+                self._read_messages()
+            except OSError as e:
+                print(f"[ENCODER] {self.path}: {e}, retrying")
+            finally:
+                if self._sock:
+                    self._sock.close()
+                    self._sock = None
+            time.sleep(1.0)
+
+    def _read_messages(self):
+        while self.running:
+            header = self._recv_exact(4)
+            if header is None:
+                print("[ENCODER] Stream ended")
+                return
+            (length,) = struct.unpack('>I', header)
+            payload = self._recv_exact(length)
+            if payload is None:
+                return
+
+            # Only H.264 access units (they start with a start code); other
+            # layouts (JPEG, tiles, unchanged markers, cursor messages) mean
+            # the encoder runs another codec or sent a side message
+            if not (payload[:3] == b'\x00\x00\x01' or payload[:4] == b'\x00\x00\x00\x01'):
+                continue
+
+            is_key = False
+            for nalu in _split_nalus(payload):
+                ntype = _nal_type(nalu)
+                if ntype == 7:
+                    if nalu != self.sps:
+                        self.sps = nalu
+                        self.pps = b''
+                        w, h = parse_sps_dimensions(nalu)
+                        if w and h:
+                            self.width, self.height = w, h
+                elif ntype == 8:
+                    if nalu != self.pps:
+                        self.pps = nalu
+                        if self.sps and self._on_init:
+                            print(f"[H264] Got SPS ({len(self.sps)}B), PPS ({len(self.pps)}B), "
+                                  f"stream is {self.width}x{self.height}")
+                            self._on_init(self.sps, self.pps, self.width, self.height)
+                elif ntype == 5:
+                    is_key = True
+
+            if self._on_frame:
+                self._on_frame(payload, is_key)
+
+    def stop(self):
+        self.running = False
+        if self._sock:
+            self._sock.close()
+
+
 # ---------------------------------------------------------------------------
 # Agent
 # ---------------------------------------------------------------------------
 
+# Frames the reader may get ahead of the broadcast loop before the agent
+# drops to the next keyframe (a few seconds at 60 fps; far more than a
+# replayed keyframe run, which is at most one GOP)
+H264_QUEUE_MAX = 300
+
+
 @dataclass
 class StreamConfig:
     width: int = 1920
@@ -465,8 +582,12 @@ class DistanceAgent:
 
         # H.264 state
         self._h264_init_msg: Optional[bytes] = None  # cached VIDEO_INIT for late-joining clients
-        self._latest_h264: Optional[bytes] = None
-        self._latest_is_key: bool = False
+        # Access units waiting to be broadcast, in decode order. A P-frame
+        # only decodes on top of everything since the last IDR, so none may be
+        # dropped or overwritten; on connect the encoder replays its cached
+        # IDR + P-frame run back to back and all of it has to go out.
+        self._h264_queue: deque = deque()
+        self._h264_skip_to_key: bool = False
         self._h264_lock = threading.Lock()
 
     # ------------------------------------------------------------------
@@ -568,29 +689,40 @@ class DistanceAgent:
 
     def _on_h264_frame(self, data: bytes, is_key: bool):
         with self._h264_lock:
-            self._latest_h264 = data
-            self._latest_is_key = is_key
-        self._h264_new.set()
+            # If the broadcast falls this far behind, drop the backlog and
+            # resume at the next IDR rather than skip frames mid-GOP
+            if len(self._h264_queue) >= H264_QUEUE_MAX:
+                print(f"[H264] {len(self._h264_queue)} frames queued, dropping until next keyframe")
+                self._h264_queue.clear()
+                self._h264_skip_to_key = True
+            if is_key:
+                self._h264_skip_to_key = False
+            if not self._h264_skip_to_key:
+                self._h264_queue.append((data, is_key))
 
     # ------------------------------------------------------------------
     # Main streaming loop
     # ------------------------------------------------------------------
 
     async def stream_frames(self):
-        reader = FFmpegReader()
+        # DISTANCE_H264_SOURCE=encoder: take H.264 from distance_encoder
+        # instead of a separate ffmpeg capture
+        if os.environ.get('DISTANCE_H264_SOURCE') == 'encoder':
+            reader = EncoderReader()
+        else:
+            reader = FFmpegReader()
         reader.set_callbacks(self._on_h264_init, self._on_h264_frame)
         reader.start()
 
         while True:
             try:
                 with self._h264_lock:
-                    h264_data = self._latest_h264
-                    is_key = self._latest_is_key
-                    self._latest_h264 = None
+                    frames = list(self._h264_queue)
+                    self._h264_queue.clear()
 
-                if h264_data is not None:
+                for h264_data, is_key in frames:
                     await self.broadcast_h264_frame(h264_data, is_key)
-                else:
+                if not frames:
                     await asyncio.sleep(0.001)
 
             except Exception as e:
@@ -0,0 +1,1922 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+#include <turbojpeg.h>
+#ifdef HAVE_ZSTD
+#include <zdict.h>
+#include <zstd.h>
+#endif
+#ifdef HAVE_PNG
+#include <png.h>
+#endif
+#include "bench.hpp"
+#include "capture.hpp"
+#include "chroma.hpp"
+#include "clock.hpp"
+#include "encoder.hpp"
+#include "frame.hpp"
+#include "frame_hash.hpp"
+#include "frame_message.hpp"
+#include "palette_rle.hpp"
+#include "predict.hpp"
+#include "rate_control.hpp"
+#include "roi.hpp"
+#include "scale.hpp"
+#include "shared_memory.hpp"
+#include "thread_pool.hpp"
+#include "tile_classify.hpp"
+#include "tile_diff.hpp"
+#include "yuv.hpp"
+
+// Distinct synthetic frames cycled through during a benchmark
+constexpr int BENCH_FRAMES = 8;
+
+// Minimum wall time per measurement
+constexpr uint64_t BENCH_MIN_US = 2000000;
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+// Render `count` frames of the configured synthetic scene into a pool
+static bool render_frames(const EncoderConfig &config, FramePool &pool, std::vector<FrameLease> &frames, int count) {
+    auto backend = create_capture_backend("synthetic");
+    if (!backend) {
+        return false;
+    }
+    // Benchmarks size their frames with width x height
+    EncoderConfig scene_config = config;
+    scene_config.synthetic_width = config.width;
+    scene_config.synthetic_height = config.height;
+    backend->configure(scene_config);
+
+    int width, height;
+    if (!backend->init(0, width, height)) {
+        return false;
+    }
+
+    for (int i = 0; i < count; i++) {
+        FrameLease frame = pool.acquire();
+        if (!frame || !backend->capture(frame)) {
+            printf("[BENCH] Failed to render frame %d\n", i);
+            return false;
+        }
+        frames.push_back(frame);
+    }
+    backend->shutdown();
+    return true;
+}
+
+#if defined(HAVE_ZSTD) || defined(HAVE_X264)
+// `name` in the system temp directory, so running a benchmark from a
+// checkout leaves no files behind
+static std::string bench_temp_path(const char *name) {
+    std::error_code error;
+    std::filesystem::path dir = std::filesystem::temp_directory_path(error);
+    return error ? std::string(name) : (dir / name).string();
+}
+#endif
+
+// Check that a JPEG decodes to the expected size
+static bool jpeg_decodes(const FrameBuffer &jpeg, int width, int height) {
+    tjhandle decompressor = tjInitDecompress();
+    if (!decompressor) {
+        return false;
+    }
+
+    int w = 0, h = 0, subsamp = 0, colorspace = 0;
+    bool ok = tjDecompressHeader3(decompressor, jpeg.data, jpeg.size, &w, &h, &subsamp, &colorspace) == 0 &&
+              w == width && h == height;
+    if (ok) {
+        std::vector<uint8_t> pixels(static_cast<size_t>(w) * h * 3);
+        ok = tjDecompress2(decompressor, jpeg.data, jpeg.size, pixels.data(), w, 0, h, TJPF_RGB, 0) == 0;
+    }
+    tjDestroy(decompressor);
+    return ok;
+}
+
+// ---------------------------------------------------------------------------
+// jpeg-strips: strip-parallel JPEG scaling from 1 to N threads
+// ---------------------------------------------------------------------------
+static int bench_jpeg_strips(const EncoderConfig &config) {
+    int max_threads = config.encode_threads > 1 ? config.encode_threads
+                                                : static_cast<int>(std::thread::hardware_concurrency());
+    if (max_threads < 1) max_threads = 1;
+
+    FramePool raw_pool(BENCH_FRAMES, static_cast<size_t>(config.width) * config.height * 4);
+    std::vector<FrameLease> frames;
+    if (!render_frames(config, raw_pool, frames, BENCH_FRAMES)) {
+        return 1;
+    }
+
+    FramePool out_pool(1, DEFAULT_FRAME_SIZE);
+    FrameLease out = out_pool.acquire();
+
+    printf("\n[BENCH] jpeg-strips: %dx%d '%s', q%d, %s, %u hardware threads\n",
+           config.width, config.height, config.scene.c_str(), config.quality,
+           config.subsampling.c_str(), std::thread::hardware_concurrency());
+    printf("  threads      fps    ms/frame  first ms   speedup   bytes/frame  decodes\n");
+
+    // 1, 2, 4, ... and always max_threads itself
+    std::vector<int> steps;
+    for (int t = 1; t < max_threads; t *= 2) steps.push_back(t);
+    steps.push_back(max_threads);
+
+    double base_fps = 0;
+    for (int threads : steps) {
+        EncoderConfig cfg = config;
+        cfg.codec = "jpeg";
+        cfg.encode_threads = threads;
+
+        auto encoder = create_frame_encoder(cfg.codec);
+        if (!encoder) {
+            return 1;
+        }
+        encoder->configure(cfg);
+        if (!encoder->init(config.width, config.height)) {
+            return 1;
+        }
+
+        int encoded = 0;
+        size_t bytes = 0;
+        uint64_t first_slice = 0;  // encode start to first final slice (--slices)
+        uint64_t start = steady_now_us();
+        uint64_t elapsed = 0;
+        while (elapsed < BENCH_MIN_US) {
+            out->slices.start();
+            uint64_t t0 = steady_now_us();
+            if (!encoder->encode(*frames[encoded % BENCH_FRAMES], *out)) {
+                return 1;
+            }
+            uint64_t first = out->slices.first_slice_us();
+            first_slice += (first ? first : steady_now_us()) - t0;
+            bytes += out->size;
+            encoded++;
+            elapsed = steady_now_us() - start;
+        }
+
+        bool decodes = jpeg_decodes(*out, config.width, config.height);
+        encoder->shutdown();
+
+        double fps = encoded / (elapsed / 1e6);
+        if (threads == 1) base_fps = fps;
+        printf("  %7d  %7.1f  %10.2f  %8.2f  %7.2fx  %12zu  %s\n", threads, fps, 1000.0 / fps,
+               first_slice / 1000.0 / encoded, fps / base_fps, bytes / encoded, decodes ? "yes" : "NO");
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// tile-diff: change detection cost per frame for each usable SIMD kernel, tile
+// rows spread over 1..N threads
+// ---------------------------------------------------------------------------
+
+// Padding added to the current frame's stride, like a DXGI RowPitch
+constexpr size_t TILE_DIFF_PITCH_PAD = 64;
+
+// Tiles changed in the "sparse" case
+constexpr int TILE_DIFF_SPARSE_TILES = 8;
+
+static int bench_tile_diff(const EncoderConfig &config) {
+    // Defaults to 4K regardless of -w/-h unless they were raised above 1080p
+    int width = config.width > 1920 ? config.width : 3840;
+    int height = config.height > 1080 ? config.height : 2160;
+    int tile = config.tile_size;
+    int cols = (width + tile - 1) / tile;
+    int rows = (height + tile - 1) / tile;
+
+    size_t prev_stride = static_cast<size_t>(width) * 4;
+    size_t cur_stride = prev_stride + TILE_DIFF_PITCH_PAD;
+    std::vector<uint8_t> prev(prev_stride * height);
+    std::vector<uint8_t> cur(cur_stride * height);
+    uint32_t seed = config.seed ? config.seed : 1;
+    for (auto &b : prev) {
+        seed = seed * 1664525u + 1013904223u;
+        b = static_cast<uint8_t>(seed >> 24);
+    }
+    for (int y = 0; y < height; y++) {
+        memcpy(&cur[y * cur_stride], &prev[y * prev_stride], prev_stride);
+    }
+
+    // Sparse case: one pixel near the bottom of a few scattered tiles, so
+    // those tiles are scanned almost fully before they are found
+    std::vector<uint8_t> sparse = cur;
+    for (int i = 0; i < TILE_DIFF_SPARSE_TILES; i++) {
+        int tx = (i * 7 + 3) % cols;
+        int ty = (i * 5 + 1) % rows;
+        int x = tx * tile + tile / 2 < width ? tx * tile + tile / 2 : width - 1;
+        int y = ty * tile + tile - 1 < height ? ty * tile + tile - 1 : height - 1;
+        sparse[y * cur_stride + x * 4] ^= 0xFF;
+    }
+
+    struct Case {
+        const char *name;
+        const uint8_t *data;
+    };
+    const Case cases[] = {{"unchanged", cur.data()}, {"sparse", sparse.data()}};
+
+    // 1, 2, 4, ... and always max_threads itself, as in jpeg-strips
+    int max_threads = config.encode_threads > 1 ? config.encode_threads
+                                                : static_cast<int>(std::thread::hardware_concurrency());
+    if (max_threads < 1) max_threads = 1;
+    std::vector<int> steps;
+    for (int t = 1; t < max_threads; t *= 2) steps.push_back(t);
+    steps.push_back(max_threads);
+
+    printf("\n[BENCH] tile-diff: %dx%d BGRA, %dx%d tiles, stride %zu/%zu, %u hardware threads\n",
+           width, height, tile, tile, cur_stride, prev_stride, std::thread::hardware_concurrency());
+    printf("  kernel   threads  case         ms/frame     GB/s  dirty  matches scalar\n");
+
+    const char *best = tile_diff_kernel();
+    TileBitmap reference, dirty;
+    reference.resize(cols, rows);
+    dirty.resize(cols, rows);
+
+    bool all_match = true;
+    for (const auto &c : cases) {
+        tile_diff_select("scalar");
+        reference.clear();
+        tile_diff(c.data, cur_stride, prev.data(), prev_stride, width, height, 4, tile,
+                  nullptr, reference, 0, rows);
+
+        for (const char *kernel : tile_diff_kernels()) {
+            tile_diff_select(kernel);
+            for (int threads : steps) {
+                // One tile row per task, like the tiles encoder
+                ThreadPool pool(threads);
+
+                int frames = 0;
+                uint64_t start = steady_now_us();
+                uint64_t elapsed = 0;
+                while (elapsed < BENCH_MIN_US / 4) {
+                    dirty.clear();
+                    pool.parallel_for(rows, [&](int ty) {
+                        tile_diff(c.data, cur_stride, prev.data(), prev_stride, width, height, 4, tile,
+                                  nullptr, dirty, ty, ty + 1);
+                    });
+                    frames++;
+                    elapsed = steady_now_us() - start;
+                }
+
+                int count = 0;
+                for (int ty = 0; ty < rows; ty++) {
+                    for (int tx = 0; tx < cols; tx++) count += dirty.test(tx, ty);
+                }
+                bool match = dirty.words == reference.words;
+                all_match = all_match && match;
+
+                double ms = elapsed / 1000.0 / frames;
+                double gbps = 2.0 * prev_stride * height / (ms / 1000.0) / 1e9;
+                printf("  %-7s  %7d  %-10s  %9.3f  %7.1f  %5d  %s\n", kernel, threads, c.name, ms, gbps,
+                       count, match ? "yes" : "NO");
+            }
+        }
+    }
+
+    tile_diff_select(best);
+    return all_match ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------
+// frame-hash: dedup hash throughput per SIMD kernel
+// ---------------------------------------------------------------------------
+static int bench_frame_hash(const EncoderConfig &config) {
+    // Same frame geometry as tile-diff
+    int width = config.width > 1920 ? config.width : 3840;
+    int height = config.height > 1080 ? config.height : 2160;
+    size_t stride = static_cast<size_t>(width) * 4 + TILE_DIFF_PITCH_PAD;
+
+    std::vector<uint8_t> frame(stride * height);
+    uint32_t seed = config.seed ? config.seed : 1;
+    for (auto &b : frame) {
+        seed = seed * 1664525u + 1013904223u;
+        b = static_cast<uint8_t>(seed >> 24);
+    }
+
+    printf("\n[BENCH] frame-hash: %dx%d BGRA, stride %zu\n", width, height, stride);
+    printf("  kernel   ms/frame     GB/s  hash              matches scalar  flip detected\n");
+
+    const char *best = frame_hash_kernel();
+    frame_hash_select("scalar");
+    uint64_t reference = frame_hash(frame.data(), stride, width, height, 4);
+
+    bool all_ok = true;
+    for (const char *kernel : frame_hash_kernels()) {
+        frame_hash_select(kernel);
+
+        int frames = 0;
+        uint64_t hash = 0;
+        uint64_t start = steady_now_us();
+        uint64_t elapsed = 0;
+        while (elapsed < BENCH_MIN_US / 4) {
+            hash = frame_hash(frame.data(), stride, width, height, 4);
+            frames++;
+            elapsed = steady_now_us() - start;
+        }
+
+        // A single bit anywhere must change the hash; padding must not
+        size_t pos = (stride * (height / 2)) + width * 2 + 1;
+        frame[pos] ^= 1;
+        frame[stride - 1] ^= 0xFF;
+        bool flipped = frame_hash(frame.data(), stride, width, height, 4) != hash;
+        frame[pos] ^= 1;
+        bool padding_ignored = frame_hash(frame.data(), stride, width, height, 4) == hash;
+        frame[stride - 1] ^= 0xFF;
+
+        bool match = hash == reference;
+        all_ok = all_ok && match && flipped && padding_ignored;
+
+        double ms = elapsed / 1000.0 / frames;
+        double gbps = static_cast<double>(width) * 4 * height / (ms / 1000.0) / 1e9;
+        printf("  %-7s  %8.3f  %7.1f  %016llx  %-14s  %s\n", kernel, ms, gbps,
+               (unsigned long long)hash, match ? "yes" : "NO",
+               flipped && padding_ignored ? "yes" : "NO");
+    }
+
+    frame_hash_select(best);
+    return all_ok ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------
+// tile-classify: per-tile text/photo classifier cost and what the hybrid
+// lossless + JPEG coding saves over JPEG alone
+// ---------------------------------------------------------------------------
+static int bench_tile_classify(const EncoderConfig &config) {
+    static const char *SCENES[] = {"desktop", "text", "media", "video"};
+    int tile = config.tile_size;
+
+    tjhandle compressor = tjInitCompress();
+    if (!compressor) {
+        return 1;
+    }
+
+    printf("\n[BENCH] tile-classify: %dx%d, %dx%d tiles, JPEG q%d 4:2:0\n",
+           config.width, config.height, tile, tile, config.quality);
+    printf("  scene     tiles  synthetic  classify us/tile  ms/frame  jpeg us/tile   jpeg bytes  hybrid bytes  lossless ok\n");
+
+    bool all_ok = true;
+    for (const char *scene : SCENES) {
+        EncoderConfig cfg = config;
+        cfg.scene = scene;
+        FramePool pool(2, static_cast<size_t>(config.width) * config.height * 4);
+        std::vector<FrameLease> frames;
+        if (!render_frames(cfg, pool, frames, 2)) {
+            tjDestroy(compressor);
+            return 1;
+        }
+        const FrameBuffer &frame = *frames[1];
+
+        struct Tile {
+            int x, y, w, h;
+        };
+        std::vector<Tile> tiles;
+        for (int y = 0; y < frame.height; y += tile) {
+            for (int x = 0; x < frame.width; x += tile) {
+                tiles.push_back({x, y, x + tile > frame.width ? frame.width - x : tile,
+                                 y + tile > frame.height ? frame.height - y : tile});
+            }
+        }
+        auto at = [&](const Tile &t) {
+            return frame.data + static_cast<size_t>(t.y) * frame.stride + static_cast<size_t>(t.x) * 4;
+        };
+
+        // Classification cost over every tile, as if the whole frame changed
+        std::vector<TileClass> classes(tiles.size());
+        int passes = 0;
+        uint64_t start = steady_now_us();
+        uint64_t elapsed = 0;
+        while (elapsed < BENCH_MIN_US / 4) {
+            for (size_t i = 0; i < tiles.size(); i++) {
+                classes[i] = classify_tile(at(tiles[i]), frame.stride, tiles[i].w, tiles[i].h, 4);
+            }
+            passes++;
+            elapsed = steady_now_us() - start;
+        }
+
+        // Bytes: every tile as JPEG vs lossless where classified synthetic
+        std::vector<uint8_t> payload(palette_rle_bound(tile, tile) + tjBufSize(tile, tile, TJSAMP_420));
+        std::vector<uint8_t> decoded(static_cast<size_t>(tile) * tile * 4);
+        size_t jpeg_bytes = 0, hybrid_bytes = 0;
+        uint64_t jpeg_us = 0;
+        int synthetic = 0;
+        bool lossless_ok = true;
+        for (size_t i = 0; i < tiles.size(); i++) {
+            const Tile &t = tiles[i];
+            unsigned char *jpeg_ptr = payload.data();
+            unsigned long jpeg_size = payload.size();
+            uint64_t jpeg_start = steady_now_us();
+            if (tjCompress2(compressor, at(t), t.w, static_cast<int>(frame.stride), t.h, TJPF_BGRX,
+                            &jpeg_ptr, &jpeg_size, TJSAMP_420, config.quality,
+                            TJFLAG_FASTDCT | TJFLAG_NOREALLOC) != 0) {
+                tjDestroy(compressor);
+                return 1;
+            }
+            jpeg_bytes += jpeg_size;
+            jpeg_us += steady_now_us() - jpeg_start;
+
+            size_t size = 0;
+            if (classes[i] == TileClass::SYNTHETIC) {
+                size = palette_rle_encode(at(t), frame.stride, t.w, t.h, 4, payload.data(), payload.size());
+            }
+            if (size == 0) {
+                hybrid_bytes += jpeg_size;
+                continue;
+            }
+            synthetic++;
+            hybrid_bytes += size;
+
+            // Round trip must be exact
+            bool same = palette_rle_decode(payload.data(), size, t.w, t.h, decoded.data(), static_cast<size_t>(t.w) * 4);
+            for (int y = 0; y < t.h && same; y++) {
+                const uint8_t *a = at(t) + static_cast<size_t>(y) * frame.stride;
+                const uint8_t *b = decoded.data() + static_cast<size_t>(y) * t.w * 4;
+                for (int x = 0; x < t.w && same; x++) {
+                    same = memcmp(a + x * 4, b + x * 4, 3) == 0;
+                }
+            }
+            lossless_ok = lossless_ok && same;
+        }
+        all_ok = all_ok && lossless_ok;
+
+        double frame_ms = elapsed / 1000.0 / passes;
+        printf("  %-8s  %5zu  %8.1f%%  %16.2f  %8.3f  %12.2f  %11zu  %12zu  %s\n", scene, tiles.size(),
+               100.0 * synthetic / tiles.size(), frame_ms * 1000.0 / tiles.size(), frame_ms,
+               static_cast<double>(jpeg_us) / tiles.size(), jpeg_bytes, hybrid_bytes,
+               lossless_ok ? "yes" : "NO");
+    }
+
+    tjDestroy(compressor);
+    return all_ok ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------
+// lossless: codec "lossless" against TurboJPEG q95 and PNG, on keyframes
+// and on a stream of updates, with and without a trained zstd dictionary
+// ---------------------------------------------------------------------------
+
+// Frames per scene; the first is a keyframe, the rest are updates
+constexpr int LOSSLESS_FRAMES = 12;
+
+// Dictionary size trained for UI content
+constexpr size_t LOSSLESS_DICT_SIZE = 64 * 1024;
+
+#ifdef HAVE_ZSTD
+// Written by the benchmark, in the temp directory, for use as
+// encoding.lossless.dictionary
+static const char *LOSSLESS_DICT_NAME = "distance_ui.dict";
+#endif
+
+// Reference decoder: applies a tile message to a BGRA canvas. `records`
+// receives the decompressed record stream; `dictionary` is the zstd
+// dictionary the encoder used, empty if none.
+static bool apply_tile_message(const FrameBuffer &msg, std::vector<uint8_t> &canvas, int width,
+                               const std::vector<uint8_t> &dictionary, std::vector<uint8_t> &records) {
+    TileMessageHeader header;
+    if (msg.size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, msg.data, sizeof(header));
+    if (header.magic != TILE_MESSAGE_MAGIC || static_cast<int>(header.width) != width) {
+        return false;
+    }
+
+    const uint8_t *body = msg.data + sizeof(header);
+    size_t body_size = msg.size - sizeof(header);
+    if (header.flags & TILE_FLAG_ZSTD) {
+#ifdef HAVE_ZSTD
+        uint32_t raw_size;
+        memcpy(&raw_size, body, sizeof(raw_size));
+        records.resize(raw_size);
+        ZSTD_DCtx *dctx = ZSTD_createDCtx();
+        size_t n;
+        if (!dictionary.empty()) {
+            ZSTD_DDict *ddict = ZSTD_createDDict(dictionary.data(), dictionary.size());
+            n = ZSTD_decompress_usingDDict(dctx, records.data(), raw_size, body + 4, body_size - 4, ddict);
+            ZSTD_freeDDict(ddict);
+        } else {
+            n = ZSTD_decompressDCtx(dctx, records.data(), raw_size, body + 4, body_size - 4);
+        }
+        ZSTD_freeDCtx(dctx);
+        if (ZSTD_isError(n) || n != raw_size) {
+            return false;
+        }
+#else
+        (void)dictionary;
+        return false;
+#endif
+    } else {
+        records.assign(body, body + body_size);
+    }
+
+    size_t stride = static_cast<size_t>(width) * 4;
+    size_t pos = 0;
+    for (uint32_t i = 0; i < header.tile_count; i++) {
+        TileRecord r;
+        if (pos + sizeof(r) > records.size()) return false;
+        memcpy(&r, &records[pos], sizeof(r));
+        pos += sizeof(r);
+        if (pos + r.payload_size > records.size()) return false;
+        const uint8_t *p = &records[pos];
+        pos += r.payload_size;
+
+        uint8_t *dst = canvas.data() + static_cast<size_t>(r.y) * stride + static_cast<size_t>(r.x) * 4;
+        size_t pixels = static_cast<size_t>(r.width) * r.height;
+        if (r.encoding == TILE_ENCODING_PALETTE) {
+            if (!palette_rle_decode(p, r.payload_size, r.width, r.height, dst, stride)) return false;
+            continue;
+        }
+        if (r.encoding == TILE_ENCODING_COPY) {
+            TileCopy copy;
+            if (r.payload_size != sizeof(copy)) return false;
+            memcpy(&copy, p, sizeof(copy));
+            const uint8_t *src = canvas.data() + static_cast<size_t>(copy.src_y) * stride + static_cast<size_t>(copy.src_x) * 4;
+            // memmove semantics: walk rows away from the overlap
+            bool up = copy.src_y < r.y;
+            for (int n = 0; n < r.height; n++) {
+                int y = up ? r.height - 1 - n : n;
+                memmove(dst + static_cast<size_t>(y) * stride, src + static_cast<size_t>(y) * stride,
+                        static_cast<size_t>(r.width) * 4);
+            }
+            continue;
+        }
+        if ((r.encoding != TILE_ENCODING_XOR && r.encoding != TILE_ENCODING_PREDICTED) || r.payload_size != pixels * 3) {
+            return false;
+        }
+        if (r.encoding == TILE_ENCODING_PREDICTED) {
+            predict_decode(p, r.width, r.height, dst, stride);
+            continue;
+        }
+        for (int y = 0; y < r.height; y++) {
+            uint8_t *row = dst + static_cast<size_t>(y) * stride;
+            const uint8_t *src = p + static_cast<size_t>(y) * r.width * 3;
+            for (int x = 0; x < r.width; x++) {
+                for (int c = 0; c < 3; c++) row[x * 4 + c] ^= src[x * 3 + c];
+            }
+        }
+    }
+    return pos == records.size();
+}
+
+static bool canvas_matches(const std::vector<uint8_t> &canvas, const FrameBuffer &frame) {
+    for (int y = 0; y < frame.height; y++) {
+        const uint8_t *a = canvas.data() + static_cast<size_t>(y) * frame.width * 4;
+        const uint8_t *b = frame.data + static_cast<size_t>(y) * frame.stride;
+        for (int x = 0; x < frame.width; x++) {
+            if (memcmp(a + x * 4, b + x * 4, 3) != 0) return false;
+        }
+    }
+    return true;
+}
+
+#if defined(HAVE_ZSTD) && defined(HAVE_PNG)
+static size_t png_size(const FrameBuffer &frame, std::vector<uint8_t> &buffer) {
+    png_image image = {};
+    image.version = PNG_IMAGE_VERSION;
+    image.width = static_cast<png_uint_32>(frame.width);
+    image.height = static_cast<png_uint_32>(frame.height);
+    image.format = PNG_FORMAT_BGRA;
+    png_alloc_size_t size = buffer.size();
+    if (!png_image_write_to_memory(&image, buffer.data(), &size, 0, frame.data,
+                                   static_cast<png_int_32>(frame.stride), nullptr)) {
+        return 0;
+    }
+    return size;
+}
+#endif
+
+struct TileCodecRun {
+    double ms_per_frame = 0;
+    size_t key_bytes = 0;     // first frame, a full refresh
+    size_t update_bytes = 0;  // mean over the rest
+    int copies = 0;           // copy records over all frames
+    bool exact = true;
+};
+
+// Encode the frames in order with a tile codec (cfg.codec), repeating until
+// enough time has passed. Codec "lossless" messages are decoded to check
+// they are exact, and their records appended to `samples` if given.
+static bool run_tile_codec(const EncoderConfig &cfg, const std::vector<FrameLease> &frames, TileCodecRun &result,
+                           std::vector<uint8_t> *samples, std::vector<size_t> *sample_sizes) {
+    auto encoder = create_frame_encoder(cfg.codec);
+    if (!encoder) {
+        return false;
+    }
+    encoder->configure(cfg);
+    if (!encoder->init(cfg.width, cfg.height)) {
+        return false;
+    }
+
+    std::vector<uint8_t> dictionary;
+    if (!cfg.lossless_dictionary.empty()) {
+        FILE *file = fopen(cfg.lossless_dictionary.c_str(), "rb");
+        if (!file) {
+            return false;
+        }
+        uint8_t chunk[4096];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+            dictionary.insert(dictionary.end(), chunk, chunk + n);
+        }
+        fclose(file);
+    }
+
+    FramePool out_pool(1, DEFAULT_FRAME_SIZE);
+    FrameLease out = out_pool.acquire();
+    std::vector<uint8_t> canvas(static_cast<size_t>(cfg.width) * cfg.height * 4, 0);
+    std::vector<uint8_t> records;
+
+    int encoded = 0;
+    size_t updates = 0;
+    uint64_t busy = 0;
+    uint64_t start = steady_now_us();
+    for (int pass = 0; pass == 0 || steady_now_us() - start < BENCH_MIN_US / 4; pass++) {
+        encoder->request_keyframe();
+        for (size_t i = 0; i < frames.size(); i++) {
+            uint64_t t0 = steady_now_us();
+            if (!encoder->encode(*frames[i], *out)) {
+                return false;
+            }
+            busy += steady_now_us() - t0;
+            encoded++;
+            if (pass > 0) continue;
+
+            if (i == 0) result.key_bytes = out->size;
+            else updates += out->size;
+            result.copies += out->copy_count;
+            if (cfg.codec != "lossless") continue;
+            result.exact = result.exact && apply_tile_message(*out, canvas, cfg.width, dictionary, records) &&
+                           canvas_matches(canvas, *frames[i]);
+            // One dictionary sample per record: zstd dictionaries pay off on
+            // small inputs, and most update records are small
+            for (size_t pos = 0; samples && pos + sizeof(TileRecord) <= records.size();) {
+                TileRecord r;
+                memcpy(&r, &records[pos], sizeof(r));
+                size_t n = sizeof(r) + r.payload_size;
+                samples->insert(samples->end(), records.begin() + pos, records.begin() + pos + n);
+                sample_sizes->push_back(n);
+                pos += n;
+            }
+        }
+    }
+    encoder->shutdown();
+
+    result.ms_per_frame = busy / 1000.0 / encoded;
+    result.update_bytes = frames.size() > 1 ? updates / (frames.size() - 1) : 0;
+    return true;
+}
+
+static int bench_lossless(const EncoderConfig &config) {
+#ifndef HAVE_ZSTD
+    (void)config;
+    printf("[BENCH] lossless: codec lossless not built (needs libzstd)\n");
+    return 1;
+#else
+    static const char *SCENES[] = {"desktop", "text", "window", "media", "cursor"};
+    int width = config.width, height = config.height;
+    double raw_mb = static_cast<double>(width) * height * 3 / 1e6;
+
+    EncoderConfig cfg = config;
+    cfg.codec = "lossless";
+    cfg.encode_threads = 1;
+    cfg.lossless_dictionary.clear();
+
+    bool has_dict = false;
+    std::string dict_path = bench_temp_path(LOSSLESS_DICT_NAME);
+    // Train a dictionary on UI content from another seed, so it has never
+    // seen the frames it is measured on
+    {
+        EncoderConfig train = cfg;
+        train.seed = config.seed + 1000;
+        std::vector<uint8_t> samples;
+        std::vector<size_t> sizes;
+        for (const char *scene : SCENES) {
+            train.scene = scene;
+            FramePool pool(LOSSLESS_FRAMES, static_cast<size_t>(width) * height * 4);
+            std::vector<FrameLease> frames;
+            TileCodecRun run;
+            if (!render_frames(train, pool, frames, LOSSLESS_FRAMES) ||
+                !run_tile_codec(train, frames, run, &samples, &sizes)) {
+                return 1;
+            }
+        }
+        std::vector<uint8_t> dict(LOSSLESS_DICT_SIZE);
+        size_t n = ZDICT_trainFromBuffer(dict.data(), dict.size(), samples.data(), sizes.data(),
+                                         static_cast<unsigned>(sizes.size()));
+        if (!ZDICT_isError(n)) {
+            FILE *file = fopen(dict_path.c_str(), "wb");
+            if (file) {
+                has_dict = fwrite(dict.data(), 1, n, file) == n;
+                fclose(file);
+            }
+        }
+        if (has_dict) {
+            printf("[BENCH] Trained a %zu byte UI dictionary on %zu samples -> %s\n", n, sizes.size(),
+                   dict_path.c_str());
+        } else {
+            printf("[BENCH] Dictionary training failed, skipping dictionary rows\n");
+        }
+    }
+
+    tjhandle compressor = tjInitCompress();
+    if (!compressor) {
+        return 1;
+    }
+    FramePool out_pool(1, DEFAULT_FRAME_SIZE);
+    FrameLease out = out_pool.acquire();
+    std::vector<uint8_t> png_buffer(static_cast<size_t>(width) * height * 5);
+
+    printf("\n[BENCH] lossless: %dx%d, %d frames per scene, zstd level %d (ratio vs %.1f MB of raw BGR)\n",
+           width, height, LOSSLESS_FRAMES, cfg.lossless_level, raw_mb);
+    printf("  scene     codec           ms/frame     MB/s   key bytes  key ratio  update bytes  exact\n");
+
+    bool all_ok = true;
+    for (const char *scene : SCENES) {
+        cfg.scene = scene;
+        FramePool pool(LOSSLESS_FRAMES, static_cast<size_t>(width) * height * 4);
+        std::vector<FrameLease> frames;
+        if (!render_frames(cfg, pool, frames, LOSSLESS_FRAMES)) {
+            tjDestroy(compressor);
+            return 1;
+        }
+
+        auto row = [&](const char *codec, double ms, size_t key, size_t update, const char *exact) {
+            printf("  %-8s  %-14s  %8.2f  %7.1f  %10zu  %8.1fx  %12zu  %s\n", scene, codec, ms,
+                   raw_mb / (ms / 1000.0), key, raw_mb * 1e6 / key, update, exact);
+        };
+
+        for (int with_dict = 0; with_dict <= (has_dict ? 1 : 0); with_dict++) {
+            EncoderConfig run_cfg = cfg;
+            if (with_dict) run_cfg.lossless_dictionary = dict_path;
+            TileCodecRun run;
+            if (!run_tile_codec(run_cfg, frames, run, nullptr, nullptr)) {
+                tjDestroy(compressor);
+                return 1;
+            }
+            all_ok = all_ok && run.exact;
+            row(with_dict ? "lossless+dict" : "lossless", run.ms_per_frame, run.key_bytes, run.update_bytes,
+                run.exact ? "yes" : "NO");
+        }
+
+        // Baselines code every frame whole: no notion of updates
+        int encoded = 0;
+        size_t jpeg_bytes = 0;
+        uint64_t start = steady_now_us();
+        while (steady_now_us() - start < BENCH_MIN_US / 4) {
+            const FrameBuffer &frame = *frames[encoded % LOSSLESS_FRAMES];
+            unsigned char *jpeg_ptr = out->data;
+            unsigned long jpeg_size = out->capacity;
+            if (tjCompress2(compressor, frame.data, width, static_cast<int>(frame.stride), height, TJPF_BGRX,
+                            &jpeg_ptr, &jpeg_size, TJSAMP_444, 95, TJFLAG_NOREALLOC) != 0) {
+                tjDestroy(compressor);
+                return 1;
+            }
+            if (encoded == 0) jpeg_bytes = jpeg_size;
+            encoded++;
+        }
+        double jpeg_ms = (steady_now_us() - start) / 1000.0 / encoded;
+        row("jpeg q95 444", jpeg_ms, jpeg_bytes, jpeg_bytes, "no");
+
+#ifdef HAVE_PNG
+        encoded = 0;
+        size_t png_bytes = 0;
+        start = steady_now_us();
+        while (steady_now_us() - start < BENCH_MIN_US / 4) {
+            size_t n = png_size(*frames[encoded % LOSSLESS_FRAMES], png_buffer);
+            if (n == 0) {
+                tjDestroy(compressor);
+                return 1;
+            }
+            if (encoded == 0) png_bytes = n;
+            encoded++;
+        }
+        double png_ms = (steady_now_us() - start) / 1000.0 / encoded;
+        row("png", png_ms, png_bytes, png_bytes, "yes");
+#endif
+    }
+
+    tjDestroy(compressor);
+    return all_ok ? 0 : 1;
+#endif
+}
+
+// Frames per scene in the motion benchmark
+constexpr int MOTION_FRAMES = 12;
+
+static int bench_motion(const EncoderConfig &config) {
+    static const char *SCENES[] = {"text", "window", "cursor", "video"};
+#ifdef HAVE_ZSTD
+    static const char *CODECS[] = {"lossless", "tiles"};
+#else
+    static const char *CODECS[] = {"tiles"};
+#endif
+    int width = config.width, height = config.height;
+
+    EncoderConfig cfg = config;
+    cfg.encode_threads = 1;
+    cfg.tile_refine_after = 0;
+    cfg.lossless_dictionary.clear();
+
+    printf("\n[BENCH] motion: %dx%d, %d frames per scene, copy records for scrolls and window moves\n",
+           width, height, MOTION_FRAMES);
+    printf("  scene     codec     motion  ms/frame  update bytes  copies/frame  exact\n");
+
+    bool all_ok = true;
+    for (const char *scene : SCENES) {
+        cfg.scene = scene;
+        FramePool pool(MOTION_FRAMES, static_cast<size_t>(width) * height * 4);
+        std::vector<FrameLease> frames;
+        if (!render_frames(cfg, pool, frames, MOTION_FRAMES)) {
+            return 1;
+        }
+
+        for (const char *codec : CODECS) {
+            for (int motion = 0; motion <= 1; motion++) {
+                cfg.codec = codec;
+                cfg.tile_motion = motion != 0;
+                TileCodecRun run;
+                if (!run_tile_codec(cfg, frames, run, nullptr, nullptr)) {
+                    return 1;
+                }
+                bool checked = cfg.codec == "lossless";
+                all_ok = all_ok && run.exact;
+                printf("  %-8s  %-8s  %-6s  %8.2f  %12zu  %12.1f  %s\n", scene, codec, motion ? "on" : "off",
+                       run.ms_per_frame, run.update_bytes, static_cast<double>(run.copies) / (MOTION_FRAMES - 1),
+                       !checked ? "-" : run.exact ? "yes" : "NO");
+            }
+        }
+    }
+    return all_ok ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------
+// scale: downscaling a 5K capture to -w/-h per filter and SIMD kernel, and
+// scale + JPEG against JPEG at full size
+// ---------------------------------------------------------------------------
+
+// Capture size the scale benchmark starts from
+constexpr int SCALE_SOURCE_WIDTH = 5120;
+constexpr int SCALE_SOURCE_HEIGHT = 2880;
+
+// Time `fn` for at least BENCH_MIN_US / 4, returns ms per call
+template <typename F>
+static double time_ms(F &&fn) {
+    int calls = 0;
+    uint64_t start = steady_now_us();
+    uint64_t elapsed = 0;
+    while (elapsed < BENCH_MIN_US / 4) {
+        if (!fn()) {
+            return -1.0;
+        }
+        calls++;
+        elapsed = steady_now_us() - start;
+    }
+    return elapsed / 1000.0 / calls;
+}
+
+static int bench_scale(const EncoderConfig &config) {
+    static const char *SCENES[] = {"desktop", "media"};
+    static const ScaleFilter FILTERS[] = {ScaleFilter::BOX, ScaleFilter::BILINEAR, ScaleFilter::LANCZOS};
+    int width = SCALE_SOURCE_WIDTH, height = SCALE_SOURCE_HEIGHT;
+    int out_w, out_h;
+    if (!fit_output_size(width, height, config.width, config.height, out_w, out_h)) {
+        printf("[BENCH] %dx%d is not a downscale of %dx%d\n", config.width, config.height, width, height);
+        return 1;
+    }
+
+    EncoderConfig cfg = config;
+    cfg.width = width;
+    cfg.height = height;
+    cfg.codec = "jpeg";
+    cfg.encode_threads = 1;
+    cfg.encode_slices = 0;
+
+    FramePool scaled_pool(1, static_cast<size_t>(out_w) * out_h * 4);
+    FrameLease scaled = scaled_pool.acquire();
+    scaled->format = PixelFormat::BGRA;
+    scaled->width = out_w;
+    scaled->height = out_h;
+    scaled->stride = out_w * 4;
+    scaled->size = static_cast<size_t>(scaled->stride) * out_h;
+    std::vector<uint8_t> reference(scaled->size);
+
+    FramePool out_pool(1, DEFAULT_FRAME_SIZE);
+    FrameLease out = out_pool.acquire();
+    auto full_jpeg = create_frame_encoder("jpeg");
+    auto small_jpeg = create_frame_encoder("jpeg");
+    if (!full_jpeg || !small_jpeg) {
+        return 1;
+    }
+    full_jpeg->configure(cfg);
+    small_jpeg->configure(cfg);
+    if (!full_jpeg->init(width, height) || !small_jpeg->init(out_w, out_h)) {
+        return 1;
+    }
+
+    std::unique_ptr<ThreadPool> threads;
+    if (config.encode_threads > 1) {
+        threads = std::make_unique<ThreadPool>(config.encode_threads);
+    }
+
+    printf("\n[BENCH] scale: %dx%d -> %dx%d BGRA, then JPEG q%d %s\n", width, height, out_w, out_h,
+           config.quality, config.subsampling.c_str());
+    printf("  scene     filter    kernel   taps   ms/frame    Mpx/s  matches scalar\n");
+
+    struct Total {
+        const char *scene;
+        const char *step;
+        double ms;
+        size_t bytes;
+    };
+    std::vector<Total> totals;
+
+    const char *best = scale_kernel();
+    bool all_match = true;
+    for (const char *scene : SCENES) {
+        cfg.scene = scene;
+        FramePool pool(1, static_cast<size_t>(width) * height * 4);
+        std::vector<FrameLease> frames;
+        if (!render_frames(cfg, pool, frames, 1)) {
+            return 1;
+        }
+        const FrameBuffer &frame = *frames[0];
+
+        double full_ms = time_ms([&]() { return full_jpeg->encode(frame, *out); });
+        totals.push_back({scene, "jpeg at full size", full_ms, out->size});
+
+        for (ScaleFilter filter : FILTERS) {
+            Scaler scaler;
+            if (!scaler.init(width, height, out_w, out_h, filter)) {
+                return 1;
+            }
+            scale_select("scalar");
+            scaler.scale(frame.data, frame.stride, 4, reference.data(), scaled->stride);
+
+            double best_ms = 0;
+            for (const char *kernel : scale_kernels()) {
+                scale_select(kernel);
+                memset(scaled->data, 0, scaled->size);
+                double ms = time_ms([&]() {
+                    scaler.scale(frame.data, frame.stride, 4, scaled->data, scaled->stride);
+                    return true;
+                });
+                bool match = memcmp(scaled->data, reference.data(), scaled->size) == 0;
+                all_match = all_match && match;
+                if (strcmp(kernel, best) == 0) best_ms = ms;
+                printf("  %-8s  %-8s  %-7s  %2dx%-2d  %8.2f  %7.1f  %s\n", scene, scale_filter_name(filter), kernel,
+                       scaler.horizontal_taps(), scaler.vertical_taps(), ms,
+                       static_cast<double>(width) * height / (ms * 1000.0), match ? "yes" : "NO");
+            }
+            scale_select(best);
+
+            // Bands across --threads, as the pipeline's convert stage does
+            if (threads) {
+                double ms = time_ms([&]() {
+                    scaler.scale(frame.data, frame.stride, 4, scaled->data, scaled->stride, threads.get());
+                    return true;
+                });
+                bool match = memcmp(scaled->data, reference.data(), scaled->size) == 0;
+                all_match = all_match && match;
+                best_ms = ms;
+                char name[32];
+                snprintf(name, sizeof(name), "%s x%d", best, threads->size());
+                printf("  %-8s  %-8s  %-7s  %2dx%-2d  %8.2f  %7.1f  %s\n", scene, scale_filter_name(filter), name,
+                       scaler.horizontal_taps(), scaler.vertical_taps(), ms,
+                       static_cast<double>(width) * height / (ms * 1000.0), match ? "yes" : "NO");
+            }
+
+            double encode_ms = time_ms([&]() { return small_jpeg->encode(*scaled, *out); });
+            static char steps[3][32];
+            int index = static_cast<int>(filter);
+            snprintf(steps[index], sizeof(steps[index]), "%s + jpeg", scale_filter_name(filter));
+            totals.push_back({scene, steps[index], best_ms + encode_ms, out->size});
+        }
+    }
+    full_jpeg->shutdown();
+    small_jpeg->shutdown();
+
+    printf("\n  scene     pipeline            ms/frame       bytes  (scale kernel %s)\n", best);
+    for (const auto &t : totals) {
+        printf("  %-8s  %-18s  %8.2f  %10zu\n", t.scene, t.step, t.ms, t.bytes);
+    }
+    return all_match ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------
+// yuv: BGRA -> planar YUV per SIMD kernel, damage-only updates, and JPEG
+// from planes vs TurboJPEG's own conversion
+// ---------------------------------------------------------------------------
+static int bench_yuv(const EncoderConfig &config) {
+    static const char *SCENES[] = {"desktop", "text", "window", "cursor", "video"};
+    struct Layout {
+        const char *name;
+        PixelFormat layout;
+        YuvRange range;
+    };
+    static const Layout LAYOUTS[] = {
+        {"I420 full", PixelFormat::I420, YuvRange::FULL},
+        {"I420 limited", PixelFormat::I420, YuvRange::LIMITED},
+        {"I444 full", PixelFormat::I444, YuvRange::FULL},
+    };
+    int width = config.width, height = config.height;
+
+    EncoderConfig cfg = config;
+    cfg.codec = "jpeg";
+    cfg.subsampling = "420";
+    cfg.encode_threads = 1;
+    cfg.encode_slices = 0;
+    cfg.scene = "desktop";
+    FramePool pool(BENCH_FRAMES, static_cast<size_t>(width) * height * 4);
+    std::vector<FrameLease> frames;
+    if (!render_frames(cfg, pool, frames, 1)) {
+        return 1;
+    }
+    const FrameBuffer &frame = *frames[0];
+
+    printf("\n[BENCH] yuv: %dx%d BGRA, full-frame conversion\n", width, height);
+    printf("  layout        kernel   ms/frame    Mpx/s  matches scalar\n");
+    const char *best = yuv_kernel();
+    bool all_match = true;
+    std::vector<uint8_t> planes(yuv_frame_size(PixelFormat::I444, width, height));
+    std::vector<uint8_t> reference(planes.size());
+    for (const auto &l : LAYOUTS) {
+        // Odd geometry too, so the edge handling is compared as well
+        auto convert = [&](std::vector<uint8_t> &dst, int w, int h) {
+            yuv_convert(frame.data, frame.stride, 4, w, h, {0, 0, w, h}, l.layout, l.range,
+                        yuv_planes(l.layout, dst.data(), w, h));
+        };
+        yuv_select("scalar");
+        convert(reference, width, height);
+        std::vector<uint8_t> odd_reference(yuv_frame_size(l.layout, width - 1, height - 1));
+        std::vector<uint8_t> odd(odd_reference.size());
+        convert(odd_reference, width - 1, height - 1);
+        size_t bytes = yuv_frame_size(l.layout, width, height);
+
+        for (const char *kernel : yuv_kernels()) {
+            yuv_select(kernel);
+            memset(planes.data(), 0, planes.size());
+            double ms = time_ms([&]() {
+                convert(planes, width, height);
+                return true;
+            });
+            convert(odd, width - 1, height - 1);
+            bool match = memcmp(planes.data(), reference.data(), bytes) == 0 && odd == odd_reference;
+            all_match = all_match && match;
+            printf("  %-12s  %-7s  %8.2f  %7.1f  %s\n", l.name, kernel, ms,
+                   static_cast<double>(width) * height / (ms * 1000.0), match ? "yes" : "NO");
+        }
+        yuv_select(best);
+    }
+
+    // The convert stage: planes kept across frames, each frame converting
+    // only its damage, then JPEG straight from the planes
+    auto bgra_jpeg = create_frame_encoder("jpeg");
+    auto planar_jpeg = create_frame_encoder("jpeg");
+    if (!bgra_jpeg || !planar_jpeg) {
+        return 1;
+    }
+    bgra_jpeg->configure(cfg);
+    planar_jpeg->configure(cfg);
+    if (!bgra_jpeg->init(width, height) || !planar_jpeg->init(width, height)) {
+        return 1;
+    }
+    YuvFormat format = planar_jpeg->input_format();
+    FramePool yuv_pool(1, yuv_frame_size(format.layout, width, height));
+    FrameLease planar = yuv_pool.acquire();
+    FramePool out_pool(1, DEFAULT_FRAME_SIZE);
+    FrameLease out = out_pool.acquire();
+
+    printf("\n[BENCH] yuv: %d-frame sequences, JPEG q%d 4:2:0 from BGRA vs from persistent I420 planes\n",
+           BENCH_FRAMES, config.quality);
+    printf("  scene     converted   convert ms  +jpeg ms     bytes   bgra jpeg ms     bytes\n");
+    for (const char *scene : SCENES) {
+        cfg.scene = scene;
+        frames.clear();
+        if (!render_frames(cfg, pool, frames, BENCH_FRAMES)) {
+            return 1;
+        }
+
+        // Steady state: the first frame (full damage) converts everything
+        YuvConverter yuv;
+        yuv.init(width, height, format);
+        yuv.update(*frames[0]);
+        // Each timed loop cycles frames 1..N-1, averaging per call
+        size_t converted = 0, planar_bytes = 0, bgra_bytes = 0;
+        int i = 1, calls = 0;
+        auto next = [&]() {
+            calls++;
+            i = i + 1 < BENCH_FRAMES ? i + 1 : 1;
+            return true;
+        };
+        double convert_ms = time_ms([&]() {
+            converted += yuv.update(*frames[i]);
+            return next();
+        });
+        converted /= calls;
+        i = 1, calls = 0;
+        double planar_ms = time_ms([&]() {
+            yuv.update(*frames[i]);
+            if (!yuv.write_to(*frames[i], *planar) || !planar_jpeg->encode(*planar, *out)) return false;
+            planar_bytes += out->size;
+            return next();
+        });
+        planar_bytes /= calls;
+        i = 1, calls = 0;
+        double bgra_ms = time_ms([&]() {
+            if (!bgra_jpeg->encode(*frames[i], *out)) return false;
+            bgra_bytes += out->size;
+            return next();
+        });
+        bgra_bytes /= calls;
+        printf("  %-8s  %8.1f%%  %10.3f  %8.2f  %8zu  %13.2f  %8zu\n", scene,
+               100.0 * converted / (static_cast<double>(width) * height), convert_ms, planar_ms, planar_bytes,
+               bgra_ms, bgra_bytes);
+    }
+    bgra_jpeg->shutdown();
+    planar_jpeg->shutdown();
+    return all_match ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------
+// rate: JPEG size model against measured sizes, then the closed loop over a
+// sequence of scene changes
+// ---------------------------------------------------------------------------
+static int bench_rate(const EncoderConfig &config) {
+    static const char *SCENES[] = {"desktop", "text", "window", "media", "video"};
+    static const int QUALITIES[] = {20, 40, 60, 75, 85, 90, 95};
+    constexpr int SEGMENT_FRAMES = 60;
+    int width = config.width, height = config.height;
+    size_t pixels = static_cast<size_t>(width) * height;
+
+    EncoderConfig cfg = config;
+    cfg.codec = "jpeg";
+    cfg.subsampling = "420";
+    cfg.encode_threads = 1;
+    cfg.encode_slices = 0;
+    cfg.encode_workers = 1;
+    cfg.rate_bitrate_kbps = 0;
+    cfg.rate_frame_kb = 0;
+    FramePool pool(BENCH_FRAMES, pixels * 4);
+    FramePool out_pool(1, DEFAULT_FRAME_SIZE);
+    FrameLease out = out_pool.acquire();
+
+    printf("\n[BENCH] rate: %dx%d JPEG 4:2:0, size relative to q75, measured / model\n", width, height);
+    size_t q75_total = 0;
+    printf("  scene     activity  k at q75");
+    for (int q : QUALITIES) printf("       q%-3d", q);
+    printf("\n");
+    for (const char *scene : SCENES) {
+        cfg.scene = scene;
+        std::vector<FrameLease> frames;
+        if (!render_frames(cfg, pool, frames, BENCH_FRAMES)) {
+            return 1;
+        }
+        // The last frame: scenes that animate have moved on from the desktop
+        const FrameBuffer &frame = *frames[BENCH_FRAMES - 1];
+        double activity = frame_activity(frame);
+        size_t sizes[sizeof(QUALITIES) / sizeof(QUALITIES[0])];
+        size_t q75 = 0;
+        for (size_t i = 0; i < sizeof(QUALITIES) / sizeof(QUALITIES[0]); i++) {
+            cfg.quality = QUALITIES[i];
+            auto jpeg = create_frame_encoder("jpeg");
+            jpeg->configure(cfg);
+            if (!jpeg->init(width, height) || !jpeg->encode(frame, *out)) {
+                return 1;
+            }
+            jpeg->shutdown();
+            sizes[i] = out->size;
+            if (QUALITIES[i] == 75) q75 = out->size;
+        }
+        q75_total += q75;
+        printf("  %-8s  %8.2f  %8.4f", scene, activity, q75 / (pixels * (activity + 1.0)));
+        for (size_t i = 0; i < sizeof(QUALITIES) / sizeof(QUALITIES[0]); i++) {
+            printf("  %.2f/%.2f", static_cast<double>(sizes[i]) / q75, jpeg_size_ratio(QUALITIES[i]));
+        }
+        printf("\n");
+    }
+
+    // Closed loop: each scene for SEGMENT_FRAMES frames (its rendered
+    // frames cycled), at 30 fps so the per-frame budget is fixed. Without
+    // rate.bitrate_kbps the targets are the mean q75 frame and half that.
+    cfg.fps = 30;
+    cfg.quality = config.quality;
+    int q75_kbps = static_cast<int>(q75_total / (sizeof(SCENES) / sizeof(SCENES[0])) * 8 * cfg.fps / 1000);
+    int targets[] = {config.rate_bitrate_kbps > 0 ? config.rate_bitrate_kbps : q75_kbps, 0};
+    targets[1] = targets[0] / 2;
+    printf("\n[BENCH] rate: closed loop, %d frames per scene at 30 fps, quality %d..%d\n", SEGMENT_FRAMES,
+           cfg.rate_min_quality, cfg.rate_max_quality);
+    printf("  target kbps  scene     budget KB  mean KB   max KB  quality mean  min  max  changes  reversals\n");
+    for (int target : targets) {
+        cfg.rate_bitrate_kbps = target;
+        auto jpeg = create_frame_encoder("jpeg");
+        jpeg->configure(cfg);
+        if (!jpeg->init(width, height)) {
+            return 1;
+        }
+        double budget_kb = target * 1000.0 / 8 / cfg.fps / 1024;
+        size_t total_bytes = 0;
+        int total_frames = 0;
+        for (const char *scene : SCENES) {
+            cfg.scene = scene;
+            std::vector<FrameLease> frames;
+            if (!render_frames(cfg, pool, frames, BENCH_FRAMES)) {
+                return 1;
+            }
+            size_t bytes = 0, max_bytes = 0;
+            // Reversals (quality turning from rising to falling or back)
+            // are oscillation; changes in one direction follow the content
+            int quality_sum = 0, min_q = 100, max_q = 0, changes = 0, reversals = 0, last_q = 0, last_step = 0;
+            for (int i = 0; i < SEGMENT_FRAMES; i++) {
+                FrameBuffer &frame = *frames[i % BENCH_FRAMES];
+                frame.timestamp_us = static_cast<uint64_t>(total_frames) * 1000000 / cfg.fps;
+                if (!jpeg->encode(frame, *out)) {
+                    return 1;
+                }
+                bytes += out->size;
+                max_bytes = out->size > max_bytes ? out->size : max_bytes;
+                int q = out->quality;
+                quality_sum += q;
+                min_q = q < min_q ? q : min_q;
+                max_q = q > max_q ? q : max_q;
+                if (i > 0 && q != last_q) {
+                    int step = q > last_q ? 1 : -1;
+                    changes++;
+                    if (last_step && step != last_step) reversals++;
+                    last_step = step;
+                }
+                last_q = q;
+                total_frames++;
+            }
+            total_bytes += bytes;
+            printf("  %11d  %-8s  %9.1f  %7.1f  %7.1f  %12.1f  %3d  %3d  %7d  %9d\n", target, scene, budget_kb,
+                   bytes / 1024.0 / SEGMENT_FRAMES, max_bytes / 1024.0, static_cast<double>(quality_sum) / SEGMENT_FRAMES,
+                   min_q, max_q, changes, reversals);
+        }
+        jpeg->shutdown();
+        printf("  %11d  %-8s  actual %.0f kbps (%.1f%% of target)\n", target, "total",
+               total_bytes * 8 / 1000.0 * cfg.fps / total_frames,
+               100.0 * total_bytes * 8 / 1000.0 * cfg.fps / total_frames / target);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// chroma: automatic subsampling on text-heavy and photo-heavy scenes
+// ---------------------------------------------------------------------------
+
+// PSNR of decoded BGRA pixels (rows without padding) against the BGRA
+// frame they were made from, over R, G and B
+static double bgra_psnr(const std::vector<uint8_t> &pixels, const FrameBuffer &frame) {
+    double sum = 0;
+    for (int y = 0; y < frame.height; y++) {
+        const uint8_t *a = pixels.data() + static_cast<size_t>(y) * frame.width * 4;
+        const uint8_t *b = frame.data + static_cast<size_t>(y) * frame.stride;
+        for (int x = 0; x < frame.width * 4; x++) {
+            if ((x & 3) == 3) continue;
+            int d = a[x] - b[x];
+            sum += d * d;
+        }
+    }
+    double mse = sum / (static_cast<double>(frame.width) * frame.height * 3);
+    return mse > 0 ? 10 * log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+// PSNR of a JPEG against the BGRA frame it was made from, over R, G and B
+static double jpeg_psnr(const FrameBuffer &jpeg, const FrameBuffer &frame) {
+    tjhandle decompressor = tjInitDecompress();
+    if (!decompressor) {
+        return 0;
+    }
+    std::vector<uint8_t> pixels(static_cast<size_t>(frame.width) * frame.height * 4);
+    bool ok = tjDecompress2(decompressor, jpeg.data, jpeg.size, pixels.data(), frame.width, 0, frame.height,
+                            TJPF_BGRX, 0) == 0;
+    tjDestroy(decompressor);
+    return ok ? bgra_psnr(pixels, frame) : 0;
+}
+
+static int bench_chroma(const EncoderConfig &config) {
+    struct Scene {
+        const char *name;
+        const char *kind;
+    };
+    static const Scene SCENES[] = {
+        {"text", "text"}, {"code", "text"}, {"desktop", "text"}, {"window", "text"},
+        {"media", "photo"}, {"video", "photo"},
+    };
+    static const char *MODES[] = {"420", "422", "444", "auto"};
+    int width = config.width, height = config.height;
+
+    EncoderConfig cfg = config;
+    cfg.codec = "jpeg";
+    cfg.encode_threads = 1;
+    cfg.encode_slices = 0;
+    cfg.rate_bitrate_kbps = 0;
+    cfg.rate_frame_kb = 0;
+    FramePool pool(BENCH_FRAMES, static_cast<size_t>(width) * height * 4);
+    FramePool yuv_pool(1, yuv_frame_size(PixelFormat::I444, width, height));
+    FramePool out_pool(1, DEFAULT_FRAME_SIZE);
+    FrameLease out = out_pool.acquire();
+    FrameLease planar = yuv_pool.acquire();
+
+    printf("\n[BENCH] chroma: %dx%d, detail (share of sharp chroma steps) and the analysis cost\n", width, height);
+    printf("  scene     kind   horizontal  vertical  texture  choice  analysis ms  planar ms  jpeg 4:2:0 ms\n");
+    struct Result {
+        size_t bytes[4];
+        double psnr[4];
+        size_t planar_bytes;
+        double planar_psnr;
+    };
+    std::vector<Result> results;
+    bool planar_match = true;
+    for (const auto &sc : SCENES) {
+        cfg.scene = sc.name;
+        std::vector<FrameLease> frames;
+        if (!render_frames(cfg, pool, frames, BENCH_FRAMES)) {
+            return 1;
+        }
+        // The last frame: scenes that animate have moved on from the desktop
+        const FrameBuffer &frame = *frames[BENCH_FRAMES - 1];
+
+        ChromaDetail detail = chroma_detail(frame.data, frame.stride, width, height, 4);
+        double analysis_ms = time_ms([&]() {
+            detail = chroma_detail(frame.data, frame.stride, width, height, 4);
+            return true;
+        });
+        YuvConverter yuv;
+        yuv.init(width, height, {PixelFormat::I444, YuvRange::FULL});
+        yuv.update(frame);
+        if (!yuv.write_to(frame, *planar)) {
+            return 1;
+        }
+        YuvPlanes p = yuv_planes(PixelFormat::I444, planar->data, width, height);
+        ChromaDetail planar_detail;
+        double planar_ms = time_ms([&]() {
+            planar_detail = chroma_detail_planar(p.data[1], p.data[2], p.stride[1], width, height);
+            return true;
+        });
+        planar_match = planar_match && choose_subsampling(planar_detail) == choose_subsampling(detail);
+
+        Result r = {};
+        double jpeg_ms = 0;
+        for (int m = 0; m < 4; m++) {
+            cfg.subsampling = MODES[m];
+            auto jpeg = create_frame_encoder("jpeg");
+            jpeg->configure(cfg);
+            if (!jpeg->init(width, height)) {
+                return 1;
+            }
+            if (m == 0) {
+                jpeg_ms = time_ms([&]() { return jpeg->encode(frame, *out); });
+            }
+            if (!jpeg->encode(frame, *out)) {
+                return 1;
+            }
+            r.bytes[m] = out->size;
+            r.psnr[m] = jpeg_psnr(*out, frame);
+            if (m == 3) {
+                // Auto from I444 planes, as the pipeline feeds it
+                auto from_planes = create_frame_encoder("jpeg");
+                from_planes->configure(cfg);
+                if (!from_planes->init(width, height) || !from_planes->encode(*planar, *out)) {
+                    return 1;
+                }
+                r.planar_bytes = out->size;
+                r.planar_psnr = jpeg_psnr(*out, frame);
+                from_planes->shutdown();
+            }
+            jpeg->shutdown();
+        }
+        results.push_back(r);
+        printf("  %-8s  %-5s  %9.2f%%  %7.2f%%  %6.1f%%  %6s  %11.3f  %9.3f  %13.2f\n", sc.name, sc.kind,
+               detail.horizontal * 100, detail.vertical * 100, detail.texture * 100,
+               subsampling_name(choose_subsampling(detail)), analysis_ms, planar_ms, jpeg_ms);
+    }
+
+    printf("\n[BENCH] chroma: JPEG q%d bytes and PSNR per subsampling, auto from BGRA and from I444 planes\n",
+           config.quality);
+    printf("  scene     kind  ");
+    for (const char *mode : MODES) printf("  %-16s", mode);
+    printf("  auto (planes)\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        printf("  %-8s  %-5s", SCENES[i].name, SCENES[i].kind);
+        for (int m = 0; m < 4; m++) printf("  %8zu %5.1f dB", r.bytes[m], r.psnr[m]);
+        printf("  %8zu %5.1f dB\n", r.planar_bytes, r.planar_psnr);
+    }
+
+    // Tile mode picks per JPEG run; most text goes lossless there, so this
+    // mostly shows photo runs staying at 4:2:0. The runs log their setup, so
+    // the table prints after them.
+    cfg.codec = "tiles";
+    std::vector<std::vector<size_t>> tile_bytes;
+    for (const auto &sc : SCENES) {
+        cfg.scene = sc.name;
+        std::vector<FrameLease> frames;
+        if (!render_frames(cfg, pool, frames, BENCH_FRAMES)) {
+            return 1;
+        }
+        std::vector<size_t> row;
+        for (const char *mode : MODES) {
+            cfg.subsampling = mode;
+            TileCodecRun run;
+            if (!run_tile_codec(cfg, frames, run, nullptr, nullptr)) {
+                return 1;
+            }
+            row.push_back(run.update_bytes);
+        }
+        tile_bytes.push_back(row);
+    }
+    printf("\n[BENCH] chroma: tiles q%d, bytes per update over %d frames\n", config.quality, BENCH_FRAMES);
+    printf("  scene     kind  ");
+    for (const char *mode : MODES) printf("  %10s", mode);
+    printf("\n");
+    for (size_t i = 0; i < tile_bytes.size(); i++) {
+        printf("  %-8s  %-5s", SCENES[i].name, SCENES[i].kind);
+        for (size_t bytes : tile_bytes[i]) printf("  %10zu", bytes);
+        printf("\n");
+    }
+    printf("  planar analysis agrees with BGRA: %s\n", planar_match ? "yes" : "NO");
+    return planar_match ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------
+// roi: quality around the pointer, paid for by the periphery
+// ---------------------------------------------------------------------------
+
+// PSNR of a JPEG against its BGRA frame, over R, G and B, separately for the
+// pixels inside and outside the region
+static void jpeg_psnr_roi(const FrameBuffer &jpeg, const FrameBuffer &frame, const Roi &roi, double &inside,
+                          double &outside) {
+    inside = outside = 0;
+    tjhandle decompressor = tjInitDecompress();
+    if (!decompressor) {
+        return;
+    }
+    std::vector<uint8_t> pixels(static_cast<size_t>(frame.width) * frame.height * 4);
+    bool ok = tjDecompress2(decompressor, jpeg.data, jpeg.size, pixels.data(), frame.width, 0, frame.height,
+                            TJPF_BGRX, 0) == 0;
+    tjDestroy(decompressor);
+    if (!ok) {
+        return;
+    }
+    double sum[2] = {0, 0};
+    double count[2] = {0, 0};
+    for (int y = 0; y < frame.height; y++) {
+        const uint8_t *a = pixels.data() + static_cast<size_t>(y) * frame.width * 4;
+        const uint8_t *b = frame.data + static_cast<size_t>(y) * frame.stride;
+        int x0[2], x1[2];
+        int spans = roi.row_spans(y, frame.width, x0, x1);
+        for (int x = 0; x < frame.width; x++) {
+            int in = 0;
+            for (int s = 0; s < spans; s++) in |= x >= x0[s] && x < x1[s];
+            for (int c = 0; c < 3; c++) {
+                int d = a[x * 4 + c] - b[x * 4 + c];
+                sum[in] += d * d;
+            }
+            count[in] += 3;
+        }
+    }
+    auto psnr = [](double s, double n) { return n == 0 ? 0.0 : s > 0 ? 10 * log10(255.0 * 255.0 * n / s) : 99.0; };
+    outside = psnr(sum[0], count[0]);
+    inside = psnr(sum[1], count[1]);
+}
+
+static int bench_roi(const EncoderConfig &config) {
+    static const char *SCENES[] = {"desktop", "text", "code", "window", "media", "video"};
+    static const int QUALITIES[] = {50, 75, 90};
+    static const int STRENGTHS[] = {64, 128, 192, 256};
+    int width = config.width, height = config.height;
+    int radius = config.roi_radius > 0 ? config.roi_radius : 160;
+
+    EncoderConfig cfg = config;
+    cfg.encode_threads = 1;
+    cfg.encode_slices = 0;
+    cfg.rate_bitrate_kbps = 0;
+    cfg.rate_frame_kb = 0;
+    cfg.roi_focus = false;
+    FramePool pool(BENCH_FRAMES, static_cast<size_t>(width) * height * 4);
+    FramePool work_pool(3, static_cast<size_t>(width) * height * 4);
+    FramePool out_pool(1, DEFAULT_FRAME_SIZE);
+    FrameLease out = out_pool.acquire();
+    FrameLease planar = work_pool.acquire();
+    FrameLease smoothed = work_pool.acquire();
+    FrameLease smoothed_planar = work_pool.acquire();
+
+    struct Result {
+        double share;
+        double smoothed_cost[4];  // most over QUALITIES and inputs
+        double smooth_ms;
+        size_t jpeg_bytes[2];  // without, with the region
+        double psnr_in[2];
+        double psnr_out[2];
+        size_t tile_bytes[2];
+    };
+    std::vector<Result> results;
+    for (const char *scene : SCENES) {
+        cfg.scene = scene;
+        std::vector<FrameLease> frames;
+        if (!render_frames(cfg, pool, frames, BENCH_FRAMES)) {
+            return 1;
+        }
+        const FrameBuffer &frame = *frames[BENCH_FRAMES - 1];
+        Roi roi = frame_roi(frame, radius, false);
+        Result r = {};
+        r.share = roi.share(width, height);
+
+        // What roi_smoothed_cost() assumes: the whole frame smoothed over
+        // as is, from BGRA and from I420 with only the luma smoothed, as
+        // the pipeline delivers 4:2:0
+        YuvConverter yuv;
+        yuv.init(width, height, {PixelFormat::I420, YuvRange::FULL});
+        yuv.update(frame);
+        if (!yuv.write_to(frame, *planar)) {
+            return 1;
+        }
+        YuvPlanes p = yuv_planes(PixelFormat::I420, planar->data, width, height);
+        Roi none;
+        for (FrameBuffer *f : {&*smoothed, &*smoothed_planar}) {
+            const FrameBuffer &src = f == &*smoothed ? frame : *planar;
+            f->size = src.size;
+            f->format = src.format;
+            f->width = width;
+            f->height = height;
+            f->stride = src.stride;
+            memcpy(f->data, src.data, src.size);
+        }
+        cfg.codec = "jpeg";
+        cfg.roi_radius = 0;
+        cfg.subsampling = "420";
+        for (int i = 0; i < 4; i++) {
+            double ms = time_ms([&]() {
+                roi_smooth(frame.data, frame.stride, width, height, 4, none, STRENGTHS[i], smoothed->data,
+                           frame.stride);
+                return true;
+            });
+            roi_smooth(p.data[0], p.stride[0], width, height, 1, none, STRENGTHS[i], smoothed_planar->data,
+                       p.stride[0]);
+            if (i == 3) r.smooth_ms = ms;
+            for (int q : QUALITIES) {
+                cfg.quality = q;
+                auto jpeg = create_frame_encoder("jpeg");
+                jpeg->configure(cfg);
+                if (!jpeg->init(width, height)) {
+                    return 1;
+                }
+                size_t sizes[4];
+                const FrameBuffer *inputs[4] = {&frame, &*smoothed, &*planar, &*smoothed_planar};
+                for (int n = 0; n < 4; n++) {
+                    if (!jpeg->encode(*inputs[n], *out)) {
+                        return 1;
+                    }
+                    sizes[n] = out->size;
+                }
+                jpeg->shutdown();
+                double cost = std::max(static_cast<double>(sizes[1]) / sizes[0],
+                                       static_cast<double>(sizes[3]) / sizes[2]);
+                r.smoothed_cost[i] = std::max(r.smoothed_cost[i], cost);
+            }
+        }
+
+        cfg.quality = config.quality;
+        for (int on = 0; on < 2; on++) {
+            cfg.codec = "jpeg";
+            cfg.roi_radius = on ? radius : 0;
+            auto jpeg = create_frame_encoder("jpeg");
+            jpeg->configure(cfg);
+            if (!jpeg->init(width, height) || !jpeg->encode(*planar, *out)) {
+                return 1;
+            }
+            r.jpeg_bytes[on] = out->size;
+            jpeg_psnr_roi(*out, frame, roi, r.psnr_in[on], r.psnr_out[on]);
+            jpeg->shutdown();
+
+            cfg.codec = "tiles";
+            TileCodecRun run;
+            if (!run_tile_codec(cfg, frames, run, nullptr, nullptr)) {
+                return 1;
+            }
+            r.tile_bytes[on] = run.key_bytes + run.update_bytes * (BENCH_FRAMES - 1);
+        }
+        results.push_back(r);
+    }
+
+    printf("\n[BENCH] roi: %dx%d, JPEG 4:2:0 bytes of the whole frame smoothed over as is, most over q50..q90\n",
+           width, height);
+    printf("  scene   ");
+    for (int strength : STRENGTHS) printf("   s%-4d", strength);
+    printf("  smooth ms\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        printf("  %-8s", SCENES[i]);
+        for (double cost : r.smoothed_cost) printf("  %6.2f", cost);
+        printf("  %9.2f\n", r.smooth_ms);
+    }
+    printf("  assumed ");
+    for (int strength : STRENGTHS) printf("  %6.2f", roi_smoothed_cost(strength));
+    printf("\n");
+
+    printf("\n[BENCH] roi: JPEG q%d from I420, radius %d around the synthetic pointer, boost %d\n", config.quality,
+           radius, config.roi_boost);
+    printf("  scene     share  quality  strength   plain bytes  inside dB  outside dB     roi bytes  inside dB  outside dB\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        RoiSmoothing smoothing = roi_smoothing(config.quality, config.roi_boost, r.share);
+        printf("  %-8s  %4.1f%%  %7d  %8d  %12zu  %9.1f  %10.1f  %12zu  %9.1f  %10.1f\n", SCENES[i], r.share * 100,
+               smoothing.quality, smoothing.strength, r.jpeg_bytes[0], r.psnr_in[0], r.psnr_out[0], r.jpeg_bytes[1],
+               r.psnr_in[1], r.psnr_out[1]);
+    }
+
+    // The split follows the region's share of each frame's JPEG runs, not
+    // of the frame
+    printf("\n[BENCH] roi: tiles q%d, bytes over %d frames (refresh + updates)\n", config.quality, BENCH_FRAMES);
+    printf("  scene     share   plain bytes     roi bytes   change\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        printf("  %-8s  %4.1f%%  %12zu  %12zu  %+6.1f%%\n", SCENES[i], r.share * 100, r.tile_bytes[0],
+               r.tile_bytes[1], 100.0 * (static_cast<double>(r.tile_bytes[1]) / r.tile_bytes[0] - 1));
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// h264: codec h264 round trip. The scene is encoded from BGRA and from I420
+// planes, at constant quality and under a VBV cap; each stream is written
+// as codec_config followed by the access units with their in-band SPS/PPS
+// removed, decoded with ffmpeg and compared with the source frames.
+// ---------------------------------------------------------------------------
+
+// Frames per run, and the keyframe interval that puts several IDRs in it
+constexpr int H264_FRAMES = 24;
+constexpr int H264_KEYINT = 10;
+
+// VBV run bitrate when encoding.h264.bitrate_kbps is 0
+constexpr int H264_BENCH_KBPS = 8000;
+
+// Frame rate the VBV buffer is sized for when capture is unthrottled, as
+// in the encoder
+constexpr int H264_BENCH_FPS = 60;
+
+// A constant-quality round trip below this PSNR counts as failed. Runs
+// under a VBV cap are instead checked against the cap: every frame within
+// the one-frame buffer (bitrate / fps)
+constexpr double H264_MIN_PSNR = 30.0;
+
+// NAL unit types (H.264 table 7-1)
+constexpr int H264_NAL_IDR = 5;
+constexpr int H264_NAL_SPS = 7;
+constexpr int H264_NAL_PPS = 8;
+
+#ifdef HAVE_X264
+// Written by the benchmark in the temp directory, the stream of the last run
+static const char *H264_STREAM_NAME = "distance_h264.h264";
+
+// Append the NAL units of Annex B `data` to `stream` with 4-byte start
+// codes, leaving SPS and PPS out if `drop_setup`. Returns a bit per NAL
+// unit type found.
+static uint32_t append_nal_units(const uint8_t *data, size_t size, bool drop_setup, std::vector<uint8_t> &stream) {
+    static const uint8_t START_CODE[] = {0, 0, 0, 1};
+    auto find_start = [&](size_t from) {
+        for (size_t i = from; i + 3 <= size; i++) {
+            if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) return i;
+        }
+        return size;
+    };
+
+    uint32_t types = 0;
+    for (size_t start = find_start(0); start < size;) {
+        size_t begin = start + 3;
+        size_t next = find_start(begin);
+        // A NAL unit never ends in a zero byte; those lead a 4-byte start code
+        size_t end = next;
+        while (next < size && end > begin && data[end - 1] == 0) end--;
+        if (end > begin) {
+            int type = data[begin] & 0x1F;
+            types |= 1u << type;
+            if (!drop_setup || (type != H264_NAL_SPS && type != H264_NAL_PPS)) {
+                stream.insert(stream.end(), START_CODE, START_CODE + sizeof(START_CODE));
+                stream.insert(stream.end(), data + begin, data + end);
+            }
+        }
+        start = next;
+    }
+    return types;
+}
+
+// Decode an Annex B file with ffmpeg into BGRA frames of width x height.
+// False if ffmpeg could not be run or reported an error.
+static bool h264_decode(const char *path, int width, int height, std::vector<std::vector<uint8_t>> &frames) {
+    char command[512];
+    snprintf(command, sizeof(command), "ffmpeg -nostdin -v error -f h264 -i \"%s\" -f rawvideo -pix_fmt bgra -",
+             path);
+#ifdef _WIN32
+    FILE *pipe = _popen(command, "rb");
+#else
+    FILE *pipe = popen(command, "r");
+#endif
+    if (!pipe) {
+        return false;
+    }
+    std::vector<uint8_t> frame(static_cast<size_t>(width) * height * 4);
+    while (fread(frame.data(), 1, frame.size(), pipe) == frame.size()) {
+        frames.push_back(frame);
+    }
+#ifdef _WIN32
+    return _pclose(pipe) == 0;
+#else
+    return pclose(pipe) == 0;
+#endif
+}
+#endif
+
+static int bench_h264(const EncoderConfig &config) {
+#ifndef HAVE_X264
+    (void)config;
+    printf("[BENCH] h264: codec h264 not built (needs libx264)\n");
+    return 1;
+#else
+    // 4:2:0 needs even sizes
+    int width = config.width & ~1, height = config.height & ~1;
+    int fps = config.fps > 0 ? config.fps : H264_BENCH_FPS;
+    int kbps = config.h264_bitrate_kbps > 0 ? config.h264_bitrate_kbps : H264_BENCH_KBPS;
+
+    EncoderConfig cfg = config;
+    cfg.codec = "h264";
+    cfg.width = width;
+    cfg.height = height;
+    cfg.fps = fps;
+    cfg.h264_keyint = H264_KEYINT;
+
+    FramePool pool(H264_FRAMES, static_cast<size_t>(width) * height * 4);
+    std::vector<FrameLease> frames;
+    if (!render_frames(cfg, pool, frames, H264_FRAMES)) {
+        return 1;
+    }
+    FramePool yuv_pool(1, yuv_frame_size(PixelFormat::I420, width, height));
+    FrameLease planar = yuv_pool.acquire();
+    FramePool out_pool(1, DEFAULT_FRAME_SIZE);
+    FrameLease out = out_pool.acquire();
+
+    struct Run {
+        const char *name;
+        bool planar;       // from I420 planes (the convert stage) instead of BGRA
+        int bitrate_kbps;  // 0: constant quality
+    };
+    const Run runs[] = {{"crf bgra", false, 0}, {"crf i420", true, 0}, {"vbv i420", true, kbps}};
+
+    printf("\n[BENCH] h264: %dx%d '%s', %d frames, %s/%s keyint %d, q%d / %d kbps at %d fps\n", width, height,
+           config.scene.c_str(), H264_FRAMES, config.h264_preset.c_str(), config.h264_profile.c_str(), H264_KEYINT,
+           config.quality, kbps, fps);
+    printf("  run       ms/frame   bytes/frame  max frame kbit   kbps  idr  config  decoded  min dB  mean dB  ok\n");
+
+    std::string stream_path = bench_temp_path(H264_STREAM_NAME);
+    bool all_ok = true;
+    for (const Run &run : runs) {
+        cfg.h264_bitrate_kbps = run.bitrate_kbps;
+        auto encoder = create_frame_encoder(cfg.codec);
+        if (!encoder) {
+            return 1;
+        }
+        encoder->configure(cfg);
+        if (!encoder->init(width, height)) {
+            return 1;
+        }
+        YuvConverter converter;
+        if (run.planar && !converter.init(width, height, encoder->input_format())) {
+            return 1;
+        }
+
+        // Every access unit starts with a start code; IDRs and only IDRs are
+        // keyframes and repeat SPS/PPS in-band; codec_config is just SPS and
+        // PPS, the same every frame, and fits the shared memory header
+        std::vector<uint8_t> stream;
+        std::vector<uint8_t> codec_config;
+        bool ok = true;
+        int keyframes = 0;
+        size_t bytes = 0, max_bytes = 0;
+        uint64_t busy = 0;
+        for (int i = 0; i < H264_FRAMES; i++) {
+            const FrameBuffer *input = frames[i].operator->();
+            if (run.planar) {
+                converter.update(*frames[i]);
+                if (!converter.write_to(*frames[i], *planar)) {
+                    return 1;
+                }
+                input = planar.operator->();
+            }
+            uint64_t t0 = steady_now_us();
+            if (!encoder->encode(*input, *out)) {
+                printf("[BENCH] h264: frame %d failed to encode\n", i);
+                return 1;
+            }
+            busy += steady_now_us() - t0;
+            bytes += out->size;
+            max_bytes = std::max(max_bytes, out->size);
+
+            if (i == 0) {
+                codec_config = out->codec_config;
+                uint32_t setup = append_nal_units(codec_config.data(), codec_config.size(), false, stream);
+                ok = ok && setup == ((1u << H264_NAL_SPS) | (1u << H264_NAL_PPS)) &&
+                     codec_config.size() <= static_cast<size_t>(SHM_CODEC_CONFIG_SIZE);
+            }
+            ok = ok && out->format == PixelFormat::H264 && out->codec_config == codec_config && out->size > 4 &&
+                 out->data[0] == 0 && out->data[1] == 0 && (out->data[2] == 1 || (out->data[2] == 0 && out->data[3] == 1));
+            uint32_t types = append_nal_units(out->data, out->size, true, stream);
+            bool idr = (types & (1u << H264_NAL_IDR)) != 0;
+            ok = ok && idr == out->keyframe && (!idr || (types & (1u << H264_NAL_SPS))) && (i > 0 || idr);
+            keyframes += out->keyframe;
+        }
+        encoder->shutdown();
+
+        FILE *file = fopen(stream_path.c_str(), "wb");
+        if (!file || fwrite(stream.data(), 1, stream.size(), file) != stream.size()) {
+            printf("[BENCH] Could not write %s\n", stream_path.c_str());
+            if (file) fclose(file);
+            return 1;
+        }
+        fclose(file);
+
+        std::vector<std::vector<uint8_t>> decoded;
+        bool decodes = h264_decode(stream_path.c_str(), width, height, decoded) &&
+                       decoded.size() == static_cast<size_t>(H264_FRAMES);
+        double min_psnr = decodes ? 99.0 : 0, sum_psnr = 0;
+        for (size_t i = 0; i < decoded.size() && i < frames.size(); i++) {
+            double psnr = bgra_psnr(decoded[i], *frames[i]);
+            min_psnr = std::min(min_psnr, psnr);
+            sum_psnr += psnr;
+        }
+        size_t vbv_bits = static_cast<size_t>(run.bitrate_kbps) * 1000 / fps;
+        ok = ok && decodes && (run.bitrate_kbps > 0 ? max_bytes * 8 <= vbv_bits : min_psnr >= H264_MIN_PSNR);
+        all_ok = all_ok && ok;
+
+        printf("  %-8s  %8.2f  %12zu  %14.1f  %5.0f  %3d  %6zu  %7zu  %6.1f  %7.1f  %s\n", run.name,
+               busy / 1000.0 / H264_FRAMES, bytes / H264_FRAMES, max_bytes * 8 / 1000.0,
+               bytes * 8.0 * fps / 1000.0 / H264_FRAMES, keyframes, codec_config.size(), decoded.size(), min_psnr,
+               decoded.empty() ? 0.0 : sum_psnr / decoded.size(), ok ? "yes" : "NO");
+    }
+    if (!all_ok) {
+        printf("  (decoded with ffmpeg from PATH; the last stream is in %s)\n", stream_path.c_str());
+    }
+    return all_ok ? 0 : 1;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+
+int run_benchmark(const std::string &name, const EncoderConfig &options) {
+    // Frames are -w x -h, or the synthetic screen size without them
+    EncoderConfig config = options;
+    if (config.width <= 0 || config.height <= 0) {
+        config.width = config.synthetic_width;
+        config.height = config.synthetic_height;
+    }
+
+    if (name == "jpeg-strips") {
+        return bench_jpeg_strips(config);
+    } else if (name == "tile-diff") {
+        return bench_tile_diff(config);
+    } else if (name == "frame-hash") {
+        return bench_frame_hash(config);
+    } else if (name == "tile-classify") {
+        return bench_tile_classify(config);
+    } else if (name == "lossless") {
+        return bench_lossless(config);
+    } else if (name == "motion") {
+        return bench_motion(config);
+    } else if (name == "scale") {
+        return bench_scale(config);
+    } else if (name == "yuv") {
+        return bench_yuv(config);
+    } else if (name == "rate") {
+        return bench_rate(config);
+    } else if (name == "chroma") {
+        return bench_chroma(config);
+    } else if (name == "roi") {
+        return bench_roi(config);
+    } else if (name == "h264") {
+        return bench_h264(config);
+    }
+
+    printf("[BENCH] Unknown benchmark: %s\n", name.c_str());
+    list_benchmarks();
+    return 1;
+}
+
+void list_benchmarks() {
+    printf("Available benchmarks:\n");
+    printf("  jpeg-strips   strip-parallel JPEG, 1..N threads (-w/-h, --scene, --threads N, --slices N)\n");
+    printf("  tile-diff     tile change detection per SIMD kernel, 1..N threads, 4K BGRA with padded stride\n");
+    printf("  frame-hash    dedup content hash per SIMD kernel, 4K BGRA with padded stride\n");
+    printf("  tile-classify text/photo tile classifier cost and hybrid vs JPEG bytes (-w/-h, -q)\n");
+    printf("  lossless      codec lossless vs JPEG q95 and PNG, keyframes and updates (-w/-h)\n");
+    printf("  motion        copy records for scrolls and window moves, on vs off per tile codec (-w/-h)\n");
+    printf("  scale         5K capture downscaled to -w/-h per filter and SIMD kernel (--threads N), vs full-size JPEG\n");
+    printf("  yuv           BGRA -> I420/I444 per SIMD kernel, damage-only updates, JPEG from planes vs BGRA (-w/-h)\n");
+    printf("  rate          JPEG size model vs measured, closed-loop rate control over scene changes (-w/-h, rate.*)\n");
+    printf("  chroma        chroma detail analysis, JPEG bytes/PSNR per subsampling and auto, text vs photo scenes (-w/-h, -q)\n");
+    printf("  roi           pointer region: smoothing cost, JPEG and tile bytes/PSNR with vs without (-w/-h, -q, roi.*)\n");
+    printf("  h264          codec h264 round trip from BGRA and I420, crf and vbv, decoded with ffmpeg (-w/-h, -q, h264.*)\n");
+}
@@ -0,0 +1,14 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <string>
+#include "config.hpp"
+
+// Offline micro-benchmarks over synthetic content (--bench <name>). Each
+// prints a table and returns a process exit code.
+int run_benchmark(const std::string &name, const EncoderConfig &config);
+
+// List benchmark names
+void list_benchmarks();
+
+#endif
@@ -1,6 +1,10 @@
 #include <cstdio>
 #include "capture.hpp"
 
+// Portable backends, compiled on every platform.
+std::unique_ptr<CaptureBackend> create_synthetic_backend();
+std::unique_ptr<CaptureBackend> create_replay_backend();
+
 // Platform-specific backend factory declarations.
 // Only the backends compiled for the current platform are declared here.
 #ifdef _WIN32
@@ -12,7 +16,17 @@ std::unique_ptr<CaptureBackend> create_dxgi_backend();
 std::unique_ptr<CaptureBackend> create_macos_backend();
 #endif
 
+#ifdef __linux__
+std::unique_ptr<CaptureBackend> create_x11shm_backend();
+#endif
+
 std::unique_ptr<CaptureBackend> create_capture_backend(const std::string &name) {
+    if (name == "synthetic") {
+        return create_synthetic_backend();
+    } else if (name == "replay") {
+        return create_replay_backend();
+    }
+
 #ifdef _WIN32
     if (name == "gdi") {
         auto backend = create_gdi_backend();
@@ -36,6 +50,15 @@ std::unique_ptr<CaptureBackend> create_capture_backend(const std::string &name)
     }
 #endif
 
+#ifdef __linux__
+    if (name == "x11shm") {
+        auto backend = create_x11shm_backend();
+        if (backend && backend->is_available()) return backend;
+        printf("[CAPTURE] Backend 'x11shm' not available\n");
+        return nullptr;
+    }
+#endif
+
     printf("[CAPTURE] Unknown backend: %s\n", name.c_str());
     return nullptr;
 }
@@ -43,6 +66,9 @@ std::unique_ptr<CaptureBackend> create_capture_backend(const std::string &name)
 void list_capture_backends() {
     printf("Available capture backends:\n");
 
+    { auto b = create_synthetic_backend(); if (b) printf("  synthetic %s\n", b->is_available() ? "(available)" : "(not available)"); }
+    { auto b = create_replay_backend();    if (b) printf("  replay %s\n",    b->is_available() ? "(available)" : "(not available)"); }
+
 #ifdef _WIN32
     { auto b = create_gdi_backend();  if (b) printf("  gdi  %s\n",  b->is_available() ? "(available)" : "(not available)"); }
     { auto b = create_dxgi_backend(); if (b) printf("  dxgi %s\n",  b->is_available() ? "(available)" : "(not available)"); }
@@ -51,4 +77,8 @@ void list_capture_backends() {
 #ifdef __APPLE__
     { auto b = create_macos_backend(); if (b) printf("  macos %s\n", b->is_available() ? "(available)" : "(not available)"); }
 #endif
+
+#ifdef __linux__
+    { auto b = create_x11shm_backend(); if (b) printf("  x11shm %s\n", b->is_available() ? "(available)" : "(not available)"); }
+#endif
 }
@@ -5,6 +5,9 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include "config.hpp"
+#include "cursor.hpp"
+#include "frame.hpp"
 
 // Abstract base class for capture backends
 class CaptureBackend {
@@ -17,11 +20,30 @@ public:
     // Check if backend is available on this system
     virtual bool is_available() const = 0;
 
+    // Apply encoder settings before init(). Backends that need more than
+    // the monitor index (fps, quality, synthetic scene...) override this.
+    virtual void configure(const EncoderConfig &) {}
+
     // Initialize capture (returns actual capture dimensions)
     virtual bool init(int monitor, int &out_width, int &out_height) = 0;
 
-    // Capture a frame (returns allocated buffer, caller must free)
-    virtual uint8_t* capture(int &out_size) = 0;
+    // Capture raw pixels into `frame`, a lease from the pipeline's raw pool
+    // sized for the init() dimensions, and fill in format, width, height,
+    // stride and damage. Backends with their own buffers may replace the
+    // lease. Returns false if there is no new frame.
+    virtual bool capture(FrameLease &frame) = 0;
+
+    // True if capture() always replaces the lease with one of the backend's
+    // own buffers. The pipeline then allocates no raw frames and passes an
+    // empty lease.
+    virtual bool provides_buffers() const { return false; }
+
+    // Cursor channel (capture.cursor): update `cursor`, the state from the
+    // previous call, with the pointer as it is now. Replace cursor.shape only
+    // when the shape changed. Called from the capture thread after every
+    // capture() attempt, frame or not, so the pointer keeps moving while
+    // the screen is still. Returns false if the backend can't report it.
+    virtual bool query_cursor(CursorState &) { return false; }
 
     // Shutdown and cleanup
     virtual void shutdown() = 0;
@@ -4,12 +4,22 @@
 #include <windows.h>
 #include <d3d11.h>
 #include <dxgi1_2.h>
-#include <turbojpeg.h>
 #include <wrl/client.h>
 #include "../capture.hpp"
 
 using Microsoft::WRL::ComPtr;
 
+// Rectangle of the foreground window relative to (origin_x, origin_y),
+// empty if there is none
+static CaptureRect foreground_window(int origin_x, int origin_y) {
+    RECT r;
+    HWND window = GetForegroundWindow();
+    if (!window || !GetWindowRect(window, &r)) {
+        return {0, 0, 0, 0};
+    }
+    return {r.left - origin_x, r.top - origin_y, r.right - r.left, r.bottom - r.top};
+}
+
 class DXGIBackend : public CaptureBackend {
 public:
     DXGIBackend() = default;
@@ -41,6 +51,11 @@ public:
         return SUCCEEDED(hr);
     }
 
+    void configure(const EncoderConfig &config) override {
+        track_focus = config.roi_focus;
+        cursor_channel = config.cursor;
+    }
+
     bool init(int monitor, int &out_width, int &out_height) override {
         HRESULT hr;
 
@@ -98,6 +113,8 @@ public:
 
         width = output_desc.DesktopCoordinates.right - output_desc.DesktopCoordinates.left;
         height = output_desc.DesktopCoordinates.bottom - output_desc.DesktopCoordinates.top;
+        origin_x = output_desc.DesktopCoordinates.left;
+        origin_y = output_desc.DesktopCoordinates.top;
 
         printf("[DXGI] Monitor %d: %dx%d\n", monitor, width, height);
 
@@ -133,25 +150,19 @@ public:
             return false;
         }
 
-        // Initialize TurboJPEG
-        compressor = tjInitCompress();
-        if (!compressor) {
-            printf("[DXGI] TurboJPEG init failed\n");
-            return false;
-        }
-
-        // Allocate buffer
-        jpeg_buffer = new unsigned char[10 * 1024 * 1024];
-
         out_width = width;
         out_height = height;
 
         return true;
     }
 
-    uint8_t* capture(int &out_size) override {
-        if (!duplication || !compressor) {
-            return nullptr;
+    bool capture(FrameLease &frame) override {
+        if (!duplication) {
+            return false;
+        }
+        if (frame->capacity < static_cast<size_t>(width) * height * 4) {
+            printf("[DXGI] Frame buffer too small for %dx%d\n", width, height);
+            return false;
         }
 
         HRESULT hr;
@@ -162,11 +173,31 @@ public:
         hr = duplication->AcquireNextFrame(100, &frame_info, &desktop_resource);
         if (hr == DXGI_ERROR_WAIT_TIMEOUT) {
             // No new frame, try again
-            return nullptr;
+            return false;
         }
         if (FAILED(hr)) {
             printf("[DXGI] Failed to acquire next frame: 0x%lx\n", hr);
-            return nullptr;
+            return false;
+        }
+
+        // The pointer only comes with frames where it moved; keep the last
+        // known position (top-left of its shape) for the others
+        if (frame_info.LastMouseUpdateTime.QuadPart != 0) {
+            pointer_visible = frame_info.PointerPosition.Visible != FALSE;
+            pointer_x = frame_info.PointerPosition.Position.x;
+            pointer_y = frame_info.PointerPosition.Position.y;
+        }
+        // A new shape comes with the frame it changed in, readable until
+        // ReleaseFrame()
+        if (cursor_channel && frame_info.PointerShapeBufferSize > 0) {
+            update_pointer_shape(frame_info.PointerShapeBufferSize);
+        }
+        // Duplication leaves the pointer out of the image, so a frame where
+        // only the pointer moved has nothing new for the cursor channel's
+        // consumers: skip the copy and the encode
+        if (cursor_channel && frame_info.LastPresentTime.QuadPart == 0 && have_image) {
+            duplication->ReleaseFrame();
+            return false;
         }
 
         // Get texture from resource
@@ -175,7 +206,7 @@ public:
         if (FAILED(hr)) {
             printf("[DXGI] Failed to get texture from resource: 0x%lx\n", hr);
             duplication->ReleaseFrame();
-            return nullptr;
+            return false;
         }
 
         // Copy to staging texture
@@ -187,26 +218,16 @@ public:
         if (FAILED(hr)) {
             printf("[DXGI] Failed to map staging texture: 0x%lx\n", hr);
             duplication->ReleaseFrame();
-            return nullptr;
+            return false;
         }
 
-        // Encode to JPEG
-        unsigned char *jpeg_ptr = jpeg_buffer;
-        unsigned long jpeg_size_val = jpeg_size;
-
-        int result = tjCompress2(
-            compressor,
-            static_cast<unsigned char*>(mapped.pData),
-            width,
-            mapped.RowPitch,
-            height,
-            TJPF_BGRA,  // DXGI gives BGRA
-            &jpeg_ptr,
-            &jpeg_size_val,
-            TJSAMP_420,
-            75,  // quality
-            TJFLAG_FASTDCT
-        );
+        // Copy rows out of the staging texture into the pooled frame; the
+        // mapping's RowPitch is usually wider than the frame
+        const uint8_t *src = static_cast<const uint8_t*>(mapped.pData);
+        size_t row_bytes = static_cast<size_t>(width) * 4;
+        for (int y = 0; y < height; y++) {
+            memcpy(frame->data + y * row_bytes, src + static_cast<size_t>(y) * mapped.RowPitch, row_bytes);
+        }
 
         // Unmap staging texture
         d3d_context->Unmap(staging_texture.Get(), 0);
@@ -214,29 +235,39 @@ public:
         // Release frame
         duplication->ReleaseFrame();
 
-        if (result != 0) {
-            printf("[DXGI] TurboJPEG compression failed: %s\n", tjGetErrorStr());
-            return nullptr;
+        have_image = true;
+        frame->size = row_bytes * height;
+        frame->format = PixelFormat::BGRA;  // DXGI gives BGRA
+        frame->width = width;
+        frame->height = height;
+        frame->stride = static_cast<int>(row_bytes);
+        if (pointer_visible && pointer_x >= 0 && pointer_y >= 0 && pointer_x < width && pointer_y < height) {
+            frame->cursor_x = pointer_x;
+            frame->cursor_y = pointer_y;
+        }
+        if (track_focus) {
+            frame->focus = foreground_window(origin_x, origin_y);
         }
 
-        // Copy JPEG to output buffer
-        uint8_t *output = new uint8_t[jpeg_size_val];
-        memcpy(output, jpeg_buffer, jpeg_size_val);
-        out_size = static_cast<int>(jpeg_size_val);
-
-        return output;
+        return true;
     }
 
-    void shutdown() override {
-        if (jpeg_buffer) {
-            delete[] jpeg_buffer;
-            jpeg_buffer = nullptr;
-        }
-        if (compressor) {
-            tjDestroy(compressor);
-            compressor = nullptr;
+    // Position and shape as of the last frame acquired; the shape's hot spot
+    // turns the top-left DXGI reports into the pointer position
+    bool query_cursor(CursorState &cursor) override {
+        if (!duplication || !cursor_channel) {
+            return false;
         }
+        cursor.visible = pointer_visible;
+        cursor.x = pointer_x + (pointer_shape ? pointer_shape->hot_x : 0);
+        cursor.y = pointer_y + (pointer_shape ? pointer_shape->hot_y : 0);
+        cursor.shape = pointer_shape;
+        return true;
+    }
 
+    void shutdown() override {
+        pointer_shape.reset();
+        have_image = false;
         staging_texture.Reset();
         duplication.Reset();
         d3d_context.Reset();
@@ -244,16 +275,59 @@ public:
     }
 
 private:
+    void update_pointer_shape(UINT size) {
+        shape_buffer.resize(size);
+        DXGI_OUTDUPL_POINTER_SHAPE_INFO info;
+        UINT required = 0;
+        HRESULT hr = duplication->GetFramePointerShape(size, shape_buffer.data(), &required, &info);
+        if (FAILED(hr)) {
+            printf("[DXGI] Failed to get pointer shape: 0x%lx\n", hr);
+            return;
+        }
+
+        auto shape = std::make_shared<CursorImage>();
+        shape->hot_x = info.HotSpot.x;
+        shape->hot_y = info.HotSpot.y;
+        const uint8_t *data = shape_buffer.data();
+        switch (info.Type) {
+        case DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MONOCHROME:
+            // AND mask rows, then as many XOR mask rows
+            cursor_from_masks(data, data + static_cast<size_t>(info.Pitch) * (info.Height / 2), info.Pitch,
+                              info.Width, info.Height / 2, *shape);
+            break;
+        case DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR:
+            cursor_from_bgra(data, info.Pitch, info.Width, info.Height, false, *shape);
+            break;
+        case DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MASKED_COLOR:
+            cursor_from_masked_color(data, info.Pitch, info.Width, info.Height, *shape);
+            break;
+        default:
+            return;
+        }
+        pointer_shape = shape;
+    }
+
     ComPtr<ID3D11Device> d3d_device;
     ComPtr<ID3D11DeviceContext> d3d_context;
     ComPtr<IDXGIOutputDuplication> duplication;
     ComPtr<ID3D11Texture2D> staging_texture;
 
-    tjhandle compressor = nullptr;
+    // Output position on the virtual desktop, and the pointer on it
+    int origin_x = 0;
+    int origin_y = 0;
+    bool pointer_visible = false;
+    int pointer_x = -1;
+    int pointer_y = -1;
+    bool track_focus = false;  // encoding.roi.focus
+
+    // Cursor channel (capture.cursor)
+    bool cursor_channel = false;
+    bool have_image = false;  // a frame was copied since init
+    std::shared_ptr<const CursorImage> pointer_shape;
+    std::vector<uint8_t> shape_buffer;
+
     int width = 0;
     int height = 0;
-    unsigned char *jpeg_buffer = nullptr;
-    unsigned long jpeg_size = 10 * 1024 * 1024;
 };
 
 std::unique_ptr<CaptureBackend> create_dxgi_backend() {
@@ -2,7 +2,6 @@
 #include <cstdlib>
 #include <cstring>
 #include <windows.h>
-#include <turbojpeg.h>
 #include "../capture.hpp"
 
 class GDIBackend : public CaptureBackend {
@@ -19,6 +18,11 @@ public:
         return true;
     }
 
+    void configure(const EncoderConfig &config) override {
+        track_focus = config.roi_focus;
+        cursor_channel = config.cursor;
+    }
+
     bool init(int monitor, int &out_width, int &out_height) override {
         // TODO: Handle multiple monitors
         if (monitor != 0) {
@@ -32,16 +36,15 @@ public:
 
         printf("[GDI] Screen: %dx%d\n", width, height);
 
-        // Initialize TurboJPEG
-        compressor = tjInitCompress();
-        if (!compressor) {
-            printf("[GDI] TurboJPEG init failed\n");
+        // Keep the memory DC and bitmap for the whole session
+        screen_dc = GetDC(nullptr);
+        mem_dc = CreateCompatibleDC(screen_dc);
+        bitmap = CreateCompatibleBitmap(screen_dc, width, height);
+        if (!bitmap) {
+            printf("[GDI] CreateCompatibleBitmap failed\n");
             return false;
         }
-
-        // Allocate buffers (4K max)
-        rgb_buffer = new unsigned char[4096 * 2160 * 3];
-        jpeg_buffer = new unsigned char[10 * 1024 * 1024];
+        SelectObject(mem_dc, bitmap);
 
         out_width = width;
         out_height = height;
@@ -49,24 +52,18 @@ public:
         return true;
     }
 
-    uint8_t* capture(int &out_size) override {
-        if (!compressor) {
-            return nullptr;
+    bool capture(FrameLease &frame) override {
+        if (!bitmap) {
+            return false;
         }
 
-        // Get screen DC
-        HDC screen_dc = GetDC(nullptr);
-        HDC mem_dc = CreateCompatibleDC(screen_dc);
-        HBITMAP bitmap = CreateCompatibleBitmap(screen_dc, width, height);
-
-        if (!bitmap) {
-            printf("[GDI] CreateCompatibleBitmap failed\n");
-            ReleaseDC(nullptr, screen_dc);
-            DeleteDC(mem_dc);
-            return nullptr;
+        // DIB rows are DWORD-aligned
+        int pitch = (width * 3 + 3) & ~3;
+        if (frame->capacity < static_cast<size_t>(pitch) * height) {
+            printf("[GDI] Frame buffer too small for %dx%d\n", width, height);
+            return false;
         }
 
-        SelectObject(mem_dc, bitmap);
         BitBlt(mem_dc, 0, 0, width, height, screen_dc, 0, 0, SRCCOPY);
 
         // Get bitmap bits (BGR format from Windows)
@@ -78,75 +75,154 @@ public:
         bmi.biBitCount = 24;
         bmi.biCompression = BI_RGB;
 
-        if (!GetDIBits(mem_dc, bitmap, 0, height, rgb_buffer, reinterpret_cast<BITMAPINFO *>(&bmi), DIB_RGB_COLORS)) {
+        // Straight into the pooled frame
+        if (!GetDIBits(mem_dc, bitmap, 0, height, frame->data, reinterpret_cast<BITMAPINFO *>(&bmi), DIB_RGB_COLORS)) {
             printf("[GDI] GetDIBits failed\n");
-            DeleteObject(bitmap);
-            DeleteDC(mem_dc);
-            ReleaseDC(nullptr, screen_dc);
-            return nullptr;
+            return false;
         }
 
-        // Encode to JPEG (quality 75)
-        unsigned char *jpeg_ptr = jpeg_buffer;
-        unsigned long jpeg_size_val = jpeg_size;
-
-        int result = tjCompress2(
-            compressor,
-            rgb_buffer,
-            width,
-            0,  // pitch (0 = width * 3)
-            height,
-            TJPF_BGR,  // Windows gives BGR
-            &jpeg_ptr,
-            &jpeg_size_val,
-            TJSAMP_420,
-            75,  // quality
-            TJFLAG_FASTDCT
-        );
-
-        if (result != 0) {
-            printf("[GDI] TurboJPEG compression failed: %s\n", tjGetErrorStr());
-            DeleteObject(bitmap);
-            DeleteDC(mem_dc);
-            ReleaseDC(nullptr, screen_dc);
-            return nullptr;
+        frame->size = static_cast<size_t>(pitch) * height;
+        frame->format = PixelFormat::BGR;  // Windows gives BGR
+        frame->width = width;
+        frame->height = height;
+        frame->stride = pitch;
+
+        // BitBlt leaves the pointer out; report where it is instead
+        POINT pointer;
+        if (GetCursorPos(&pointer) && pointer.x >= 0 && pointer.y >= 0 && pointer.x < width && pointer.y < height) {
+            frame->cursor_x = pointer.x;
+            frame->cursor_y = pointer.y;
+        }
+        RECT window;
+        HWND foreground = track_focus ? GetForegroundWindow() : nullptr;
+        if (foreground && GetWindowRect(foreground, &window)) {
+            frame->focus = {window.left, window.top, window.right - window.left, window.bottom - window.top};
         }
 
-        // Copy JPEG to output buffer
-        uint8_t *output = new uint8_t[jpeg_size_val];
-        memcpy(output, jpeg_buffer, jpeg_size_val);
-        out_size = static_cast<int>(jpeg_size_val);
-
-        // Cleanup
-        DeleteObject(bitmap);
-        DeleteDC(mem_dc);
-        ReleaseDC(nullptr, screen_dc);
+        return true;
+    }
 
-        return output;
+    // BitBlt leaves the pointer out; its image is converted again only when
+    // the cursor handle changes
+    bool query_cursor(CursorState &cursor) override {
+        if (!cursor_channel || !mem_dc) {
+            return false;
+        }
+        CURSORINFO info = {};
+        info.cbSize = sizeof(info);
+        if (!GetCursorInfo(&info)) {
+            return false;
+        }
+        cursor.x = info.ptScreenPos.x;
+        cursor.y = info.ptScreenPos.y;
+        cursor.visible = (info.flags & CURSOR_SHOWING) && cursor.x >= 0 && cursor.y >= 0 && cursor.x < width &&
+                         cursor.y < height;
+        if (info.hCursor && (info.hCursor != cursor_handle || !cursor.shape)) {
+            auto shape = cursor_image(info.hCursor);
+            if (shape) {
+                cursor.shape = shape;
+                cursor_handle = info.hCursor;
+            }
+        }
+        return true;
     }
 
     void shutdown() override {
-        if (jpeg_buffer) {
-            delete[] jpeg_buffer;
-            jpeg_buffer = nullptr;
+        cursor_handle = nullptr;
+        if (bitmap) {
+            DeleteObject(bitmap);
+            bitmap = nullptr;
         }
-        if (rgb_buffer) {
-            delete[] rgb_buffer;
-            rgb_buffer = nullptr;
+        if (mem_dc) {
+            DeleteDC(mem_dc);
+            mem_dc = nullptr;
         }
-        if (compressor) {
-            tjDestroy(compressor);
-            compressor = nullptr;
+        if (screen_dc) {
+            ReleaseDC(nullptr, screen_dc);
+            screen_dc = nullptr;
         }
     }
 
 private:
-    tjhandle compressor = nullptr;
+    // A cursor's image from its mask bitmap (1 bpp: AND rows, then XOR rows
+    // for monochrome cursors) and color bitmap, if any. Color bitmaps
+    // without alpha take it from the AND mask.
+    std::shared_ptr<const CursorImage> cursor_image(HCURSOR handle) {
+        ICONINFO icon;
+        if (!GetIconInfo(handle, &icon)) {
+            return nullptr;
+        }
+        BITMAP mask_bitmap = {};
+        GetObject(icon.hbmMask, sizeof(mask_bitmap), &mask_bitmap);
+        int w = mask_bitmap.bmWidth;
+        int mask_rows = mask_bitmap.bmHeight;
+        int h = icon.hbmColor ? mask_rows : mask_rows / 2;
+
+        auto shape = std::make_shared<CursorImage>();
+        shape->hot_x = static_cast<int>(icon.xHotspot);
+        shape->hot_y = static_cast<int>(icon.yHotspot);
+
+        // DIB rows are DWORD-aligned
+        size_t mask_pitch = static_cast<size_t>((w + 31) / 32) * 4;
+        std::vector<uint8_t> mask(mask_pitch * mask_rows);
+        struct {
+            BITMAPINFOHEADER header;
+            RGBQUAD colors[2];
+        } mono = {};
+        mono.header.biSize = sizeof(BITMAPINFOHEADER);
+        mono.header.biWidth = w;
+        mono.header.biHeight = -mask_rows;  // top-down
+        mono.header.biPlanes = 1;
+        mono.header.biBitCount = 1;
+        mono.header.biCompression = BI_RGB;
+        bool ok = w > 0 && h > 0 &&
+                  GetDIBits(mem_dc, icon.hbmMask, 0, mask_rows, mask.data(), reinterpret_cast<BITMAPINFO *>(&mono),
+                            DIB_RGB_COLORS);
+
+        if (ok && !icon.hbmColor) {
+            cursor_from_masks(mask.data(), mask.data() + mask_pitch * h, mask_pitch, w, h, *shape);
+        } else if (ok) {
+            std::vector<uint8_t> color(static_cast<size_t>(w) * h * 4);
+            BITMAPINFOHEADER bmi = {0};
+            bmi.biSize = sizeof(BITMAPINFOHEADER);
+            bmi.biWidth = w;
+            bmi.biHeight = -h;
+            bmi.biPlanes = 1;
+            bmi.biBitCount = 32;
+            bmi.biCompression = BI_RGB;
+            ok = GetDIBits(mem_dc, icon.hbmColor, 0, h, color.data(), reinterpret_cast<BITMAPINFO *>(&bmi),
+                           DIB_RGB_COLORS) != 0;
+            bool has_alpha = false;
+            for (size_t i = 3; i < color.size() && !has_alpha; i += 4) {
+                has_alpha = color[i] != 0;
+            }
+            for (int y = 0; y < h && !has_alpha; y++) {
+                for (int x = 0; x < w; x++) {
+                    bool and_bit = mask[y * mask_pitch + x / 8] & (0x80 >> (x & 7));
+                    color[(static_cast<size_t>(y) * w + x) * 4 + 3] = and_bit ? 0 : 255;
+                }
+            }
+            if (ok) {
+                cursor_from_bgra(color.data(), static_cast<size_t>(w) * 4, w, h, false, *shape);
+            }
+        }
+
+        DeleteObject(icon.hbmMask);
+        if (icon.hbmColor) {
+            DeleteObject(icon.hbmColor);
+        }
+        return ok ? shape : nullptr;
+    }
+
+    HDC screen_dc = nullptr;
+    HDC mem_dc = nullptr;
+    HBITMAP bitmap = nullptr;
+    bool track_focus = false;  // encoding.roi.focus
+    bool cursor_channel = false;  // capture.cursor
+    HCURSOR cursor_handle = nullptr;  // the one cursor_image() last converted
+
     int width = 0;
     int height = 0;
-    unsigned char *rgb_buffer = nullptr;
-    unsigned char *jpeg_buffer = nullptr;
-    unsigned long jpeg_size = 10 * 1024 * 1024;
 };
 
 std::unique_ptr<CaptureBackend> create_gdi_backend() {
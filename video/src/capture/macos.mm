@@ -1,86 +1,84 @@
 // macOS screen capture backend using ScreenCaptureKit (macOS 12.3+)
-// IPC: Unix domain socket at /tmp/distance_video.sock
-// Wire format: 4-byte big-endian frame length + raw JPEG bytes
+// SCStream delivers frames on its own queue; the receiver keeps only the
+// newest one and capture() copies it into the pipeline's frame lease.
+// Encoding and the agent socket live in the pipeline and SocketTransport.
+//
+// Each frame also carries the pointer position and, with
+// encoding.roi.focus, the frontmost window's bounds (CGWindowList), mapped
+// from global display points to the captured pixels.
+//
+// With the cursor channel (capture.cursor) SCStream leaves the pointer out
+// (showsCursor = NO), so moving it no longer makes new frames, and
+// query_cursor() reports it instead. SCStream has no pointer metadata: the
+// image comes from NSCursor.currentSystemCursor, rendered at the display's
+// pixel scale.
 
 #ifdef __APPLE__
 
 #import <ScreenCaptureKit/ScreenCaptureKit.h>
 #import <CoreVideo/CoreVideo.h>
 #import <CoreMedia/CoreMedia.h>
+#import <CoreGraphics/CoreGraphics.h>
 #import <Foundation/Foundation.h>
-#include <turbojpeg.h>
-#include <sys/socket.h>
-#include <sys/un.h>
-#include <unistd.h>
+#import <AppKit/AppKit.h>
 #include <stdint.h>
-#include <arpa/inet.h>
-#include <signal.h>
 #include <cstdio>
-#include <atomic>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 
 #include "../capture.hpp"
 
-#define UNIX_SOCKET_PATH "/tmp/distance_video.sock"
+// How long capture() waits for SCStream to deliver a frame
+constexpr int FRAME_WAIT_MS = 100;
 
 // ---------------------------------------------------------------------------
-// FrameSender: holds the Unix socket fd and TurboJPEG compressor.
-// Called from SCStream's sample buffer callback on a background queue.
+// FrameReceiver: retains the latest pixel buffer from SCStream's sample
+// buffer callback (background queue) until capture() picks it up.
 // ---------------------------------------------------------------------------
-@interface FrameSender : NSObject <SCStreamOutput>
-@property (nonatomic, assign) int clientFd;
-@property (nonatomic, assign) tjhandle compressor;
-@property (nonatomic, assign) int quality;
-@property (nonatomic, assign) BOOL verbose;
+@interface FrameReceiver : NSObject <SCStreamOutput> {
+@public
+    std::mutex mutex;
+    std::condition_variable ready;
+    CVPixelBufferRef latest;
+}
 @end
 
-@implementation FrameSender
+@implementation FrameReceiver
 
 - (void)stream:(SCStream *)stream
     didOutputSampleBuffer:(CMSampleBufferRef)sampleBuffer
                    ofType:(SCStreamOutputType)type
 {
     if (type != SCStreamOutputTypeScreen) return;
-    if (self.clientFd < 0) return;
 
     CVImageBufferRef imageBuffer = CMSampleBufferGetImageBuffer(sampleBuffer);
     if (!imageBuffer) return;
 
-    CVPixelBufferLockBaseAddress(imageBuffer, kCVPixelBufferLock_ReadOnly);
-
-    size_t width  = CVPixelBufferGetWidth(imageBuffer);
-    size_t height = CVPixelBufferGetHeight(imageBuffer);
-    size_t stride = CVPixelBufferGetBytesPerRow(imageBuffer);
-    uint8_t *data = (uint8_t *)CVPixelBufferGetBaseAddress(imageBuffer);
-
-    unsigned char *jpegBuf = NULL;
-    unsigned long jpegSize = 0;
-
-    int rc = tjCompress2(
-        self.compressor,
-        data,
-        (int)width, (int)stride, (int)height,
-        TJPF_BGRA,
-        &jpegBuf, &jpegSize,
-        TJSAMP_420, self.quality,
-        TJFLAG_FASTDCT
-    );
-
-    CVPixelBufferUnlockBaseAddress(imageBuffer, kCVPixelBufferLock_ReadOnly);
-
-    if (rc != 0 || !jpegBuf) {
-        if (self.verbose) printf("[MACOS] TurboJPEG error: %s\n", tjGetErrorStr());
-        return;
+    // Replace whatever capture() hasn't picked up yet — only the newest frame matters
+    CVPixelBufferRetain(imageBuffer);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (latest) CVPixelBufferRelease(latest);
+        latest = imageBuffer;
     }
+    ready.notify_one();
+}
 
-    // Send: [4-byte big-endian length][jpeg bytes]
-    uint32_t lenBE = htonl((uint32_t)jpegSize);
-    ssize_t sent = send(self.clientFd, &lenBE, 4, 0);
-    if (sent == 4) {
-        send(self.clientFd, jpegBuf, jpegSize, 0);
-    }
+// Take ownership of the newest frame, waiting up to timeout_ms for one
+- (CVPixelBufferRef)takeLatest:(int)timeout_ms {
+    std::unique_lock<std::mutex> lock(mutex);
+    ready.wait_for(lock, std::chrono::milliseconds(timeout_ms), [self] { return latest != nullptr; });
+    CVPixelBufferRef buffer = latest;
+    latest = nullptr;
+    return buffer;
+}
 
-    tjFree(jpegBuf);
+- (void)dealloc {
+    if (latest) CVPixelBufferRelease(latest);
 }
 
 @end
@@ -103,47 +101,17 @@ public:
         return false;
     }
 
-    // init() creates the socket server and waits for the agent to connect,
-    // then starts the SCStream. Dimensions are set from the display.
+    // init() starts the SCStream. Dimensions are set from the display.
     bool init(int monitor, int &out_width, int &out_height) override {
         if (!is_available()) {
             printf("[MACOS] ScreenCaptureKit not available (requires macOS 12.3+)\n");
             return false;
         }
 
-        // Suppress SIGPIPE so a disconnected agent doesn't crash us
-        signal(SIGPIPE, SIG_IGN);
-
-        // Create Unix domain socket server
-        serverFd_ = socket(AF_UNIX, SOCK_STREAM, 0);
-        if (serverFd_ < 0) { perror("[MACOS] socket"); return false; }
-
-        int opt = 1;
-        setsockopt(serverFd_, SOL_SOCKET, SO_NOSIGPIPE, &opt, sizeof(opt));
-
-        struct sockaddr_un addr = {};
-        addr.sun_family = AF_UNIX;
-        strncpy(addr.sun_path, UNIX_SOCKET_PATH, sizeof(addr.sun_path) - 1);
-        unlink(UNIX_SOCKET_PATH);
-
-        if (bind(serverFd_, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-            perror("[MACOS] bind"); return false;
-        }
-        if (listen(serverFd_, 1) < 0) {
-            perror("[MACOS] listen"); return false;
-        }
-
-        printf("[MACOS] Waiting for agent on %s ...\n", UNIX_SOCKET_PATH);
-        clientFd_ = accept(serverFd_, NULL, NULL);
-        if (clientFd_ < 0) { perror("[MACOS] accept"); return false; }
-
-        opt = 1;
-        setsockopt(clientFd_, SOL_SOCKET, SO_NOSIGPIPE, &opt, sizeof(opt));
-        printf("[MACOS] Agent connected\n");
-
         // Get shareable content and start stream
         __block bool success = false;
         __block int bWidth = 0, bHeight = 0;
+        __block CGDirectDisplayID bDisplay = 0;
         dispatch_semaphore_t sem = dispatch_semaphore_create(0);
 
         if (@available(macOS 12.3, *)) {
@@ -162,6 +130,7 @@ public:
 
                     bWidth  = (int)display.width;
                     bHeight = (int)display.height;
+                    bDisplay = display.displayID;
 
                     SCContentFilter *filter =
                         [[SCContentFilter alloc] initWithDisplay:display
@@ -171,14 +140,10 @@ public:
                     cfg.width       = (size_t)bWidth;
                     cfg.height      = (size_t)bHeight;
                     cfg.pixelFormat = kCVPixelFormatType_32BGRA;
-                    cfg.showsCursor = YES;
-                    cfg.minimumFrameInterval = CMTimeMake(1, fps_);
+                    cfg.showsCursor = cursorChannel_ ? NO : YES;
+                    cfg.minimumFrameInterval = fps_ > 0 ? CMTimeMake(1, fps_) : kCMTimeZero;
 
-                    sender_ = [[FrameSender alloc] init];
-                    sender_.clientFd   = clientFd_;
-                    sender_.compressor = tjInitCompress();
-                    sender_.quality    = quality_;
-                    sender_.verbose    = verbose_;
+                    receiver_ = [[FrameReceiver alloc] init];
 
                     stream_ = [[SCStream alloc] initWithFilter:filter
                                                  configuration:cfg
@@ -186,7 +151,7 @@ public:
 
                     NSError *addErr = nil;
                     BOOL added = [stream_
-                        addStreamOutput:sender_
+                        addStreamOutput:receiver_
                                    type:SCStreamOutputTypeScreen
                      sampleHandlerQueue:dispatch_get_global_queue(
                                           DISPATCH_QUEUE_PRIORITY_HIGH, 0)
@@ -222,20 +187,55 @@ public:
 
         captureWidth_  = bWidth;
         captureHeight_ = bHeight;
+        displayID_     = bDisplay;
         out_width  = bWidth;
         out_height = bHeight;
         initialized_ = true;
         return true;
     }
 
-    // capture() is not used in the macOS backend — frames are pushed to the
-    // socket directly from the SCStream callback. Return nullptr to signal
-    // that main.cpp should use the push model for this backend.
-    uint8_t* capture(int &out_size) override {
-        // SCStream pushes frames asynchronously; nothing to poll here.
-        // Sleep to avoid busy-spinning in main.cpp's capture loop.
-        usleep(10000);  // 10ms
-        return nullptr;
+    bool capture(FrameLease &frame) override {
+        if (!initialized_) {
+            return false;
+        }
+
+        CVPixelBufferRef buffer = [receiver_ takeLatest:FRAME_WAIT_MS];
+        if (!buffer) {
+            return false;  // display idle, SCStream sent nothing
+        }
+
+        CVPixelBufferLockBaseAddress(buffer, kCVPixelBufferLock_ReadOnly);
+
+        int width  = (int)CVPixelBufferGetWidth(buffer);
+        int height = (int)CVPixelBufferGetHeight(buffer);
+        size_t src_stride = CVPixelBufferGetBytesPerRow(buffer);
+        const uint8_t *src = (const uint8_t *)CVPixelBufferGetBaseAddress(buffer);
+        size_t row_bytes = (size_t)width * 4;
+
+        bool ok = frame->capacity >= row_bytes * height;
+        if (ok) {
+            for (int y = 0; y < height; y++) {
+                memcpy(frame->data + y * row_bytes, src + y * src_stride, row_bytes);
+            }
+        } else if (verbose_) {
+            printf("[MACOS] Frame buffer too small for %dx%d\n", width, height);
+        }
+
+        CVPixelBufferUnlockBaseAddress(buffer, kCVPixelBufferLock_ReadOnly);
+        CVPixelBufferRelease(buffer);
+
+        if (!ok) {
+            return false;
+        }
+
+        frame->size = row_bytes * height;
+        frame->format = PixelFormat::BGRA;
+        frame->width = width;
+        frame->height = height;
+        frame->stride = (int)row_bytes;
+        locate_pointer(*frame);
+
+        return true;
     }
 
     void shutdown() override {
@@ -243,40 +243,149 @@ public:
             [stream_ stopCaptureWithCompletionHandler:^(NSError *) {}];
             stream_ = nil;
         }
-        if (sender_) {
-            if (sender_.compressor) {
-                tjDestroy(sender_.compressor);
-                sender_.compressor = nullptr;
-            }
-            sender_ = nil;
-        }
-        if (clientFd_ >= 0) { close(clientFd_); clientFd_ = -1; }
-        if (serverFd_ >= 0) { close(serverFd_); serverFd_ = -1; }
-        unlink(UNIX_SOCKET_PATH);
+        receiver_ = nil;
         initialized_ = false;
     }
 
-    // Called by main.cpp to set config before init()
-    void set_config(int fps, int quality, int monitor, bool verbose) {
+    void configure(const EncoderConfig &config) override {
+        set_config(config.fps, config.monitor, config.verbose);
+        trackFocus_ = config.roi_focus;
+        cursorChannel_ = config.cursor;
+    }
+
+    // Called by configure() to set config before init()
+    void set_config(int fps, int monitor, bool verbose) {
         fps_     = fps;
-        quality_ = quality;
         monitor_ = monitor;
         verbose_ = verbose;
     }
 
+    bool query_cursor(CursorState &cursor) override {
+        if (!initialized_ || !cursorChannel_) {
+            return false;
+        }
+        int x, y;
+        cursor.visible = pointer_pixels(captureWidth_, captureHeight_, x, y);
+        cursor.x = cursor.visible ? x : -1;
+        cursor.y = cursor.visible ? y : -1;
+
+        // currentSystemCursor hands out a new object every time, so the
+        // image is rendered on each call and kept only if its hash differs
+        @autoreleasepool {
+            std::shared_ptr<CursorImage> shape = render_system_cursor();
+            if (shape && (!cursor.shape || cursor.shape->hash != shape->hash)) {
+                cursor.shape = shape;
+            }
+        }
+        return true;
+    }
+
 private:
-    int serverFd_      = -1;
-    int clientFd_      = -1;
+    // Pointer position in width x height pixels of the captured display;
+    // false when it is on another display
+    bool pointer_pixels(int width, int height, int &x, int &y) {
+        CGRect bounds = CGDisplayBounds(displayID_);
+        CGEventRef event = CGEventCreate(nullptr);
+        if (!event || bounds.size.width <= 0 || bounds.size.height <= 0) {
+            if (event) CFRelease(event);
+            return false;
+        }
+        CGPoint p = CGEventGetLocation(event);
+        CFRelease(event);
+        x = (int)((p.x - bounds.origin.x) * width / bounds.size.width);
+        y = (int)((p.y - bounds.origin.y) * height / bounds.size.height);
+        return x >= 0 && y >= 0 && x < width && y < height;
+    }
+
+    // The system-wide cursor as BGRA at its bitmap's native resolution
+    // (2x on Retina), hot spot scaled to match
+    std::shared_ptr<CursorImage> render_system_cursor() {
+        NSCursor *current = [NSCursor currentSystemCursor];
+        NSImage *image = current.image;
+        if (!image || image.size.width <= 0 || image.size.height <= 0) {
+            return nullptr;
+        }
+        NSRect rect = NSMakeRect(0, 0, image.size.width, image.size.height);
+        CGImageRef cg = [image CGImageForProposedRect:&rect context:nil hints:nil];
+        if (!cg) {
+            return nullptr;
+        }
+        int w = (int)std::min<size_t>(CGImageGetWidth(cg), CURSOR_MAX_SIZE);
+        int h = (int)std::min<size_t>(CGImageGetHeight(cg), CURSOR_MAX_SIZE);
+        std::vector<uint8_t> pixels((size_t)w * h * 4, 0);
+        CGColorSpaceRef space = CGColorSpaceCreateDeviceRGB();
+        CGContextRef ctx = CGBitmapContextCreate(pixels.data(), w, h, 8, (size_t)w * 4, space,
+                                                 kCGImageAlphaPremultipliedFirst | kCGBitmapByteOrder32Little);
+        CGColorSpaceRelease(space);
+        if (!ctx) {
+            return nullptr;
+        }
+        CGContextDrawImage(ctx, CGRectMake(0, 0, CGImageGetWidth(cg), CGImageGetHeight(cg)), cg);
+        CGContextRelease(ctx);
+
+        auto shape = std::make_shared<CursorImage>();
+        NSPoint hot = current.hotSpot;
+        shape->hot_x = (int)(hot.x * CGImageGetWidth(cg) / image.size.width);
+        shape->hot_y = (int)(hot.y * CGImageGetHeight(cg) / image.size.height);
+        cursor_from_bgra(pixels.data(), (size_t)w * 4, w, h, true, *shape);
+        return shape;
+    }
+
+    // Pointer and frontmost window in frame pixels. Both come in global
+    // display points, top-left origin; the display may be scaled (Retina).
+    void locate_pointer(FrameBuffer &frame) {
+        CGRect bounds = CGDisplayBounds(displayID_);
+        if (bounds.size.width <= 0 || bounds.size.height <= 0) {
+            return;
+        }
+        double sx = frame.width / bounds.size.width, sy = frame.height / bounds.size.height;
+
+        int x, y;
+        if (pointer_pixels(frame.width, frame.height, x, y)) {
+            frame.cursor_x = x;
+            frame.cursor_y = y;
+        }
+
+        if (!trackFocus_) {
+            return;
+        }
+        // On-screen windows come front to back; the first at layer 0 is the
+        // frontmost application window
+        CFArrayRef windows = CGWindowListCopyWindowInfo(
+            kCGWindowListOptionOnScreenOnly | kCGWindowListExcludeDesktopElements, kCGNullWindowID);
+        if (!windows) {
+            return;
+        }
+        for (CFIndex i = 0; i < CFArrayGetCount(windows); i++) {
+            CFDictionaryRef info = (CFDictionaryRef)CFArrayGetValueAtIndex(windows, i);
+            int layer = -1;
+            CFNumberRef layer_number = (CFNumberRef)CFDictionaryGetValue(info, kCGWindowLayer);
+            if (!layer_number || !CFNumberGetValue(layer_number, kCFNumberIntType, &layer) || layer != 0) {
+                continue;
+            }
+            CGRect r;
+            CFDictionaryRef rect = (CFDictionaryRef)CFDictionaryGetValue(info, kCGWindowBounds);
+            if (rect && CGRectMakeWithDictionaryRepresentation(rect, &r)) {
+                frame.focus = {(int)((r.origin.x - bounds.origin.x) * sx), (int)((r.origin.y - bounds.origin.y) * sy),
+                               (int)(r.size.width * sx), (int)(r.size.height * sy)};
+            }
+            break;
+        }
+        CFRelease(windows);
+    }
+
     int captureWidth_  = 0;
     int captureHeight_ = 0;
     int fps_           = 30;
-    int quality_       = 75;
     int monitor_       = 0;
     bool verbose_      = false;
     bool initialized_  = false;
+    bool trackFocus_   = false;  // encoding.roi.focus
+    bool cursorChannel_ = false; // capture.cursor
+    CGDirectDisplayID displayID_ = 0;
 
-    SCStream    *stream_ = nil;
-    FrameSender *sender_ = nil;
+    SCStream      *stream_   = nil;
+    FrameReceiver *receiver_ = nil;
 };
 
 std::unique_ptr<CaptureBackend> create_macos_backend() {
@@ -0,0 +1,288 @@
+// Replay capture backend: streams raw frames from a recording made with
+// --record (format in recording.hpp). The file is memory-mapped and each
+// frame is handed to the pipeline as a lease pointing straight into the
+// mapping, so pages are faulted in on demand with no intermediate copy.
+//
+// Frames are paced by their recorded timestamps (replay.realtime = true) or
+// returned as fast as the main loop asks for them (combine with --fps 0).
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "../capture.hpp"
+#include "../recording.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Mapped frames that can be in the pipeline at once
+constexpr int VIEW_COUNT = 8;
+
+// How long capture() waits for a free view before giving up on this tick
+constexpr int VIEW_WAIT_MS = 50;
+
+class ReplayBackend : public CaptureBackend {
+public:
+    ReplayBackend() = default;
+    ~ReplayBackend() override { shutdown(); }
+
+    const char* get_name() const override {
+        return "replay";
+    }
+
+    bool is_available() const override {
+        // Pure file I/O, always available
+        return true;
+    }
+
+    void configure(const EncoderConfig &config) override {
+        path = config.replay_path;
+        realtime = config.replay_realtime;
+        loop = config.replay_loop;
+    }
+
+    bool init(int, int &out_width, int &out_height) override {
+        if (path.empty()) {
+            printf("[REPLAY] No recording given (--replay <file>)\n");
+            return false;
+        }
+
+        if (!map_file()) {
+            return false;
+        }
+
+        if (file_size < RECORDING_ALIGN) {
+            printf("[REPLAY] %s is too small to be a recording\n", path.c_str());
+            return false;
+        }
+
+        const RecordingHeader *header = reinterpret_cast<const RecordingHeader *>(mapping);
+        if (memcmp(header->magic, RECORDING_MAGIC, sizeof(header->magic)) != 0) {
+            printf("[REPLAY] %s is not a distance recording\n", path.c_str());
+            return false;
+        }
+
+        width = header->width;
+        height = header->height;
+        stride = header->stride;
+        record_size = header->record_size;
+        if (record_size != recording_record_size(stride, height) || stride < static_cast<uint32_t>(width) * 4) {
+            printf("[REPLAY] Corrupt header in %s\n", path.c_str());
+            return false;
+        }
+
+        // An interrupted recording has no frame count; use what's on disk
+        uint64_t on_disk = (file_size - RECORDING_ALIGN) / record_size;
+        frame_count = header->frame_count ? header->frame_count : static_cast<uint32_t>(on_disk);
+        if (frame_count > on_disk) {
+            frame_count = static_cast<uint32_t>(on_disk);
+        }
+        if (frame_count == 0) {
+            printf("[REPLAY] %s contains no frames\n", path.c_str());
+            return false;
+        }
+
+        printf("[REPLAY] %s: %dx%d, %u frames @ %u fps (%s)\n", path.c_str(), width, height,
+               frame_count, header->fps, realtime ? "realtime" : "as fast as possible");
+
+        // View buffers: leases whose data is repointed at the mapping
+        views = std::make_unique<FramePool>();
+        for (int i = 0; i < VIEW_COUNT; i++) {
+            views->add_buffer(nullptr, 0, nullptr);
+        }
+
+        next_frame = 0;
+        out_width = width;
+        out_height = height;
+
+        return true;
+    }
+
+    bool provides_buffers() const override { return true; }
+
+    bool capture(FrameLease &frame) override {
+        if (!mapping || !views) {
+            return false;
+        }
+
+        if (next_frame >= frame_count) {
+            if (!loop) {
+                if (!finished) printf("[REPLAY] End of recording\n");
+                finished = true;
+                return false;
+            }
+            next_frame = 0;
+        }
+
+        // Hand out the mapped frame itself; with every view still in flight
+        // the pipeline is backed up, so skip this tick
+        FrameLease view = views->acquire(VIEW_WAIT_MS);
+        if (!view) {
+            return false;
+        }
+
+        const uint8_t *pixels = frame_pixels(next_frame);
+        const RecordingFrameTrailer *trailer = reinterpret_cast<const RecordingFrameTrailer *>(
+            pixels + static_cast<size_t>(stride) * height);
+
+        if (realtime) {
+            wait_until(trailer->timestamp_us);
+        }
+
+#ifndef _WIN32
+        // Start faulting in the next frame while this one is encoded
+        if (next_frame + 1 < frame_count) {
+            madvise(const_cast<uint8_t *>(frame_pixels(next_frame + 1)), record_size, MADV_WILLNEED);
+        }
+#endif
+        next_frame++;
+
+        size_t frame_bytes = static_cast<size_t>(stride) * height;
+        view->data = const_cast<uint8_t *>(pixels);
+        view->capacity = frame_bytes;
+        frame = view;
+
+        frame->size = frame_bytes;
+        frame->format = PixelFormat::BGRA;
+        frame->width = width;
+        frame->height = height;
+        frame->stride = stride;
+
+        return true;
+    }
+
+    void shutdown() override {
+        views.reset();
+        unmap_file();
+    }
+
+private:
+    const uint8_t* frame_pixels(uint32_t index) const {
+        return mapping + RECORDING_ALIGN + static_cast<uint64_t>(index) * record_size;
+    }
+
+    // Sleep until `timestamp_us` past the start of the current pass. The
+    // clock restarts whenever playback wraps to frame 0.
+    void wait_until(uint64_t timestamp_us) {
+        using namespace std::chrono;
+        if (next_frame == 0) {
+            pass_start = steady_clock::now();
+        }
+        auto due = pass_start + microseconds(timestamp_us);
+        if (due > steady_clock::now()) {
+            std::this_thread::sleep_until(due);
+        }
+    }
+
+#ifdef _WIN32
+    bool map_file() {
+        file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file_handle == INVALID_HANDLE_VALUE) {
+            printf("[REPLAY] Could not open %s: %lu\n", path.c_str(), GetLastError());
+            return false;
+        }
+
+        LARGE_INTEGER size;
+        GetFileSizeEx(file_handle, &size);
+        file_size = static_cast<uint64_t>(size.QuadPart);
+
+        mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping_handle) {
+            printf("[REPLAY] CreateFileMapping failed: %lu\n", GetLastError());
+            return false;
+        }
+
+        mapping = static_cast<const uint8_t *>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+        if (!mapping) {
+            printf("[REPLAY] MapViewOfFile failed: %lu\n", GetLastError());
+            return false;
+        }
+        return true;
+    }
+
+    void unmap_file() {
+        if (mapping) {
+            UnmapViewOfFile(mapping);
+            mapping = nullptr;
+        }
+        if (mapping_handle) {
+            CloseHandle(mapping_handle);
+            mapping_handle = nullptr;
+        }
+        if (file_handle != INVALID_HANDLE_VALUE) {
+            CloseHandle(file_handle);
+            file_handle = INVALID_HANDLE_VALUE;
+        }
+    }
+
+    HANDLE file_handle = INVALID_HANDLE_VALUE;
+    HANDLE mapping_handle = nullptr;
+#else
+    bool map_file() {
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            perror("[REPLAY] open");
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            perror("[REPLAY] fstat");
+            return false;
+        }
+        file_size = static_cast<uint64_t>(st.st_size);
+
+        void *addr = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            perror("[REPLAY] mmap");
+            return false;
+        }
+        mapping = static_cast<const uint8_t *>(addr);
+        madvise(addr, file_size, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    void unmap_file() {
+        if (mapping) {
+            munmap(const_cast<uint8_t *>(mapping), file_size);
+            mapping = nullptr;
+        }
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    int fd = -1;
+#endif
+
+    std::string path;
+    bool realtime = true;
+    bool loop = true;
+
+    const uint8_t *mapping = nullptr;
+    uint64_t file_size = 0;
+    int width = 0;
+    int height = 0;
+    uint32_t stride = 0;
+    uint32_t record_size = 0;
+    uint32_t frame_count = 0;
+    uint32_t next_frame = 0;
+    bool finished = false;
+    std::chrono::steady_clock::time_point pass_start;
+
+    std::unique_ptr<FramePool> views;
+};
+
+std::unique_ptr<CaptureBackend> create_replay_backend() {
+    return std::make_unique<ReplayBackend>();
+}
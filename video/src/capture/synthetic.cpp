@@ -0,0 +1,521 @@
+// Synthetic capture backend: deterministic, seedable screen content at any
+// resolution, for benchmarking the encode path on CI and headless servers.
+// Frames depend only on (scene, seed, width, height, frame index), so two runs
+// with the same settings produce byte-identical input.
+//
+// Scenes:
+//   desktop  static desktop with a few windows (identical frame every tick)
+//   text     terminal-style text scrolling up
+//   code     the same scrolling, syntax-highlighted: every word in color
+//   window   a window dragged around over a static desktop
+//   video    full-screen noise, every pixel changes every frame
+//   cursor   static desktop, only a mouse pointer moves
+//   media    desktop with a video player window: photographic content
+//            changing every frame next to static text and UI
+//
+// Every scene reports a pointer moving along the cursor scene's path (only
+// that scene draws it), and the window and media scenes report their
+// window as focused, for region-of-interest encoding. With the cursor
+// channel (capture.cursor) nothing draws the pointer; it is reported with
+// its sprite as the shape, and the cursor scene's frames stay still.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include "../capture.hpp"
+
+// ---------------------------------------------------------------------------
+// Deterministic PRNG (splitmix64)
+// ---------------------------------------------------------------------------
+static uint64_t mix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+static uint32_t bgra(uint8_t r, uint8_t g, uint8_t b) {
+    return 0xFF000000u | (static_cast<uint32_t>(r) << 16) | (static_cast<uint32_t>(g) << 8) | b;
+}
+
+enum class Scene { Desktop, Text, Code, Window, Video, Cursor, Media };
+
+static bool parse_scene(const std::string &name, Scene &out) {
+    if (name == "desktop") out = Scene::Desktop;
+    else if (name == "text") out = Scene::Text;
+    else if (name == "code") out = Scene::Code;
+    else if (name == "window") out = Scene::Window;
+    else if (name == "video") out = Scene::Video;
+    else if (name == "cursor") out = Scene::Cursor;
+    else if (name == "media") out = Scene::Media;
+    else return false;
+    return true;
+}
+
+// Terminal background for the text scene
+static const uint32_t TEXT_BG = 0xFF0C0C10u;
+
+// Editor token colors for the code scene: keywords, types, strings,
+// numbers, comments and plain names
+static const uint32_t CODE_COLORS[] = {
+    0xFFC586C0u, 0xFF4EC9B0u, 0xFFCE9178u, 0xFFB5CEA8u, 0xFF6A9955u, 0xFF9CDCFEu,
+};
+
+// Glyph cell size used for all text-like content
+constexpr int GLYPH_W = 8;
+constexpr int GLYPH_H = 16;
+
+// Text scroll speed in pixels per frame
+constexpr int SCROLL_PX = 4;
+
+// Mouse pointer sprite size
+constexpr int CURSOR_W = 12;
+constexpr int CURSOR_H = 19;
+
+// Pixel (cx, cy) of the pointer sprite, a classic arrow with a black outline
+// and white fill; false where it is transparent
+static bool cursor_pixel(int cx, int cy, uint32_t &color) {
+    int span = cy < 12 ? cy + 1 : 12 - (cy - 12) * 2;
+    if (span <= 0 || cx >= span || cx >= CURSOR_W || cy >= CURSOR_H) {
+        return false;
+    }
+    bool edge = cx == 0 || cx == span - 1 || cy == CURSOR_H - 1;
+    color = edge ? bgra(0, 0, 0) : bgra(255, 255, 255);
+    return true;
+}
+
+class SyntheticBackend : public CaptureBackend {
+public:
+    SyntheticBackend() = default;
+    ~SyntheticBackend() override { shutdown(); }
+
+    const char* get_name() const override {
+        return "synthetic";
+    }
+
+    bool is_available() const override {
+        // Pure software, always available
+        return true;
+    }
+
+    void configure(const EncoderConfig &config) override {
+        scene_name = config.scene;
+        seed = config.seed;
+        width = config.synthetic_width;
+        height = config.synthetic_height;
+        cursor_channel = config.cursor;
+    }
+
+    bool init(int, int &out_width, int &out_height) override {
+        if (!parse_scene(scene_name, scene)) {
+            printf("[SYNTH] Unknown scene: %s\n", scene_name.c_str());
+            return false;
+        }
+        if (width < 64 || height < 64) {
+            printf("[SYNTH] Resolution too small: %dx%d\n", width, height);
+            return false;
+        }
+
+        stride = width * 4;
+        screen.assign(static_cast<size_t>(width) * height, 0);
+        frame_index = 0;
+
+        // Every scene except video starts from the same desktop
+        if (scene != Scene::Video) {
+            background.assign(static_cast<size_t>(width) * height, 0);
+            draw_desktop(background);
+            if (scene == Scene::Media) {
+                draw_window(background, width / 8, height / 8, width / 2, height / 2, seed ^ 0x5A5Au);
+            }
+            screen = background;
+        }
+        if (scene == Scene::Text || scene == Scene::Code) {
+            text_line = 0;
+            fill_rect(screen, 0, 0, width, height, TEXT_BG);
+            for (int y = 0; y + GLYPH_H <= height; y += GLYPH_H) {
+                draw_text_line(screen.data(), y, next_line_seed());
+            }
+            line_buffer.assign(static_cast<size_t>(width) * GLYPH_H, TEXT_BG);
+            draw_text_line(line_buffer.data(), 0, next_line_seed());
+            line_row = 0;
+        }
+
+        if (cursor_channel) {
+            auto shape = std::make_shared<CursorImage>();
+            cursor_shape_resize(*shape, CURSOR_W, CURSOR_H);
+            for (int cy = 0; cy < CURSOR_H; cy++) {
+                for (int cx = 0; cx < CURSOR_W; cx++) {
+                    uint32_t color;
+                    if (cursor_pixel(cx, cy, color)) {
+                        memcpy(&shape->pixels[(static_cast<size_t>(cy) * CURSOR_W + cx) * 4], &color, 4);
+                    }
+                }
+            }
+            cursor_shape_finish(*shape);
+            cursor_shape = shape;
+        }
+
+        printf("[SYNTH] Scene '%s' at %dx%d, seed %u\n", scene_name.c_str(), width, height, seed);
+
+        out_width = width;
+        out_height = height;
+
+        return true;
+    }
+
+    bool capture(FrameLease &frame) override {
+        if (screen.empty()) {
+            return false;
+        }
+        if (frame->capacity < static_cast<size_t>(stride) * height) {
+            printf("[SYNTH] Frame buffer too small for %dx%d\n", width, height);
+            return false;
+        }
+
+        render_next();
+        int pointer_x, pointer_y;
+        pointer_position(frame_index - 1, pointer_x, pointer_y);
+
+        memcpy(frame->data, screen.data(), static_cast<size_t>(stride) * height);
+        frame->size = static_cast<size_t>(stride) * height;
+        frame->format = PixelFormat::BGRA;
+        frame->width = width;
+        frame->height = height;
+        frame->stride = stride;
+        frame->damage = damage;
+        frame->cursor_x = pointer_x;
+        frame->cursor_y = pointer_y;
+        frame->focus = focus;
+
+        return true;
+    }
+
+    // The pointer of the last frame rendered, hot spot at the sprite's tip
+    bool query_cursor(CursorState &cursor) override {
+        if (!cursor_shape || frame_index == 0) {
+            return false;
+        }
+        cursor.visible = true;
+        pointer_position(frame_index - 1, cursor.x, cursor.y);
+        cursor.shape = cursor_shape;
+        return true;
+    }
+
+    void shutdown() override {
+        screen.clear();
+        background.clear();
+        line_buffer.clear();
+        damage.clear();
+    }
+
+private:
+    // -----------------------------------------------------------------------
+    // Per-scene frame generation
+    // -----------------------------------------------------------------------
+    void render_next() {
+        damage.clear();
+        focus = {0, 0, 0, 0};
+
+        switch (scene) {
+        case Scene::Desktop:
+            if (frame_index == 0) damage.push_back({0, 0, width, height});
+            break;
+        case Scene::Text:
+        case Scene::Code:
+            scroll_text();
+            break;
+        case Scene::Window:
+            move_window();
+            break;
+        case Scene::Video:
+            fill_noise();
+            break;
+        case Scene::Cursor:
+            move_cursor();
+            break;
+        case Scene::Media:
+            play_media();
+            break;
+        }
+
+        frame_index++;
+    }
+
+    void scroll_text() {
+        // Shift the whole screen up, then feed the exposed strip from the
+        // next line of text. Lines are generated in order, so the content
+        // is a function of the frame index alone.
+        int keep = height - SCROLL_PX;
+        memmove(screen.data(), screen.data() + static_cast<size_t>(SCROLL_PX) * width,
+                static_cast<size_t>(keep) * stride);
+
+        for (int y = keep; y < height; y++) {
+            memcpy(&screen[static_cast<size_t>(y) * width],
+                   &line_buffer[static_cast<size_t>(line_row) * width], stride);
+            if (++line_row == GLYPH_H) {
+                std::fill(line_buffer.begin(), line_buffer.end(), TEXT_BG);
+                draw_text_line(line_buffer.data(), 0, next_line_seed());
+                line_row = 0;
+            }
+        }
+
+        damage.push_back({0, 0, width, height});
+    }
+
+    void move_window() {
+        int win_w = width / 3;
+        int win_h = height / 3;
+        double t = frame_index * 0.02;
+        int x = static_cast<int>((width - win_w) * (0.5 + 0.5 * sin(t * 1.3)));
+        int y = static_cast<int>((height - win_h) * (0.5 + 0.5 * sin(t * 0.7 + 1.0)));
+
+        if (frame_index > 0) {
+            restore_background(last_x, last_y, win_w, win_h);
+            damage.push_back({last_x, last_y, win_w, win_h});
+        } else {
+            damage.push_back({0, 0, width, height});
+        }
+        draw_window(screen, x, y, win_w, win_h, seed ^ 0xA5A5u);
+        damage.push_back({x, y, win_w, win_h});
+        focus = {x, y, win_w, win_h};
+
+        last_x = x;
+        last_y = y;
+    }
+
+    void fill_noise() {
+        // Blocky luma noise with a slowly drifting tint — every pixel changes
+        uint64_t state = mix64(seed ^ (static_cast<uint64_t>(frame_index) << 32));
+        int tint = (frame_index * 3) & 0xFF;
+        for (int y = 0; y < height; y++) {
+            uint32_t *row = &screen[static_cast<size_t>(y) * width];
+            for (int x = 0; x < width; x += 8) {
+                state = mix64(state);
+                int n = x + 8 <= width ? 8 : width - x;
+                for (int i = 0; i < n; i++) {
+                    uint8_t v = static_cast<uint8_t>(state >> (i * 8));
+                    row[x + i] = bgra(v, static_cast<uint8_t>((v + tint) >> 1), static_cast<uint8_t>(255 - v));
+                }
+            }
+        }
+        damage.push_back({0, 0, width, height});
+    }
+
+    // Top-left of the pointer sprite at frame `index`, which is also its
+    // hotspot
+    void pointer_position(uint64_t index, int &x, int &y) const {
+        double t = index * 0.05;
+        x = static_cast<int>((width - CURSOR_W) * (0.5 + 0.45 * sin(t)));
+        y = static_cast<int>((height - CURSOR_H) * (0.5 + 0.45 * sin(t * 1.7)));
+    }
+
+    void move_cursor() {
+        if (cursor_channel) {
+            if (frame_index == 0) damage.push_back({0, 0, width, height});
+            return;
+        }
+        int x, y;
+        pointer_position(frame_index, x, y);
+
+        if (frame_index > 0) {
+            restore_background(last_x, last_y, CURSOR_W, CURSOR_H);
+            damage.push_back({last_x, last_y, CURSOR_W, CURSOR_H});
+        } else {
+            damage.push_back({0, 0, width, height});
+        }
+        draw_cursor(screen, x, y);
+        damage.push_back({x, y, CURSOR_W, CURSOR_H});
+
+        last_x = x;
+        last_y = y;
+    }
+
+    void play_media() {
+        // Client area of the player window drawn in init()
+        int x0 = width / 8 + 1, y0 = height / 8 + 24;
+        int w = width / 2 - 2, h = height / 2 - 25;
+
+        // Smooth separable shading that drifts over time, plus film grain:
+        // thousands of colors and soft transitions, like a photo or video
+        double t = frame_index * 0.04;
+        col_a.resize(w);
+        col_b.resize(w);
+        row_a.resize(h);
+        row_b.resize(h);
+        for (int x = 0; x < w; x++) {
+            col_a[x] = static_cast<int>(60 * sin(x * 0.021 + t));
+            col_b[x] = static_cast<int>(50 * sin(x * 0.009 - t * 0.5));
+        }
+        for (int y = 0; y < h; y++) {
+            row_a[y] = static_cast<int>(60 * cos(y * 0.017 - t * 0.7));
+            row_b[y] = static_cast<int>(50 * sin(y * 0.023 + t * 0.3));
+        }
+
+        uint64_t state = mix64(seed ^ (static_cast<uint64_t>(frame_index) << 32) ^ 0x3C3Cu);
+        for (int y = 0; y < h; y++) {
+            uint32_t *row = &screen[static_cast<size_t>(y0 + y) * width + x0];
+            for (int x = 0; x < w; x++) {
+                if ((x & 7) == 0) state = mix64(state);
+                int grain = static_cast<int>((state >> ((x & 7) * 8)) & 7) - 3;
+                int r = 128 + col_a[x] + row_a[y] + grain;
+                int g = 110 + col_b[x] + row_a[y] / 2 + grain;
+                int b = 120 + col_a[x] / 2 + row_b[y] + grain;
+                row[x] = bgra(clamp_u8(r), clamp_u8(g), clamp_u8(b));
+            }
+        }
+
+        if (frame_index == 0) {
+            damage.push_back({0, 0, width, height});
+        } else {
+            damage.push_back({x0, y0, w, h});
+        }
+        focus = {width / 8, height / 8, width / 2, height / 2};
+    }
+
+    static uint8_t clamp_u8(int v) {
+        return static_cast<uint8_t>(v < 0 ? 0 : v > 255 ? 255 : v);
+    }
+
+    // -----------------------------------------------------------------------
+    // Drawing primitives (BGRA, top-down)
+    // -----------------------------------------------------------------------
+    void fill_rect(std::vector<uint32_t> &dst, int x, int y, int w, int h, uint32_t color) {
+        int x0 = x < 0 ? 0 : x, y0 = y < 0 ? 0 : y;
+        int x1 = x + w > width ? width : x + w, y1 = y + h > height ? height : y + h;
+        for (int yy = y0; yy < y1; yy++) {
+            uint32_t *row = &dst[static_cast<size_t>(yy) * width];
+            for (int xx = x0; xx < x1; xx++) row[xx] = color;
+        }
+    }
+
+    void restore_background(int x, int y, int w, int h) {
+        for (int yy = y; yy < y + h && yy < height; yy++) {
+            size_t off = static_cast<size_t>(yy) * width + x;
+            memcpy(&screen[off], &background[off], static_cast<size_t>(w) * 4);
+        }
+    }
+
+    // One row of pseudo-glyphs: each cell is a 5x9 bit pattern from the hash,
+    // with random word gaps and a ragged line end like real text. dst points
+    // at a width-wide buffer; rows outside [0, rows) are clipped. With
+    // `colors`, each word takes one of them instead of fg.
+    void draw_glyphs(uint32_t *dst, int rows, int x, int y, int max_w, uint64_t line_seed, uint32_t fg,
+                     const uint32_t *colors = nullptr, int color_count = 0) {
+        uint64_t state = mix64(line_seed);
+        int cols = max_w / GLYPH_W;
+        int length = static_cast<int>(state % (cols + 1));
+        if (colors) fg = colors[(state >> 32) % color_count];
+
+        for (int c = 0; c < length; c++) {
+            state = mix64(state);
+            if ((state & 7) == 0) {  // space
+                if (colors) fg = colors[(state >> 3) % color_count];
+                continue;
+            }
+            int px = x + c * GLYPH_W + 1;
+            for (int gy = 0; gy < 9; gy++) {
+                int py = y + 4 + gy;
+                if (py < 0 || py >= rows) continue;
+                uint32_t *row = dst + static_cast<size_t>(py) * width;
+                for (int gx = 0; gx < 5; gx++) {
+                    if ((state >> (8 + gy * 5 + gx)) & 1) row[px + gx] = fg;
+                }
+            }
+        }
+    }
+
+    void draw_text_line(uint32_t *dst, int y, uint64_t line_seed) {
+        if (scene == Scene::Code) {
+            draw_glyphs(dst, y + GLYPH_H, 0, y, width, line_seed, 0, CODE_COLORS,
+                        static_cast<int>(sizeof(CODE_COLORS) / sizeof(CODE_COLORS[0])));
+            return;
+        }
+        // Roughly one line in five is highlighted, like prompts or diffs
+        uint32_t fg = mix64(line_seed ^ 1) % 5 == 0 ? bgra(120, 200, 120) : bgra(210, 210, 210);
+        draw_glyphs(dst, y + GLYPH_H, 0, y, width, line_seed, fg);
+    }
+
+    void draw_window(std::vector<uint32_t> &dst, int x, int y, int w, int h, uint64_t win_seed) {
+        uint64_t state = mix64(win_seed);
+        fill_rect(dst, x, y, w, h, bgra(240, 240, 240));
+        fill_rect(dst, x, y, w, 24, bgra(60, 90, static_cast<uint8_t>(140 + (state & 0x3F))));
+        fill_rect(dst, x, y, w, 1, bgra(30, 30, 30));
+        fill_rect(dst, x, y + h - 1, w, 1, bgra(30, 30, 30));
+        fill_rect(dst, x, y, 1, h, bgra(30, 30, 30));
+        fill_rect(dst, x + w - 1, y, 1, h, bgra(30, 30, 30));
+
+        // Dark text on the light client area
+        int bottom = y + h - 4 < height ? y + h - 4 : height;
+        for (int ty = y + 32; ty + GLYPH_H <= bottom; ty += GLYPH_H) {
+            state = mix64(state);
+            draw_glyphs(dst.data(), bottom, x + 8, ty, w - 16, state, bgra(20, 20, 20));
+        }
+    }
+
+    void draw_desktop(std::vector<uint32_t> &dst) {
+        // Vertical gradient wallpaper
+        for (int y = 0; y < height; y++) {
+            uint8_t v = static_cast<uint8_t>(40 + 80 * y / height);
+            fill_rect(dst, 0, y, width, 1, bgra(v / 2, v / 2 + 20, v + 40));
+        }
+
+        // Taskbar
+        fill_rect(dst, 0, height - 32, width, 32, bgra(32, 32, 36));
+
+        // A few overlapping windows, placed from the seed
+        uint64_t state = mix64(seed);
+        for (int i = 0; i < 4; i++) {
+            state = mix64(state);
+            int w = width / 4 + static_cast<int>(state % (width / 4));
+            int h = height / 4 + static_cast<int>((state >> 20) % (height / 4));
+            int x = static_cast<int>((state >> 40) % (width - w));
+            int y = static_cast<int>((state >> 52) % (height - 32 - h));
+            draw_window(dst, x, y, w, h, state);
+        }
+    }
+
+    void draw_cursor(std::vector<uint32_t> &dst, int x, int y) {
+        for (int cy = 0; cy < CURSOR_H; cy++) {
+            for (int cx = 0; cx < CURSOR_W; cx++) {
+                uint32_t color;
+                if (cursor_pixel(cx, cy, color)) {
+                    dst[static_cast<size_t>(y + cy) * width + x + cx] = color;
+                }
+            }
+        }
+    }
+
+    uint64_t next_line_seed() {
+        return mix64(seed + 0x100000000ull * ++text_line);
+    }
+
+    std::string scene_name = "desktop";
+    Scene scene = Scene::Desktop;
+    uint32_t seed = 1;
+
+    int width = 1920;
+    int height = 1080;
+    int stride = 0;
+    std::vector<uint32_t> screen;
+    std::vector<uint32_t> background;
+    std::vector<CaptureRect> damage;
+    CaptureRect focus = {0, 0, 0, 0};
+    uint64_t frame_index = 0;
+    bool cursor_channel = false;  // capture.cursor
+    std::shared_ptr<const CursorImage> cursor_shape;
+
+    // Scene state
+    uint64_t text_line = 0;
+    std::vector<uint32_t> line_buffer;
+    int line_row = 0;
+    int last_x = 0;
+    int last_y = 0;
+    std::vector<int> col_a, col_b, row_a, row_b;
+};
+
+std::unique_ptr<CaptureBackend> create_synthetic_backend() {
+    return std::make_unique<SyntheticBackend>();
+}
@@ -0,0 +1,460 @@
+// Linux screen capture backend using X11 + MIT-SHM (XShmGetImage)
+// Each XImage is backed by a SysV shared memory segment created once in
+// init(). A small ring of them is handed to the pipeline as frame leases, so
+// the X server writes pixels straight into the buffer the encoder reads —
+// no per-frame allocation, no socket copy, and no copy out of the segment.
+// Works on any X server with MIT-SHM, including Xvfb:
+//   Xvfb :99 -screen 0 1920x1080x24 &  DISPLAY=:99 ./distance_encoder -e x11shm
+//
+// When built with XDamage (HAVE_XDAMAGE), the backend subscribes to damage
+// on the root window and only grabs when something was drawn. Between frames
+// capture() blocks on the X connection instead of polling, so an idle desktop
+// costs next to nothing. The damaged rectangles travel with each frame.
+//
+// XShmGetImage leaves the pointer out of the pixels; its position is
+// queried with each grab and, with encoding.roi.focus, the geometry of the
+// window manager's active window (_NET_ACTIVE_WINDOW), for region-of-interest
+// encoding.
+//
+// With XFixes (HAVE_XFIXES) the backend feeds the cursor channel
+// (capture.cursor): XFixesGetCursorImage gives the pointer's position and
+// image, converted again only when its serial changes. The pointer never
+// damages the root window, so the damage wait is cut to one frame interval
+// to keep polling it at the frame rate while the screen is still.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <poll.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#ifdef HAVE_XDAMAGE
+#include <X11/extensions/Xdamage.h>
+#endif
+#ifdef HAVE_XFIXES
+#include <X11/extensions/Xfixes.h>
+#endif
+#include "../capture.hpp"
+
+// How long capture() waits for damage before returning "no new frame"
+constexpr int DAMAGE_WAIT_MS = 100;
+
+// Past this many rectangles the list is collapsed to its bounding box
+constexpr int MAX_DAMAGE_RECTS = 64;
+
+// Shared memory images in the ring: one being grabbed into plus enough to
+// cover frames queued or being encoded downstream
+constexpr int SHM_IMAGE_COUNT = 4;
+
+// How long capture() waits for a free image before giving up on this tick
+constexpr int IMAGE_WAIT_MS = 50;
+
+// One XImage and the SysV segment behind it
+struct ShmImage {
+    XImage *image = nullptr;
+    XShmSegmentInfo info = {};
+    bool attached = false;
+};
+
+// XShmAttach reports failure asynchronously through the X error handler
+// (e.g. when DISPLAY points at a remote server). Trap it during init, and
+// around queries of windows that may be gone by the time they arrive.
+static bool x_error_trapped = false;
+
+static int trap_x_error(Display *, XErrorEvent *) {
+    x_error_trapped = true;
+    return 0;
+}
+
+class X11ShmBackend : public CaptureBackend {
+public:
+    X11ShmBackend() = default;
+    ~X11ShmBackend() override { shutdown(); }
+
+    const char* get_name() const override {
+        return "x11shm";
+    }
+
+    bool is_available() const override {
+        Display *test_display = XOpenDisplay(nullptr);
+        if (!test_display) {
+            return false;
+        }
+
+        bool has_shm = XShmQueryExtension(test_display);
+        XCloseDisplay(test_display);
+        return has_shm;
+    }
+
+    void configure(const EncoderConfig &config) override {
+        track_focus = config.roi_focus;
+        cursor_channel = config.cursor;
+        if (cursor_channel && config.fps > 0) {
+            damage_wait_ms = std::min(DAMAGE_WAIT_MS, std::max(1, 1000 / config.fps));
+        }
+    }
+
+    bool init(int monitor, int &out_width, int &out_height) override {
+        display = XOpenDisplay(nullptr);
+        if (!display) {
+            printf("[X11] Cannot open display (is DISPLAY set?)\n");
+            return false;
+        }
+
+        if (!XShmQueryExtension(display)) {
+            printf("[X11] MIT-SHM extension not available\n");
+            return false;
+        }
+
+        // Each X screen is treated as a monitor
+        if (monitor < 0 || monitor >= ScreenCount(display)) {
+            printf("[X11] Screen %d not found (%d available)\n", monitor, ScreenCount(display));
+            return false;
+        }
+
+        Screen *screen = ScreenOfDisplay(display, monitor);
+        root = RootWindowOfScreen(screen);
+        width = WidthOfScreen(screen);
+        height = HeightOfScreen(screen);
+
+        printf("[X11] Screen %d: %dx%d, depth %d\n", monitor, width, height, DefaultDepthOfScreen(screen));
+
+        for (int i = 0; i < SHM_IMAGE_COUNT; i++) {
+            if (!create_image(screen, images[i])) {
+                return false;
+            }
+            images_pool.add_buffer(reinterpret_cast<uint8_t *>(images[i].image->data),
+                                   static_cast<size_t>(images[i].image->bytes_per_line) * height, &images[i]);
+        }
+        attached = true;
+        net_active_window = XInternAtom(display, "_NET_ACTIVE_WINDOW", False);
+
+#ifdef HAVE_XDAMAGE
+        init_damage();
+#endif
+        if (cursor_channel) {
+#ifdef HAVE_XFIXES
+            int event_base, error_base;
+            has_xfixes = XFixesQueryExtension(display, &event_base, &error_base);
+#endif
+            if (!has_xfixes) {
+                printf("[X11] XFixes not available, no cursor channel\n");
+            }
+        }
+
+        out_width = width;
+        out_height = height;
+
+        return true;
+    }
+
+    bool provides_buffers() const override { return true; }
+
+    bool capture(FrameLease &frame) override {
+        if (!attached) {
+            return false;
+        }
+
+        // Grab into one of our own segments instead of the lease we were
+        // given; the pipeline returns it to the ring once encoded.
+        FrameLease slot = images_pool.acquire(IMAGE_WAIT_MS);
+        if (!slot) {
+            return false;
+        }
+
+#ifdef HAVE_XDAMAGE
+        // Nothing drawn since the last grab: skip capture and encode
+        if (damage && !collect_damage(damage_wait_ms)) {
+            return false;
+        }
+#endif
+
+        ShmImage *target = static_cast<ShmImage *>(slot->user);
+        if (!XShmGetImage(display, root, target->image, 0, 0, AllPlanes)) {
+            printf("[X11] XShmGetImage failed\n");
+            return false;
+        }
+
+        slot->size = static_cast<size_t>(target->image->bytes_per_line) * height;
+        slot->format = PixelFormat::BGRA;  // 24-bit depth in 32 bpp, little-endian
+        slot->width = width;
+        slot->height = height;
+        slot->stride = target->image->bytes_per_line;
+        slot->damage = damage_rects;
+        query_pointer(*slot);
+        slot->focus = track_focus ? active_window() : CaptureRect{0, 0, 0, 0};
+        frame = slot;
+
+        return true;
+    }
+
+    bool query_cursor(CursorState &cursor) override {
+#ifdef HAVE_XFIXES
+        if (!has_xfixes || !display) {
+            return false;
+        }
+        XFixesCursorImage *image = XFixesGetCursorImage(display);
+        if (!image) {
+            return false;
+        }
+        cursor.x = image->x;
+        cursor.y = image->y;
+        cursor.visible = image->x >= 0 && image->y >= 0 && image->x < width && image->y < height;
+        if (!cursor.shape || image->cursor_serial != cursor_image_serial) {
+            // Xlib hands out each 32-bit ARGB pixel in an unsigned long
+            std::vector<uint32_t> argb(static_cast<size_t>(image->width) * image->height);
+            for (size_t i = 0; i < argb.size(); i++) {
+                argb[i] = static_cast<uint32_t>(image->pixels[i]);
+            }
+            auto shape = std::make_shared<CursorImage>();
+            shape->hot_x = image->xhot;
+            shape->hot_y = image->yhot;
+            cursor_from_bgra(reinterpret_cast<const uint8_t *>(argb.data()), static_cast<size_t>(image->width) * 4,
+                             image->width, image->height, true, *shape);
+            cursor.shape = shape;
+            cursor_image_serial = image->cursor_serial;
+        }
+        XFree(image);
+        return true;
+#else
+        (void)cursor;
+        return false;
+#endif
+    }
+
+    void shutdown() override {
+#ifdef HAVE_XDAMAGE
+        if (damage_region) {
+            XFixesDestroyRegion(display, damage_region);
+            damage_region = 0;
+        }
+        if (damage) {
+            XDamageDestroy(display, damage);
+            damage = 0;
+        }
+#endif
+        damage_rects.clear();
+        attached = false;
+        for (auto &img : images) {
+            destroy_image(img);
+        }
+        if (display) {
+            XCloseDisplay(display);
+            display = nullptr;
+        }
+    }
+
+private:
+    bool create_image(Screen *screen, ShmImage &img) {
+        img.image = XShmCreateImage(display, DefaultVisualOfScreen(screen), DefaultDepthOfScreen(screen),
+                                    ZPixmap, nullptr, &img.info, width, height);
+        if (!img.image) {
+            printf("[X11] XShmCreateImage failed\n");
+            return false;
+        }
+
+        if (img.image->bits_per_pixel != 32) {
+            printf("[X11] Unsupported pixel layout: %d bpp (need 32)\n", img.image->bits_per_pixel);
+            return false;
+        }
+
+        img.info.shmid = shmget(IPC_PRIVATE, img.image->bytes_per_line * img.image->height, IPC_CREAT | 0600);
+        if (img.info.shmid < 0) {
+            perror("[X11] shmget");
+            return false;
+        }
+
+        img.info.shmaddr = img.image->data = static_cast<char *>(shmat(img.info.shmid, nullptr, 0));
+        if (img.info.shmaddr == reinterpret_cast<char *>(-1)) {
+            perror("[X11] shmat");
+            img.info.shmaddr = img.image->data = nullptr;
+            shmctl(img.info.shmid, IPC_RMID, nullptr);
+            return false;
+        }
+        img.info.readOnly = False;
+
+        x_error_trapped = false;
+        XErrorHandler old_handler = XSetErrorHandler(trap_x_error);
+        XShmAttach(display, &img.info);
+        XSync(display, False);
+        XSetErrorHandler(old_handler);
+
+        // Mark for removal now; the segment lives until both sides detach,
+        // so it can't leak if we crash.
+        shmctl(img.info.shmid, IPC_RMID, nullptr);
+
+        if (x_error_trapped) {
+            printf("[X11] XShmAttach failed (remote display?)\n");
+            return false;
+        }
+        img.attached = true;
+        return true;
+    }
+
+    void destroy_image(ShmImage &img) {
+        if (img.attached) {
+            XShmDetach(display, &img.info);
+            img.attached = false;
+        }
+        if (img.image) {
+            // The pixel data belongs to the segment, not to Xlib
+            img.image->data = nullptr;
+            XDestroyImage(img.image);
+            img.image = nullptr;
+        }
+        if (img.info.shmaddr) {
+            shmdt(img.info.shmaddr);
+            img.info.shmaddr = nullptr;
+        }
+    }
+
+    // Pointer position on this screen, -1 when it is on another one
+    void query_pointer(FrameBuffer &frame) {
+        Window root_return, child;
+        int x, y, win_x, win_y;
+        unsigned int mask;
+        frame.cursor_x = frame.cursor_y = -1;
+        if (XQueryPointer(display, root, &root_return, &child, &x, &y, &win_x, &win_y, &mask) &&
+            x >= 0 && y >= 0 && x < width && y < height) {
+            frame.cursor_x = x;
+            frame.cursor_y = y;
+        }
+    }
+
+    // The active window's rectangle in screen coordinates; empty when the
+    // window manager doesn't publish one or it went away meanwhile
+    CaptureRect active_window() {
+        CaptureRect rect = {0, 0, 0, 0};
+        Atom type;
+        int format;
+        unsigned long count, after;
+        unsigned char *data = nullptr;
+        if (XGetWindowProperty(display, root, net_active_window, 0, 1, False, XA_WINDOW, &type, &format, &count,
+                               &after, &data) != Success || !data) {
+            return rect;
+        }
+        Window window = count && format == 32 ? *reinterpret_cast<Window *>(data) : 0;
+        XFree(data);
+        if (!window) {
+            return rect;
+        }
+
+        x_error_trapped = false;
+        XErrorHandler old_handler = XSetErrorHandler(trap_x_error);
+        XWindowAttributes attrs;
+        Window child;
+        int x = 0, y = 0;
+        bool ok = XGetWindowAttributes(display, window, &attrs) &&
+                  XTranslateCoordinates(display, window, root, 0, 0, &x, &y, &child);
+        XSync(display, False);
+        XSetErrorHandler(old_handler);
+        if (ok && !x_error_trapped) {
+            rect = {x, y, attrs.width, attrs.height};
+        }
+        return rect;
+    }
+
+#ifdef HAVE_XDAMAGE
+    void init_damage() {
+        int error_base;
+        if (!XDamageQueryExtension(display, &damage_event_base, &error_base) ||
+            !XFixesQueryExtension(display, &error_base, &error_base)) {
+            printf("[X11] XDamage not available, capturing every frame\n");
+            return;
+        }
+
+        damage = XDamageCreate(display, root, XDamageReportNonEmpty);
+        damage_region = XFixesCreateRegion(display, nullptr, 0);
+        pending_damage = true;  // first frame is always a full grab
+        full_damage = true;
+        printf("[X11] XDamage tracking enabled\n");
+    }
+
+    // Drain queued X events, noting whether any damage was reported.
+    void drain_events() {
+        while (XPending(display)) {
+            XEvent ev;
+            XNextEvent(display, &ev);
+            if (ev.type == damage_event_base + XDamageNotify) {
+                pending_damage = true;
+            }
+        }
+    }
+
+    // Wait up to timeout_ms for damage, then move the accumulated damage
+    // into damage_rects. Returns false if nothing changed.
+    bool collect_damage(int timeout_ms) {
+        drain_events();
+        if (!pending_damage) {
+            struct pollfd pfd = { ConnectionNumber(display), POLLIN, 0 };
+            if (poll(&pfd, 1, timeout_ms) > 0) {
+                drain_events();
+            }
+        }
+        if (!pending_damage) {
+            damage_rects.clear();
+            return false;
+        }
+
+        // Fetch and reset the server-side damage before grabbing, so anything
+        // drawn during the grab is reported next time around.
+        XDamageSubtract(display, damage, None, damage_region);
+        pending_damage = false;
+
+        damage_rects.clear();
+        if (full_damage) {
+            damage_rects.push_back({0, 0, width, height});
+            full_damage = false;
+            return true;
+        }
+
+        int count = 0;
+        XRectangle bounds;
+        XRectangle *rects = XFixesFetchRegionAndBounds(display, damage_region, &count, &bounds);
+        if (count > MAX_DAMAGE_RECTS) {
+            damage_rects.push_back({bounds.x, bounds.y, bounds.width, bounds.height});
+        } else {
+            for (int i = 0; i < count; i++) {
+                damage_rects.push_back({rects[i].x, rects[i].y, rects[i].width, rects[i].height});
+            }
+        }
+        if (rects) {
+            XFree(rects);
+        }
+
+        return !damage_rects.empty();
+    }
+
+    Damage damage = 0;
+    XserverRegion damage_region = 0;
+    int damage_event_base = 0;
+    bool pending_damage = false;
+    bool full_damage = false;
+#endif
+
+    Display *display = nullptr;
+    Window root = 0;
+    ShmImage images[SHM_IMAGE_COUNT];
+    FramePool images_pool;
+    bool attached = false;
+    std::vector<CaptureRect> damage_rects;
+    bool track_focus = false;  // encoding.roi.focus
+    Atom net_active_window = None;
+    bool cursor_channel = false;  // capture.cursor
+    bool has_xfixes = false;
+    unsigned long cursor_image_serial = 0;
+    int damage_wait_ms = DAMAGE_WAIT_MS;
+
+    int width = 0;
+    int height = 0;
+};
+
+std::unique_ptr<CaptureBackend> create_x11shm_backend() {
+    return std::make_unique<X11ShmBackend>();
+}
@@ -0,0 +1,181 @@
+#include <vector>
+#include "chroma.hpp"
+
+// |dCb| + |dCr| between neighbours counted as a sharp chroma edge, and at
+// most this much as flat. Photo content rarely steps this far between
+// adjacent pixels; colored glyphs on a plain background step several times
+// further.
+constexpr int SHARP_STEP = 40;
+constexpr int FLAT_STEP = 6;
+
+// Share of horizontal edges above which 4:2:2 and 4:2:0 would smear
+// visibly, and of vertical edges above which 4:2:0 would
+constexpr float DETAIL_444 = 0.004f;
+constexpr float DETAIL_422 = 0.004f;
+
+// Share of all horizontal steps that are sharp above which the content is
+// noise or dense texture (text and UI stay under a few percent); the
+// texture masks what subsampling loses, so it gets 4:2:0 whatever its edges
+constexpr float TEXTURE_SHARE = 0.2f;
+
+// One row in this many starts a sample (itself and the two rows below);
+// the offset within each block cycles so text lines and scrolls don't alias
+// with the sampling
+constexpr int ROW_STEP = 8;
+
+// Frames in a row that must want coarser chroma before the selector drops
+constexpr int HOLD_FRAMES = 15;
+
+static inline int absolute(int v) {
+    return v < 0 ? -v : v;
+}
+
+template <typename T>
+static inline int step(const T *cb0, const T *cr0, const T *cb1, const T *cr1, int i, int j) {
+    return absolute(cb0[i] - cb1[j]) + absolute(cr0[i] - cr1[j]);
+}
+
+// Edge counts over the sampled rows
+struct EdgeCounts {
+    int horizontal = 0;
+    int sharp = 0;
+    int h_pairs = 0;
+    int vertical = 0;
+    int v_pairs = 0;
+
+    ChromaDetail detail() const {
+        ChromaDetail d;
+        d.horizontal = h_pairs ? static_cast<float>(horizontal) / h_pairs : 0.0f;
+        d.vertical = v_pairs ? static_cast<float>(vertical) / v_pairs : 0.0f;
+        d.texture = h_pairs ? static_cast<float>(sharp) / h_pairs : 0.0f;
+        return d;
+    }
+};
+
+// A sharp step that has flat chroma on at least one side: the edge of a
+// glyph stroke or a line against a plain background. Noise and fine photo
+// texture step sharply on both sides and don't count; subsampling them is
+// masked by the texture itself. `rows` is 1 (horizontal only) or 3.
+template <typename T>
+static void count_edges(const T *const *cb, const T *const *cr, int rows, int w, EdgeCounts &c) {
+    int horizontal = 0, sharp_steps = 0;
+    for (int x = 2; x + 1 < w; x++) {
+        bool sharp = step(cb[0], cr[0], cb[0], cr[0], x - 1, x) > SHARP_STEP;
+        bool flat = step(cb[0], cr[0], cb[0], cr[0], x, x + 1) <= FLAT_STEP ||
+                    step(cb[0], cr[0], cb[0], cr[0], x - 2, x - 1) <= FLAT_STEP;
+        horizontal += sharp && flat;
+        sharp_steps += sharp;
+    }
+    c.horizontal += horizontal;
+    c.sharp += sharp_steps;
+    c.h_pairs += w > 3 ? w - 3 : 0;
+    if (rows < 3) {
+        return;
+    }
+
+    // Between rows 0 and 1 with row 2 flat against row 1, and between rows
+    // 1 and 2 with row 0 flat against row 1
+    int vertical = 0;
+    for (int x = 0; x < w; x++) {
+        int top = step(cb[0], cr[0], cb[1], cr[1], x, x);
+        int bottom = step(cb[1], cr[1], cb[2], cr[2], x, x);
+        vertical += (top > SHARP_STEP && bottom <= FLAT_STEP) + (bottom > SHARP_STEP && top <= FLAT_STEP);
+    }
+    c.vertical += vertical;
+    c.v_pairs += w * 2;
+}
+
+// First row of each sample; rows of the sample that fall off the bottom
+// shorten it
+template <typename Fn>
+static void for_sampled_rows(int h, Fn &&fn) {
+    for (int block = 0; block * ROW_STEP < h; block++) {
+        int y = block * ROW_STEP + (block * 3) % ROW_STEP;
+        if (y >= h) break;
+        fn(y, y + 2 < h ? 3 : 1);
+    }
+}
+
+// Chroma of a BGR(A) row, scaled like JPEG's Cb and Cr around 0 with luma
+// approximated as (R + 2G + B) / 4
+template <int BPP>
+static void chroma_row(const uint8_t *src, int w, int16_t *cb, int16_t *cr) {
+    for (int x = 0; x < w; x++) {
+        const uint8_t *p = src + x * BPP;
+        int y = (p[2] + 2 * p[1] + p[0]) >> 2;
+        cb[x] = static_cast<int16_t>(((p[0] - y) * 9) >> 4);
+        cr[x] = static_cast<int16_t>(((p[2] - y) * 23) >> 5);
+    }
+}
+
+template <int BPP>
+static ChromaDetail detail_rgb(const uint8_t *data, size_t stride, int w, int h) {
+    std::vector<int16_t> buffer(static_cast<size_t>(w) * 6);
+    const int16_t *cb[3], *cr[3];
+    for (int i = 0; i < 3; i++) {
+        cb[i] = buffer.data() + static_cast<size_t>(w) * i * 2;
+        cr[i] = cb[i] + w;
+    }
+    EdgeCounts counts;
+    for_sampled_rows(h, [&](int y, int rows) {
+        for (int i = 0; i < rows; i++) {
+            int16_t *row = buffer.data() + static_cast<size_t>(w) * i * 2;
+            chroma_row<BPP>(data + static_cast<size_t>(y + i) * stride, w, row, row + w);
+        }
+        count_edges(cb, cr, rows, w, counts);
+    });
+    return counts.detail();
+}
+
+ChromaDetail chroma_detail(const uint8_t *data, size_t stride, int w, int h, int bytes_per_pixel) {
+    if (w < 1 || h < 1) {
+        return ChromaDetail();
+    }
+    return bytes_per_pixel == 3 ? detail_rgb<3>(data, stride, w, h) : detail_rgb<4>(data, stride, w, h);
+}
+
+ChromaDetail chroma_detail_planar(const uint8_t *cb, const uint8_t *cr, size_t stride, int w, int h) {
+    EdgeCounts counts;
+    if (w < 1 || h < 1) {
+        return counts.detail();
+    }
+    for_sampled_rows(h, [&](int y, int rows) {
+        const uint8_t *cb_rows[3], *cr_rows[3];
+        for (int i = 0; i < 3; i++) {
+            size_t offset = static_cast<size_t>(y + (i < rows ? i : 0)) * stride;
+            cb_rows[i] = cb + offset;
+            cr_rows[i] = cr + offset;
+        }
+        count_edges(cb_rows, cr_rows, rows, w, counts);
+    });
+    return counts.detail();
+}
+
+Subsampling choose_subsampling(const ChromaDetail &detail) {
+    if (detail.texture > TEXTURE_SHARE) return Subsampling::S420;
+    if (detail.horizontal > DETAIL_444) return Subsampling::S444;
+    if (detail.vertical > DETAIL_422) return Subsampling::S422;
+    return Subsampling::S420;
+}
+
+const char* subsampling_name(Subsampling subsampling) {
+    switch (subsampling) {
+    case Subsampling::S444: return "444";
+    case Subsampling::S422: return "422";
+    case Subsampling::S420: return "420";
+    }
+    return "?";
+}
+
+Subsampling SubsamplingSelector::update(const ChromaDetail &detail) {
+    Subsampling wanted = choose_subsampling(detail);
+    if (wanted <= selected) {
+        // Finer (or the same) takes effect at once
+        selected = wanted;
+        coarser_frames = 0;
+    } else if (++coarser_frames >= HOLD_FRAMES) {
+        selected = wanted;
+        coarser_frames = 0;
+    }
+    return selected;
+}
@@ -0,0 +1,55 @@
+#ifndef CHROMA_HPP
+#define CHROMA_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// JPEG chroma resolution, finest first. The values are TurboJPEG's
+// TJSAMP_444, TJSAMP_422 and TJSAMP_420, which is also how frame metadata
+// records them.
+enum class Subsampling : uint8_t {
+    S444 = 0,  // full chroma
+    S422 = 1,  // half horizontally
+    S420 = 2,  // half both ways
+};
+
+// Chroma a subsampled encode would lose: the share of neighbour pairs, over
+// the sampled rows, with a sharp chroma step next to flat chroma, as at the
+// edges of colored text, syntax highlighting or thin colored lines. Photos
+// change chroma smoothly and score near zero, and so does gray text, which
+// has no chroma at all. Noise steps sharply everywhere; `texture` catches
+// it, since subsampling it is not visible.
+struct ChromaDetail {
+    float horizontal = 0;  // left/right pairs: lost by 4:2:2 and 4:2:0
+    float vertical = 0;    // pairs one row apart: lost by 4:2:0
+    float texture = 0;     // left/right pairs with any sharp step
+};
+
+// Of the w x h block at `data` (BGRA or BGR), chroma approximated from RGB.
+// Samples three rows in eight; about a fifth of the cost of JPEG-encoding
+// the block, a tenth from I444 planes (--bench chroma).
+ChromaDetail chroma_detail(const uint8_t *data, size_t stride, int w, int h, int bytes_per_pixel);
+
+// The same from the Cb and Cr planes of an I444 frame
+ChromaDetail chroma_detail_planar(const uint8_t *cb, const uint8_t *cr, size_t stride, int w, int h);
+
+// Coarsest subsampling that keeps the detail
+Subsampling choose_subsampling(const ChromaDetail &detail);
+
+// "444", "422" or "420"
+const char* subsampling_name(Subsampling subsampling);
+
+// Per-frame choice for a stream. A frame that needs finer chroma gets it at
+// once; going back to coarser waits until HOLD_FRAMES frames in a row asked
+// for it, so content near a threshold does not flip every frame.
+class SubsamplingSelector {
+public:
+    Subsampling update(const ChromaDetail &detail);
+    Subsampling current() const { return selected; }
+
+private:
+    Subsampling selected = Subsampling::S420;
+    int coarser_frames = 0;  // consecutive frames that wanted coarser
+};
+
+#endif
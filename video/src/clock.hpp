@@ -0,0 +1,13 @@
+#ifndef CLOCK_HPP
+#define CLOCK_HPP
+
+#include <chrono>
+#include <cstdint>
+
+// Monotonic microseconds, for frame timestamps and stage timing
+inline uint64_t steady_now_us() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+#endif
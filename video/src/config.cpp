@@ -64,6 +64,12 @@ int config_load(const char *path, EncoderConfig &out) {
         out.height = json_get_int(capture, "height", out.height);
         out.fps = json_get_int(capture, "fps", out.fps);
         out.monitor = json_get_int(capture, "monitor", out.monitor);
+        out.cursor = json_get_bool(capture, "cursor", out.cursor);
+
+        const char *scale_filter = json_get_string(capture, "scale_filter", nullptr);
+        if (scale_filter) {
+            out.scale_filter = scale_filter;
+        }
 
         const char *encoder = json_get_string(capture, "encoder", nullptr);
         if (encoder) {
@@ -80,6 +86,130 @@ int config_load(const char *path, EncoderConfig &out) {
         if (codec) {
             out.codec = codec;
         }
+
+        const char *subsampling = json_get_string(encoding, "subsampling", nullptr);
+        if (subsampling) {
+            out.subsampling = subsampling;
+        }
+        out.encode_workers = json_get_int(encoding, "workers", out.encode_workers);
+        out.encode_threads = json_get_int(encoding, "threads", out.encode_threads);
+        out.encode_slices = json_get_int(encoding, "slices", out.encode_slices);
+        out.dedup = json_get_bool(encoding, "dedup", out.dedup);
+
+        cJSON *rate = cJSON_GetObjectItemCaseSensitive(encoding, "rate");
+        if (cJSON_IsObject(rate)) {
+            out.rate_bitrate_kbps = json_get_int(rate, "bitrate_kbps", out.rate_bitrate_kbps);
+            out.rate_frame_kb = json_get_int(rate, "frame_kb", out.rate_frame_kb);
+            out.rate_min_quality = json_get_int(rate, "min_quality", out.rate_min_quality);
+            out.rate_max_quality = json_get_int(rate, "max_quality", out.rate_max_quality);
+        }
+
+        cJSON *roi = cJSON_GetObjectItemCaseSensitive(encoding, "roi");
+        if (cJSON_IsObject(roi)) {
+            out.roi_radius = json_get_int(roi, "radius", out.roi_radius);
+            out.roi_boost = json_get_int(roi, "boost", out.roi_boost);
+            out.roi_min_quality = json_get_int(roi, "min_quality", out.roi_min_quality);
+            out.roi_focus = json_get_bool(roi, "focus", out.roi_focus);
+        }
+
+        cJSON *simulcast = cJSON_GetObjectItemCaseSensitive(encoding, "simulcast");
+        if (cJSON_IsArray(simulcast)) {
+            out.simulcast.clear();
+            cJSON *item = nullptr;
+            cJSON_ArrayForEach(item, simulcast) {
+                if (!cJSON_IsObject(item)) {
+                    continue;
+                }
+                SimulcastLayer layer;
+                cJSON *scale = cJSON_GetObjectItemCaseSensitive(item, "scale");
+                if (cJSON_IsNumber(scale)) {
+                    layer.scale = scale->valuedouble;
+                }
+                layer.width = json_get_int(item, "width", layer.width);
+                layer.height = json_get_int(item, "height", layer.height);
+                layer.quality = json_get_int(item, "quality", layer.quality);
+                layer.codec = json_get_string(item, "codec", "");
+                layer.bitrate_kbps = json_get_int(item, "bitrate_kbps", layer.bitrate_kbps);
+                layer.shm_name = json_get_string(item, "shm_name", "");
+                layer.socket_path = json_get_string(item, "socket_path", "");
+                out.simulcast.push_back(layer);
+            }
+        }
+
+        cJSON *tiles = cJSON_GetObjectItemCaseSensitive(encoding, "tiles");
+        if (cJSON_IsObject(tiles)) {
+            out.tile_size = json_get_int(tiles, "size", out.tile_size);
+            out.tile_refresh_frames = json_get_int(tiles, "refresh_frames", out.tile_refresh_frames);
+            out.tile_motion = json_get_bool(tiles, "motion", out.tile_motion);
+            out.tile_refine_after = json_get_int(tiles, "refine_after", out.tile_refine_after);
+            out.tile_refine_quality = json_get_int(tiles, "refine_quality", out.tile_refine_quality);
+            out.tile_refine_budget_kb = json_get_int(tiles, "refine_budget_kb", out.tile_refine_budget_kb);
+            const char *lossless = json_get_string(tiles, "lossless", nullptr);
+            if (lossless) {
+                out.tile_lossless = lossless;
+            }
+        }
+
+        cJSON *lossless = cJSON_GetObjectItemCaseSensitive(encoding, "lossless");
+        if (cJSON_IsObject(lossless)) {
+            out.lossless_level = json_get_int(lossless, "level", out.lossless_level);
+            const char *dictionary = json_get_string(lossless, "dictionary", nullptr);
+            if (dictionary) {
+                out.lossless_dictionary = dictionary;
+            }
+        }
+
+        cJSON *h264 = cJSON_GetObjectItemCaseSensitive(encoding, "h264");
+        if (cJSON_IsObject(h264)) {
+            const char *preset = json_get_string(h264, "preset", nullptr);
+            if (preset) {
+                out.h264_preset = preset;
+            }
+            const char *profile = json_get_string(h264, "profile", nullptr);
+            if (profile) {
+                out.h264_profile = profile;
+            }
+            out.h264_keyint = json_get_int(h264, "keyint", out.h264_keyint);
+            out.h264_bitrate_kbps = json_get_int(h264, "bitrate_kbps", out.h264_bitrate_kbps);
+        }
+    }
+
+    // Get synthetic capture settings
+    cJSON *synthetic = cJSON_GetObjectItemCaseSensitive(root, "synthetic");
+    if (cJSON_IsObject(synthetic)) {
+        const char *scene = json_get_string(synthetic, "scene", nullptr);
+        if (scene) {
+            out.scene = scene;
+        }
+        out.seed = static_cast<uint32_t>(json_get_int(synthetic, "seed", static_cast<int>(out.seed)));
+        out.synthetic_width = json_get_int(synthetic, "width", out.synthetic_width);
+        out.synthetic_height = json_get_int(synthetic, "height", out.synthetic_height);
+    }
+
+    // Get replay capture settings
+    cJSON *replay = cJSON_GetObjectItemCaseSensitive(root, "replay");
+    if (cJSON_IsObject(replay)) {
+        const char *replay_path = json_get_string(replay, "path", nullptr);
+        if (replay_path) {
+            out.replay_path = replay_path;
+        }
+        out.replay_realtime = json_get_bool(replay, "realtime", out.replay_realtime);
+        out.replay_loop = json_get_bool(replay, "loop", out.replay_loop);
+    }
+
+    // Get output settings
+    cJSON *output = cJSON_GetObjectItemCaseSensitive(root, "output");
+    if (cJSON_IsObject(output)) {
+        const char *transport = json_get_string(output, "transport", nullptr);
+        if (transport) {
+            out.transport = transport;
+        }
+
+        const char *socket_path = json_get_string(output, "socket_path", nullptr);
+        if (socket_path) {
+            out.socket_path = socket_path;
+        }
+        out.join_cache_kb = json_get_int(output, "join_cache_kb", out.join_cache_kb);
     }
 
     // Get shared memory settings
@@ -101,6 +231,11 @@ int config_load(const char *path, EncoderConfig &out) {
     if (cJSON_IsObject(debug)) {
         out.verbose = json_get_bool(debug, "verbose", out.verbose);
         out.benchmark = json_get_bool(debug, "benchmark", out.benchmark);
+
+        const char *record = json_get_string(debug, "record", nullptr);
+        if (record) {
+            out.record_path = record;
+        }
     }
 
     cJSON_Delete(root);
@@ -112,18 +247,140 @@ int config_load(const char *path, EncoderConfig &out) {
 void config_print(const EncoderConfig &config) {
     printf("\n[CONFIG] Current settings:\n");
     printf("  Capture:\n");
-    printf("    Resolution: %dx%d\n", config.width, config.height);
+    if (config.width > 0 && config.height > 0) {
+        printf("    Resolution: %dx%d (%s downscale)\n", config.width, config.height, config.scale_filter.c_str());
+    } else {
+        printf("    Resolution: native\n");
+    }
     printf("    FPS: %d\n", config.fps);
     printf("    Monitor: %d\n", config.monitor);
     printf("    Encoder: %s\n", config.encoder.c_str());
+    printf("    Cursor channel: %s\n", config.cursor ? "yes" : "no");
     printf("  Encoding:\n");
     printf("    Quality: %d\n", config.quality);
     printf("    Codec: %s\n", config.codec.c_str());
-    printf("  Shared Memory:\n");
-    printf("    Name: %s\n", config.shm_name.c_str());
-    printf("    Size: %d MB\n", config.shm_size / (1024 * 1024));
+    if (config.codec == "jpeg" || config.codec == "tiles") {
+        printf("    Subsampling: %s\n", config.subsampling.c_str());
+    }
+    if (config.codec == "jpeg" && (config.rate_bitrate_kbps > 0 || config.rate_frame_kb > 0)) {
+        if (config.rate_frame_kb > 0) {
+            printf("    Rate: %d KB per frame", config.rate_frame_kb);
+        } else {
+            printf("    Rate: %d kbps", config.rate_bitrate_kbps);
+        }
+        printf(", quality %d..%d\n", config.rate_min_quality, config.rate_max_quality);
+    }
+    if ((config.codec == "jpeg" || config.codec == "tiles") && (config.roi_radius > 0 || config.roi_focus)) {
+        printf("    ROI: ");
+        if (config.roi_radius > 0) {
+            printf("%dpx around the pointer%s", config.roi_radius, config.roi_focus ? " and " : "");
+        }
+        printf("%s, up to +%d quality\n", config.roi_focus ? "the focused window" : "", config.roi_boost);
+    }
+    if (config.codec == "tiles") {
+        printf("    Tiles: %dpx, full refresh every %d frames, lossless %s, motion %s\n", config.tile_size,
+               config.tile_refresh_frames, config.tile_lossless.c_str(), config.tile_motion ? "on" : "off");
+        if (config.tile_refine_after > 0) {
+            printf("    Refine: after %d still frames, quality %d, up to %d KB per message\n",
+                   config.tile_refine_after, config.tile_refine_quality, config.tile_refine_budget_kb);
+        }
+    }
+    if (config.codec == "lossless") {
+        printf("    Lossless: %dpx tiles, full refresh every %d frames, motion %s, zstd level %d%s%s\n",
+               config.tile_size, config.tile_refresh_frames, config.tile_motion ? "on" : "off", config.lossless_level,
+               config.lossless_dictionary.empty() ? "" : ", dictionary ", config.lossless_dictionary.c_str());
+    }
+    if (config.codec == "h264") {
+        printf("    H.264: %s/%s, keyint %d, %s\n", config.h264_preset.c_str(), config.h264_profile.c_str(),
+               config.h264_keyint, config.h264_bitrate_kbps > 0 ? "bitrate" : "crf");
+        if (config.h264_bitrate_kbps > 0) {
+            printf("    Bitrate: %d kbps\n", config.h264_bitrate_kbps);
+        }
+    }
+    printf("    Workers: %d x %d threads\n", config.encode_workers, config.encode_threads);
+    if (config.encode_slices > 1) {
+        printf("    Slices: %d\n", config.encode_slices);
+    }
+    printf("    Dedup: %s\n", config.dedup ? "yes" : "no");
+    for (size_t i = 0; i < config.simulcast.size(); i++) {
+        const SimulcastLayer &layer = config.simulcast[i];
+        EncoderConfig lc = layer_config(config, static_cast<int>(i) + 1);
+        char size[32];
+        if (layer.scale > 0) snprintf(size, sizeof(size), "x%.2f", layer.scale);
+        else snprintf(size, sizeof(size), "%dx%d", lc.width, lc.height);
+        char quality[32];
+        if (layer.bitrate_kbps > 0) snprintf(quality, sizeof(quality), "%d kbps", layer.bitrate_kbps);
+        else snprintf(quality, sizeof(quality), "q%d", lc.quality);
+        printf("    Layer %zu: %s %s %s -> %s\n", i + 1, size, lc.codec.c_str(), quality,
+               lc.transport == "socket" ? lc.socket_path.c_str() : lc.shm_name.c_str());
+    }
+    if (config.encoder == "synthetic") {
+        printf("  Synthetic:\n");
+        printf("    Scene: %s\n", config.scene.c_str());
+        printf("    Seed: %u\n", config.seed);
+        printf("    Size: %dx%d\n", config.synthetic_width, config.synthetic_height);
+    }
+    if (config.encoder == "replay") {
+        printf("  Replay:\n");
+        printf("    File: %s\n", config.replay_path.c_str());
+        printf("    Realtime: %s\n", config.replay_realtime ? "yes" : "no");
+        printf("    Loop: %s\n", config.replay_loop ? "yes" : "no");
+    }
+    printf("  Output:\n");
+    printf("    Transport: %s\n", config.transport.c_str());
+    if (config.transport == "socket") {
+        printf("    Socket: %s\n", config.socket_path.c_str());
+    } else {
+        printf("    Shared memory: %s (%d MB)\n", config.shm_name.c_str(), config.shm_size / (1024 * 1024));
+    }
+    if (config.join_cache_kb > 0) {
+        printf("    Join cache: up to %d KB\n", config.join_cache_kb);
+    } else {
+        printf("    Join cache: off\n");
+    }
     printf("  Debug:\n");
     printf("    Verbose: %s\n", config.verbose ? "yes" : "no");
     printf("    Benchmark: %s\n", config.benchmark ? "yes" : "no");
+    if (!config.record_path.empty()) {
+        printf("    Record: %s\n", config.record_path.c_str());
+    }
     printf("\n");
 }
+
+int layer_count(const EncoderConfig &config) {
+    return 1 + static_cast<int>(config.simulcast.size());
+}
+
+// `base` with "_layer<N>" added, before a ".sock" extension if it has one
+static std::string layer_endpoint(const std::string &base, int layer) {
+    std::string suffix = "_layer" + std::to_string(layer);
+    const std::string ext = ".sock";
+    if (base.size() > ext.size() && base.compare(base.size() - ext.size(), ext.size(), ext) == 0) {
+        return base.substr(0, base.size() - ext.size()) + suffix + ext;
+    }
+    return base + suffix;
+}
+
+EncoderConfig layer_config(const EncoderConfig &config, int layer) {
+    EncoderConfig out = config;
+    out.layer = layer;
+    if (layer <= 0 || layer > static_cast<int>(config.simulcast.size())) {
+        return out;
+    }
+
+    const SimulcastLayer &l = config.simulcast[layer - 1];
+    if (l.width > 0) out.width = l.width;
+    if (l.height > 0) out.height = l.height;
+    if (l.quality >= 0) out.quality = l.quality;
+    if (!l.codec.empty()) out.codec = l.codec;
+    if (l.bitrate_kbps >= 0) {
+        out.h264_bitrate_kbps = l.bitrate_kbps;
+        out.rate_bitrate_kbps = l.bitrate_kbps;
+        out.rate_frame_kb = 0;
+    }
+    out.shm_name = l.shm_name.empty() ? layer_endpoint(config.shm_name, layer) : l.shm_name;
+    out.socket_path = l.socket_path.empty() ? layer_endpoint(config.socket_path, layer) : l.socket_path;
+    // Recording belongs to the capture, not a layer
+    out.record_path.clear();
+    return out;
+}
@@ -3,26 +3,109 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
+
+// An extra encoding of the same capture (encoding.simulcast), published on
+// its own shared memory block or socket. Unset fields keep the main
+// encoding's value.
+struct SimulcastLayer {
+    double scale = 0;    // output size as a fraction of the main output, 0 = use width/height
+    int width = 0;       // largest output size, 0 = the main output size
+    int height = 0;
+    int quality = -1;
+    std::string codec;
+    int bitrate_kbps = -1;  // H.264 bitrate and JPEG rate control target
+    std::string shm_name;     // empty = <main name>_layer<N>
+    std::string socket_path;  // empty = <main path without .sock>_layer<N>.sock
+};
 
 struct EncoderConfig {
-    // Capture settings
-    int width = 1920;
-    int height = 1080;
-    int fps = 30;
+    // Capture settings. Captures larger than width x height are downscaled
+    // to fit before encoding; 0 keeps the native size.
+    int width = 0;
+    int height = 0;
+    std::string scale_filter = "bilinear";  // "box", "bilinear", "lanczos"
+    int fps = 30;  // 0 = unthrottled
     int monitor = 0;  // 0 = primary, 1+ = additional monitors
+    bool cursor = false;  // pointer sent as cursor messages, not in the pixels (cursor.hpp)
 
     // Encoding settings
     int quality = 75;  // 0-100, meaning varies by encoder
-    std::string encoder = "gdi";  // "gdi", "dxgi", "nvenc"
-    std::string codec = "h264";    // "h264", "h265", "vp9"
+    std::string encoder = "gdi";  // "gdi", "dxgi", "macos", "x11shm", "synthetic", "replay"
+    std::string codec = "jpeg";    // see create_frame_encoder()
+    std::string subsampling = "420";  // JPEG chroma: "444", "422", "420", "gray", "auto" (chroma.hpp)
+    int encode_workers = 1;  // frames encoded in parallel, one encoder each
+    int encode_threads = 1;  // threads per encoder (JPEG: parallel strips)
+    int encode_slices = 0;   // JPEG strips published as they finish, 0 or 1 = whole frames
+    bool dedup = true;       // skip encoding frames identical to the previous one
+
+    // JPEG rate control (codec = "jpeg"): quality picked per frame to hit a
+    // bitrate or a per-frame size instead of the fixed `quality`
+    int rate_bitrate_kbps = 0;  // 0 = off
+    int rate_frame_kb = 0;      // per-frame budget, overrides the bitrate; 0 = off
+    int rate_min_quality = 20;
+    int rate_max_quality = 90;
+
+    // Region of interest (codec = "jpeg" or "tiles", roi.hpp): more of each
+    // frame's bytes go within roi_radius output pixels of the pointer and,
+    // with roi_focus, to the focused window; the rest is coded coarser
+    // (jpeg: low-passed) so the frame costs what it would have without
+    int roi_radius = 0;        // 0 = off
+    int roi_boost = 15;        // most quality points added in the region
+    int roi_min_quality = 30;  // tiles: lowest quality left to the periphery
+    bool roi_focus = false;
+
+    // Simulcast: layers 1..N after the main encoding (layer 0), each with
+    // its own encoders and endpoint. `layer` is the layer a config
+    // returned by layer_config() is for.
+    std::vector<SimulcastLayer> simulcast;
+    int layer = 0;
+
+    // Tile mode settings (codec = "tiles" or "lossless")
+    int tile_size = 64;         // pixels, multiple of 16
+    int tile_refresh_frames = 300;  // full refresh every N frames, 0 = never
+    std::string tile_lossless = "auto";  // text/UI tiles lossless: "auto" (classified), "off", "always"
+    bool tile_motion = true;        // send scrolls and window moves as copy records
+    int tile_refine_after = 30;     // re-send JPEG tiles still for N frames at refine_quality, 0 = never
+    int tile_refine_quality = 95;
+    int tile_refine_budget_kb = 64; // refinements fill messages up to this size
+
+    // Lossless settings (codec = "lossless", tile settings apply too)
+    int lossless_level = 1;           // zstd level
+    std::string lossless_dictionary;  // zstd dictionary file, empty = none
+
+    // H.264 settings (codec = "h264", needs libx264)
+    std::string h264_preset = "veryfast";  // x264 preset, always tuned zerolatency
+    std::string h264_profile = "baseline"; // "baseline", "main", "high"
+    int h264_keyint = 0;         // frames between IDRs, 0 = 2 seconds
+    int h264_bitrate_kbps = 0;   // 0 = constant quality from `quality`
+
+    // Synthetic capture settings (encoder = "synthetic")
+    std::string scene = "desktop";  // "desktop", "text", "code", "window", "video", "cursor", "media"
+    uint32_t seed = 1;
+    int synthetic_width = 1920;  // size of the rendered screen, before any downscale
+    int synthetic_height = 1080;
+
+    // Replay capture settings (encoder = "replay")
+    std::string replay_path;
+    bool replay_realtime = true;  // pace by recorded timestamps
+    bool replay_loop = true;
 
     // Output settings
+#ifdef __APPLE__
+    std::string transport = "socket";  // "shm" (Windows/Linux), "socket" (macOS/Linux)
+#else
+    std::string transport = "shm";
+#endif
+    std::string socket_path = "/tmp/distance_video.sock";
+    int join_cache_kb = 16384;  // the last keyframe and what followed, for consumers joining late, 0 = off
     std::string shm_name = "distance_video_0";
-    int shm_size = 10 * 1024 * 1024 + 256;  // DEFAULT_FRAME_SIZE + HEADER_SIZE
+    int shm_size = 2 * 10 * 1024 * 1024 + 256;  // HEADER_SIZE + two frame slots of (size - HEADER_SIZE) / 2, at most DEFAULT_FRAME_SIZE each
 
     // Debug
     bool verbose = false;
     bool benchmark = false;
+    std::string record_path;  // write raw captured frames here (see recording.hpp)
 };
 
 struct EncoderContext {
@@ -36,4 +119,12 @@ int config_load(const char *path, EncoderConfig &out);
 // Print config
 void config_print(const EncoderConfig &config);
 
+// Number of encodings: the main one plus the simulcast layers
+int layer_count(const EncoderConfig &config);
+
+// The config of layer `layer`: the main settings with the layer's overrides
+// and endpoints. Layer 0 is the main config itself. Output size is left to
+// the pipeline (SimulcastLayer::scale is relative to the main output).
+EncoderConfig layer_config(const EncoderConfig &config, int layer);
+
 #endif
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cstring>
+#include "cursor.hpp"
+#include "frame_hash.hpp"
+#include "frame_message.hpp"
+
+bool CursorState::same_as(const CursorState &other) const {
+    uint64_t hash = shape ? shape->hash : 0;
+    uint64_t other_hash = other.shape ? other.shape->hash : 0;
+    return visible == other.visible && x == other.x && y == other.y && hash == other_hash;
+}
+
+void cursor_shape_resize(CursorImage &shape, int width, int height) {
+    shape.width = std::min(std::max(width, 0), CURSOR_MAX_SIZE);
+    shape.height = std::min(std::max(height, 0), CURSOR_MAX_SIZE);
+    shape.hot_x = std::min(std::max(shape.hot_x, 0), std::max(shape.width - 1, 0));
+    shape.hot_y = std::min(std::max(shape.hot_y, 0), std::max(shape.height - 1, 0));
+    shape.pixels.assign(static_cast<size_t>(shape.width) * shape.height * 4, 0);
+}
+
+void cursor_shape_finish(CursorImage &shape) {
+    uint64_t hash = 0;
+    if (shape.width > 0 && shape.height > 0) {
+        hash = frame_hash(shape.pixels.data(), static_cast<size_t>(shape.width) * 4, shape.width, shape.height, 4);
+    }
+    // Same pixels with another hot spot is another shape
+    hash ^= (static_cast<uint64_t>(shape.hot_x) << 32 | static_cast<uint32_t>(shape.hot_y)) * 0x9E3779B97F4A7C15ull;
+    shape.hash = hash ? hash : 1;
+}
+
+void cursor_from_bgra(const uint8_t *src, size_t stride, int width, int height, bool premultiplied,
+                      CursorImage &shape) {
+    cursor_shape_resize(shape, width, height);
+    for (int y = 0; y < shape.height; y++) {
+        const uint8_t *s = src + y * stride;
+        uint8_t *d = &shape.pixels[static_cast<size_t>(y) * shape.width * 4];
+        for (int x = 0; x < shape.width; x++, s += 4, d += 4) {
+            uint8_t a = s[3];
+            if (premultiplied && a > 0 && a < 255) {
+                for (int c = 0; c < 3; c++) {
+                    d[c] = static_cast<uint8_t>(std::min(255, (s[c] * 255 + a / 2) / a));
+                }
+            } else {
+                memcpy(d, s, 3);
+            }
+            d[3] = a;
+        }
+    }
+    cursor_shape_finish(shape);
+}
+
+void cursor_from_masks(const uint8_t *and_mask, const uint8_t *xor_mask, size_t stride, int width, int height,
+                       CursorImage &shape) {
+    cursor_shape_resize(shape, width, height);
+    for (int y = 0; y < shape.height; y++) {
+        uint8_t *d = &shape.pixels[static_cast<size_t>(y) * shape.width * 4];
+        for (int x = 0; x < shape.width; x++, d += 4) {
+            uint8_t bit = static_cast<uint8_t>(0x80 >> (x & 7));
+            bool and_bit = and_mask[y * stride + x / 8] & bit;
+            bool xor_bit = xor_mask[y * stride + x / 8] & bit;
+            if (and_bit && !xor_bit) {
+                continue;  // transparent
+            }
+            uint8_t v = !and_bit && xor_bit ? 255 : 0;
+            d[0] = d[1] = d[2] = v;
+            d[3] = 255;
+        }
+    }
+    cursor_shape_finish(shape);
+}
+
+void cursor_from_masked_color(const uint8_t *src, size_t stride, int width, int height, CursorImage &shape) {
+    cursor_shape_resize(shape, width, height);
+    for (int y = 0; y < shape.height; y++) {
+        const uint8_t *s = src + y * stride;
+        uint8_t *d = &shape.pixels[static_cast<size_t>(y) * shape.width * 4];
+        for (int x = 0; x < shape.width; x++, s += 4, d += 4) {
+            bool xor_pixel = s[3] != 0;
+            if (xor_pixel && (s[0] | s[1] | s[2]) == 0) {
+                continue;  // XOR with black: the screen shows through
+            }
+            memcpy(d, s, 3);
+            d[3] = 255;
+        }
+    }
+    cursor_shape_finish(shape);
+}
+
+size_t write_cursor_message(const CursorState &state, int width, int height, bool with_shape,
+                            std::vector<uint8_t> &out) {
+    const CursorImage *shape = state.shape.get();
+    with_shape = with_shape && shape;
+
+    CursorMessage msg = {};
+    msg.magic = CURSOR_MESSAGE_MAGIC;
+    msg.flags = (state.visible ? CURSOR_FLAG_VISIBLE : 0) | (with_shape ? CURSOR_FLAG_SHAPE : 0);
+    msg.x = state.x;
+    msg.y = state.y;
+    msg.width = static_cast<uint32_t>(width);
+    msg.height = static_cast<uint32_t>(height);
+    if (shape) {
+        msg.shape_hash = shape->hash;
+        msg.shape_width = static_cast<uint16_t>(shape->width);
+        msg.shape_height = static_cast<uint16_t>(shape->height);
+        msg.hot_x = static_cast<uint16_t>(shape->hot_x);
+        msg.hot_y = static_cast<uint16_t>(shape->hot_y);
+    }
+
+    size_t pixel_bytes = with_shape ? shape->pixels.size() : 0;
+    out.resize(sizeof(msg) + pixel_bytes);
+    memcpy(out.data(), &msg, sizeof(msg));
+    if (pixel_bytes) {
+        memcpy(out.data() + sizeof(msg), shape->pixels.data(), pixel_bytes);
+    }
+    return out.size();
+}
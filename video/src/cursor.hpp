@@ -0,0 +1,77 @@
+#ifndef CURSOR_HPP
+#define CURSOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Cursor channel (capture.cursor): the pointer travels next to the frames
+// as small cursor messages (frame_message.hpp) instead of in their pixels,
+// so moving it over a still screen costs a few dozen bytes per update
+// rather than a frame. Consumers draw it on top of the picture.
+//
+// Shapes are identified by a hash. A message carries the shape's pixels
+// only when the consumer may not have them yet; otherwise the hash alone
+// names the shape to draw.
+
+// Shapes larger than this are cut to it (cursors are 32..64 px; 256 covers
+// accessibility sizes)
+constexpr int CURSOR_MAX_SIZE = 256;
+
+// One pointer image: BGRA, straight (not premultiplied) alpha, tightly
+// packed. The hot spot is the pixel that sits at the pointer position.
+// (Not "CursorShape": X.h defines that as a macro.)
+struct CursorImage {
+    int width = 0;
+    int height = 0;
+    int hot_x = 0;
+    int hot_y = 0;
+    std::vector<uint8_t> pixels;
+    uint64_t hash = 0;  // of size, hot spot and pixels; never 0
+};
+
+// Where the pointer is and what it looks like, as the capture backend
+// last saw it. Shapes are immutable once published, so the state can be
+// copied between threads freely.
+struct CursorState {
+    bool visible = false;
+    int x = -1;  // hot spot in capture pixels
+    int y = -1;
+    std::shared_ptr<const CursorImage> shape;  // null: not known (yet)
+
+    bool same_as(const CursorState &other) const;
+};
+
+// Size the shape to width x height (clipped to CURSOR_MAX_SIZE) before the
+// pixels are filled in, keeping the hot spot the caller set inside it. The
+// cursor_from_*() fillers below start with this, so set the hot spot first.
+void cursor_shape_resize(CursorImage &shape, int width, int height);
+
+// Compute shape.hash once its pixels are final
+void cursor_shape_finish(CursorImage &shape);
+
+// Fill a shape from 32-bit BGRA rows; `premultiplied` for sources whose
+// color is already scaled by alpha (XFixes)
+void cursor_from_bgra(const uint8_t *src, size_t stride, int width, int height, bool premultiplied,
+                      CursorImage &shape);
+
+// Fill a shape from 1 bpp AND and XOR masks (Windows monochrome cursors).
+// AND 1 / XOR 0 is transparent, AND 0 paints the XOR bit as black or
+// white. AND 1 / XOR 1 inverts the screen, which a consumer drawing with
+// alpha can't do: it becomes opaque black, so I-beams stay visible.
+void cursor_from_masks(const uint8_t *and_mask, const uint8_t *xor_mask, size_t stride, int width, int height,
+                       CursorImage &shape);
+
+// Fill a shape from Windows masked-color rows (BGRX plus a mask in the top
+// byte): mask 0 replaces the screen, mask 0xFF XORs it. XORing black is a
+// no-op and becomes transparent; other XOR pixels become opaque.
+void cursor_from_masked_color(const uint8_t *src, size_t stride, int width, int height, CursorImage &shape);
+
+// The cursor message for `state` in a width x height frame (the position is
+// already in its pixels), with the shape's pixels when `with_shape` and
+// there is one. Returns the message size.
+size_t write_cursor_message(const CursorState &state, int width, int height, bool with_shape,
+                            std::vector<uint8_t> &out);
+
+#endif
@@ -0,0 +1,251 @@
+// H.264 encoder using libx264 in-process, tuned "zerolatency": no B-frames,
+// no lookahead, every input frame produces one access unit immediately.
+// Only built when libx264 is found (HAVE_X264).
+//
+// Input is I420 (BT.601, limited range), which the pipeline converts once
+// per change (input_format); raw BGRA/BGR frames are converted here. The
+// access unit is written to the output frame in Annex B form. IDR frames
+// repeat SPS/PPS in-band so a stream can be joined at any keyframe; the
+// encoder also hands SPS/PPS out separately as the frame's codec_config,
+// which the shared memory transport keeps in its header.
+//
+// Rate control: encoding.h264.bitrate_kbps > 0 gives capped VBR with a
+// one-frame VBV buffer (low latency); otherwise constant quality (CRF)
+// derived from encoding.quality.
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <x264.h>
+#include "../encoder.hpp"
+
+// encoding.quality 0..100 maps linearly onto CRF 51..11 (75 -> 21)
+static float quality_to_crf(int quality) {
+    if (quality < 0) quality = 0;
+    if (quality > 100) quality = 100;
+    return 51.0f - quality * 0.4f;
+}
+
+// Keyframe interval when encoding.h264.keyint is 0
+constexpr int DEFAULT_KEYINT_SECONDS = 2;
+
+// Frame rate assumed for rate control when capture is unthrottled
+constexpr int UNTHROTTLED_FPS = 60;
+
+class H264Encoder : public FrameEncoder {
+public:
+    H264Encoder() = default;
+    ~H264Encoder() override { shutdown(); }
+
+    const char* get_name() const override {
+        return "h264";
+    }
+
+    bool is_available() const override {
+        return true;
+    }
+
+    void configure(const EncoderConfig &config) override {
+        quality = config.quality;
+        threads = config.encode_threads;
+        fps = config.fps > 0 ? config.fps : UNTHROTTLED_FPS;
+        preset = config.h264_preset;
+        profile = config.h264_profile;
+        keyint = config.h264_keyint > 0 ? config.h264_keyint : fps * DEFAULT_KEYINT_SECONDS;
+        bitrate_kbps = config.h264_bitrate_kbps;
+    }
+
+    bool init(int width, int height) override {
+        return open(width, height);
+    }
+
+    bool keeps_state() const override {
+        return true;
+    }
+
+    bool needs_even_size() const override {
+        return true;
+    }
+
+    YuvFormat input_format() const override {
+        return {PixelFormat::I420, YuvRange::LIMITED};
+    }
+
+    void request_keyframe() override {
+        force_idr = true;
+    }
+
+    bool encode(const FrameBuffer &raw, FrameBuffer &out) override {
+        int bpp = 0;
+        switch (raw.format) {
+        case PixelFormat::BGRA: bpp = 4; break;
+        case PixelFormat::BGR:  bpp = 3; break;
+        case PixelFormat::I420: break;
+        default:
+            printf("[H264] Unsupported input format\n");
+            return false;
+        }
+
+        if ((raw.width != width || raw.height != height) && !open(raw.width, raw.height)) {
+            return false;
+        }
+
+        // Same layout as our planes (no row padding), so an
+        // I420 frame is read in place; x264 copies its input
+        uint8_t *data = planes.data();
+        if (bpp) {
+            yuv_convert(raw.data, raw.stride, bpp, width, height, {0, 0, width, height}, PixelFormat::I420,
+                        YuvRange::LIMITED, yuv_planes(PixelFormat::I420, data, width, height));
+        } else {
+            data = raw.data;
+        }
+        YuvPlanes p = yuv_planes(PixelFormat::I420, data, width, height);
+        for (int i = 0; i < 3; i++) {
+            picture.img.plane[i] = p.data[i];
+        }
+        picture.i_pts = pts++;
+        picture.i_type = force_idr ? X264_TYPE_IDR : X264_TYPE_AUTO;
+        force_idr = false;
+
+        x264_nal_t *nals = nullptr;
+        int nal_count = 0;
+        x264_picture_t encoded;
+        int size = x264_encoder_encode(encoder, &nals, &nal_count, &picture, &encoded);
+        if (size < 0) {
+            printf("[H264] x264_encoder_encode failed\n");
+            return false;
+        }
+        if (size == 0) {
+            // Nothing out yet; zerolatency should never buffer
+            return false;
+        }
+        if (static_cast<size_t>(size) > out.capacity) {
+            printf("[H264] Output buffer too small (%d > %zu)\n", size, out.capacity);
+            return false;
+        }
+
+        // Payloads of one call are contiguous in memory
+        memcpy(out.data, nals[0].p_payload, size);
+        out.size = static_cast<size_t>(size);
+        out.format = PixelFormat::H264;
+        out.keyframe = encoded.b_keyframe != 0;
+        out.codec_config = codec_config;
+        return true;
+    }
+
+    void shutdown() override {
+        if (encoder) {
+            x264_encoder_close(encoder);
+            encoder = nullptr;
+        }
+        planes.clear();
+        width = height = 0;
+    }
+
+private:
+    bool open(int w, int h) {
+        shutdown();
+
+        x264_param_t param;
+        if (x264_param_default_preset(&param, preset.c_str(), "zerolatency") < 0) {
+            printf("[H264] Unknown preset: %s\n", preset.c_str());
+            return false;
+        }
+
+        // The SPS crops in units of 2 for 4:2:0, so an odd size can't be
+        // padded and cropped back; the pipeline hands us even sizes
+        if ((w | h) & 1) {
+            printf("[H264] %dx%d: width and height must be even\n", w, h);
+            return false;
+        }
+        param.i_width = w;
+        param.i_height = h;
+        param.i_csp = X264_CSP_I420;
+        param.i_threads = threads > 1 ? threads : 1;
+        param.i_fps_num = fps;
+        param.i_fps_den = 1;
+        param.b_vfr_input = 0;
+        param.i_keyint_max = keyint;
+        param.b_repeat_headers = 1;
+        param.b_annexb = 1;
+        param.i_log_level = X264_LOG_WARNING;
+
+        if (bitrate_kbps > 0) {
+            param.rc.i_rc_method = X264_RC_ABR;
+            param.rc.i_bitrate = bitrate_kbps;
+            param.rc.i_vbv_max_bitrate = bitrate_kbps;
+            param.rc.i_vbv_buffer_size = bitrate_kbps / fps > 0 ? bitrate_kbps / fps : 1;
+        } else {
+            param.rc.i_rc_method = X264_RC_CRF;
+            param.rc.f_rf_constant = quality_to_crf(quality);
+        }
+
+        if (x264_param_apply_profile(&param, profile.c_str()) < 0) {
+            printf("[H264] Unknown or incompatible profile: %s\n", profile.c_str());
+            return false;
+        }
+
+        encoder = x264_encoder_open(&param);
+        if (!encoder) {
+            printf("[H264] x264_encoder_open failed\n");
+            return false;
+        }
+
+        // SPS and PPS, with start codes, for the transport header
+        x264_nal_t *nals = nullptr;
+        int nal_count = 0;
+        if (x264_encoder_headers(encoder, &nals, &nal_count) < 0) {
+            printf("[H264] x264_encoder_headers failed\n");
+            shutdown();
+            return false;
+        }
+        codec_config.clear();
+        for (int i = 0; i < nal_count; i++) {
+            if (nals[i].i_type == NAL_SPS || nals[i].i_type == NAL_PPS) {
+                codec_config.insert(codec_config.end(), nals[i].p_payload, nals[i].p_payload + nals[i].i_payload);
+            }
+        }
+
+        // I420 planes raw frames are converted into
+        planes.assign(yuv_frame_size(PixelFormat::I420, w, h), 0);
+        x264_picture_init(&picture);
+        picture.img.i_csp = X264_CSP_I420;
+        picture.img.i_plane = 3;
+        YuvPlanes p = yuv_planes(PixelFormat::I420, planes.data(), w, h);
+        for (int i = 0; i < 3; i++) {
+            picture.img.plane[i] = p.data[i];
+            picture.img.i_stride[i] = p.stride[i];
+        }
+
+        width = w;
+        height = h;
+        pts = 0;
+        force_idr = false;
+        printf("[H264] %dx%d %s/%s zerolatency, keyint %d, %s, %d threads\n",
+               w, h, preset.c_str(), profile.c_str(), keyint,
+               bitrate_kbps > 0 ? "vbv" : "crf", param.i_threads);
+        return true;
+    }
+
+    int quality = 75;
+    int threads = 1;
+    int fps = 30;
+    std::string preset = "veryfast";
+    std::string profile = "baseline";
+    int keyint = 60;
+    int bitrate_kbps = 0;
+
+    x264_t *encoder = nullptr;
+    x264_picture_t picture;
+    std::vector<uint8_t> planes;
+    std::vector<uint8_t> codec_config;
+    int width = 0;
+    int height = 0;
+    int64_t pts = 0;
+    bool force_idr = false;
+};
+
+std::unique_ptr<FrameEncoder> create_h264_encoder() {
+    return std::make_unique<H264Encoder>();
+}
@@ -0,0 +1,545 @@
+// JPEG encoder using TurboJPEG. Honours encoding.quality and
+// encoding.subsampling; compresses straight into the pooled output frame.
+//
+// At 4:2:0 and 4:4:4 it asks the pipeline for planar YUV of that layout
+// (input_format), so TurboJPEG skips its own color conversion and only
+// regions that changed since the last frame are converted at all.
+//
+// With encoding.threads > 1 (or encoding.slices > 1) the frame is cut into
+// horizontal strips whose height is a multiple of the MCU height, and the
+// strips are compressed concurrently, one TurboJPEG handle each. The strips
+// are stitched into a single baseline JPEG: headers from the first strip
+// (with the height patched), a DRI marker whose interval is one strip's worth
+// of MCUs, and each strip's entropy-coded data separated by RSTn markers.
+// Every strip scan starts with fresh DC predictors and ends byte-aligned,
+// which is exactly what a decoder expects at a restart marker, so the result
+// decodes with any standard JPEG decoder.
+//
+// Strips are stitched in order as soon as they and all strips above them are
+// done. With encoding.slices > 1 each stitched prefix is also marked ready in
+// out.slices, so the pipeline can send the top of the frame while the bottom
+// is still encoding; threads alone keep whole-frame publishing, so the wire
+// format only changes when slices are asked for.
+//
+// With encoding.subsampling "auto" the chroma resolution is picked per frame
+// (chroma.hpp): 4:4:4 while the frame has colored text or fine colored
+// lines, 4:2:0 (or 4:2:2) otherwise. The pipeline then delivers I444 and
+// the chroma planes are halved here when a frame does not need them whole.
+//
+// With encoding.rate set, a RateController (rate_control.hpp) picks each
+// frame's quality from the content and the bytes spent so far; the quality
+// used is returned in out.quality.
+//
+// With encoding.roi set, the area around the pointer (roi.hpp) is what the
+// quality is for. A JPEG has one quality for the whole frame, so the frame
+// goes up to roi.boost points higher and the periphery is low-passed first,
+// just enough to take back what the higher quality costs. (Requantizing the
+// periphery's DCT blocks instead saves next to nothing: the coefficients
+// keep the finer steps' scale and cost about as many bits.)
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <turbojpeg.h>
+#include "../chroma.hpp"
+#include "../encoder.hpp"
+#include "../rate_control.hpp"
+#include "../roi.hpp"
+#include "../thread_pool.hpp"
+
+// JPEG markers used when stitching strips
+constexpr uint8_t MARKER_SOF0 = 0xC0;
+constexpr uint8_t MARKER_RST0 = 0xD0;
+constexpr uint8_t MARKER_SOI  = 0xD8;
+constexpr uint8_t MARKER_EOI  = 0xD9;
+constexpr uint8_t MARKER_SOS  = 0xDA;
+constexpr uint8_t MARKER_DRI  = 0xDD;
+
+// DRI stores the restart interval in 16 bits
+constexpr int MAX_RESTART_INTERVAL = 0xFFFF;
+
+// One horizontal slice of the frame and its private compressor
+struct JpegStrip {
+    int y = 0;
+    int height = 0;
+    tjhandle compressor = nullptr;
+    std::vector<uint8_t> buffer;
+    unsigned long size = 0;
+    bool ok = false;
+    bool done = false;
+};
+
+class JpegEncoder : public FrameEncoder {
+public:
+    JpegEncoder() = default;
+    ~JpegEncoder() override { shutdown(); }
+
+    const char* get_name() const override {
+        return "jpeg";
+    }
+
+    bool is_available() const override {
+        // TurboJPEG is a hard build dependency
+        return true;
+    }
+
+    void configure(const EncoderConfig &config) override {
+        quality = config.quality;
+        subsampling_name = config.subsampling;
+        threads = config.encode_threads;
+        slices = config.encode_slices;
+        rate_control = rate.init(config);
+        roi_radius = config.roi_radius;
+        roi_focus = config.roi_focus;
+        roi_boost = config.roi_boost;
+    }
+
+    bool init(int width, int height) override {
+        // Auto plans and takes input as for 4:4:4, the finest it may pick
+        auto_subsampling = subsampling_name == "auto";
+        if (auto_subsampling) {
+            subsampling = TJSAMP_444;
+            selector = SubsamplingSelector();
+        } else if (!parse_subsampling(subsampling_name, subsampling)) {
+            printf("[JPEG] Unknown subsampling: %s\n", subsampling_name.c_str());
+            return false;
+        }
+        if (quality < 1 || quality > 100) {
+            printf("[JPEG] Quality %d out of range, clamping\n", quality);
+            quality = quality < 1 ? 1 : 100;
+        }
+        if (threads < 1) {
+            threads = 1;
+        }
+
+        compressor = tjInitCompress();
+        if (!compressor) {
+            printf("[JPEG] TurboJPEG init failed\n");
+            return false;
+        }
+
+        if (threads > 1 || slices > 1) {
+            pool = std::make_unique<ThreadPool>(threads);
+            if (!plan_strips(width, height)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    YuvFormat input_format() const override {
+        YuvFormat format;
+        if (subsampling == TJSAMP_420) format.layout = PixelFormat::I420;
+        else if (subsampling == TJSAMP_444) format.layout = PixelFormat::I444;
+        return format;
+    }
+
+    bool encode(const FrameBuffer &raw, FrameBuffer &out) override {
+        if (!compressor) {
+            return false;
+        }
+
+        int pixel_format = -1;
+        switch (raw.format) {
+        case PixelFormat::BGRA: pixel_format = TJPF_BGRX; break;
+        case PixelFormat::BGR:  pixel_format = TJPF_BGR;  break;
+        case PixelFormat::I420:
+        case PixelFormat::I444:
+            if (raw.format != input_format().layout) {
+                printf("[JPEG] Planar input does not match subsampling %s\n", subsampling_name.c_str());
+                return false;
+            }
+            break;
+        default:
+            printf("[JPEG] Unsupported input format\n");
+            return false;
+        }
+
+        frame_subsampling = subsampling;
+        if (auto_subsampling) {
+            ChromaDetail detail;
+            if (raw.format == PixelFormat::I444) {
+                YuvPlanes p = yuv_planes(raw.format, raw.data, raw.width, raw.height);
+                detail = chroma_detail_planar(p.data[1], p.data[2], p.stride[1], raw.width, raw.height);
+            } else {
+                detail = chroma_detail(raw.data, raw.stride, raw.width, raw.height, raw.format == PixelFormat::BGR ? 3 : 4);
+            }
+            frame_subsampling = static_cast<int>(selector.update(detail));
+        }
+        pixels = raw.data;
+        pixel_stride = raw.stride;
+        if (raw.format == PixelFormat::I420 || raw.format == PixelFormat::I444) {
+            set_planes(raw);
+        }
+
+        size_t pixel_count = static_cast<size_t>(raw.width) * raw.height;
+        double activity = 0;
+        frame_quality = quality;
+        if (rate_control) {
+            activity = frame_activity(raw);
+            frame_quality = rate.choose(pixel_count, activity, raw.timestamp_us);
+        }
+        // Rate control judges the frame by the quality it chose
+        int budget_quality = frame_quality;
+        if (roi_radius > 0 || roi_focus) {
+            Roi roi = frame_roi(raw, roi_radius, roi_focus);
+            if (roi.active()) {
+                RoiSmoothing smoothing = roi_smoothing(frame_quality, roi_boost, roi.share(raw.width, raw.height));
+                frame_quality = smoothing.quality;
+                if (smoothing.strength > 0) {
+                    smooth_periphery(raw, roi, smoothing.strength);
+                }
+            }
+        }
+
+        if (pool) {
+            if ((raw.width != plan_width || raw.height != plan_height) &&
+                !plan_strips(raw.width, raw.height)) {
+                return false;
+            }
+        }
+        if (pool && strips.size() > 1) {
+            if (!encode_strips(raw, pixel_format, out)) {
+                return false;
+            }
+        } else {
+            unsigned long jpeg_size_val = out.capacity;
+            int result = compress(compressor, raw, pixel_format, 0, raw.height, out.data, &jpeg_size_val);
+            if (result != 0) {
+                printf("[JPEG] TurboJPEG compression failed: %s\n", tjGetErrorStr());
+                return false;
+            }
+
+            out.size = jpeg_size_val;
+            out.format = PixelFormat::JPEG;
+            out.keyframe = true;
+        }
+
+        out.quality = frame_quality;
+        out.subsampling = frame_subsampling;
+        if (rate_control) {
+            rate.update(budget_quality, pixel_count, activity, out.size);
+        }
+        return true;
+    }
+
+    bool streams_slices() const override {
+        return slices > 1 && pool && strips.size() > 1;
+    }
+
+    void shutdown() override {
+        pool.reset();
+        for (auto &strip : strips) {
+            if (strip.compressor) tjDestroy(strip.compressor);
+        }
+        strips.clear();
+        if (compressor) {
+            tjDestroy(compressor);
+            compressor = nullptr;
+        }
+    }
+
+private:
+    // Planes of a planar frame at frame_subsampling: as delivered, or with
+    // the I444 chroma halved when auto picked 4:2:2 or 4:2:0
+    void set_planes(const FrameBuffer &raw) {
+        YuvPlanes p = yuv_planes(raw.format, raw.data, raw.width, raw.height);
+        for (int i = 0; i < 3; i++) {
+            planes[i] = p.data[i];
+            plane_strides[i] = p.stride[i];
+        }
+        if (raw.format != PixelFormat::I444 || frame_subsampling == TJSAMP_444) {
+            return;
+        }
+        bool halve_rows = frame_subsampling == TJSAMP_420;
+        int cw = (raw.width + 1) / 2;
+        size_t plane = static_cast<size_t>(cw) * (halve_rows ? (raw.height + 1) / 2 : raw.height);
+        halved.resize(plane * 2);
+        for (int i = 1; i < 3; i++) {
+            uint8_t *dst = halved.data() + plane * (i - 1);
+            yuv_halve_chroma(p.data[i], p.stride[i], raw.width, raw.height, halve_rows, dst, cw);
+            planes[i] = dst;
+            plane_strides[i] = cw;
+        }
+    }
+
+    // Smooth everything outside `roi` into `smoothed` and encode from
+    // there: the luma plane of planar input (chroma has little detail left
+    // to lose), or the pixels themselves
+    void smooth_periphery(const FrameBuffer &raw, const Roi &roi, int strength) {
+        if (raw.format == PixelFormat::I420 || raw.format == PixelFormat::I444) {
+            smoothed.resize(static_cast<size_t>(raw.width) * raw.height);
+            roi_smooth(planes[0], plane_strides[0], raw.width, raw.height, 1, roi, strength, smoothed.data(),
+                       raw.width, pool.get());
+            planes[0] = smoothed.data();
+            plane_strides[0] = raw.width;
+            return;
+        }
+        int bpp = raw.format == PixelFormat::BGR ? 3 : 4;
+        smoothed.resize(static_cast<size_t>(raw.width) * raw.height * bpp);
+        roi_smooth(raw.data, raw.stride, raw.width, raw.height, bpp, roi, strength, smoothed.data(),
+                   static_cast<size_t>(raw.width) * bpp, pool.get());
+        pixels = smoothed.data();
+        pixel_stride = raw.width * bpp;
+    }
+
+    // Rows [y, y + rows) of `raw` to a JPEG in `dst`, `size` bytes on entry
+    // and the JPEG size on return. Pixels come from `pixels` and planar input
+    // from set_planes(); y is a multiple of the MCU height, so even for 4:2:0.
+    int compress(tjhandle handle, const FrameBuffer &raw, int pixel_format, int y, int rows,
+                 unsigned char *dst, unsigned long *size) {
+        if (raw.format == PixelFormat::I420 || raw.format == PixelFormat::I444) {
+            size_t chroma_y = static_cast<size_t>(frame_subsampling == TJSAMP_420 ? y / 2 : y);
+            const unsigned char *rows_at[3] = {
+                planes[0] + static_cast<size_t>(y) * plane_strides[0],
+                planes[1] + chroma_y * plane_strides[1],
+                planes[2] + chroma_y * plane_strides[2],
+            };
+            return tjCompressFromYUVPlanes(handle, rows_at, raw.width, plane_strides, rows, frame_subsampling,
+                                           &dst, size, frame_quality, TJFLAG_FASTDCT | TJFLAG_NOREALLOC);
+        }
+        return tjCompress2(
+            handle,
+            pixels + static_cast<size_t>(y) * pixel_stride,
+            raw.width,
+            pixel_stride,
+            rows,
+            pixel_format,
+            &dst,
+            size,
+            frame_subsampling,
+            frame_quality,
+            TJFLAG_FASTDCT | TJFLAG_NOREALLOC
+        );
+    }
+
+    // -----------------------------------------------------------------------
+    // Strip encoding
+    // -----------------------------------------------------------------------
+
+    // Cut width x height into MCU-aligned strips, at least one per thread (or
+    // encoding.slices) and few enough MCUs each to fit the 16-bit restart
+    // interval. With auto subsampling strips are cut in 4:2:0 MCU rows (16
+    // pixels, whole MCUs at every subsampling) and sized for 4:4:4, which
+    // has the most MCUs.
+    bool plan_strips(int width, int height) {
+        int mcu_w = tjMCUWidth[subsampling];
+        int mcu_h = auto_subsampling ? tjMCUHeight[TJSAMP_420] : tjMCUHeight[subsampling];
+        int mcu_cols = (width + mcu_w - 1) / mcu_w * (mcu_h / tjMCUHeight[subsampling]);
+        int mcu_rows = (height + mcu_h - 1) / mcu_h;
+
+        int count = slices > threads ? slices : threads;
+        if (count > mcu_rows) count = mcu_rows;
+        int rows_per_strip = (mcu_rows + count - 1) / count;
+        while (rows_per_strip > 1 && mcu_cols * rows_per_strip > MAX_RESTART_INTERVAL) {
+            rows_per_strip--;
+        }
+        if (mcu_cols * rows_per_strip > MAX_RESTART_INTERVAL) {
+            printf("[JPEG] Frame too wide for strip encoding: %dx%d\n", width, height);
+            return false;
+        }
+        count = (mcu_rows + rows_per_strip - 1) / rows_per_strip;
+
+        for (auto &strip : strips) {
+            if (strip.compressor) tjDestroy(strip.compressor);
+        }
+        strips.assign(count, JpegStrip());
+
+        int strip_h = rows_per_strip * mcu_h;
+        for (int i = 0; i < count; i++) {
+            JpegStrip &strip = strips[i];
+            strip.y = i * strip_h;
+            strip.height = i == count - 1 ? height - strip.y : strip_h;
+            strip.buffer.resize(tjBufSize(width, strip.height, subsampling));
+            strip.compressor = tjInitCompress();
+            if (!strip.compressor) {
+                printf("[JPEG] TurboJPEG init failed\n");
+                return false;
+            }
+        }
+
+        strip_rows = strip_h;
+        plan_width = width;
+        plan_height = height;
+        printf("[JPEG] %d strips of %d rows on %d threads\n", count, strip_h, pool->size());
+        return true;
+    }
+
+    bool encode_strips(const FrameBuffer &raw, int pixel_format, FrameBuffer &out) {
+        int mcu_w = tjMCUWidth[frame_subsampling], mcu_h = tjMCUHeight[frame_subsampling];
+        restart_interval = (raw.width + mcu_w - 1) / mcu_w * (strip_rows / mcu_h);
+        out.format = PixelFormat::JPEG;
+        out.keyframe = true;
+        stitched = 0;
+        next_strip = 0;
+        stitch_ok = true;
+        for (auto &strip : strips) strip.done = false;
+
+        pool->parallel_for(static_cast<int>(strips.size()), [&](int i) {
+            JpegStrip &strip = strips[i];
+            strip.size = strip.buffer.size();
+            strip.ok = compress(strip.compressor, raw, pixel_format, strip.y, strip.height,
+                                strip.buffer.data(), &strip.size) == 0;
+
+            // Stitch every strip whose predecessors are all in
+            std::lock_guard<std::mutex> lock(stitch_mutex);
+            strip.done = true;
+            size_t before = stitched;
+            while (next_strip < strips.size() && strips[next_strip].done) {
+                if (stitch_ok) {
+                    stitch_ok = strips[next_strip].ok && stitch(next_strip, raw.height, out);
+                }
+                next_strip++;
+            }
+            if (stitch_ok && stitched > before && slices > 1) {
+                out.slices.advance(stitched);
+            }
+        });
+
+        for (const auto &strip : strips) {
+            if (!strip.ok) {
+                printf("[JPEG] TurboJPEG strip compression failed: %s\n", tjGetErrorStr());
+                return false;
+            }
+        }
+        if (!stitch_ok) {
+            return false;
+        }
+
+        out.data[stitched++] = 0xFF;
+        out.data[stitched++] = MARKER_EOI;
+        out.size = stitched;
+        return true;
+    }
+
+    // Append strip i to the JPEG in `out`: the first strip brings the
+    // headers and a DRI, later ones an RSTn before their scan. Room for the
+    // final EOI is always kept.
+    bool stitch(size_t i, int height, FrameBuffer &out) {
+        const uint8_t *src = strips[i].buffer.data();
+        size_t size = strips[i].size;
+        if (size < 4 || src[0] != 0xFF || src[1] != MARKER_SOI ||
+            src[size - 2] != 0xFF || src[size - 1] != MARKER_EOI) {
+            printf("[JPEG] Malformed strip %zu\n", i);
+            return false;
+        }
+
+        // Walk marker segments up to and including SOS
+        size_t pos = 2;
+        size_t scan_start = 0;
+        while (pos + 4 <= size && src[pos] == 0xFF) {
+            uint8_t marker = src[pos + 1];
+            size_t length = (static_cast<size_t>(src[pos + 2]) << 8) | src[pos + 3];
+            if (marker == MARKER_SOS) {
+                scan_start = pos + 2 + length;
+                break;
+            }
+            pos += 2 + length;
+        }
+        if (!scan_start || scan_start > size - 2) {
+            printf("[JPEG] No scan in strip %zu\n", i);
+            return false;
+        }
+
+        size_t scan_size = size - 2 - scan_start;
+        size_t needed = (i == 0 ? scan_start + 6 : 2) + scan_size + 2;
+        if (stitched + needed > out.capacity) {
+            printf("[JPEG] Output buffer too small (%zu > %zu)\n", stitched + needed, out.capacity);
+            return false;
+        }
+
+        uint8_t *dst = out.data + stitched;
+        if (i == 0) {
+            // SOI + tables + SOF from the first strip, then DRI, then its SOS
+            size_t header = pos;
+            memcpy(dst, src, header);
+            if (!patch_height(dst, header, height)) {
+                printf("[JPEG] No SOF0 in strip 0\n");
+                return false;
+            }
+            dst += header;
+            const uint8_t dri[6] = {0xFF, MARKER_DRI, 0x00, 0x04,
+                                    static_cast<uint8_t>(restart_interval >> 8),
+                                    static_cast<uint8_t>(restart_interval & 0xFF)};
+            memcpy(dst, dri, sizeof(dri));
+            dst += sizeof(dri);
+            memcpy(dst, src + pos, scan_start - pos);
+            dst += scan_start - pos;
+        } else {
+            *dst++ = 0xFF;
+            *dst++ = static_cast<uint8_t>(MARKER_RST0 + ((i - 1) & 7));
+        }
+
+        memcpy(dst, src + scan_start, scan_size);
+        dst += scan_size;
+        stitched = static_cast<size_t>(dst - out.data);
+        return true;
+    }
+
+    // Set the frame height in the SOF0 segment within data[0, size)
+    static bool patch_height(uint8_t *data, size_t size, int height) {
+        size_t pos = 2;
+        while (pos + 9 <= size && data[pos] == 0xFF) {
+            size_t length = (static_cast<size_t>(data[pos + 2]) << 8) | data[pos + 3];
+            if (data[pos + 1] == MARKER_SOF0) {
+                data[pos + 5] = static_cast<uint8_t>(height >> 8);
+                data[pos + 6] = static_cast<uint8_t>(height & 0xFF);
+                return true;
+            }
+            pos += 2 + length;
+        }
+        return false;
+    }
+
+    int quality = 75;
+    int frame_quality = 75;  // this frame's, from rate control or `quality`
+    std::string subsampling_name = "420";
+    int subsampling = TJSAMP_420;
+    bool auto_subsampling = false;
+    SubsamplingSelector selector;
+    int frame_subsampling = TJSAMP_420;  // this frame's, TJSAMP_*
+
+    // Planes of the frame being encoded (planar input), see set_planes()
+    const uint8_t *planes[3] = {};
+    int plane_strides[3] = {};
+    std::vector<uint8_t> halved;  // chroma halved from I444
+
+    // Region of interest (encoding.roi)
+    int roi_radius = 0;
+    bool roi_focus = false;
+    int roi_boost = 15;
+
+    // Packed pixels of the frame being encoded: the input, or the smoothed
+    // copy when a region of interest is active
+    const uint8_t *pixels = nullptr;
+    int pixel_stride = 0;
+    std::vector<uint8_t> smoothed;
+
+    int threads = 1;
+    int slices = 0;
+
+    RateController rate;
+    bool rate_control = false;
+
+    tjhandle compressor = nullptr;
+
+    // Strip mode (threads > 1 or slices > 1)
+    std::unique_ptr<ThreadPool> pool;
+    std::vector<JpegStrip> strips;
+    int strip_rows = 0;        // pixel rows per strip but the last
+    int restart_interval = 0;  // MCUs per strip at this frame's subsampling
+
+    // Stitching progress within one encode_strips() call
+    std::mutex stitch_mutex;
+    size_t stitched = 0;
+    size_t next_strip = 0;
+    bool stitch_ok = true;
+    int plan_width = 0;
+    int plan_height = 0;
+};
+
+std::unique_ptr<FrameEncoder> create_jpeg_encoder() {
+    return std::make_unique<JpegEncoder>();
+}
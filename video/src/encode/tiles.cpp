@@ -0,0 +1,1025 @@
+// Dirty-tile encoder. The frame is split into a fixed grid of square tiles
+// (encoding.tiles.size); each frame only the tiles whose pixels differ from
+// the previous frame are JPEG-encoded and published as a tile message
+// (frame_message.hpp). A static desktop with a blinking cursor costs one
+// tile per frame instead of a full-screen JPEG.
+//
+// Each dirty tile is classified (tile_classify.hpp): text and UI tiles are
+// coded losslessly with a palette and run lengths, photographic tiles with
+// JPEG, both kinds side by side in the same message, so terminal text stays
+// sharp without raising the JPEG quality for everything
+// (encoding.tiles.lossless). Horizontally adjacent dirty tiles of the same
+// kind in a tile row are merged into a single record to save per-record
+// header overhead. Backend damage rects, when present, limit which tiles
+// are compared at all; the comparison itself is tile_diff() (tile_diff.hpp),
+// one tile row per thread. Every encoding.tiles.refresh_frames frames (and
+// on the first frame, or when a consumer joins) the whole frame is sent so
+// late or lossy consumers can resync.
+//
+// Scrolling and window drags would dirty most of the screen at once. When
+// enough tiles change, the motion detector (motion.hpp) looks for one
+// offset the changed content moved by. Tiles whose pixels are exactly the
+// previous frame's at that offset go out as copy records (a few bytes
+// each), and only the rest, such as the strip a scroll exposes, is
+// encoded (encoding.tiles.motion).
+//
+// With encoding.subsampling "auto" each JPEG run gets its own chroma
+// resolution (chroma.hpp): 4:4:4 where it holds colored text or fine colored
+// lines, 4:2:0 for photos and video.
+//
+// With encoding.roi set, JPEG runs near the pointer (roi.hpp) go out up to
+// roi.boost quality points higher and the rest lower, split so the frame's
+// JPEG bytes stay what one quality for all would have cost. Runs are cut
+// where the region starts and ends.
+//
+// Tiles that stop changing are refined progressively: once a JPEG tile has
+// been still for encoding.tiles.refine_after frames it is sent again at
+// refine_quality with full chroma, using only what the frame leaves over
+// (see encode_refinements()). Idle frames that dedup would have skipped are
+// spent on this too (FrameEncoder::refine), so a paused video or a photo
+// sharpens within a second or two, while anything that moves stays cheap.
+//
+// Codec "lossless" is the same encoder with every record lossless, for CAD
+// and code review: each run is coded as a palette, as an XOR against the
+// previous frame (small edits inside a tile leave mostly zeros) or as
+// predicted residuals (predict.hpp), whichever fits, and the record stream of
+// the whole message is compressed with zstd in one go (TILE_FLAG_ZSTD),
+// optionally with a dictionary trained on UI content
+// (encoding.lossless.dictionary). Codec "lossless" is only built with
+// libzstd.
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <turbojpeg.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "../chroma.hpp"
+#include "../clock.hpp"
+#include "../encoder.hpp"
+#include "../frame_message.hpp"
+#include "../motion.hpp"
+#include "../palette_rle.hpp"
+#include "../predict.hpp"
+#include "../roi.hpp"
+#include "../thread_pool.hpp"
+#include "../tile_classify.hpp"
+#include "../tile_diff.hpp"
+
+// Tile size bounds; multiples of 16 keep tiles MCU-aligned at any subsampling
+constexpr int MIN_TILE_SIZE = 16;
+constexpr int MAX_TILE_SIZE = 512;
+
+// Fewest dirty tiles worth looking for a scroll or window move in
+constexpr int MOTION_MIN_TILES = 4;
+
+// Refinement stops once an encode has used this share of the frame interval
+constexpr int REFINE_TIME_PERCENT = 50;
+
+// Refinement time per message when capture is unthrottled (fps 0)
+constexpr uint64_t REFINE_TIME_UNTHROTTLED_US = 8000;
+
+// encoding.tiles.lossless
+enum class LosslessMode { AUTO, OFF, ALWAYS };
+
+static bool parse_lossless_mode(const std::string &name, LosslessMode &out) {
+    if (name == "auto") out = LosslessMode::AUTO;
+    else if (name == "off") out = LosslessMode::OFF;
+    else if (name == "always") out = LosslessMode::ALWAYS;
+    else return false;
+    return true;
+}
+
+// One update rectangle: a run of dirty tiles of one class in one tile row,
+// all in or all out of the region of interest
+struct TileRun {
+    int x, y, width, height;
+    TileClass kind;
+    bool roi = false;
+};
+
+// Records and payloads produced by one thread, appended to the message
+struct TileGroup {
+    tjhandle compressor = nullptr;
+    std::vector<uint8_t> buffer;
+    size_t used = 0;
+    uint32_t count = 0;
+    bool ok = true;
+    int subsampling = -1;  // finest TJSAMP_* of its JPEG records, -1 if none
+
+    void used_subsampling(int s) {
+        if (subsampling < 0 || s < subsampling) subsampling = s;
+    }
+
+    // Make room for `bytes` more without shrinking
+    uint8_t* reserve(size_t bytes) {
+        if (buffer.size() < used + bytes) {
+            buffer.resize((used + bytes) * 3 / 2);
+        }
+        return buffer.data() + used;
+    }
+};
+
+// Rough size of predicted residuals after zstd on photographic content,
+// to weigh them against an XOR record
+constexpr size_t PREDICTED_BYTES_PER_PIXEL = 1;
+
+class TileEncoder : public FrameEncoder {
+public:
+    explicit TileEncoder(bool lossless_codec) : lossless_codec(lossless_codec) {}
+    ~TileEncoder() override { shutdown(); }
+
+    const char* get_name() const override {
+        return lossless_codec ? "lossless" : "tiles";
+    }
+
+    bool is_available() const override {
+        // Built on TurboJPEG, a hard build dependency
+        return true;
+    }
+
+    void configure(const EncoderConfig &config) override {
+        quality = config.quality;
+        subsampling_name = config.subsampling;
+        threads = config.encode_threads;
+        tile_size = config.tile_size;
+        refresh_frames = config.tile_refresh_frames;
+        lossless_name = lossless_codec ? "always" : config.tile_lossless;
+        motion = config.tile_motion;
+        zstd_level = config.lossless_level;
+        dictionary_path = config.lossless_dictionary;
+        // Codec "lossless" has nothing to refine
+        refine_after = lossless_codec ? 0 : config.tile_refine_after;
+        refine_quality = config.tile_refine_quality;
+        refine_budget = static_cast<size_t>(config.tile_refine_budget_kb) * 1024;
+        roi_radius = config.roi_radius;
+        roi_focus = config.roi_focus;
+        roi_boost = config.roi_boost;
+        roi_min_quality = config.roi_min_quality;
+        refine_time_us = config.fps > 0 ? 1000000ull * REFINE_TIME_PERCENT / 100 / config.fps
+                                        : REFINE_TIME_UNTHROTTLED_US;
+    }
+
+    bool init(int, int) override {
+        // Auto sizes JPEG buffers for 4:4:4, the finest it may pick
+        auto_subsampling = subsampling_name == "auto";
+        if (auto_subsampling) {
+            subsampling = TJSAMP_444;
+        } else if (!parse_subsampling(subsampling_name, subsampling)) {
+            printf("[TILES] Unknown subsampling: %s\n", subsampling_name.c_str());
+            return false;
+        }
+        if (!parse_lossless_mode(lossless_name, lossless)) {
+            printf("[TILES] Unknown lossless mode: %s\n", lossless_name.c_str());
+            return false;
+        }
+        if (tile_size < MIN_TILE_SIZE || tile_size > MAX_TILE_SIZE || tile_size % 16 != 0) {
+            printf("[TILES] Tile size must be a multiple of 16 in [%d, %d], got %d\n",
+                   MIN_TILE_SIZE, MAX_TILE_SIZE, tile_size);
+            return false;
+        }
+        if (quality < 1 || quality > 100) {
+            printf("[TILES] Quality %d out of range, clamping\n", quality);
+            quality = quality < 1 ? 1 : 100;
+        }
+        if (refine_quality < 1 || refine_quality > 100) {
+            printf("[TILES] Refine quality %d out of range, clamping\n", refine_quality);
+            refine_quality = refine_quality < 1 ? 1 : 100;
+        }
+        if (threads < 1) {
+            threads = 1;
+        }
+
+        pool = std::make_unique<ThreadPool>(threads);
+        groups.resize(threads);
+        for (auto &group : groups) {
+            group.compressor = tjInitCompress();
+            if (!group.compressor) {
+                printf("[TILES] TurboJPEG init failed\n");
+                return false;
+            }
+        }
+
+        if (lossless_codec && !init_zstd()) {
+            return false;
+        }
+
+        printf("[TILES] %dx%d tiles, full refresh every %d frames, %d threads, %s diff, lossless %s, motion %s\n",
+               tile_size, tile_size, refresh_frames, threads, tile_diff_kernel(), lossless_name.c_str(),
+               motion ? "on" : "off");
+        if (refine_after > 0) {
+            printf("[TILES] Refining tiles still for %d frames at quality %d, up to %zu KB per message\n",
+                   refine_after, refine_quality, refine_budget / 1024);
+        }
+        return true;
+    }
+
+    bool keeps_state() const override {
+        return true;
+    }
+
+    bool encode(const FrameBuffer &raw, FrameBuffer &out) override {
+        uint64_t start_us = steady_now_us();
+        int bpp;
+        switch (raw.format) {
+        case PixelFormat::BGRA: bpp = 4; pixel_format = TJPF_BGRX; break;
+        case PixelFormat::BGR:  bpp = 3; pixel_format = TJPF_BGR;  break;
+        default:
+            printf("[TILES] Unsupported input format\n");
+            return false;
+        }
+
+        bool full = false;
+        if (raw.width != width || raw.height != height || bpp != pixel_size) {
+            resize(raw.width, raw.height, bpp);
+            full = true;
+        }
+        if ((refresh_frames > 0 && frames_since_refresh >= refresh_frames) || refresh_requested) {
+            full = true;
+        }
+        refresh_requested = false;
+        frames_since_refresh = full ? 1 : frames_since_refresh + 1;
+
+        detect_changes(raw, mark_candidates(raw, full), full);
+        age_tiles();
+        find_copies(raw, full);
+        mark_roi(raw);
+        collect_runs();
+        split_quality();
+        reset_groups();
+        write_copies();
+
+        // XOR records read the previous frame, so it is only updated after
+        bool ok = encode_runs(raw, full) && encode_refinements(raw.data, raw.stride, start_us) &&
+                  assemble(out, full);
+        update_previous(raw, runs);
+        update_previous(raw, copies);
+        if (!ok) {
+            // Consumers missed these tiles
+            refresh_requested = true;
+        }
+        return ok;
+    }
+
+    void request_keyframe() override {
+        refresh_requested = true;
+    }
+
+    // Nothing changed: the previous frame is what is on screen, so the
+    // refinements come from it
+    bool refine(FrameBuffer &out) override {
+        if (refine_after <= 0 || previous.empty() || refresh_requested) {
+            return false;
+        }
+        uint64_t start_us = steady_now_us();
+        dirty.clear();
+        runs.clear();
+        copies.clear();
+        age_tiles();
+        reset_groups();
+
+        if (!encode_refinements(previous.data(), previous_stride, start_us)) {
+            refresh_requested = true;
+            return false;
+        }
+        if (refines.empty()) {
+            return false;
+        }
+        if (!assemble(out, false)) {
+            refresh_requested = true;
+            return false;
+        }
+        return true;
+    }
+
+    void shutdown() override {
+        pool.reset();
+        for (auto &group : groups) {
+            if (group.compressor) tjDestroy(group.compressor);
+        }
+        groups.clear();
+        previous.clear();
+        width = height = pixel_size = 0;
+#ifdef HAVE_ZSTD
+        if (zstd) {
+            ZSTD_freeCCtx(zstd);
+            zstd = nullptr;
+        }
+        if (zstd_dictionary) {
+            ZSTD_freeCDict(zstd_dictionary);
+            zstd_dictionary = nullptr;
+        }
+#endif
+    }
+
+private:
+    void resize(int w, int h, int bpp) {
+        width = w;
+        height = h;
+        pixel_size = bpp;
+        cols = (w + tile_size - 1) / tile_size;
+        rows = (h + tile_size - 1) / tile_size;
+        previous_stride = static_cast<size_t>(w) * bpp;
+        previous.assign(previous_stride * h, 0);
+        candidates.resize(cols, rows);
+        dirty.resize(cols, rows);
+        moved.resize(cols, rows);
+        tile_class.assign(static_cast<size_t>(cols) * rows, TileClass::NATURAL);
+        still_frames.assign(static_cast<size_t>(cols) * rows, 0);
+        refined.assign(static_cast<size_t>(cols) * rows, 0);
+        refine_cursor = 0;
+    }
+
+    // Which tiles could have changed: all of them (no candidate bitmap), or
+    // only those touched by the backend's damage rects
+    const TileBitmap* mark_candidates(const FrameBuffer &raw, bool full) {
+        if (full || raw.damage.empty()) {
+            return nullptr;
+        }
+
+        candidates.clear();
+        for (const auto &r : raw.damage) {
+            int x0 = r.x < 0 ? 0 : r.x, y0 = r.y < 0 ? 0 : r.y;
+            int x1 = r.x + r.width > width ? width : r.x + r.width;
+            int y1 = r.y + r.height > height ? height : r.y + r.height;
+            if (x1 <= x0 || y1 <= y0) continue;
+            for (int ty = y0 / tile_size; ty <= (y1 - 1) / tile_size; ty++) {
+                for (int tx = x0 / tile_size; tx <= (x1 - 1) / tile_size; tx++) {
+                    candidates.set(tx, ty);
+                }
+            }
+        }
+        return &candidates;
+    }
+
+    // Find and classify the tiles that differ from the previous frame
+    void detect_changes(const FrameBuffer &raw, const TileBitmap *compare, bool full) {
+        if (full) {
+            dirty.fill();
+        } else {
+            dirty.clear();
+        }
+
+        pool->parallel_for(rows, [&](int ty) {
+            if (!full) {
+                tile_diff(raw.data, raw.stride, previous.data(), previous_stride, width, height,
+                          pixel_size, tile_size, compare, dirty, ty, ty + 1);
+            }
+
+            int y0 = ty * tile_size;
+            int th = y0 + tile_size > height ? height - y0 : tile_size;
+            for (int tx = 0; tx < cols; tx++) {
+                if (!dirty.test(tx, ty)) continue;
+
+                int x0 = tx * tile_size;
+                int tw = x0 + tile_size > width ? width - x0 : tile_size;
+                const uint8_t *src = raw.data + static_cast<size_t>(y0) * raw.stride + static_cast<size_t>(x0) * pixel_size;
+                TileClass &kind = tile_class[static_cast<size_t>(ty) * cols + tx];
+                switch (lossless) {
+                case LosslessMode::AUTO:   kind = classify_tile(src, raw.stride, tw, th, pixel_size); break;
+                case LosslessMode::OFF:    kind = TileClass::NATURAL; break;
+                case LosslessMode::ALWAYS: kind = TileClass::SYNTHETIC; break;
+                }
+            }
+        });
+    }
+
+    // Copy the runs sent this frame into the previous frame
+    void update_previous(const FrameBuffer &raw, const std::vector<TileRun> &sent) {
+        pool->parallel_for(static_cast<int>(sent.size()), [&](int i) {
+            const TileRun &run = sent[i];
+            size_t row_bytes = static_cast<size_t>(run.width) * pixel_size;
+            const uint8_t *src = raw.data + static_cast<size_t>(run.y) * raw.stride + static_cast<size_t>(run.x) * pixel_size;
+            uint8_t *prev = previous.data() + static_cast<size_t>(run.y) * previous_stride + static_cast<size_t>(run.x) * pixel_size;
+            for (int y = 0; y < run.height; y++) {
+                memcpy(prev + y * previous_stride, src + static_cast<size_t>(y) * raw.stride, row_bytes);
+            }
+        });
+    }
+
+    // Count the frames each tile has been still; a changed tile starts over
+    void age_tiles() {
+        for (int ty = 0; ty < rows; ty++) {
+            for (int tx = 0; tx < cols; tx++) {
+                uint16_t &still = still_frames[static_cast<size_t>(ty) * cols + tx];
+                if (dirty.test(tx, ty)) {
+                    still = 0;
+                } else if (still < UINT16_MAX) {
+                    still++;
+                }
+            }
+        }
+    }
+
+    // Remember whether consumers now have a run's tiles at refine quality
+    void mark_refined(const TileRun &run, bool value) {
+        int ty = run.y / tile_size;
+        for (int tx = run.x / tile_size; tx * tile_size < run.x + run.width; tx++) {
+            refined[static_cast<size_t>(ty) * cols + tx] = value;
+        }
+    }
+
+    // Dirty tiles that hold the previous frame's pixels moved by one offset
+    // (a scroll or a dragged window) become copy records instead of being
+    // encoded. The detector proposes the offset from the dirty area; each
+    // tile is then checked pixel for pixel against its source.
+    void find_copies(const FrameBuffer &raw, bool full) {
+        copies.clear();
+        if (!motion || full) {
+            return;
+        }
+
+        int count = 0, tx0 = cols, tx1 = -1, ty0 = rows, ty1 = -1;
+        for (int ty = 0; ty < rows; ty++) {
+            for (int tx = 0; tx < cols; tx++) {
+                if (!dirty.test(tx, ty)) continue;
+                count++;
+                tx0 = tx < tx0 ? tx : tx0;
+                tx1 = tx > tx1 ? tx : tx1;
+                ty0 = ty < ty0 ? ty : ty0;
+                ty1 = ty > ty1 ? ty : ty1;
+            }
+        }
+        if (count < MOTION_MIN_TILES) {
+            return;
+        }
+
+        int x0 = tx0 * tile_size, y0 = ty0 * tile_size;
+        int x1 = (tx1 + 1) * tile_size > width ? width : (tx1 + 1) * tile_size;
+        int y1 = (ty1 + 1) * tile_size > height ? height : (ty1 + 1) * tile_size;
+        MotionVector mv;
+        if (!motion_detector.find(raw.data, raw.stride, previous.data(), previous_stride, pixel_size,
+                                  x0, y0, x1 - x0, y1 - y0, mv)) {
+            return;
+        }
+
+        moved.clear();
+        pool->parallel_for(rows, [&](int ty) {
+            for (int tx = 0; tx < cols; tx++) {
+                if (dirty.test(tx, ty) && tile_moved(raw, tx, ty, mv)) moved.set(tx, ty);
+            }
+        });
+
+        // A moved tile is as sharp as the tiles it came from. Collected
+        // first: sources may be moved tiles themselves.
+        refined_updates.clear();
+        for (int ty = 0; ty < rows; ty++) {
+            for (int tx = 0; tx < cols; tx++) {
+                if (!moved.test(tx, ty)) continue;
+                dirty.reset(tx, ty);
+                int sx = tx * tile_size - mv.dx, sy = ty * tile_size - mv.dy;
+                bool sharp = true;
+                for (int sty = sy / tile_size; sty <= (sy + tile_size - 1) / tile_size && sty < rows; sty++) {
+                    for (int stx = sx / tile_size; stx <= (sx + tile_size - 1) / tile_size && stx < cols; stx++) {
+                        sharp = sharp && refined[static_cast<size_t>(sty) * cols + stx];
+                    }
+                }
+                refined_updates.push_back({static_cast<size_t>(ty) * cols + tx, sharp});
+            }
+        }
+        for (const auto &update : refined_updates) {
+            refined[update.first] = update.second;
+        }
+
+        // One record per run of moved tiles in a tile row, ordered against
+        // the direction of motion so that applying them one after another
+        // never reads a source an earlier copy has already overwritten
+        copy_dx = mv.dx;
+        copy_dy = mv.dy;
+        for (int n = 0; n < rows; n++) {
+            int ty = mv.dy > 0 ? rows - 1 - n : n;
+            int y = ty * tile_size;
+            int th = y + tile_size > height ? height - y : tile_size;
+            for (int m = 0; m < cols;) {
+                int tx = mv.dx > 0 ? cols - 1 - m : m;
+                if (!moved.test(tx, ty)) {
+                    m++;
+                    continue;
+                }
+                int first = tx, last = tx;
+                for (m++; m < cols; m++) {
+                    int next = mv.dx > 0 ? cols - 1 - m : m;
+                    if (!moved.test(next, ty)) break;
+                    first = next < first ? next : first;
+                    last = next > last ? next : last;
+                }
+                int x = first * tile_size;
+                int x_end = (last + 1) * tile_size > width ? width : (last + 1) * tile_size;
+                copies.push_back({x, y, x_end - x, th, TileClass::SYNTHETIC});
+            }
+        }
+    }
+
+    // Whether tile (tx, ty) of `raw` is the previous frame's pixels at
+    // (x - dx, y - dy)
+    bool tile_moved(const FrameBuffer &raw, int tx, int ty, const MotionVector &mv) const {
+        int x = tx * tile_size, y = ty * tile_size;
+        int tw = x + tile_size > width ? width - x : tile_size;
+        int th = y + tile_size > height ? height - y : tile_size;
+        int sx = x - mv.dx, sy = y - mv.dy;
+        if (sx < 0 || sy < 0 || sx + tw > width || sy + th > height) {
+            return false;
+        }
+        size_t row_bytes = static_cast<size_t>(tw) * pixel_size;
+        for (int r = 0; r < th; r++) {
+            const uint8_t *a = raw.data + static_cast<size_t>(y + r) * raw.stride + static_cast<size_t>(x) * pixel_size;
+            const uint8_t *b = previous.data() + static_cast<size_t>(sy + r) * previous_stride +
+                               static_cast<size_t>(sx) * pixel_size;
+            if (memcmp(a, b, row_bytes) != 0) return false;
+        }
+        return true;
+    }
+
+    // Copy records go first in the message, ahead of anything painted
+    void write_copies() {
+        TileGroup &group = groups[0];
+        for (const auto &run : copies) {
+            uint8_t *dst = group.reserve(sizeof(TileRecord) + sizeof(TileCopy));
+            write_record(dst, run, TILE_ENCODING_COPY, sizeof(TileCopy));
+            TileCopy copy;
+            copy.src_x = static_cast<uint16_t>(run.x - copy_dx);
+            copy.src_y = static_cast<uint16_t>(run.y - copy_dy);
+            memcpy(dst + sizeof(TileRecord), &copy, sizeof(copy));
+            group.used += sizeof(TileRecord) + sizeof(TileCopy);
+            group.count++;
+        }
+    }
+
+    void reset_groups() {
+        for (auto &group : groups) {
+            group.used = 0;
+            group.count = 0;
+            group.ok = true;
+            group.subsampling = -1;
+        }
+    }
+
+    // Tiles in this frame's region of interest, if it has one
+    void mark_roi(const FrameBuffer &raw) {
+        roi = Roi();
+        if (roi_radius > 0 || roi_focus) {
+            roi = frame_roi(raw, roi_radius, roi_focus);
+        }
+        roi_tiles.assign(static_cast<size_t>(cols) * rows, 0);
+        if (!roi.active()) {
+            return;
+        }
+        for (int ty = 0; ty < rows; ty++) {
+            for (int tx = 0; tx < cols; tx++) {
+                CaptureRect tile = {tx * tile_size, ty * tile_size, tile_size, tile_size};
+                roi_tiles[static_cast<size_t>(ty) * cols + tx] = roi.touches(tile);
+            }
+        }
+    }
+
+    // JPEG quality in and out of the region for this frame, from the share
+    // of the photographic (JPEG) area the region holds
+    void split_quality() {
+        run_quality = {quality, quality};
+        if (!roi.active()) {
+            return;
+        }
+        long long inside = 0, total = 0;
+        for (const auto &run : runs) {
+            if (run.kind != TileClass::NATURAL) continue;
+            long long area = static_cast<long long>(run.width) * run.height;
+            total += area;
+            inside += run.roi ? area : 0;
+        }
+        if (total > 0) {
+            run_quality = roi_quality(quality, roi_boost, static_cast<double>(inside) / total, roi_min_quality);
+        }
+    }
+
+    void collect_runs() {
+        runs.clear();
+        for (int ty = 0; ty < rows; ty++) {
+            int y0 = ty * tile_size;
+            int th = y0 + tile_size > height ? height - y0 : tile_size;
+            for (int tx = 0; tx < cols;) {
+                if (!dirty.test(tx, ty)) {
+                    tx++;
+                    continue;
+                }
+                int start = tx;
+                size_t row = static_cast<size_t>(ty) * cols;
+                TileClass kind = tile_class[row + tx];
+                uint8_t in_roi = roi_tiles[row + tx];
+                while (tx < cols && dirty.test(tx, ty) && tile_class[row + tx] == kind && roi_tiles[row + tx] == in_roi) tx++;
+                int x0 = start * tile_size;
+                int x1 = tx * tile_size > width ? width : tx * tile_size;
+                runs.push_back({x0, y0, x1 - x0, th, kind, in_roi != 0});
+            }
+        }
+    }
+
+    // Encode each run into its thread's group buffer as record + payload.
+    // Synthetic runs that turn out to have too many colors for a palette
+    // (the classifier only samples) fall back to JPEG.
+    bool encode_runs(const FrameBuffer &raw, bool full) {
+        int group_count = static_cast<int>(groups.size());
+        pool->parallel_for(group_count, [&](int g) {
+            TileGroup &group = groups[g];
+            size_t begin = runs.size() * g / group_count;
+            size_t end = runs.size() * (g + 1) / group_count;
+            for (size_t i = begin; i < end; i++) {
+                const TileRun &run = runs[i];
+                const uint8_t *src = raw.data + static_cast<size_t>(run.y) * raw.stride + static_cast<size_t>(run.x) * pixel_size;
+                unsigned long jpeg_size = tjBufSize(run.width, run.height, subsampling);
+                size_t palette_bound = palette_rle_bound(run.width, run.height);
+                size_t bound = palette_bound > jpeg_size ? palette_bound : jpeg_size;
+                if (lossless_codec) {
+                    // XOR and predicted records are 3 bytes per pixel
+                    size_t bgr_size = static_cast<size_t>(run.width) * run.height * 3;
+                    bound = bgr_size > bound ? bgr_size : bound;
+                }
+                uint8_t *dst = group.reserve(sizeof(TileRecord) + bound);
+                uint8_t encoding = TILE_ENCODING_JPEG;
+                size_t payload_size = 0;
+                int jpeg_quality = run.roi ? run_quality.inside : run_quality.outside;
+
+                if (lossless_codec) {
+                    payload_size = encode_lossless(src, raw.stride, run, full, dst + sizeof(TileRecord), encoding);
+                } else if (run.kind == TileClass::SYNTHETIC) {
+                    payload_size = palette_rle_encode(src, raw.stride, run.width, run.height, pixel_size,
+                                                      dst + sizeof(TileRecord), palette_bound);
+                    encoding = TILE_ENCODING_PALETTE;
+                }
+                if (payload_size == 0 && !lossless_codec) {
+                    int run_subsampling = subsampling;
+                    if (auto_subsampling) {
+                        ChromaDetail detail = chroma_detail(src, raw.stride, run.width, run.height, pixel_size);
+                        run_subsampling = static_cast<int>(choose_subsampling(detail));
+                    }
+                    if (!compress_jpeg(group, src, raw.stride, run, jpeg_quality, run_subsampling,
+                                       dst + sizeof(TileRecord), jpeg_size)) {
+                        group.ok = false;
+                        return;
+                    }
+                    payload_size = jpeg_size;
+                    encoding = TILE_ENCODING_JPEG;
+                    group.used_subsampling(run_subsampling);
+                }
+
+                write_record(dst, run, encoding, payload_size);
+                group.used += sizeof(TileRecord) + payload_size;
+                group.count++;
+                mark_refined(run, encoding != TILE_ENCODING_JPEG || jpeg_quality >= refine_quality);
+            }
+        });
+
+        for (const auto &group : groups) {
+            if (!group.ok) {
+                printf("[TILES] TurboJPEG compression failed: %s\n", tjGetErrorStr());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Lossless payload for a run, whichever should come out smallest after
+    // zstd: an XOR against the previous frame (unchanged pixels become
+    // zeros, nearly free), a palette, or predicted residuals. dst holds at
+    // least palette_rle_bound() and 3 bytes per pixel.
+    size_t encode_lossless(const uint8_t *src, size_t stride, const TileRun &run, bool full,
+                           uint8_t *dst, uint8_t &encoding) {
+        size_t pixels = static_cast<size_t>(run.width) * run.height;
+        const uint8_t *prev = previous.data() + static_cast<size_t>(run.y) * previous_stride +
+                              static_cast<size_t>(run.x) * pixel_size;
+
+        size_t changed = pixels;
+        if (!full) {
+            changed = 0;
+            for (int y = 0; y < run.height; y++) {
+                const uint8_t *a = src + static_cast<size_t>(y) * stride;
+                const uint8_t *b = prev + static_cast<size_t>(y) * previous_stride;
+                for (int x = 0; x < run.width; x++, a += pixel_size, b += pixel_size) {
+                    changed += a[0] != b[0] || a[1] != b[1] || a[2] != b[2];
+                }
+            }
+        }
+
+        size_t palette_size = palette_rle_encode(src, stride, run.width, run.height, pixel_size,
+                                                 dst, palette_rle_bound(run.width, run.height));
+        size_t xor_cost = changed * 3;
+        size_t other_cost = palette_size ? palette_size : pixels * PREDICTED_BYTES_PER_PIXEL;
+        if (!full && xor_cost < other_cost) {
+            uint8_t *p = dst;
+            for (int y = 0; y < run.height; y++) {
+                const uint8_t *a = src + static_cast<size_t>(y) * stride;
+                const uint8_t *b = prev + static_cast<size_t>(y) * previous_stride;
+                for (int x = 0; x < run.width; x++, a += pixel_size, b += pixel_size) {
+                    *p++ = a[0] ^ b[0];
+                    *p++ = a[1] ^ b[1];
+                    *p++ = a[2] ^ b[2];
+                }
+            }
+            encoding = TILE_ENCODING_XOR;
+            return pixels * 3;
+        }
+        if (palette_size) {
+            encoding = TILE_ENCODING_PALETTE;
+            return palette_size;
+        }
+
+        predict_encode(src, stride, run.width, run.height, pixel_size, dst);
+        encoding = TILE_ENCODING_PREDICTED;
+        return pixels * 3;
+    }
+
+    // Re-send tiles that have been still for refine_after frames and went
+    // out as JPEG below refine_quality, now at refine_quality with full
+    // chroma, one tile per record. Only what the frame left over is used:
+    // tiles are added while the message stays under the refine budget and
+    // the encode under refine_time_us, round-robin from where the previous
+    // message stopped. A tile that changes again is preempted: it goes out
+    // at normal quality with the dirty tiles and its still count starts
+    // over, so a refinement never lands on top of newer content.
+    bool encode_refinements(const uint8_t *data, size_t stride, uint64_t start_us) {
+        refines.clear();
+        if (refine_after <= 0) {
+            return true;
+        }
+
+        size_t used = 0;
+        for (const auto &group : groups) {
+            used += group.used;
+        }
+        TileGroup &group = groups[0];
+        size_t tiles = refined.size();
+        for (size_t n = 0; n < tiles && used < refine_budget; n++) {
+            size_t i = (refine_cursor + n) % tiles;
+            if (refined[i] || still_frames[i] < refine_after) continue;
+            if (steady_now_us() - start_us > refine_time_us) break;
+
+            int x0 = static_cast<int>(i % cols) * tile_size;
+            int y0 = static_cast<int>(i / cols) * tile_size;
+            TileRun run = {x0, y0, x0 + tile_size > width ? width - x0 : tile_size,
+                           y0 + tile_size > height ? height - y0 : tile_size, TileClass::NATURAL};
+            const uint8_t *src = data + static_cast<size_t>(y0) * stride + static_cast<size_t>(x0) * pixel_size;
+            unsigned long jpeg_size = tjBufSize(run.width, run.height, TJSAMP_444);
+            uint8_t *dst = group.reserve(sizeof(TileRecord) + jpeg_size);
+            if (!compress_jpeg(group, src, stride, run, refine_quality, TJSAMP_444,
+                               dst + sizeof(TileRecord), jpeg_size)) {
+                printf("[TILES] TurboJPEG compression failed: %s\n", tjGetErrorStr());
+                return false;
+            }
+
+            write_record(dst, run, TILE_ENCODING_JPEG, jpeg_size);
+            group.used += sizeof(TileRecord) + jpeg_size;
+            group.count++;
+            group.used_subsampling(TJSAMP_444);
+            used += sizeof(TileRecord) + jpeg_size;
+            refined[i] = 1;
+            refines.push_back(run);
+            refine_cursor = (i + 1) % tiles;
+        }
+        return true;
+    }
+
+    static void write_record(uint8_t *dst, const TileRun &run, uint8_t encoding, size_t payload_size) {
+        TileRecord record = {};
+        record.x = static_cast<uint16_t>(run.x);
+        record.y = static_cast<uint16_t>(run.y);
+        record.width = static_cast<uint16_t>(run.width);
+        record.height = static_cast<uint16_t>(run.height);
+        record.encoding = encoding;
+        record.payload_size = static_cast<uint32_t>(payload_size);
+        memcpy(dst, &record, sizeof(record));
+    }
+
+    bool compress_jpeg(TileGroup &group, const uint8_t *src, size_t stride, const TileRun &run,
+                       int jpeg_quality, int jpeg_subsampling, uint8_t *dst, unsigned long &jpeg_size) {
+        unsigned char *jpeg_ptr = dst;
+        return tjCompress2(
+                   group.compressor,
+                   src,
+                   run.width,
+                   static_cast<int>(stride),
+                   run.height,
+                   pixel_format,
+                   &jpeg_ptr,
+                   &jpeg_size,
+                   jpeg_subsampling,
+                   jpeg_quality,
+                   TJFLAG_FASTDCT | TJFLAG_NOREALLOC) == 0;
+    }
+
+    bool assemble(FrameBuffer &out, bool full) {
+        size_t records = 0;
+        uint32_t count = 0;
+        for (const auto &group : groups) {
+            records += group.used;
+            count += group.count;
+        }
+        size_t total = sizeof(TileMessageHeader) + records;
+        if (!compressed() && total > out.capacity) {
+            printf("[TILES] Output buffer too small (%zu > %zu)\n", total, out.capacity);
+            return false;
+        }
+
+        TileMessageHeader header = {};
+        header.magic = TILE_MESSAGE_MAGIC;
+        header.version = TILE_MESSAGE_VERSION;
+        header.flags = (full ? TILE_FLAG_FULL_REFRESH : 0) | (compressed() ? TILE_FLAG_ZSTD : 0);
+        header.width = static_cast<uint32_t>(width);
+        header.height = static_cast<uint32_t>(height);
+        header.tile_size = static_cast<uint16_t>(tile_size);
+        header.tile_count = count;
+
+        uint8_t *dst = out.data;
+        memcpy(dst, &header, sizeof(header));
+        dst += sizeof(header);
+#ifdef HAVE_ZSTD
+        if (compressed()) {
+            total = compress_records(out, records);
+            if (total == 0) {
+                return false;
+            }
+        } else
+#endif
+        {
+            for (const auto &group : groups) {
+                memcpy(dst, group.buffer.data(), group.used);
+                dst += group.used;
+            }
+        }
+
+        out.size = total;
+        out.format = PixelFormat::TILES;
+        out.keyframe = full;
+        out.damage.clear();
+        for (const auto &run : runs) {
+            out.damage.push_back({run.x, run.y, run.width, run.height});
+        }
+        for (const auto &run : refines) {
+            out.damage.push_back({run.x, run.y, run.width, run.height});
+        }
+        for (const auto &run : copies) {
+            out.damage.push_back({run.x, run.y, run.width, run.height});
+        }
+        out.copy_count = static_cast<int>(copies.size());
+        out.copy_dx = copy_dx;
+        out.copy_dy = copy_dy;
+        out.subsampling = -1;
+        for (const auto &group : groups) {
+            if (group.subsampling >= 0 && (out.subsampling < 0 || group.subsampling < out.subsampling)) {
+                out.subsampling = group.subsampling;
+            }
+        }
+        return true;
+    }
+
+#ifdef HAVE_ZSTD
+    // Records of every group behind the header as one zstd frame, after
+    // their decompressed size. Returns the message size, 0 on failure.
+    size_t compress_records(FrameBuffer &out, size_t records_size) {
+        staging.resize(records_size);
+        size_t offset = 0;
+        for (const auto &group : groups) {
+            memcpy(staging.data() + offset, group.buffer.data(), group.used);
+            offset += group.used;
+        }
+
+        size_t start = sizeof(TileMessageHeader) + sizeof(uint32_t);
+        if (out.capacity < start) {
+            return 0;
+        }
+        uint32_t raw_size = static_cast<uint32_t>(records_size);
+        memcpy(out.data + sizeof(TileMessageHeader), &raw_size, sizeof(raw_size));
+
+        size_t result = zstd_dictionary
+            ? ZSTD_compress_usingCDict(zstd, out.data + start, out.capacity - start,
+                                       staging.data(), records_size, zstd_dictionary)
+            : ZSTD_compressCCtx(zstd, out.data + start, out.capacity - start,
+                                staging.data(), records_size, zstd_level);
+        if (ZSTD_isError(result)) {
+            printf("[TILES] zstd compression failed: %s\n", ZSTD_getErrorName(result));
+            return 0;
+        }
+        return start + result;
+    }
+#endif
+
+    // Record stream goes out zstd-compressed (codec "lossless" is only
+    // built with libzstd)
+    bool compressed() const {
+        return lossless_codec;
+    }
+
+    bool init_zstd() {
+#ifdef HAVE_ZSTD
+        zstd = ZSTD_createCCtx();
+        if (!zstd) {
+            printf("[TILES] zstd init failed\n");
+            return false;
+        }
+        if (!dictionary_path.empty()) {
+            FILE *file = fopen(dictionary_path.c_str(), "rb");
+            if (!file) {
+                printf("[TILES] Could not open zstd dictionary: %s\n", dictionary_path.c_str());
+                return false;
+            }
+            std::vector<uint8_t> dictionary;
+            uint8_t chunk[4096];
+            size_t n;
+            while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+                dictionary.insert(dictionary.end(), chunk, chunk + n);
+            }
+            fclose(file);
+
+            zstd_dictionary = ZSTD_createCDict(dictionary.data(), dictionary.size(), zstd_level);
+            if (!zstd_dictionary) {
+                printf("[TILES] Invalid zstd dictionary: %s\n", dictionary_path.c_str());
+                return false;
+            }
+        }
+        printf("[TILES] Lossless records zstd level %d, %s\n", zstd_level,
+               zstd_dictionary ? dictionary_path.c_str() : "no dictionary");
+#endif
+        return true;
+    }
+
+    bool lossless_codec = false;
+    int quality = 75;
+    std::string subsampling_name = "420";
+    int subsampling = TJSAMP_420;
+    bool auto_subsampling = false;  // per JPEG run
+    int pixel_format = TJPF_BGRX;
+    int threads = 1;
+    int tile_size = 64;
+    int refresh_frames = 300;
+    std::string lossless_name = "auto";
+    LosslessMode lossless = LosslessMode::AUTO;
+    int frames_since_refresh = 0;
+    bool refresh_requested = false;
+
+    // Frame geometry and the previous frame, tightly packed
+    int width = 0;
+    int height = 0;
+    int pixel_size = 0;
+    int cols = 0;
+    int rows = 0;
+    size_t previous_stride = 0;
+    std::vector<uint8_t> previous;
+    TileBitmap candidates;
+    TileBitmap dirty;
+    std::vector<TileClass> tile_class;
+    std::vector<TileRun> runs;
+
+    // Region of interest (encoding.roi): this frame's, the tiles it touches,
+    // and the JPEG quality in and out of it
+    int roi_radius = 0;
+    bool roi_focus = false;
+    int roi_boost = 15;
+    int roi_min_quality = 30;
+    Roi roi;
+    std::vector<uint8_t> roi_tiles;
+    RoiQuality run_quality = {75, 75};
+
+    // Scroll and window-move detection: tiles sent as copies this frame,
+    // all moved by (copy_dx, copy_dy)
+    bool motion = true;
+    MotionDetector motion_detector;
+    TileBitmap moved;
+    std::vector<TileRun> copies;
+    std::vector<std::pair<size_t, bool>> refined_updates;
+    int copy_dx = 0;
+    int copy_dy = 0;
+
+    // Progressive refinement, per tile: frames since it last changed, and
+    // whether consumers have it at refine quality (or lossless) already
+    int refine_after = 30;
+    int refine_quality = 95;
+    size_t refine_budget = 64 * 1024;
+    uint64_t refine_time_us = 0;
+    std::vector<uint16_t> still_frames;
+    std::vector<uint8_t> refined;
+    std::vector<TileRun> refines;
+    size_t refine_cursor = 0;
+
+    std::unique_ptr<ThreadPool> pool;
+    std::vector<TileGroup> groups;
+
+    // Codec "lossless"
+    int zstd_level = 1;
+    std::string dictionary_path;
+    std::vector<uint8_t> staging;
+#ifdef HAVE_ZSTD
+    ZSTD_CCtx *zstd = nullptr;
+    ZSTD_CDict *zstd_dictionary = nullptr;
+#endif
+};
+
+std::unique_ptr<FrameEncoder> create_tiles_encoder() {
+    return std::make_unique<TileEncoder>(false);
+}
+
+#ifdef HAVE_ZSTD
+std::unique_ptr<FrameEncoder> create_lossless_encoder() {
+    return std::make_unique<TileEncoder>(true);
+}
+#endif
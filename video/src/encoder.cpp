@@ -0,0 +1,88 @@
+#include <cstdio>
+#include <turbojpeg.h>
+#include "encoder.hpp"
+
+// Encoder factory declarations
+std::unique_ptr<FrameEncoder> create_jpeg_encoder();
+std::unique_ptr<FrameEncoder> create_tiles_encoder();
+
+// Optional encoders, only declared when their library was found
+#ifdef HAVE_ZSTD
+std::unique_ptr<FrameEncoder> create_lossless_encoder();
+#endif
+#ifdef HAVE_X264
+std::unique_ptr<FrameEncoder> create_h264_encoder();
+#endif
+
+std::unique_ptr<FrameEncoder> create_frame_encoder(const std::string &codec) {
+    if (codec == "jpeg") {
+        auto encoder = create_jpeg_encoder();
+        if (encoder && encoder->is_available()) return encoder;
+        printf("[ENCODE] Encoder 'jpeg' not available\n");
+        return nullptr;
+    } else if (codec == "tiles") {
+        auto encoder = create_tiles_encoder();
+        if (encoder && encoder->is_available()) return encoder;
+        printf("[ENCODE] Encoder 'tiles' not available\n");
+        return nullptr;
+    }
+
+#ifdef HAVE_ZSTD
+    if (codec == "lossless") {
+        auto encoder = create_lossless_encoder();
+        if (encoder && encoder->is_available()) return encoder;
+        printf("[ENCODE] Encoder 'lossless' not available\n");
+        return nullptr;
+    }
+#else
+    // Uncompressed records of a 4K frame don't fit a frame buffer
+    if (codec == "lossless") {
+        printf("[ENCODE] Encoder 'lossless' not built (libzstd not found)\n");
+        return nullptr;
+    }
+#endif
+
+#ifdef HAVE_X264
+    if (codec == "h264") {
+        auto encoder = create_h264_encoder();
+        if (encoder && encoder->is_available()) return encoder;
+        printf("[ENCODE] Encoder 'h264' not available\n");
+        return nullptr;
+    }
+#else
+    if (codec == "h264") {
+        printf("[ENCODE] Encoder 'h264' not built (libx264 not found)\n");
+        return nullptr;
+    }
+#endif
+
+    printf("[ENCODE] Unknown codec: %s\n", codec.c_str());
+    return nullptr;
+}
+
+void list_frame_encoders() {
+    printf("Available encoders:\n");
+
+    { auto e = create_jpeg_encoder();  if (e) printf("  jpeg %s\n",  e->is_available() ? "(available)" : "(not available)"); }
+    { auto e = create_tiles_encoder(); if (e) printf("  tiles %s\n", e->is_available() ? "(available)" : "(not available)"); }
+#ifdef HAVE_ZSTD
+    { auto e = create_lossless_encoder(); if (e) printf("  lossless %s\n", e->is_available() ? "(available)" : "(not available)"); }
+#else
+    printf("  lossless (not built, needs libzstd)\n");
+#endif
+
+#ifdef HAVE_X264
+    { auto e = create_h264_encoder();  if (e) printf("  h264 %s\n",  e->is_available() ? "(available)" : "(not available)"); }
+#else
+    printf("  h264 (not built, needs libx264)\n");
+#endif
+}
+
+bool parse_subsampling(const std::string &name, int &out) {
+    if (name == "444") out = TJSAMP_444;
+    else if (name == "422") out = TJSAMP_422;
+    else if (name == "420") out = TJSAMP_420;
+    else if (name == "gray") out = TJSAMP_GRAY;
+    else return false;
+    return true;
+}
@@ -0,0 +1,78 @@
+#ifndef ENCODER_HPP
+#define ENCODER_HPP
+
+#include <memory>
+#include <string>
+#include "config.hpp"
+#include "frame.hpp"
+#include "yuv.hpp"
+
+// Abstract base class for frame encoders. An encoder turns one raw frame
+// (BGRA/BGR from any capture backend, or the planar YUV it asked for with
+// input_format()) into one encoded frame. Instances are
+// not shared between threads: the pipeline creates one per encode worker.
+class FrameEncoder {
+public:
+    virtual ~FrameEncoder() = default;
+
+    // Get encoder name (matches config.codec)
+    virtual const char* get_name() const = 0;
+
+    // Check if this encoder is available in this build
+    virtual bool is_available() const = 0;
+
+    // Apply encoder-specific settings from the config (quality etc.).
+    // Called before init().
+    virtual void configure(const EncoderConfig &) {}
+
+    // Prepare for frames of width x height
+    virtual bool init(int width, int height) = 0;
+
+    // Input the encoder works from, valid after init(). For I420/I444 the
+    // pipeline converts each frame's changes into persistent planes once,
+    // before the frame is dealt to a worker; encode() must still accept
+    // BGRA/BGR (the fallback when a frame can't be converted).
+    virtual YuvFormat input_format() const { return {}; }
+
+    // Encode `raw` into `out`, a lease from the pipeline's encoded pool, and
+    // fill in its size and format. Returns false on failure.
+    virtual bool encode(const FrameBuffer &raw, FrameBuffer &out) = 0;
+
+    // Shutdown and cleanup
+    virtual void shutdown() = 0;
+
+    // True if each frame is encoded relative to the previous one (deltas).
+    // Such encoders must see every frame in order, so they get one worker.
+    virtual bool keeps_state() const { return false; }
+
+    // True if width and height must be even (H.264 4:2:0 has no way to
+    // signal a one-pixel crop); the pipeline scales odd sizes down for it
+    virtual bool needs_even_size() const { return false; }
+
+    // True if encode() marks each finished prefix of `out` ready in
+    // out.slices as it goes, so the frame can be published in slices
+    virtual bool streams_slices() const { return false; }
+
+    // Make the next frame a keyframe (a consumer joined mid-stream).
+    // Encoders without state produce nothing else.
+    virtual void request_keyframe() {}
+
+    // The captured frame was identical to the last one: spend the idle
+    // frame improving what consumers already have (progressive refinement).
+    // Returns false if there is nothing to send; the pipeline then
+    // publishes an unchanged message instead.
+    virtual bool refine(FrameBuffer &) { return false; }
+};
+
+// Factory function to create encoder by codec name
+std::unique_ptr<FrameEncoder> create_frame_encoder(const std::string &codec);
+
+// List encoders compiled into this build
+void list_frame_encoders();
+
+// encoding.subsampling "444", "422", "420" or "gray" as a TurboJPEG TJSAMP_*
+// value, for the JPEG-based encoders. False for anything else ("auto" is
+// resolved per frame by the caller).
+bool parse_subsampling(const std::string &name, int &out);
+
+#endif
@@ -0,0 +1,178 @@
+#include <chrono>
+#include "clock.hpp"
+#include "frame.hpp"
+
+// Damage rects reserved per buffer so steady-state frames don't allocate
+constexpr size_t DAMAGE_RESERVE = 64;
+
+void FrameLease::reset() {
+    if (!buffer) {
+        return;
+    }
+    if (buffer->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        buffer->pool->release(buffer);
+    }
+    buffer = nullptr;
+}
+
+FramePool::FramePool(int count, size_t capacity) {
+    buffers.reserve(count);
+    free_list.reserve(count);
+    for (int i = 0; i < count; i++) {
+        auto buf = std::make_unique<FrameBuffer>();
+        buf->data = new uint8_t[capacity];
+        buf->capacity = capacity;
+        buf->owns_data = true;
+        buf->pool = this;
+        buf->damage.reserve(DAMAGE_RESERVE);
+        free_list.push_back(buf.get());
+        buffers.push_back(std::move(buf));
+    }
+}
+
+FramePool::~FramePool() {
+    for (auto &buf : buffers) {
+        if (buf->owns_data) {
+            delete[] buf->data;
+        }
+    }
+}
+
+void FramePool::add_buffer(uint8_t *data, size_t capacity, void *user) {
+    auto buf = std::make_unique<FrameBuffer>();
+    buf->data = data;
+    buf->capacity = capacity;
+    buf->user = user;
+    buf->pool = this;
+    buf->damage.reserve(DAMAGE_RESERVE);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    free_list.reserve(buffers.size() + 1);
+    free_list.push_back(buf.get());
+    buffers.push_back(std::move(buf));
+}
+
+FrameLease FramePool::acquire() {
+    return acquire(0);
+}
+
+FrameLease FramePool::acquire(int timeout_ms) {
+    FrameBuffer *buf = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (free_list.empty()) {
+            exhausted.fetch_add(1, std::memory_order_relaxed);
+            if (timeout_ms <= 0 ||
+                !returned.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                                   [this] { return !free_list.empty(); })) {
+                return FrameLease();
+            }
+        }
+        buf = free_list.back();
+        free_list.pop_back();
+    }
+
+    // Back to the defaults in frame.hpp, so a stage that leaves a field
+    // alone never publishes the previous frame's value. clear() keeps the
+    // vectors' capacity.
+    buf->size = 0;
+    buf->format = PixelFormat::BGRA;
+    buf->width = 0;
+    buf->height = 0;
+    buf->stride = 0;
+    buf->timestamp_us = 0;
+    buf->damage.clear();
+    buf->cursor_x = -1;
+    buf->cursor_y = -1;
+    buf->focus = {0, 0, 0, 0};
+    buf->content_hash = 0;
+    buf->duplicate = false;
+    buf->keyframe = false;
+    buf->codec_config.clear();
+    buf->quality = 0;
+    buf->subsampling = -1;
+    buf->copy_count = 0;
+    buf->copy_dx = 0;
+    buf->copy_dy = 0;
+    buf->slices.reset();
+    buf->refs.store(1, std::memory_order_relaxed);
+    return FrameLease(buf);
+}
+
+// ---------------------------------------------------------------------------
+// SliceProgress
+// ---------------------------------------------------------------------------
+void SliceProgress::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ready = 0;
+    state = PENDING;
+    active = true;
+    first_us = 0;
+}
+
+void SliceProgress::advance(size_t ready_bytes) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (ready_bytes <= ready) {
+            return;
+        }
+        ready = ready_bytes;
+        state = READY;
+        if (!first_us) {
+            first_us = steady_now_us();
+        }
+    }
+    changed.notify_all();
+}
+
+void SliceProgress::finish(bool ok) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        state = ok ? DONE : FAILED;
+    }
+    changed.notify_all();
+}
+
+bool SliceProgress::streaming() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return active;
+}
+
+SliceProgress::State SliceProgress::wait(size_t sent, int timeout_ms, size_t &ready_out) {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                     [&] { return ready > sent || state == DONE || state == FAILED; });
+    ready_out = ready;
+    if (state == READY && ready <= sent) {
+        return PENDING;
+    }
+    return state;
+}
+
+uint64_t SliceProgress::first_slice_us() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return first_us;
+}
+
+void SliceProgress::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ready = 0;
+    state = PENDING;
+    active = false;
+    first_us = 0;
+}
+
+// ---------------------------------------------------------------------------
+
+int FramePool::available() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return static_cast<int>(free_list.size());
+}
+
+void FramePool::release(FrameBuffer *buffer) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        free_list.push_back(buffer);
+    }
+    returned.notify_one();
+}
@@ -0,0 +1,205 @@
+#ifndef FRAME_HPP
+#define FRAME_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Screen-space rectangle in capture pixels
+struct CaptureRect {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// Layout of the bytes in a FrameBuffer
+enum class PixelFormat {
+    BGRA,  // 32 bpp, alpha/padding byte ignored
+    BGR,   // 24 bpp (GDI)
+    JPEG,   // encoded, `size` bytes
+    TILES,  // encoded tile message, `size` bytes (frame_message.hpp)
+    UNCHANGED,  // marker: same pixels as the previous frame (frame_message.hpp)
+    H264,   // one Annex B access unit, `size` bytes
+    I420,   // planar YCbCr 4:2:0, `stride` is the luma stride (yuv.hpp)
+    I444,   // planar YCbCr 4:4:4 (yuv.hpp)
+};
+
+class FramePool;
+
+// Progress of an encoded frame that is published while it is still being
+// encoded (sub-frame slices). The encoder marks each prefix of `data` final
+// as it lands; the publisher forwards the new bytes right away, so sending
+// overlaps encoding the rest of the frame.
+class SliceProgress {
+public:
+    enum State { PENDING, READY, DONE, FAILED };
+
+    // Publish this frame in slices; called before the encode starts
+    void start();
+
+    // data[0, ready_bytes) is final
+    void advance(size_t ready_bytes);
+
+    // Encode finished (size and metadata are final) or failed
+    void finish(bool ok);
+
+    bool streaming() const;
+
+    // Wait up to timeout_ms for more than `sent` bytes or the end of the
+    // encode. `ready` gets the final prefix length.
+    State wait(size_t sent, int timeout_ms, size_t &ready);
+
+    // When the first slice became ready (steady clock), 0 if none yet
+    uint64_t first_slice_us() const;
+
+    // Back to a plain, non-streamed frame
+    void reset();
+
+private:
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    size_t ready = 0;
+    State state = PENDING;
+    bool active = false;
+    uint64_t first_us = 0;
+};
+
+// One pooled frame buffer plus the metadata that travels with it. Buffers
+// are only ever created by a FramePool and handed out through FrameLease.
+struct FrameBuffer {
+    uint8_t *data = nullptr;
+    size_t capacity = 0;
+    size_t size = 0;  // bytes used
+
+    PixelFormat format = PixelFormat::BGRA;
+    int width = 0;
+    int height = 0;
+    int stride = 0;  // bytes per row for raw formats
+    uint64_t timestamp_us = 0;  // capture time, steady clock
+
+    // Regions that changed since the previous frame. Empty means unknown —
+    // treat the whole frame as changed.
+    std::vector<CaptureRect> damage;
+
+    // Raw frames: the pointer's hotspot and the focused window in frame
+    // pixels, from backends that report them (cursor_x < 0 and an empty
+    // focus otherwise). The pointer need not be in the pixels.
+    int cursor_x = -1;
+    int cursor_y = -1;
+    CaptureRect focus = {0, 0, 0, 0};
+
+    // Raw frames: frame_hash() of the pixels, and whether it matched the
+    // previous frame's (set by the pipeline when encoding.dedup is on)
+    uint64_t content_hash = 0;
+    bool duplicate = false;
+
+    // Encoded frames: decodable without any earlier frame (JPEG, full tile
+    // refresh, H.264 IDR), and out-of-band decoder setup (H.264 SPS/PPS)
+    bool keyframe = false;
+    std::vector<uint8_t> codec_config;
+
+    // Encoded JPEG frames: the quality used (rate control), 0 otherwise
+    int quality = 0;
+
+    // Encoded JPEG frames: chroma subsampling, as TurboJPEG's TJSAMP_*
+    // (0 4:4:4, 1 4:2:2, 2 4:2:0, 3 gray); tile frames: the finest any JPEG
+    // record used. -1 when there is no JPEG data.
+    int subsampling = -1;
+
+    // Encoded tile frames: copy records leading the message (a scroll or a
+    // window move) and the offset they all move content by
+    int copy_count = 0;
+    int copy_dx = 0;
+    int copy_dy = 0;
+
+    // Encoded frames published before the encode is done
+    SliceProgress slices;
+
+    // Opaque per-buffer tag for pool owners (e.g. an XImage per buffer)
+    void *user = nullptr;
+
+private:
+    friend class FramePool;
+    friend class FrameLease;
+    std::atomic<int> refs{0};
+    FramePool *pool = nullptr;
+    bool owns_data = false;
+};
+
+// Refcounted handle to a pooled FrameBuffer. Copies share the buffer; it goes
+// back to its pool when the last lease is destroyed or reset.
+class FrameLease {
+public:
+    FrameLease() = default;
+    ~FrameLease() { reset(); }
+
+    FrameLease(const FrameLease &other) : buffer(other.buffer) {
+        if (buffer) buffer->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    FrameLease(FrameLease &&other) noexcept : buffer(other.buffer) { other.buffer = nullptr; }
+
+    FrameLease& operator=(FrameLease other) noexcept {
+        std::swap(buffer, other.buffer);
+        return *this;
+    }
+
+    void reset();
+
+    explicit operator bool() const { return buffer != nullptr; }
+    FrameBuffer* operator->() const { return buffer; }
+    FrameBuffer& operator*() const { return *buffer; }
+
+private:
+    friend class FramePool;
+    explicit FrameLease(FrameBuffer *buf) : buffer(buf) {}
+    FrameBuffer *buffer = nullptr;
+};
+
+// Fixed set of frame buffers allocated up front, so steady-state capture does
+// no heap allocation. The pool must outlive every lease taken from it.
+class FramePool {
+public:
+    // `count` buffers of `capacity` bytes each, allocated now
+    FramePool(int count, size_t capacity);
+    // Empty pool; storage is added with add_buffer()
+    FramePool() = default;
+    ~FramePool();
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    // Register externally owned storage (e.g. a shared memory segment).
+    // The pool never frees it, and the owner may repoint `data` at other
+    // memory it controls (e.g. a file mapping) while holding the lease.
+    void add_buffer(uint8_t *data, size_t capacity, void *user);
+
+    // Take a free buffer, or an empty lease if all are in use
+    FrameLease acquire();
+
+    // Like acquire(), but wait up to timeout_ms for a buffer to come back
+    FrameLease acquire(int timeout_ms);
+
+    int size() const { return static_cast<int>(buffers.size()); }
+    int available() const;
+
+    // Number of acquire() calls that found the pool empty (and had to wait
+    // or fail)
+    uint64_t exhausted_count() const { return exhausted.load(std::memory_order_relaxed); }
+
+private:
+    friend class FrameLease;
+    void release(FrameBuffer *buffer);
+
+    std::vector<std::unique_ptr<FrameBuffer>> buffers;
+    std::vector<FrameBuffer *> free_list;
+    mutable std::mutex mutex;
+    std::condition_variable returned;
+    std::atomic<uint64_t> exhausted{0};
+};
+
+#endif
@@ -0,0 +1,312 @@
+#include <cstring>
+#include "frame_hash.hpp"
+#include "simd.hpp"
+
+// Bytes per stripe: eight 64-bit accumulator lanes
+constexpr size_t STRIPE = 64;
+
+// Stripes between scrambles; each stripe in a block has its own key
+constexpr size_t BLOCK_STRIPES = 16;
+
+constexpr uint64_t PRIME32_1 = 0x9E3779B1ULL;
+constexpr uint64_t PRIME32_2 = 0x85EBCA77ULL;
+constexpr uint64_t PRIME32_3 = 0xC2B2AE3DULL;
+constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+// Per-stripe accumulate keys, then the scramble key
+struct HashKeys {
+    alignas(64) uint64_t accumulate[BLOCK_STRIPES][8];
+    alignas(64) uint64_t scramble[8];
+};
+
+static HashKeys make_keys() {
+    // splitmix64: any fixed, well-mixed bytes will do
+    HashKeys keys;
+    uint64_t x = PRIME64_5;
+    auto next = [&x]() {
+        uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    };
+    for (auto &row : keys.accumulate) {
+        for (auto &k : row) k = next();
+    }
+    for (auto &k : keys.scramble) k = next();
+    return keys;
+}
+
+static const HashKeys KEYS = make_keys();
+
+// Fold `stripes` consecutive 64-byte stripes into acc, stripe s using
+// keys[8 * s]:
+//   acc[i]     += lo32(d[i] ^ k[i]) * hi32(d[i] ^ k[i])
+//   acc[i ^ 1] += d[i]
+typedef void (*AccumulateFn)(uint64_t *acc, const uint8_t *data, size_t stripes, const uint64_t *keys);
+
+// acc[i] = (acc[i] ^ (acc[i] >> 47) ^ key[i]) * PRIME32_1
+typedef void (*ScrambleFn)(uint64_t *acc, const uint64_t *key);
+
+// ---------------------------------------------------------------------------
+// Kernels
+// ---------------------------------------------------------------------------
+static uint64_t read64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;  // little-endian hosts only, like the frame formats
+}
+
+static void accumulate_scalar(uint64_t *acc, const uint8_t *data, size_t stripes, const uint64_t *keys) {
+    for (size_t s = 0; s < stripes; s++, data += STRIPE, keys += 8) {
+        for (int i = 0; i < 8; i++) {
+            uint64_t d = read64(data + 8 * i);
+            uint64_t dk = d ^ keys[i];
+            acc[i ^ 1] += d;
+            acc[i] += (dk & 0xFFFFFFFF) * (dk >> 32);
+        }
+    }
+}
+
+static void scramble_scalar(uint64_t *acc, const uint64_t *key) {
+    for (int i = 0; i < 8; i++) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= key[i];
+        acc[i] = a * PRIME32_1;
+    }
+}
+
+#ifdef SIMD_X86
+static void accumulate_sse2(uint64_t *acc, const uint8_t *data, size_t stripes, const uint64_t *keys) {
+    __m128i *a = reinterpret_cast<__m128i *>(acc);
+    __m128i v[4] = {_mm_loadu_si128(a), _mm_loadu_si128(a + 1), _mm_loadu_si128(a + 2), _mm_loadu_si128(a + 3)};
+    for (size_t s = 0; s < stripes; s++, data += STRIPE, keys += 8) {
+        for (int j = 0; j < 4; j++) {
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data) + j);
+            __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys) + j);
+            __m128i dk = _mm_xor_si128(d, k);
+            __m128i product = _mm_mul_epu32(dk, _mm_shuffle_epi32(dk, _MM_SHUFFLE(0, 3, 0, 1)));
+            __m128i swapped = _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+            v[j] = _mm_add_epi64(v[j], _mm_add_epi64(product, swapped));
+        }
+    }
+    for (int j = 0; j < 4; j++) _mm_storeu_si128(a + j, v[j]);
+}
+
+static void scramble_sse2(uint64_t *acc, const uint64_t *key) {
+    const __m128i prime = _mm_set1_epi32(static_cast<int>(PRIME32_1));
+    __m128i *a = reinterpret_cast<__m128i *>(acc);
+    for (int j = 0; j < 4; j++) {
+        __m128i v = _mm_loadu_si128(a + j);
+        v = _mm_xor_si128(v, _mm_srli_epi64(v, 47));
+        v = _mm_xor_si128(v, _mm_loadu_si128(reinterpret_cast<const __m128i *>(key) + j));
+        __m128i lo = _mm_mul_epu32(v, prime);
+        __m128i hi = _mm_mul_epu32(_mm_shuffle_epi32(v, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+        _mm_storeu_si128(a + j, _mm_add_epi64(lo, _mm_slli_epi64(hi, 32)));
+    }
+}
+
+SIMD_TARGET("avx2")
+static void accumulate_avx2(uint64_t *acc, const uint8_t *data, size_t stripes, const uint64_t *keys) {
+    __m256i *a = reinterpret_cast<__m256i *>(acc);
+    __m256i v0 = _mm256_loadu_si256(a), v1 = _mm256_loadu_si256(a + 1);
+    for (size_t s = 0; s < stripes; s++, data += STRIPE, keys += 8) {
+        const __m256i *d = reinterpret_cast<const __m256i *>(data);
+        const __m256i *k = reinterpret_cast<const __m256i *>(keys);
+        __m256i d0 = _mm256_loadu_si256(d), d1 = _mm256_loadu_si256(d + 1);
+        __m256i dk0 = _mm256_xor_si256(d0, _mm256_loadu_si256(k));
+        __m256i dk1 = _mm256_xor_si256(d1, _mm256_loadu_si256(k + 1));
+        __m256i p0 = _mm256_mul_epu32(dk0, _mm256_shuffle_epi32(dk0, _MM_SHUFFLE(0, 3, 0, 1)));
+        __m256i p1 = _mm256_mul_epu32(dk1, _mm256_shuffle_epi32(dk1, _MM_SHUFFLE(0, 3, 0, 1)));
+        v0 = _mm256_add_epi64(v0, _mm256_add_epi64(p0, _mm256_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2))));
+        v1 = _mm256_add_epi64(v1, _mm256_add_epi64(p1, _mm256_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2))));
+    }
+    _mm256_storeu_si256(a, v0);
+    _mm256_storeu_si256(a + 1, v1);
+}
+
+SIMD_TARGET("avx2")
+static void scramble_avx2(uint64_t *acc, const uint64_t *key) {
+    const __m256i prime = _mm256_set1_epi32(static_cast<int>(PRIME32_1));
+    __m256i *a = reinterpret_cast<__m256i *>(acc);
+    for (int j = 0; j < 2; j++) {
+        __m256i v = _mm256_loadu_si256(a + j);
+        v = _mm256_xor_si256(v, _mm256_srli_epi64(v, 47));
+        v = _mm256_xor_si256(v, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(key) + j));
+        __m256i lo = _mm256_mul_epu32(v, prime);
+        __m256i hi = _mm256_mul_epu32(_mm256_shuffle_epi32(v, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+        _mm256_storeu_si256(a + j, _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32)));
+    }
+}
+
+// GCC 12's avx512fintrin.h passes a self-initialized _mm512_undefined_epi32()
+// as the unused merge operand of unmasked intrinsics (srli, mul_epu32, ...),
+// which -Wuninitialized reports once they are inlined here. A false
+// positive in the header; later GCC releases no longer report it.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+SIMD_TARGET("avx512f")
+static void accumulate_avx512(uint64_t *acc, const uint8_t *data, size_t stripes, const uint64_t *keys) {
+    __m512i v = _mm512_loadu_si512(acc);
+    for (size_t s = 0; s < stripes; s++, data += STRIPE, keys += 8) {
+        __m512i d = _mm512_loadu_si512(data);
+        __m512i dk = _mm512_xor_si512(d, _mm512_loadu_si512(keys));
+        __m512i product = _mm512_mul_epu32(dk, _mm512_srli_epi64(dk, 32));
+        __m512i swapped = _mm512_shuffle_epi32(d, static_cast<_MM_PERM_ENUM>(_MM_SHUFFLE(1, 0, 3, 2)));
+        v = _mm512_add_epi64(v, _mm512_add_epi64(product, swapped));
+    }
+    _mm512_storeu_si512(acc, v);
+}
+
+SIMD_TARGET("avx512f")
+static void scramble_avx512(uint64_t *acc, const uint64_t *key) {
+    const __m512i prime = _mm512_set1_epi32(static_cast<int>(PRIME32_1));
+    __m512i v = _mm512_loadu_si512(acc);
+    v = _mm512_xor_si512(v, _mm512_srli_epi64(v, 47));
+    v = _mm512_xor_si512(v, _mm512_loadu_si512(key));
+    __m512i lo = _mm512_mul_epu32(v, prime);
+    __m512i hi = _mm512_mul_epu32(_mm512_srli_epi64(v, 32), prime);
+    _mm512_storeu_si512(acc, _mm512_add_epi64(lo, _mm512_slli_epi64(hi, 32)));
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif // SIMD_X86
+
+#ifdef SIMD_NEON
+static void accumulate_neon(uint64_t *acc, const uint8_t *data, size_t stripes, const uint64_t *keys) {
+    uint64x2_t v[4] = {vld1q_u64(acc), vld1q_u64(acc + 2), vld1q_u64(acc + 4), vld1q_u64(acc + 6)};
+    for (size_t s = 0; s < stripes; s++, data += STRIPE, keys += 8) {
+        for (int j = 0; j < 4; j++) {
+            uint64x2_t d = vreinterpretq_u64_u8(vld1q_u8(data + 16 * j));
+            uint64x2_t dk = veorq_u64(d, vld1q_u64(keys + 2 * j));
+            uint64x2_t product = vmull_u32(vmovn_u64(dk), vshrn_n_u64(dk, 32));
+            v[j] = vaddq_u64(v[j], vaddq_u64(product, vextq_u64(d, d, 1)));
+        }
+    }
+    for (int j = 0; j < 4; j++) vst1q_u64(acc + 2 * j, v[j]);
+}
+
+static void scramble_neon(uint64_t *acc, const uint64_t *key) {
+    const uint32x2_t prime = vdup_n_u32(static_cast<uint32_t>(PRIME32_1));
+    for (int j = 0; j < 4; j++) {
+        uint64x2_t v = vld1q_u64(acc + 2 * j);
+        v = veorq_u64(v, vshrq_n_u64(v, 47));
+        v = veorq_u64(v, vld1q_u64(key + 2 * j));
+        uint64x2_t lo = vmull_u32(vmovn_u64(v), prime);
+        uint64x2_t hi = vmull_u32(vshrn_n_u64(v, 32), prime);
+        vst1q_u64(acc + 2 * j, vaddq_u64(lo, vshlq_n_u64(hi, 32)));
+    }
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Runtime dispatch
+// ---------------------------------------------------------------------------
+struct Kernel {
+    const char *name;
+    AccumulateFn accumulate;
+    ScrambleFn scramble;
+};
+
+// Best first
+static const Kernel KERNELS[] = {
+#ifdef SIMD_X86
+    {"avx512", accumulate_avx512, scramble_avx512},
+    {"avx2", accumulate_avx2, scramble_avx2},
+    {"sse2", accumulate_sse2, scramble_sse2},
+#endif
+#ifdef SIMD_NEON
+    {"neon", accumulate_neon, scramble_neon},
+#endif
+    {"scalar", accumulate_scalar, scramble_scalar},
+};
+
+static KernelTable kernel_table(KERNELS);
+
+const char* frame_hash_kernel() {
+    return kernel_table.name();
+}
+
+std::vector<const char*> frame_hash_kernels() {
+    return kernel_table.usable();
+}
+
+bool frame_hash_select(const char *name) {
+    return kernel_table.select(name);
+}
+
+// ---------------------------------------------------------------------------
+
+static uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// Feeds stripes to the kernel, scrambling at every block boundary
+struct StripeStream {
+    const Kernel *kernel;
+    alignas(64) uint64_t acc[8] = {PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3,
+                                   PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1};
+    size_t in_block = 0;
+
+    void feed(const uint8_t *data, size_t stripes) {
+        while (stripes > 0) {
+            size_t n = BLOCK_STRIPES - in_block;
+            if (n > stripes) n = stripes;
+            kernel->accumulate(acc, data, n, KEYS.accumulate[in_block]);
+            data += n * STRIPE;
+            stripes -= n;
+            in_block += n;
+            if (in_block == BLOCK_STRIPES) {
+                kernel->scramble(acc, KEYS.scramble);
+                in_block = 0;
+            }
+        }
+    }
+};
+
+uint64_t frame_hash(const uint8_t *data, size_t stride, int width, int height, int bytes_per_pixel) {
+    StripeStream stream{&kernel_table.active()};
+    size_t row_bytes = static_cast<size_t>(width) * bytes_per_pixel;
+    size_t full = row_bytes / STRIPE;
+    size_t tail = row_bytes % STRIPE;
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t *row = data + static_cast<size_t>(y) * stride;
+        stream.feed(row, full);
+        if (tail == 0) {
+            continue;
+        }
+        if (full > 0) {
+            // Last 64 bytes of the row, overlapping the previous stripe
+            stream.feed(row + row_bytes - STRIPE, 1);
+        } else {
+            uint8_t padded[STRIPE] = {};
+            memcpy(padded, row, tail);
+            stream.feed(padded, 1);
+        }
+    }
+
+    // Merge the lanes xxHash64-style, with the geometry, then avalanche
+    uint64_t h = (static_cast<uint64_t>(width) << 32 | static_cast<uint32_t>(height)) * PRIME64_1 +
+                 static_cast<uint64_t>(bytes_per_pixel) * PRIME64_5;
+    for (uint64_t lane : stream.acc) {
+        h ^= rotl64(lane * PRIME64_2, 31) * PRIME64_1;
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+    }
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
@@ -0,0 +1,28 @@
+#ifndef FRAME_HASH_HPP
+#define FRAME_HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 64-bit content hash of a raw frame, for spotting frames identical to the
+// previous one. Covers the visible width * bytes_per_pixel of every row and
+// ignores stride padding, so the same pixels hash the same whatever the
+// backend's row pitch. Geometry is mixed in: a resize never matches.
+//
+// The core is an XXH3-style multiply-accumulate over 64-byte stripes (eight
+// 64-bit lanes, 32x32->64 multiplies, periodic scrambling), vectorized with
+// the widest SIMD the CPU supports and picked once at runtime. Not
+// compatible with XXH3 output; every kernel gives the same value.
+uint64_t frame_hash(const uint8_t *data, size_t stride, int width, int height, int bytes_per_pixel);
+
+// Name of the kernel frame_hash() uses ("avx512", "avx2", "sse2", "neon", "scalar")
+const char* frame_hash_kernel();
+
+// Kernels usable on this CPU, best first
+std::vector<const char*> frame_hash_kernels();
+
+// Force a kernel by name (benchmarks). Returns false if not usable here.
+bool frame_hash_select(const char *name);
+
+#endif
@@ -0,0 +1,188 @@
+#ifndef FRAME_MESSAGE_HPP
+#define FRAME_MESSAGE_HPP
+
+#include <cstdint>
+
+// Encoded frame payloads published by the transports. All fields are
+// little-endian and structs are packed.
+//
+// Consumers tell the layouts apart from the shared memory header's `layout`
+// field, or on the socket (where every message is a 4-byte big-endian length
+// followed by the payload) from the first bytes of the payload:
+//
+//   FRAME_LAYOUT_JPEG   one complete JPEG (starts with FF D8)
+//   FRAME_LAYOUT_TILES  a tile message:
+//
+//     [TileMessageHeader]
+//     [TileRecord][payload]   tile_count times, back to back
+//
+//   FRAME_LAYOUT_H264   one H.264 access unit in Annex B form (starts with
+//     00 00 00 01). IDR frames repeat SPS/PPS in-band; shared memory also
+//     keeps them in the header's codec_config for the frame's slot.
+//
+// A socket consumer that connects mid-stream is first sent the last
+// keyframe and every frame since, back to back (output.join_cache_kb);
+// decode them in order and show the last, then carry on with the live
+// stream. Without a cached keyframe the encoder makes a new one, and
+// frames before it are not sent.
+// A shared memory reader that attaches mid-stream finds the same run in
+// the join block, <shm_name>_join (layout in shared_memory.hpp), in socket
+// framing. Decode it, then carry on with frame block sequences after its
+// join_sequence. If the run is empty, bump `refresh_request` instead.
+//
+// Frames encoded in slices (encoding.slices) reach the socket as a series
+// of slice messages, each [SliceMessageHeader][bytes], sent as soon as the
+// encoder finishes that part of the frame. Writing each slice's bytes at
+// its offset rebuilds the frame payload, complete once SLICE_FLAG_LAST
+// arrives; SLICE_FLAG_ABORT means the encode failed, drop the partial
+// frame. In shared memory the slices land in the frame data slot that
+// doesn't hold the current frame, and `partial_size` tracks how much of
+// the next frame is already there.
+//
+//   FRAME_LAYOUT_UNCHANGED  an UnchangedMessage: the captured frame was
+//     identical to the previous one, so nothing was encoded. Keep showing
+//     what you have. In shared memory the header's `unchanged` flag is set
+//     instead and the current slot still holds the last real frame.
+//
+//   FRAME_LAYOUT_CURSOR  a cursor message (capture.cursor, cursor.hpp):
+//
+//     [CursorMessage][shape_width * shape_height * 4 bytes BGRA]
+//
+//     The pointer moved, changed shape or was hidden. The frames don't
+//     contain it; draw the shape over the picture with its hot spot at
+//     (x, y), in the frame's pixels, at the shape's own size. Pixels follow
+//     only with CURSOR_FLAG_SHAPE, the first time this connection sees a
+//     shape; later messages name it by shape_hash alone, so keep the shapes
+//     you were sent. In shared memory cursor messages go to their own block,
+//     <shm_name>_cursor, which always holds the latest message with pixels.
+//
+// A tile message carries only the regions that changed since the previous
+// message. Consumers keep a frame-sized canvas and paint each record's
+// payload at (x, y), decoded per its `encoding`: JPEG for photographic
+// regions, a lossless palette coding for text and UI. A message with TILE_FLAG_FULL_REFRESH covers the whole
+// frame, so consumers joining late can start from it. Shared memory only
+// holds the latest message: a consumer that sees `sequence` advance by more
+// than one has missed updates. It should add 1 to the header's
+// `refresh_request` and wait for the full refresh that follows (the same
+// goes for H.264 and the next IDR frame).
+// Records with TILE_ENCODING_COPY come first in a message. Each moves
+// pixels that are already on the canvas (a scroll or a dragged window):
+// the w x h rect at (src_x, src_y) is copied to (x, y), reading the source
+// as it was before that record, like memmove. Apply them in order, before
+// painting the other records. What is left, such as the strip a scroll
+// exposes, arrives as ordinary records. All copy records of a message
+// move content by the same offset. Shared memory also puts it in the
+// header (copy_count, copy_dx, copy_dy), so a consumer compositing on the
+// GPU can move the texture region without parsing the records first.
+//
+// Records may also cover regions that did not change: tiles that stay still
+// are re-sent at higher quality (encoding.tiles.refine_after), including in
+// place of an unchanged message. They paint like any other record.
+//
+// With TILE_FLAG_ZSTD (codec "lossless") the header is followed by a u32
+// with the size of the record stream and then the records as one zstd
+// frame; decompress it (with the same dictionary if the encoder was given
+// one, see the frame's dictionary ID) and read records from that as usual.
+constexpr uint8_t FRAME_LAYOUT_JPEG  = 0;
+constexpr uint8_t FRAME_LAYOUT_TILES = 1;
+constexpr uint8_t FRAME_LAYOUT_UNCHANGED = 2;
+constexpr uint8_t FRAME_LAYOUT_H264 = 3;
+constexpr uint8_t FRAME_LAYOUT_CURSOR = 4;
+
+constexpr uint32_t TILE_MESSAGE_MAGIC = 0x4C495444;  // "DTIL"
+constexpr uint16_t TILE_MESSAGE_VERSION = 4;  // 2: TILE_ENCODING_PALETTE, 3: lossless codec, 4: TILE_ENCODING_COPY
+
+constexpr uint32_t UNCHANGED_MESSAGE_MAGIC = 0x4D415344;  // "DSAM"
+
+constexpr uint32_t SLICE_MESSAGE_MAGIC = 0x434C5344;  // "DSLC"
+
+constexpr uint32_t CURSOR_MESSAGE_MAGIC = 0x52554344;  // "DCUR"
+
+// CursorMessage::flags
+constexpr uint16_t CURSOR_FLAG_VISIBLE = 0x0001;  // draw it; otherwise hide the pointer
+constexpr uint16_t CURSOR_FLAG_SHAPE   = 0x0002;  // shape pixels follow the message
+
+// SliceMessageHeader::flags
+constexpr uint16_t SLICE_FLAG_LAST  = 0x0001;  // frame complete after this slice
+constexpr uint16_t SLICE_FLAG_ABORT = 0x0002;  // encode failed, no bytes
+constexpr uint16_t SLICE_FLAG_KEYFRAME = 0x0004;  // frame decodes on its own
+
+// TileMessageHeader::flags
+constexpr uint16_t TILE_FLAG_FULL_REFRESH = 0x0001;  // every tile present
+constexpr uint16_t TILE_FLAG_ZSTD = 0x0002;  // records are one zstd frame (codec "lossless")
+
+// TileRecord::encoding
+constexpr uint8_t TILE_ENCODING_JPEG = 0;  // payload is a complete JPEG of w x h
+constexpr uint8_t TILE_ENCODING_PALETTE = 1;  // lossless palette + run lengths of w x h (palette_rle.hpp)
+constexpr uint8_t TILE_ENCODING_XOR = 2;    // w x h [B G R] XORed with the canvas under the record
+constexpr uint8_t TILE_ENCODING_PREDICTED = 3;  // w x h residuals of the median predictor (predict.hpp)
+constexpr uint8_t TILE_ENCODING_COPY = 4;   // TileCopy: w x h moved here from elsewhere on the canvas
+
+#pragma pack(push, 1)
+struct TileMessageHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint32_t width;       // full frame size
+    uint32_t height;
+    uint16_t tile_size;   // grid the records are aligned to
+    uint16_t _reserved;
+    uint32_t tile_count;  // records that follow
+};
+
+struct TileRecord {
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+    uint8_t  encoding;
+    uint8_t  _reserved[3];
+    uint32_t payload_size;
+};
+
+struct TileCopy {
+    uint16_t src_x;
+    uint16_t src_y;
+};
+
+struct SliceMessageHeader {
+    uint32_t magic;
+    uint16_t flags;
+    uint8_t  layout;      // FRAME_LAYOUT_* of the rebuilt payload
+    uint8_t  _reserved;
+    uint32_t frame_id;    // same for every slice of one frame
+    uint32_t offset;      // where these bytes go in the payload
+    uint32_t width;
+    uint32_t height;
+};
+
+struct UnchangedMessage {
+    uint32_t magic;
+    uint32_t width;
+    uint32_t height;
+};
+
+struct CursorMessage {
+    uint32_t magic;
+    uint16_t flags;
+    uint16_t _reserved;
+    int32_t  x;             // hot spot position in the frame
+    int32_t  y;
+    uint32_t width;         // frame size the position is in
+    uint32_t height;
+    uint64_t shape_hash;    // 0: shape unknown, draw nothing
+    uint16_t shape_width;
+    uint16_t shape_height;
+    uint16_t hot_x;         // hot spot within the shape
+    uint16_t hot_y;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(TileMessageHeader) == 24, "TileMessageHeader layout");
+static_assert(sizeof(TileRecord) == 16, "TileRecord layout");
+static_assert(sizeof(TileCopy) == 4, "TileCopy layout");
+static_assert(sizeof(UnchangedMessage) == 12, "UnchangedMessage layout");
+static_assert(sizeof(SliceMessageHeader) == 24, "SliceMessageHeader layout");
+static_assert(sizeof(CursorMessage) == 40, "CursorMessage layout");
+
+#endif
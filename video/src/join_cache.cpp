@@ -0,0 +1,26 @@
+#include "join_cache.hpp"
+
+void JoinCache::add(const FrameBuffer &frame) {
+    if (max_bytes == 0 || frame.format == PixelFormat::UNCHANGED || frame.size == 0) {
+        return;
+    }
+    if (frame.keyframe) {
+        run.clear();
+        frames = 0;
+        restarts++;
+    } else if (frames == 0) {
+        return;  // no keyframe to build on
+    }
+    if (run.size() + 4 + frame.size > max_bytes) {
+        run.clear();
+        frames = 0;
+        restarts++;
+        return;
+    }
+    uint32_t size = static_cast<uint32_t>(frame.size);
+    const uint8_t length[4] = {static_cast<uint8_t>(size >> 24), static_cast<uint8_t>(size >> 16),
+                               static_cast<uint8_t>(size >> 8), static_cast<uint8_t>(size)};
+    run.insert(run.end(), length, length + 4);
+    run.insert(run.end(), frame.data, frame.data + frame.size);
+    frames++;
+}
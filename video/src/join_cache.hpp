@@ -0,0 +1,50 @@
+#ifndef JOIN_CACHE_HPP
+#define JOIN_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "frame.hpp"
+
+// What a consumer joining mid-stream needs to show the current picture
+// right away (output.join_cache_kb): the last keyframe and every frame
+// published after it, as the payloads that went out (frame_message.hpp).
+// For JPEG that is the last frame alone; for tiles the last full refresh
+// and the tile messages since; for H.264 the last IDR and the rest of its
+// GOP so far. Replayed back to back they rebuild exactly what everyone
+// else is showing, so nobody has to wait for, or force, a new keyframe.
+// Unchanged markers change nothing and are left out.
+//
+// The run is kept as socket messages ([4-byte big-endian length][payload]
+// each), so the socket sends it in one go and shared memory copies it into
+// its join block as is.
+//
+// Bounded by max_bytes: a run that outgrows it is dropped until the next
+// keyframe, and a consumer joining meanwhile asks the encoder for one as
+// it would without the cache.
+class JoinCache {
+public:
+    explicit JoinCache(size_t max_bytes) : max_bytes(max_bytes) {}
+
+    // Record a frame once it is complete
+    void add(const FrameBuffer &frame);
+
+    // Frames to replay; 0 when there is no usable run
+    size_t count() const { return frames; }
+
+    // The run, oldest frame first
+    const uint8_t* data() const { return run.data(); }
+    size_t bytes() const { return run.size(); }
+
+    // Changes whenever the run starts over (new keyframe, or dropped);
+    // until then it only grows at the end
+    uint32_t generation() const { return restarts; }
+
+private:
+    size_t max_bytes;
+    std::vector<uint8_t> run;  // reused across runs
+    size_t frames = 0;
+    uint32_t restarts = 0;
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include <csignal>
 #include <string>
 #include <memory>
+#include <vector>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -12,12 +13,20 @@
 #include <time.h>
 #endif
 
+#include "bench.hpp"
 #include "config.hpp"
+#include "encoder.hpp"
 #include "shared_memory.hpp"
 #include "capture.hpp"
+#include "pipeline.hpp"
+#include "recording.hpp"
+#include "transport.hpp"
 
 static volatile int running = 1;
 
+// How often the pipeline prints per-stage stats
+constexpr uint64_t STATS_INTERVAL_MS = 2000;
+
 // ---------------------------------------------------------------------------
 // Platform-portable timing helpers
 // ---------------------------------------------------------------------------
@@ -45,16 +54,29 @@ void print_usage(const char *prog) {
     printf("Usage: %s [options]\n", prog);
     printf("Options:\n");
     printf("  -c, --config <file>     Config file (default: config.json)\n");
-    printf("  -w, --width <int>       Capture width\n");
-    printf("  -h, --height <int>      Capture height\n");
-    printf("  -f, --fps <int>         Frames per second\n");
+    printf("  -w, --width <int>       Output width, larger captures are downscaled (0 = native)\n");
+    printf("  -h, --height <int>      Output height, larger captures are downscaled (0 = native)\n");
+    printf("  --scale <filter>        Downscale filter (box, bilinear, lanczos)\n");
+    printf("  -f, --fps <int>         Frames per second (0 = unthrottled)\n");
     printf("  -q, --quality <int>     Encoding quality (0-100)\n");
     printf("  -m, --monitor <int>     Monitor index (0=primary)\n");
-    printf("  -e, --encoder <name>    Encoder backend (gdi, dxgi, macos)\n");
-    printf("  --codec <name>          Codec (h264, h265)\n");
+    printf("  -e, --encoder <name>    Encoder backend (gdi, dxgi, macos, x11shm, synthetic, replay)\n");
+    printf("  --cursor                Send the pointer as cursor messages instead of in the frames\n");
+    printf("  --codec <name>          Codec (jpeg, tiles, lossless, h264)\n");
+    printf("  --workers <int>         Frames encoded in parallel\n");
+    printf("  --threads <int>         Threads per encoder (parallel JPEG strips)\n");
+    printf("  --slices <int>          JPEG strips per frame, published as each finishes\n");
+    printf("  --no-dedup              Encode frames even if identical to the previous one\n");
+    printf("  --scene <name>          Synthetic scene (desktop, text, code, window, video, cursor, media)\n");
+    printf("  --seed <int>            Synthetic scene seed\n");
+    printf("  --scene-size <WxH>      Synthetic screen size (default 1920x1080)\n");
+    printf("  --replay <file>         Replay a raw recording (implies -e replay)\n");
+    printf("  --replay-fast           Ignore recorded timestamps during replay\n");
+    printf("  --record <file>         Record raw captured frames to file\n");
     printf("  -v, --verbose           Verbose output\n");
     printf("  --benchmark             Log frame timing\n");
-    printf("  --list-backends         List available backends\n");
+    printf("  --bench <name>          Run an offline benchmark and exit (--bench list)\n");
+    printf("  --list-backends         List available capture backends and encoders\n");
     printf("  --help                  Show this help\n");
 }
 
@@ -69,6 +91,8 @@ static const char* default_encoder() {
     return "dxgi";
 #elif defined(__APPLE__)
     return "macos";
+#elif defined(__linux__)
+    return "x11shm";
 #else
     return "unknown";
 #endif
@@ -77,9 +101,14 @@ static const char* default_encoder() {
 int main(int argc, char *argv[]) {
     printf("Distance Encoder - Starting\n");
     signal(SIGINT, sigint_handler);
+#ifndef _WIN32
+    // A consumer hanging up must not kill us; send() reports it instead
+    signal(SIGPIPE, SIG_IGN);
+#endif
 
     EncoderContext ctx;
     ctx.config.encoder = default_encoder();
+    std::string bench_name;
 
     // Parse arguments
     for (int i = 1; i < argc; i++) {
@@ -88,6 +117,7 @@ int main(int argc, char *argv[]) {
             return 0;
         } else if (strcmp(argv[i], "--list-backends") == 0) {
             list_capture_backends();
+            list_frame_encoders();
             return 0;
         } else if ((strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--config") == 0) && i + 1 < argc) {
             ctx.config_file = argv[++i];
@@ -95,6 +125,8 @@ int main(int argc, char *argv[]) {
             ctx.config.width = atoi(argv[++i]);
         } else if ((strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--height") == 0) && i + 1 < argc) {
             ctx.config.height = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            ctx.config.scale_filter = argv[++i];
         } else if ((strcmp(argv[i], "-f") == 0 || strcmp(argv[i], "--fps") == 0) && i + 1 < argc) {
             ctx.config.fps = atoi(argv[++i]);
         } else if ((strcmp(argv[i], "-q") == 0 || strcmp(argv[i], "--quality") == 0) && i + 1 < argc) {
@@ -103,10 +135,41 @@ int main(int argc, char *argv[]) {
             ctx.config.monitor = atoi(argv[++i]);
         } else if ((strcmp(argv[i], "-e") == 0 || strcmp(argv[i], "--encoder") == 0) && i + 1 < argc) {
             ctx.config.encoder = argv[++i];
+        } else if (strcmp(argv[i], "--codec") == 0 && i + 1 < argc) {
+            ctx.config.codec = argv[++i];
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            ctx.config.encode_workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            ctx.config.encode_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--slices") == 0 && i + 1 < argc) {
+            ctx.config.encode_slices = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cursor") == 0) {
+            ctx.config.cursor = true;
+        } else if (strcmp(argv[i], "--no-dedup") == 0) {
+            ctx.config.dedup = false;
+        } else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+            ctx.config.scene = argv[++i];
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            ctx.config.seed = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--scene-size") == 0 && i + 1 < argc) {
+            const char *size = argv[++i];
+            if (sscanf(size, "%dx%d", &ctx.config.synthetic_width, &ctx.config.synthetic_height) != 2) {
+                printf("[ERROR] Bad --scene-size: %s (expected WxH)\n", size);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            ctx.config.replay_path = argv[++i];
+            ctx.config.encoder = "replay";
+        } else if (strcmp(argv[i], "--replay-fast") == 0) {
+            ctx.config.replay_realtime = false;
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            ctx.config.record_path = argv[++i];
         } else if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--verbose") == 0) {
             ctx.config.verbose = true;
         } else if (strcmp(argv[i], "--benchmark") == 0) {
             ctx.config.benchmark = true;
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            bench_name = argv[++i];
         }
     }
 
@@ -117,6 +180,14 @@ int main(int argc, char *argv[]) {
 
     config_print(ctx.config);
 
+    // Offline benchmarks run on synthetic frames and exit
+    if (bench_name == "list") {
+        list_benchmarks();
+        return 0;
+    } else if (!bench_name.empty()) {
+        return run_benchmark(bench_name, ctx.config);
+    }
+
     // Get capture backend
     auto backend = create_capture_backend(ctx.config.encoder);
     if (!backend) {
@@ -131,6 +202,8 @@ int main(int argc, char *argv[]) {
 
     printf("[MAIN] Using backend: %s\n", backend->get_name());
 
+    backend->configure(ctx.config);
+
     // Initialize capture
     int cap_width, cap_height;
     if (!backend->init(ctx.config.monitor, cap_width, cap_height)) {
@@ -140,71 +213,71 @@ int main(int argc, char *argv[]) {
 
     printf("[CAPTURE] Initialized: %dx%d\n", cap_width, cap_height);
 
-    // Shared memory (no-op stub on non-Windows; IPC handled inside the backend)
-    auto shm = std::make_unique<SharedMemory>(ctx.config.shm_name, ctx.config.shm_size);
-    if (!shm->is_valid()) {
-        printf("[ERROR] Failed to create shared memory\n");
-        backend->shutdown();
-        return 1;
+    // Optional raw frame recording, fed by the pipeline before encoding
+    FrameRecorder recorder;
+    if (!ctx.config.record_path.empty()) {
+        if (!recorder.open(ctx.config.record_path, cap_width, cap_height, ctx.config.fps)) {
+            backend->shutdown();
+            return 1;
+        }
     }
 
-    // Main capture loop
-    printf("[MAIN] Starting capture loop (%d FPS)...\n", ctx.config.fps);
-    shm->set_state(SHM_STATE_RUNNING, SHM_ERR_NONE);
-
-    int frame_count = 0;
-    uint64_t last_stats_time = get_tick_ms();
-    int frame_interval_ms = 1000 / ctx.config.fps;
-
-    while (running) {
-        uint64_t frame_start = get_tick_ms();
+    // Where encoded frames go: shared memory or the agent socket, one
+    // endpoint per simulcast layer
+    std::vector<std::unique_ptr<FrameTransport>> transports;
+    std::vector<FrameTransport *> layer_transports;
+    for (int i = 0; i < layer_count(ctx.config); i++) {
+        auto transport = create_transport(layer_config(ctx.config, i));
+        if (!transport || !transport->is_valid()) {
+            printf("[ERROR] Failed to create %s transport\n", ctx.config.transport.c_str());
+            backend->shutdown();
+            return 1;
+        }
+        layer_transports.push_back(transport.get());
+        transports.push_back(std::move(transport));
+    }
 
-        // Capture frame.
-        // Push-model backends (e.g. macos) handle delivery internally and return nullptr here.
-        int frame_size = 0;
-        uint8_t *frame_data = backend->capture(frame_size);
+    printf("[MAIN] Publishing via %s", transports[0]->get_name());
+    if (transports.size() > 1) {
+        printf(", %zu simulcast layers", transports.size() - 1);
+    }
+    printf("\n");
 
-        if (!frame_data) {
-            // Either no new frame yet (DXGI timeout) or push-model backend — both are normal.
-            sleep_ms(10);
-            continue;
-        }
+    // Capture, encode and publish on their own threads
+    if (ctx.config.fps > 0) {
+        printf("[MAIN] Starting capture pipeline (%d FPS)...\n", ctx.config.fps);
+    } else {
+        printf("[MAIN] Starting capture pipeline (unthrottled)...\n");
+    }
+    for (auto &t : transports) t->set_state(SHM_STATE_RUNNING, SHM_ERR_NONE);
 
-        // Write to shared memory (Windows only; stub on other platforms)
-        if (shm->write_frame(frame_data, frame_size,
-                             cap_width, cap_height,
-                             ctx.config.fps, ctx.config.quality,
-                             ctx.config.monitor) != 0) {
-            printf("[ERROR] Failed to write frame\n");
-            delete[] frame_data;
-            continue;
-        }
+    Pipeline pipeline(ctx.config, *backend, layer_transports,
+                      ctx.config.record_path.empty() ? nullptr : &recorder);
+    if (!pipeline.start(cap_width, cap_height)) {
+        for (auto &t : transports) t->set_state(SHM_STATE_ERROR, SHM_ERR_ENCODE_FAIL);
+        backend->shutdown();
+        return 1;
+    }
 
-        delete[] frame_data;
-        frame_count++;
+    uint64_t last_stats_time = get_tick_ms();
+    while (running) {
+        sleep_ms(100);
 
         // Log stats
         uint64_t now = get_tick_ms();
-        if (now - last_stats_time >= 2000) {
-            printf("[CAPTURE] %d frames, %d bytes/frame\n", frame_count, frame_size);
-            frame_count = 0;
+        if (now - last_stats_time >= STATS_INTERVAL_MS) {
+            pipeline.print_stats();
             last_stats_time = now;
         }
-
-        // Frame rate limiting
-        uint64_t elapsed = get_tick_ms() - frame_start;
-        if (elapsed < (uint64_t)frame_interval_ms) {
-            sleep_ms((int)(frame_interval_ms - elapsed));
-        } else if (ctx.config.benchmark) {
-            printf("[BENCH] Frame took %llu ms (target %d ms)\n",
-                   (unsigned long long)elapsed, frame_interval_ms);
-        }
     }
 
-    // Cleanup
+    // Cleanup: stop the pipeline first so every frame is back in its pool
+    // before the backend that may own the pixels goes away
     printf("[MAIN] Cleaning up...\n");
-    shm->set_state(0, SHM_ERR_NONE);
+    pipeline.stop();
+    for (auto &t : transports) t->set_state(0, SHM_ERR_NONE);
     backend->shutdown();
+    recorder.close();
 
     printf("[MAIN] Done\n");
     return 0;
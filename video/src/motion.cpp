@@ -0,0 +1,165 @@
+#include <cstring>
+#include "motion.hpp"
+
+// Pixels per hashed row segment: the width of the 64-bit gear hash
+constexpr int SEGMENT = 64;
+
+// A segment is an anchor when the top hash bits are zero: 1 position in 32
+constexpr int ANCHOR_SHIFT = 59;
+constexpr int ANCHOR_RATE_BITS = 5;
+
+// Rows of the current frame looked at
+constexpr int CUR_ROW_STEP = 4;
+
+// Share of the previous frame's rows (1/N) that must turn up at least one
+// moved anchor before the rest are searched
+constexpr int PROBE_DIVISOR = 4;
+
+// Fewest agreeing anchors for a move to count
+constexpr int MIN_VOTES = 8;
+
+// Distinct moves tallied; power of two
+constexpr int VOTE_SLOTS = 4096;
+
+// Spreads a color over all 64 bits before it enters the hash
+constexpr uint64_t MIX = 0x9E3779B97F4A7C15ull;
+
+constexpr int32_t EMPTY = -2;
+constexpr int32_t AMBIGUOUS = -1;
+
+template <int BPP>
+static inline uint32_t load_color(const uint8_t *p) {
+    if (BPP == 4) {
+        uint32_t c;
+        memcpy(&c, p, 4);
+        return c & 0x00FFFFFFu;
+    }
+    return p[0] | (p[1] << 8) | (p[2] << 16);
+}
+
+static inline size_t slot_of(uint64_t hash) {
+    return static_cast<size_t>((hash ^ (hash >> 29)) * 0xBF58476D1CE4E5B9ull >> 32);
+}
+
+// Call found(x, hash) for every anchor segment of a row. The hash is a
+// gear hash: shifted left one bit per pixel, so a pixel has left it
+// SEGMENT pixels later, and the only dependency between iterations is a
+// shift and an add. Segments that are one flat color are never anchors:
+// they would match anywhere in the same flat area.
+template <int BPP, typename F>
+static void scan_row(const uint8_t *row, int w, F &&found) {
+    uint64_t hash = 0;
+    int run = 0;  // pixels in a row equal to their left neighbour, ending here
+    uint32_t left = 0;
+    for (int x = 0; x < w; x++) {
+        uint32_t c = load_color<BPP>(row + static_cast<size_t>(x) * BPP);
+        hash = (hash << 1) + (c + 1) * MIX;
+        run = x && c == left ? run + 1 : 0;
+        left = c;
+        if (x >= SEGMENT - 1 && run < SEGMENT - 1 && (hash >> ANCHOR_SHIFT) == 0) {
+            found(x - SEGMENT + 1, hash);
+        }
+    }
+}
+
+bool MotionDetector::find(const uint8_t *cur, size_t cur_stride, const uint8_t *prev, size_t prev_stride,
+                          int bpp, int x, int y, int w, int h, MotionVector &out) {
+    if (w < SEGMENT || h < 2 || (bpp != 3 && bpp != 4)) {
+        return false;
+    }
+    cur += static_cast<size_t>(y) * cur_stride + static_cast<size_t>(x) * bpp;
+    prev += static_cast<size_t>(y) * prev_stride + static_cast<size_t>(x) * bpp;
+
+    // Anchors of the current frame, every CUR_ROW_STEP rows, in an
+    // open-addressed table sized to be about half full
+    size_t expected = (static_cast<size_t>(w) * ((h + CUR_ROW_STEP - 1) / CUR_ROW_STEP) >> ANCHOR_RATE_BITS) + 1;
+    size_t slots = 1024;
+    while (slots < expected * 2) {
+        slots <<= 1;
+    }
+    anchors.assign(slots, {0, EMPTY, 0});
+    size_t mask = slots - 1;
+    size_t limit = slots * 3 / 4;
+    size_t used = 0;
+
+    int row = 0;
+    auto insert = [&](int ax, uint64_t hash) {
+        size_t i = slot_of(hash) & mask;
+        while (anchors[i].x != EMPTY) {
+            if (anchors[i].hash == hash) {
+                anchors[i].x = AMBIGUOUS;
+                return;
+            }
+            i = (i + 1) & mask;
+        }
+        // Far more anchors than expected (repetitive content): keep the
+        // table usable, the ones already in are enough to vote
+        if (used == limit) {
+            return;
+        }
+        anchors[i] = {hash, ax, row};
+        used++;
+    };
+    for (row = 0; row < h; row += CUR_ROW_STEP) {
+        const uint8_t *p = cur + static_cast<size_t>(row) * cur_stride;
+        if (bpp == 4) scan_row<4>(p, w, insert);
+        else scan_row<3>(p, w, insert);
+    }
+
+    // Every row of the previous frame: anchors found in the current one
+    // vote for how far they moved
+    votes.assign(VOTE_SLOTS, {0, 0, 0});
+    int cast = 0;
+    auto vote = [&](int ax, uint64_t hash) {
+        size_t i = slot_of(hash) & mask;
+        while (anchors[i].x != EMPTY && anchors[i].hash != hash) {
+            i = (i + 1) & mask;
+        }
+        const Anchor &a = anchors[i];
+        if (a.x < 0) {
+            return;  // not in the current frame, or ambiguous
+        }
+        int dx = a.x - ax, dy = a.y - row;
+        if (dx == 0 && dy == 0) {
+            return;
+        }
+        cast++;
+        size_t v = (static_cast<uint32_t>(dx) * 0x9E3779B1u ^ static_cast<uint32_t>(dy) * 0x85EBCA6Bu) >> 20;
+        for (int n = 0; n < VOTE_SLOTS; n++, v = (v + 1) & (VOTE_SLOTS - 1)) {
+            Vote &slot = votes[v];
+            if (slot.count == 0) {
+                slot = {dx, dy, 1};
+                return;
+            }
+            if (slot.dx == dx && slot.dy == dy) {
+                slot.count++;
+                return;
+            }
+        }
+    };
+    int probe_rows = h / PROBE_DIVISOR;
+    for (row = 0; row < h; row++) {
+        // Nothing moved within the first rows: video or a repaint, not
+        // worth hashing the rest
+        if (row == probe_rows && cast == 0) {
+            return false;
+        }
+        const uint8_t *p = prev + static_cast<size_t>(row) * prev_stride;
+        if (bpp == 4) scan_row<4>(p, w, vote);
+        else scan_row<3>(p, w, vote);
+    }
+
+    const Vote *best = nullptr;
+    for (const auto &v : votes) {
+        if (v.count > 0 && (!best || v.count > best->count)) {
+            best = &v;
+        }
+    }
+    if (!best || best->count < MIN_VOTES) {
+        return false;
+    }
+    out.dx = best->dx;
+    out.dy = best->dy;
+    out.votes = best->count;
+    return true;
+}
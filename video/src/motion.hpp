@@ -0,0 +1,54 @@
+#ifndef MOTION_HPP
+#define MOTION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Content that moved between two frames: pixels now at (x, y) were at
+// (x - dx, y - dy). `votes` is how many anchors agreed on it.
+struct MotionVector {
+    int dx = 0;
+    int dy = 0;
+    int votes = 0;
+};
+
+// Finds the dominant move inside a region of two frames: a scroll (browser,
+// terminal, editor) or a dragged window. Both frames are cut into 64-pixel
+// row segments with a rolling hash, and content-defined anchors (segments
+// whose hash has a given bit pattern, skipping flat ones) are kept. Since
+// an anchor depends only on the pixels under it, moved content produces
+// the same anchors at its new position; every anchor of the previous frame
+// found (once) in the current one votes for its displacement, and the most
+// common one wins.
+//
+// Only every 4th row of the current frame is hashed but every row of the
+// previous one, about 1.3 passes over the region. If the first quarter of
+// the previous rows finds nothing that moved (video, a repaint) the search
+// stops there, at about half a pass. The caller verifies the result (tiles
+// that really match) before relying on it.
+class MotionDetector {
+public:
+    // Search `w` x `h` pixels at (x, y) in both frames (BGRA or BGR, same
+    // size and format). Returns false if no move other than (0, 0) has
+    // enough votes.
+    bool find(const uint8_t *cur, size_t cur_stride, const uint8_t *prev, size_t prev_stride,
+              int bytes_per_pixel, int x, int y, int w, int h, MotionVector &out);
+
+private:
+    struct Anchor {
+        uint64_t hash;
+        int32_t x;  // -1: hash seen more than once, ambiguous
+        int32_t y;
+    };
+    struct Vote {
+        int32_t dx;
+        int32_t dy;
+        int count;
+    };
+
+    std::vector<Anchor> anchors;
+    std::vector<Vote> votes;
+};
+
+#endif
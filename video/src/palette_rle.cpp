@@ -0,0 +1,149 @@
+#include <cstring>
+#include "palette_rle.hpp"
+
+constexpr int MAX_PALETTE = 256;
+constexpr size_t PALETTE_HEADER = 1 + MAX_PALETTE * 3;
+
+// Color -> palette index map; power of two, at least 4x MAX_PALETTE
+constexpr int INDEX_SLOTS = 1024;
+constexpr uint32_t EMPTY_SLOT = 0xFFFFFFFFu;
+
+static uint32_t load_color(const uint8_t *p, int bpp) {
+    uint32_t c;
+    if (bpp == 4) {
+        memcpy(&c, p, 4);
+        return c & 0x00FFFFFFu;
+    }
+    return p[0] | (p[1] << 8) | (p[2] << 16);
+}
+
+size_t palette_rle_bound(int w, int h) {
+    return PALETTE_HEADER + static_cast<size_t>(w) * h * 2;
+}
+
+struct Palette {
+    uint32_t keys[INDEX_SLOTS];
+    uint8_t values[INDEX_SLOTS];
+    uint32_t colors[MAX_PALETTE];
+    int count = 0;
+
+    Palette() { memset(keys, 0xFF, sizeof(keys)); }
+
+    // Index of c, added if new; -1 once the palette is full
+    int index(uint32_t c) {
+        uint32_t i = (c * 0x9E3779B1u) >> 22;
+        while (keys[i] != EMPTY_SLOT) {
+            if (keys[i] == c) return values[i];
+            i = (i + 1) & (INDEX_SLOTS - 1);
+        }
+        if (count == MAX_PALETTE) {
+            return -1;
+        }
+        keys[i] = c;
+        values[i] = static_cast<uint8_t>(count);
+        colors[count] = c;
+        return count++;
+    }
+};
+
+// Index byte plus varint length; never more than 2 bytes per pixel covered
+static uint8_t* put_run(uint8_t *p, int index, size_t length) {
+    *p++ = static_cast<uint8_t>(index);
+    size_t v = length - 1;
+    while (v >= 0x80) {
+        *p++ = static_cast<uint8_t>(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = static_cast<uint8_t>(v);
+    return p;
+}
+
+size_t palette_rle_encode(const uint8_t *data, size_t stride, int w, int h, int bpp,
+                          uint8_t *dst, size_t capacity) {
+    if (w <= 0 || h <= 0 || capacity < palette_rle_bound(w, h)) {
+        return 0;
+    }
+
+    // Runs are written after the largest possible palette and moved down
+    // once the palette size is known
+    Palette palette;
+    uint8_t *runs = dst + PALETTE_HEADER;
+    uint8_t *p = runs;
+
+    uint32_t current = load_color(data, bpp);
+    int current_index = palette.index(current);
+    size_t length = 0;
+    for (int y = 0; y < h; y++) {
+        const uint8_t *row = data + static_cast<size_t>(y) * stride;
+        for (int x = 0; x < w; x++) {
+            uint32_t c = load_color(row + static_cast<size_t>(x) * bpp, bpp);
+            if (c == current) {
+                length++;
+                continue;
+            }
+            p = put_run(p, current_index, length);
+            current = c;
+            current_index = palette.index(c);
+            if (current_index < 0) {
+                return 0;
+            }
+            length = 1;
+        }
+    }
+    p = put_run(p, current_index, length);
+
+    size_t run_bytes = static_cast<size_t>(p - runs);
+    size_t header = 1 + static_cast<size_t>(palette.count) * 3;
+    dst[0] = static_cast<uint8_t>(palette.count - 1);
+    memmove(dst + header, runs, run_bytes);
+    for (int i = 0; i < palette.count; i++) {
+        uint32_t c = palette.colors[i];
+        dst[1 + i * 3] = static_cast<uint8_t>(c);
+        dst[2 + i * 3] = static_cast<uint8_t>(c >> 8);
+        dst[3 + i * 3] = static_cast<uint8_t>(c >> 16);
+    }
+    return header + run_bytes;
+}
+
+bool palette_rle_decode(const uint8_t *src, size_t size, int w, int h, uint8_t *dst, size_t stride) {
+    if (size < 1) {
+        return false;
+    }
+    int count = src[0] + 1;
+    size_t pos = 1 + static_cast<size_t>(count) * 3;
+    if (size < pos) {
+        return false;
+    }
+
+    size_t total = static_cast<size_t>(w) * h;
+    size_t pixel = 0;
+    while (pixel < total) {
+        if (pos >= size) {
+            return false;
+        }
+        int index = src[pos++];
+        size_t length = 0;
+        for (int shift = 0;; shift += 7) {
+            if (pos >= size || shift > 28) {
+                return false;
+            }
+            uint8_t b = src[pos++];
+            length |= static_cast<size_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) break;
+        }
+        length++;
+        if (index >= count || length > total - pixel) {
+            return false;
+        }
+
+        const uint8_t *color = src + 1 + index * 3;
+        for (size_t i = 0; i < length; i++, pixel++) {
+            uint8_t *out = dst + (pixel / w) * stride + (pixel % w) * 4;
+            out[0] = color[0];
+            out[1] = color[1];
+            out[2] = color[2];
+            out[3] = 0xFF;
+        }
+    }
+    return pos == size;
+}
@@ -0,0 +1,32 @@
+#ifndef PALETTE_RLE_HPP
+#define PALETTE_RLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Lossless coding for blocks of at most 256 colors (text, UI), used for
+// TILE_ENCODING_PALETTE records:
+//
+//   u8     palette size - 1
+//   [B G R] x palette size
+//   runs over the pixels in row-major order, crossing row ends:
+//     u8   palette index
+//     run length - 1 as a LEB128 varint (7 bits per byte, low first)
+//
+// Never more than palette_rle_bound() bytes: a run costs at most two bytes
+// per pixel it covers.
+
+// Largest output for a w x h block
+size_t palette_rle_bound(int w, int h);
+
+// Encode the w x h block at `data` (BGRA or BGR) into dst. Returns the
+// encoded size, or 0 if the block has more than 256 colors or dst is too
+// small.
+size_t palette_rle_encode(const uint8_t *data, size_t stride, int w, int h, int bytes_per_pixel,
+                          uint8_t *dst, size_t capacity);
+
+// Decode into a w x h BGRA block. False if the payload is malformed or
+// doesn't cover the block exactly.
+bool palette_rle_decode(const uint8_t *src, size_t size, int w, int h, uint8_t *dst, size_t stride);
+
+#endif
@@ -0,0 +1,749 @@
+#include <cstdio>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include "clock.hpp"
+#include "frame_hash.hpp"
+#include "frame_message.hpp"
+#include "pipeline.hpp"
+#include "shared_memory.hpp"
+
+// Frames that can wait between two stages. One is enough for overlap; the
+// second absorbs jitter without adding much latency.
+constexpr size_t QUEUE_DEPTH = 2;
+
+// Upper bound on config.encode_workers
+constexpr int MAX_ENCODE_WORKERS = 16;
+
+// How long a stage blocks before re-checking `running`
+constexpr int WAIT_MS = 50;
+
+// How long publish waits for a frame before checking the pointer, with
+// the cursor channel on
+constexpr int CURSOR_WAIT_MS = 10;
+
+static const char *STAGE_NAMES[] = {"capture", "convert", "encode", "publish"};
+
+Pipeline::Pipeline(const EncoderConfig &config, CaptureBackend &backend,
+                   const std::vector<FrameTransport *> &transports, FrameRecorder *recorder)
+    : config(config), backend(backend), transports(transports), recorder(recorder),
+      captured(QUEUE_DEPTH) {}
+
+Pipeline::~Pipeline() {
+    stop();
+    for (auto &l : layers) {
+        for (auto &w : l->workers) {
+            w.encoder->shutdown();
+        }
+    }
+}
+
+bool Pipeline::start(int width, int height) {
+    int count = layer_count(config);
+    if (static_cast<int>(transports.size()) != count) {
+        printf("[PIPE] %d layers but %zu transports\n", count, transports.size());
+        return false;
+    }
+
+    // Layer sizes relative to the main output, which is the capture
+    // downscaled to fit config.width x config.height
+    int main_width = width, main_height = height;
+    fit_output_size(width, height, config.width, config.height, main_width, main_height);
+    if (config.encode_threads > 1) {
+        scale_pool = std::make_unique<ThreadPool>(config.encode_threads);
+    }
+    for (int i = 0; i < count; i++) {
+        layers.push_back(std::make_unique<Layer>());
+        Layer &l = *layers.back();
+        l.config = layer_config(config, i);
+        l.transport = transports[i];
+        if (!start_layer(l, width, height, main_width, main_height)) {
+            return false;
+        }
+    }
+
+    // Frames alive at once. Raw: capture, the captured queue, convert, and
+    // per worker its input queue plus the frame being encoded. Encoded: per
+    // worker the frame being encoded plus its output queue, and publish.
+    // The workers' share is in the last form convert makes, for every
+    // layer taking that form: planar frames, else downscaled ones, else raw.
+    int raw_count = 2 + static_cast<int>(QUEUE_DEPTH);
+    std::vector<int> taken(layers.size(), 0);
+    for (size_t i = 0; i < layers.size(); i++) {
+        int source = layers[i]->source >= 0 ? layers[i]->source : static_cast<int>(i);
+        taken[source] += static_cast<int>(layers[i]->workers.size()) * (static_cast<int>(QUEUE_DEPTH) + 1);
+    }
+    int scaled_count = 0, yuv_count = 0, encoded_count = 0;
+    for (size_t i = 0; i < layers.size(); i++) {
+        Layer &l = *layers[i];
+        if (l.source < 0 && !l.scaler && !l.yuv) {
+            raw_count += taken[i];
+        }
+        if (l.scaler) {
+            size_t bytes = static_cast<size_t>(l.width) * l.height * 4;
+            l.scaled_pool = std::make_unique<FramePool>(1 + (l.yuv ? 0 : taken[i]), bytes);
+            scaled_count += l.scaled_pool->size();
+        }
+        if (l.yuv) {
+            size_t bytes = yuv_frame_size(l.yuv->format().layout, l.width, l.height);
+            l.yuv_pool = std::make_unique<FramePool>(1 + taken[i], bytes);
+            yuv_count += l.yuv_pool->size();
+        }
+        l.encoded_pool = std::make_unique<FramePool>(
+            1 + static_cast<int>(l.workers.size()) * (static_cast<int>(QUEUE_DEPTH) + 1), DEFAULT_FRAME_SIZE);
+        encoded_count += l.encoded_pool->size();
+    }
+    // Backends grabbing into their own buffers never write to these
+    if (backend.provides_buffers()) {
+        raw_count = 0;
+    }
+    raw_pool = std::make_unique<FramePool>(raw_count, static_cast<size_t>(width) * height * 4);
+    capture_width = width;
+    capture_height = height;
+
+    last_stats_us = steady_now_us();
+    running = true;
+    threads.emplace_back(&Pipeline::capture_loop, this);
+    threads.emplace_back(&Pipeline::convert_loop, this);
+    for (auto &l : layers) {
+        for (size_t i = 0; i < l->workers.size(); i++) {
+            threads.emplace_back(&Pipeline::encode_loop, this, std::ref(*l), i);
+        }
+        threads.emplace_back(&Pipeline::publish_loop, this, std::ref(*l));
+    }
+
+    printf("[PIPE] Started: %s x%zu, %d raw + %d scaled + %d yuv + %d encoded buffers, queue depth %zu\n",
+           config.codec.c_str(), layers[0]->workers.size(), raw_count, scaled_count, yuv_count,
+           encoded_count, QUEUE_DEPTH);
+    if (config.dedup) {
+        printf("[PIPE] Dedup on, %s frame hash\n", frame_hash_kernel());
+    }
+    if (config.cursor) {
+        printf("[PIPE] Cursor channel on\n");
+    }
+    return true;
+}
+
+// Encoders, output size and conversions of one layer
+bool Pipeline::start_layer(Layer &l, int width, int height, int main_width, int main_height) {
+    const EncoderConfig &lc = l.config;
+    int max_w = lc.width, max_h = lc.height;
+    if (lc.layer > 0) {
+        const SimulcastLayer &sl = config.simulcast[lc.layer - 1];
+        if (sl.scale > 0) {
+            max_w = static_cast<int>(main_width * sl.scale);
+            max_h = static_cast<int>(main_height * sl.scale);
+        } else {
+            max_w = sl.width > 0 ? sl.width : main_width;
+            max_h = sl.height > 0 ? sl.height : main_height;
+        }
+    }
+    l.width = width;
+    l.height = height;
+    bool scaling = fit_output_size(width, height, max_w, max_h, l.width, l.height);
+
+    int worker_count = lc.encode_workers;
+    if (worker_count < 1 || worker_count > MAX_ENCODE_WORKERS) {
+        printf("[PIPE] encode_workers %d out of range, using 1\n", worker_count);
+        worker_count = 1;
+    }
+    for (int i = 0; i < worker_count; i++) {
+        EncodeWorker w;
+        w.encoder = create_frame_encoder(lc.codec);
+        if (!w.encoder) {
+            return false;
+        }
+        if (w.encoder->keeps_state() && worker_count > 1) {
+            printf("[PIPE] %s encodes frame-to-frame deltas, using 1 worker\n", w.encoder->get_name());
+            worker_count = 1;
+        }
+        w.encoder->configure(lc);
+        if (w.encoder->needs_even_size() && ((l.width | l.height) & 1)) {
+            // fit_output_size() rounds to even
+            scaling = fit_output_size(width, height, l.width & ~1, l.height & ~1, l.width, l.height);
+        }
+        if (!w.encoder->init(l.width, l.height)) {
+            printf("[PIPE] Failed to initialize %s encoder\n", w.encoder->get_name());
+            return false;
+        }
+        w.input = std::make_unique<SpscQueue<FrameLease>>(QUEUE_DEPTH);
+        w.output = std::make_unique<SpscQueue<FrameLease>>(QUEUE_DEPTH);
+        l.workers.push_back(std::move(w));
+    }
+    YuvFormat input = l.workers[0].encoder->input_format();
+    bool planar = input.layout == PixelFormat::I420 || input.layout == PixelFormat::I444;
+
+    if (lc.layer > 0) {
+        printf("[PIPE] Layer %d: %dx%d %s q%d -> %s\n", lc.layer, l.width, l.height, lc.codec.c_str(), lc.quality,
+               l.transport->get_name());
+    }
+
+    // An earlier layer already making the same frames: take those
+    for (int i = 0; i < lc.layer; i++) {
+        const Layer &other = *layers[i];
+        if (other.source < 0 && other.width == l.width && other.height == l.height &&
+            (other.yuv ? other.yuv->format().layout : PixelFormat::BGRA) == input.layout &&
+            (!planar || other.yuv->format().range == input.range)) {
+            l.source = i;
+            printf("[PIPE] Layer %d shares the frames of layer %d\n", lc.layer, i);
+            return true;
+        }
+    }
+
+    // Captures larger than the layer's output are downscaled in convert
+    if (scaling) {
+        ScaleFilter filter;
+        if (!parse_scale_filter(config.scale_filter, filter)) {
+            printf("[PIPE] Unknown scale filter: %s (box, bilinear, lanczos)\n", config.scale_filter.c_str());
+            return false;
+        }
+        l.scaler = std::make_unique<Scaler>();
+        if (!l.scaler->init(width, height, l.width, l.height, filter)) {
+            printf("[PIPE] Cannot scale %dx%d to %dx%d\n", width, height, l.width, l.height);
+            return false;
+        }
+        printf("[PIPE] Downscaling %dx%d -> %dx%d, %s (%dx%d taps, %s, %d threads)\n", width, height, l.width,
+               l.height, scale_filter_name(filter), l.scaler->horizontal_taps(), l.scaler->vertical_taps(),
+               scale_kernel(), scale_pool ? scale_pool->size() : 1);
+    }
+
+    // Encoders that work from planar YUV get it from convert, converted
+    // once per change rather than once per frame per worker
+    if (planar) {
+        l.yuv = std::make_unique<YuvConverter>();
+        if (!l.yuv->init(l.width, l.height, input)) {
+            return false;
+        }
+        printf("[PIPE] Converting to %s %s range (%s)\n", input.layout == PixelFormat::I420 ? "I420" : "I444",
+               input.range == YuvRange::FULL ? "full" : "limited", yuv_kernel());
+    }
+    return true;
+}
+
+void Pipeline::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+
+    for (auto &t : threads) {
+        if (t.joinable()) t.join();
+    }
+    threads.clear();
+
+    // Return anything still queued to its pool
+    FrameLease drop;
+    while (captured.try_pop(drop)) drop.reset();
+    for (auto &l : layers) {
+        for (auto &w : l->workers) {
+            while (w.input->try_pop(drop)) drop.reset();
+            while (w.output->try_pop(drop)) drop.reset();
+        }
+    }
+}
+
+bool Pipeline::push(SpscQueue<FrameLease> &queue, FrameLease &frame, StageStats &s) {
+    uint64_t t0 = steady_now_us();
+    while (running) {
+        if (queue.push_wait(frame, WAIT_MS)) {
+            s.stall_us += steady_now_us() - t0;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Pipeline::pop(SpscQueue<FrameLease> &queue, FrameLease &frame, StageStats &s, int wait_ms) {
+    uint64_t t0 = steady_now_us();
+    size_t depth = queue.size();
+    bool ok = queue.pop_wait(frame, wait_ms);
+    s.stall_us += steady_now_us() - t0;
+    if (ok) {
+        s.queue_depth += depth;
+    }
+    return ok;
+}
+
+// Marker published in place of a frame identical to the previous one
+static void write_unchanged(FrameBuffer &out) {
+    UnchangedMessage msg = {};
+    msg.magic = UNCHANGED_MESSAGE_MAGIC;
+    msg.width = static_cast<uint32_t>(out.width);
+    msg.height = static_cast<uint32_t>(out.height);
+    memcpy(out.data, &msg, sizeof(msg));
+    out.size = sizeof(msg);
+    out.format = PixelFormat::UNCHANGED;
+    out.damage.clear();
+}
+
+// Downscaled copy of a raw frame. Duplicates keep their metadata only: the
+// encoder never looks at their pixels.
+static void scale_frame(Scaler &scaler, ThreadPool *pool, const FrameBuffer &raw, FrameBuffer &out) {
+    int bpp = raw.format == PixelFormat::BGR ? 3 : 4;
+    out.format = raw.format;
+    out.width = scaler.width();
+    out.height = scaler.height();
+    out.stride = out.width * bpp;
+    out.size = static_cast<size_t>(out.stride) * out.height;
+    out.timestamp_us = raw.timestamp_us;
+    out.content_hash = raw.content_hash;
+    out.duplicate = raw.duplicate;
+    out.damage.clear();
+    for (const auto &r : raw.damage) {
+        out.damage.push_back(scaler.map_rect(r));
+    }
+    out.cursor_x = raw.cursor_x < 0 ? -1 : static_cast<int>(static_cast<long long>(raw.cursor_x) * out.width / raw.width);
+    out.cursor_y = raw.cursor_y < 0 ? -1 : static_cast<int>(static_cast<long long>(raw.cursor_y) * out.height / raw.height);
+    out.focus = raw.focus.width > 0 && raw.focus.height > 0 ? scaler.map_rect(raw.focus) : CaptureRect{0, 0, 0, 0};
+    if (!raw.duplicate) {
+        scaler.scale(raw.data, raw.stride, bpp, out.data, out.stride, pool);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Stages
+// ---------------------------------------------------------------------------
+void Pipeline::capture_loop() {
+    StageStats &s = stats[CAPTURE];
+    const uint64_t interval_us = config.fps > 0 ? 1000000 / config.fps : 0;
+    uint64_t next_tick = steady_now_us();
+
+    bool own_buffers = backend.provides_buffers();
+
+    while (running) {
+        uint64_t t0 = steady_now_us();
+        FrameLease frame;
+        if (!own_buffers) {
+            frame = raw_pool->acquire(WAIT_MS);
+        }
+        uint64_t t1 = steady_now_us();
+        s.stall_us += t1 - t0;
+        if (!frame && !own_buffers) {
+            continue;
+        }
+
+        // Backends that know the pointer or focus fill them in; acquire()
+        // left them unset
+        bool captured_frame = backend.capture(frame);
+        if (config.cursor) {
+            poll_cursor();
+        }
+        if (!captured_frame) {
+            // Either no new frame yet (DXGI timeout, no damage) or push-model
+            // backend — both are normal.
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+        frame->timestamp_us = t1;
+        s.busy_us += steady_now_us() - t1;
+        s.frames++;
+
+        // Damage-tracking backends report which regions changed
+        if (config.verbose && !frame->damage.empty()) {
+            long long damaged_px = 0;
+            for (const auto &r : frame->damage) damaged_px += (long long)r.width * r.height;
+            printf("[CAPTURE] %zu damage rects, %.1f%% of frame\n", frame->damage.size(),
+                   100.0 * damaged_px / ((long long)frame->width * frame->height));
+        }
+
+        if (!push(captured, frame, s)) {
+            break;
+        }
+
+        // Frame rate limiting on an absolute schedule, so stalls don't drift
+        if (interval_us) {
+            next_tick += interval_us;
+            uint64_t now = steady_now_us();
+            if (next_tick > now) {
+                std::this_thread::sleep_for(std::chrono::microseconds(next_tick - now));
+            } else {
+                if (config.benchmark) {
+                    printf("[BENCH] Frame took %llu us (target %llu us)\n",
+                           (unsigned long long)(now - t0), (unsigned long long)interval_us);
+                }
+                next_tick = now;
+            }
+        }
+    }
+}
+
+// Downscale, then planar YUV, each into a lease of the layer's own pool; the
+// wait for a buffer counts as stall
+bool Pipeline::convert_layer(Layer &l, const FrameLease &raw, FrameLease &out, StageStats &s, uint64_t &t0) {
+    auto acquire = [&](FramePool &pool) {
+        uint64_t t1 = steady_now_us();
+        FrameLease lease = pool.acquire(WAIT_MS);
+        uint64_t waited = steady_now_us() - t1;
+        s.stall_us += waited;
+        t0 += waited;
+        return lease;
+    };
+    out = raw;
+    if (l.scaler) {
+        FrameLease scaled = acquire(*l.scaled_pool);
+        if (!scaled) {
+            if (l.yuv) l.yuv->invalidate();
+            return false;
+        }
+        scale_frame(*l.scaler, scale_pool.get(), *out, *scaled);
+        out = scaled;
+    }
+    if (l.yuv) {
+        // Planes first, so they stay current even if this frame is dropped
+        if (!out->duplicate) {
+            l.yuv->update(*out);
+        }
+        FrameLease planar = acquire(*l.yuv_pool);
+        if (!planar) {
+            return false;
+        }
+        // Too small (the capture grew): the encoder takes raw as well
+        if (l.yuv->write_to(*out, *planar)) {
+            out = planar;
+        }
+    }
+    return true;
+}
+
+void Pipeline::convert_loop() {
+    StageStats &s = stats[CONVERT];
+    uint64_t last_hash = 0;
+    bool have_last = false;
+    std::vector<FrameLease> forms(layers.size());
+
+    while (running) {
+        FrameLease frame;
+        if (!pop(captured, frame, s, WAIT_MS)) {
+            continue;
+        }
+
+        uint64_t t0 = steady_now_us();
+        if (recorder) {
+            recorder->write_frame(*frame);
+        }
+        frame->duplicate = false;
+        if (config.dedup) {
+            int bpp = frame->format == PixelFormat::BGR ? 3 : 4;
+            frame->content_hash = frame_hash(frame->data, frame->stride, frame->width, frame->height, bpp);
+            bool forced = resync.exchange(false);
+            frame->duplicate = have_last && !forced && frame->content_hash == last_hash;
+            last_hash = frame->content_hash;
+            have_last = true;
+        }
+
+        // Every layer's form of the frame; a layer without buffers drops it
+        // for all, so layers stay on the same frames
+        bool dropped = false;
+        for (size_t i = 0; i < layers.size(); i++) {
+            Layer &l = *layers[i];
+            if (dropped) {
+                if (l.yuv) l.yuv->invalidate();  // missed this frame's changes
+            } else if (l.source >= 0) {
+                forms[i] = forms[l.source];
+            } else if (!convert_layer(l, frame, forms[i], s, t0)) {
+                dropped = true;
+            }
+        }
+        frame.reset();
+        if (dropped) {
+            resync = true;  // don't let the next frame dedup against it
+            for (auto &f : forms) f.reset();
+            continue;
+        }
+        s.busy_us += steady_now_us() - t0;
+        s.frames++;
+
+        for (size_t i = 0; i < layers.size() && running; i++) {
+            Layer &l = *layers[i];
+            if (!push(*l.workers[l.next_worker].input, forms[i], s)) {
+                break;
+            }
+            l.next_worker = (l.next_worker + 1) % l.workers.size();
+        }
+        for (auto &f : forms) f.reset();
+    }
+}
+
+void Pipeline::encode_loop(Layer &l, size_t index) {
+    StageStats &s = l.stats[0];
+    EncodeWorker &w = l.workers[index];
+
+    while (running) {
+        FrameLease raw;
+        if (!pop(*w.input, raw, s, WAIT_MS)) {
+            continue;
+        }
+
+        uint64_t t0 = steady_now_us();
+        FrameLease out = l.encoded_pool->acquire(WAIT_MS);
+        uint64_t t1 = steady_now_us();
+        s.stall_us += t1 - t0;
+
+        // Publisher stuck or encode failed: drop this frame
+        if (out) {
+            out->width = raw->width;
+            out->height = raw->height;
+            out->timestamp_us = raw->timestamp_us;
+            out->damage = raw->damage;
+            if (l.keyframe_requested.exchange(false)) {
+                w.encoder->request_keyframe();
+            }
+            // Sliced encodes go to the publisher before they start, so it
+            // can send each slice the moment it is final
+            bool streamed = !raw->duplicate && w.encoder->streams_slices();
+            if (streamed) {
+                out->slices.start();
+                FrameLease early = out;
+                uint64_t t2 = steady_now_us();
+                if (!push(*w.output, early, s)) {
+                    out->slices.finish(false);
+                    break;
+                }
+                t1 += steady_now_us() - t2;
+            }
+
+            bool ok;
+            if (raw->duplicate) {
+                if (!w.encoder->refine(*out)) {
+                    write_unchanged(*out);
+                }
+                dedup_hits++;
+                ok = true;
+            } else {
+                ok = w.encoder->encode(*raw, *out);
+            }
+            if (streamed) {
+                out->slices.finish(ok);
+            }
+            if (ok) {
+                s.frames++;
+            } else {
+                resync = true;
+            }
+            if (streamed || !ok) {
+                out.reset();
+            }
+            if (streamed) {
+                raw.reset();
+                s.busy_us += steady_now_us() - t1;
+                continue;
+            }
+        } else {
+            resync = true;
+        }
+        raw.reset();
+        s.busy_us += steady_now_us() - t1;
+
+        if (!push(*w.output, out, s)) {
+            break;
+        }
+    }
+}
+
+void Pipeline::publish_loop(Layer &l) {
+    StageStats &s = l.stats[1];
+    size_t next_worker = 0;
+    int wait_ms = config.cursor ? CURSOR_WAIT_MS : WAIT_MS;
+
+    while (running) {
+        FrameLease frame;
+        bool popped = pop(*l.workers[next_worker].output, frame, s, wait_ms);
+        if (config.cursor) {
+            publish_cursor(l);
+        }
+        if (!popped) {
+            l.transport->poll();
+            take_refresh_request(l);
+            continue;
+        }
+        next_worker = (next_worker + 1) % l.workers.size();
+        if (!frame) {
+            continue;  // dropped by the encoder
+        }
+
+        uint64_t t0 = steady_now_us();
+        int result = frame->slices.streaming() ? publish_slices(l, *frame) : l.transport->publish(*frame);
+        if (result != 0) {
+            printf("[ERROR] Failed to publish frame\n");
+        }
+        l.bytes_published += frame->size;
+        if (frame->quality > 0) {
+            l.quality_sum += frame->quality;
+            l.quality_frames++;
+        }
+        take_refresh_request(l);
+        s.busy_us += steady_now_us() - t0;
+        s.frames++;
+    }
+}
+
+// A consumer that joined or fell behind wants a keyframe: force the next
+// frame through dedup and have the encoder start over
+void Pipeline::take_refresh_request(Layer &l) {
+    if (l.transport->take_refresh_request()) {
+        resync = true;
+        l.keyframe_requested = true;
+    }
+}
+
+// Forward a frame slice by slice while its encode is still running
+int Pipeline::publish_slices(Layer &l, FrameBuffer &frame) {
+    SliceProgress &progress = frame.slices;
+    size_t sent = 0;
+    int result = 0;
+
+    while (running) {
+        size_t ready = 0;
+        SliceProgress::State state = progress.wait(sent, WAIT_MS, ready);
+        if (state == SliceProgress::FAILED) {
+            return l.transport->publish_slice(frame, sent, 0, SLICE_FLAG_ABORT);
+        }
+        if (state == SliceProgress::DONE) {
+            return result | l.transport->publish_slice(frame, sent, frame.size - sent, SLICE_FLAG_LAST);
+        }
+        if (state == SliceProgress::READY) {
+            result |= l.transport->publish_slice(frame, sent, ready - sent, 0);
+            sent = ready;
+        }
+    }
+    return result;
+}
+
+// Take the backend's pointer; hand it to the publish threads if it changed
+void Pipeline::poll_cursor() {
+    CursorState state = cursor_polled;
+    if (!backend.query_cursor(state) || state.same_as(cursor_polled)) {
+        return;
+    }
+    if (config.verbose && state.shape && state.shape != cursor_polled.shape) {
+        printf("[PIPE] Cursor shape %dx%d, hot spot %d,%d, %016llx\n", state.shape->width, state.shape->height,
+               state.shape->hot_x, state.shape->hot_y, (unsigned long long)state.shape->hash);
+    }
+    cursor_polled = state;
+    cursor_updates++;
+
+    std::lock_guard<std::mutex> lock(cursor_mutex);
+    cursor = state;
+    cursor_serial++;
+}
+
+// Send the latest pointer state if this layer hasn't yet, positioned in the
+// layer's output pixels
+void Pipeline::publish_cursor(Layer &l) {
+    CursorState state;
+    {
+        std::lock_guard<std::mutex> lock(cursor_mutex);
+        if (cursor_serial == 0 || l.cursor_serial == cursor_serial) {
+            return;
+        }
+        l.cursor_serial = cursor_serial;
+        state = cursor;
+    }
+    if (state.x >= 0 && (l.width != capture_width || l.height != capture_height)) {
+        state.x = static_cast<int>(static_cast<long long>(state.x) * l.width / capture_width);
+        state.y = static_cast<int>(static_cast<long long>(state.y) * l.height / capture_height);
+    }
+    if (l.transport->publish_cursor(state, l.width, l.height) != 0) {
+        printf("[ERROR] Failed to publish cursor\n");
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Stats
+// ---------------------------------------------------------------------------
+// One stats line: throughput, occupancy and stall since `last`
+static uint64_t print_stage(const char *name, const StageStats &stats, uint64_t last[4], double elapsed_s,
+                            bool queue) {
+    uint64_t cur[4] = {stats.frames, stats.busy_us, stats.stall_us, stats.queue_depth};
+    uint64_t frames = cur[0] - last[0];
+    uint64_t busy = cur[1] - last[1];
+    uint64_t stall = cur[2] - last[2];
+    uint64_t depth = cur[3] - last[3];
+    for (int k = 0; k < 4; k++) last[k] = cur[k];
+
+    printf("[PIPE] %-8s %6.1f fps  busy %5.1f%%  stall %6.2f ms/frame",
+           name, frames / elapsed_s, busy / (elapsed_s * 1e4), frames ? stall / 1000.0 / frames : 0.0);
+    if (queue) {
+        printf("  queue %.2f", frames ? static_cast<double>(depth) / frames : 0.0);
+    }
+    printf("\n");
+    return frames;
+}
+
+// Target vs actual output of a rate-controlled layer
+void Pipeline::print_rate(Layer &l, double elapsed_s) {
+    uint64_t bytes = l.bytes_published, quality_sum = l.quality_sum, quality_frames = l.quality_frames;
+    uint64_t d_bytes = bytes - l.last_rate[0];
+    uint64_t d_quality = quality_sum - l.last_rate[1];
+    uint64_t d_coded = quality_frames - l.last_rate[2];
+    l.last_rate[0] = bytes;
+    l.last_rate[1] = quality_sum;
+    l.last_rate[2] = quality_frames;
+
+    const EncoderConfig &lc = l.config;
+    if (lc.codec != "jpeg" || (lc.rate_bitrate_kbps <= 0 && lc.rate_frame_kb <= 0)) {
+        return;
+    }
+    char name[32];
+    if (lc.layer > 0) snprintf(name, sizeof(name), "rate%d", lc.layer);
+    else snprintf(name, sizeof(name), "rate");
+    double quality = d_coded ? static_cast<double>(d_quality) / d_coded : 0.0;
+    if (lc.rate_frame_kb > 0) {
+        printf("[PIPE] %-8s target %d KB/frame, actual %.1f KB/frame, quality %.1f\n", name, lc.rate_frame_kb,
+               d_coded ? d_bytes / 1024.0 / d_coded : 0.0, quality);
+    } else {
+        printf("[PIPE] %-8s target %d kbps, actual %.0f kbps, quality %.1f\n", name, lc.rate_bitrate_kbps,
+               d_bytes * 8 / 1000.0 / elapsed_s, quality);
+    }
+}
+
+void Pipeline::print_stats() {
+    uint64_t now = steady_now_us();
+    double elapsed_s = (now - last_stats_us) / 1e6;
+    last_stats_us = now;
+    if (elapsed_s <= 0) {
+        return;
+    }
+
+    print_stage(STAGE_NAMES[CAPTURE], stats[CAPTURE], last_snapshot[CAPTURE], elapsed_s, false);
+    print_stage(STAGE_NAMES[CONVERT], stats[CONVERT], last_snapshot[CONVERT], elapsed_s, true);
+    uint64_t encode_frames = 0;
+    for (auto &l : layers) {
+        for (int i = 0; i < 2; i++) {
+            const char *stage = STAGE_NAMES[ENCODE + i];
+            char name[32];
+            if (l->config.layer > 0) snprintf(name, sizeof(name), "%s%d", stage, l->config.layer);
+            else snprintf(name, sizeof(name), "%s", stage);
+            uint64_t frames = print_stage(name, l->stats[i], l->last_snapshot[i], elapsed_s, true);
+            if (i == 0) {
+                encode_frames += frames;
+            }
+        }
+        print_rate(*l, elapsed_s);
+    }
+
+    if (config.dedup) {
+        uint64_t hits = dedup_hits;
+        uint64_t frames = hits - last_dedup_hits;
+        last_dedup_hits = hits;
+        printf("[PIPE] dedup    %6.1f fps unchanged (%.1f%% of encode), %llu total\n",
+               frames / elapsed_s, encode_frames ? 100.0 * frames / encode_frames : 0.0,
+               (unsigned long long)hits);
+    }
+    if (config.cursor) {
+        uint64_t updates = cursor_updates;
+        printf("[PIPE] cursor   %6.1f updates/s\n", (updates - last_cursor_updates) / elapsed_s);
+        last_cursor_updates = updates;
+    }
+
+    uint64_t scaled_waits = 0, yuv_waits = 0, encoded_waits = 0;
+    for (auto &l : layers) {
+        if (l->scaled_pool) scaled_waits += l->scaled_pool->exhausted_count();
+        if (l->yuv_pool) yuv_waits += l->yuv_pool->exhausted_count();
+        encoded_waits += l->encoded_pool->exhausted_count();
+    }
+    if (raw_pool->exhausted_count() || scaled_waits || yuv_waits || encoded_waits) {
+        printf("[PIPE] pool waits: raw %llu, scaled %llu, yuv %llu, encoded %llu\n",
+               (unsigned long long)raw_pool->exhausted_count(), (unsigned long long)scaled_waits,
+               (unsigned long long)yuv_waits, (unsigned long long)encoded_waits);
+    }
+}
@@ -0,0 +1,182 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "capture.hpp"
+#include "config.hpp"
+#include "cursor.hpp"
+#include "encoder.hpp"
+#include "frame.hpp"
+#include "recording.hpp"
+#include "scale.hpp"
+#include "spsc_queue.hpp"
+#include "transport.hpp"
+
+// Counters one pipeline stage updates as it runs. Read (and diffed) by
+// Pipeline::print_stats() from the main thread.
+struct StageStats {
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> busy_us{0};       // doing actual work
+    std::atomic<uint64_t> stall_us{0};      // waiting on input, output space or buffers
+    std::atomic<uint64_t> queue_depth{0};   // sum of input queue depth seen per frame
+};
+
+// capture -> convert -> encode -> publish, each stage on its own thread with
+// a bounded SPSC queue in between, so capture of frame N+1 overlaps encode of
+// frame N and frame time is set by the slowest stage rather than the sum.
+//
+//   capture  backend->capture() into a raw frame lease, paced to config.fps
+//   convert  per-frame raw work: recording, content hash for dedup, the
+//            downscale to config.width x config.height when the capture
+//            is larger (see Scaler; encoding.threads bands), and planar
+//            YUV for encoders that take it (see YuvConverter)
+//   encode   raw -> config.codec into an encoded frame lease, or an
+//            "unchanged" marker if the frame repeats the previous one (or
+//            the encoder's refinement of what it already sent, see
+//            FrameEncoder::refine)
+//   publish  hand the encoded frame to the transport
+//
+// With the cursor channel (capture.cursor) capture also polls the pointer
+// after every capture attempt, and each publish thread sends the latest
+// state between frames, so the pointer keeps moving while nothing is
+// encoded.
+//
+// Encoders that stream slices (encoding.slices) push their output lease
+// before encoding, and publish forwards each slice as it becomes final, so
+// the first bytes of a frame go out while the rest is still being encoded.
+//
+// The encode stage is a pool of config.encode_workers threads, each with its
+// own FrameEncoder and its own pair of queues. Convert deals frames out
+// round-robin and publish collects them in the same order, so frames leave
+// in capture order without any queue having more than one producer or
+// consumer.
+//
+// With simulcast (encoding.simulcast) every layer has its own encode workers,
+// publish thread and transport, fed by the one capture and convert stage.
+// Convert makes each layer's form of the frame (size, planar YUV) once and
+// layers with the same form share it.
+class Pipeline {
+public:
+    // One transport per layer (layer_count(config)), layer 0 first
+    Pipeline(const EncoderConfig &config, CaptureBackend &backend, const std::vector<FrameTransport *> &transports,
+             FrameRecorder *recorder);
+    ~Pipeline();
+
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+
+    // Allocate buffers for width x height capture and start the threads.
+    // Encoders see their layer's output size, smaller if the capture is
+    // downscaled.
+    bool start(int width, int height);
+
+    // Stop and join all stages, returning every in-flight frame to its pool
+    void stop();
+
+    // Print per-stage throughput, occupancy and stall time since the last call
+    void print_stats();
+
+private:
+    enum Stage { CAPTURE, CONVERT, ENCODE, PUBLISH, STAGE_COUNT };
+
+    // One encode worker. A failed encode still pushes an empty lease so
+    // publish stays in step with the round-robin.
+    struct EncodeWorker {
+        std::unique_ptr<FrameEncoder> encoder;
+        std::unique_ptr<SpscQueue<FrameLease>> input;
+        std::unique_ptr<SpscQueue<FrameLease>> output;
+    };
+
+    // One encoding of the capture. Pools are declared before the workers
+    // so queued leases are released while their pools still exist.
+    struct Layer {
+        EncoderConfig config;  // layer_config()
+        FrameTransport *transport = nullptr;
+        int width = 0;   // output size
+        int height = 0;
+        int source = -1;  // earlier layer whose frames this one takes, or -1
+
+        std::unique_ptr<Scaler> scaler;
+        std::unique_ptr<YuvConverter> yuv;
+        std::unique_ptr<FramePool> scaled_pool;  // downscaled raw frames, if scaling
+        std::unique_ptr<FramePool> yuv_pool;     // planar frames, if the encoder takes YUV
+        std::unique_ptr<FramePool> encoded_pool;
+        std::vector<EncodeWorker> workers;
+        size_t next_worker = 0;  // convert's round-robin position
+
+        // A consumer joined this layer's transport
+        std::atomic<bool> keyframe_requested{false};
+        StageStats stats[2];  // ENCODE, PUBLISH
+        uint64_t last_snapshot[2][4] = {};
+
+        // Output for the rate line: bytes published, and the quality of
+        // rate-controlled frames
+        std::atomic<uint64_t> bytes_published{0};
+        std::atomic<uint64_t> quality_sum{0};
+        std::atomic<uint64_t> quality_frames{0};
+        uint64_t last_rate[3] = {};
+
+        uint64_t cursor_serial = 0;  // Pipeline::cursor_serial last sent
+    };
+
+    bool start_layer(Layer &layer, int width, int height, int main_width, int main_height);
+    // This layer's form of `raw` into `out`; false if a buffer ran out
+    bool convert_layer(Layer &layer, const FrameLease &raw, FrameLease &out, StageStats &stats, uint64_t &t0);
+
+    void capture_loop();
+    void convert_loop();
+    void encode_loop(Layer &layer, size_t index);
+    void publish_loop(Layer &layer);
+    int publish_slices(Layer &layer, FrameBuffer &frame);
+    void take_refresh_request(Layer &layer);
+    void poll_cursor();
+    void publish_cursor(Layer &layer);
+    void print_rate(Layer &layer, double elapsed_s);
+
+    // Push with backpressure; accounts the wait as stall time
+    bool push(SpscQueue<FrameLease> &queue, FrameLease &frame, StageStats &stats);
+    // Pop with timeout; accounts the wait as stall time
+    bool pop(SpscQueue<FrameLease> &queue, FrameLease &frame, StageStats &stats, int wait_ms);
+
+    const EncoderConfig &config;
+    CaptureBackend &backend;
+    std::vector<FrameTransport *> transports;
+    FrameRecorder *recorder;
+
+    std::unique_ptr<FramePool> raw_pool;
+    SpscQueue<FrameLease> captured;
+    std::vector<std::unique_ptr<Layer>> layers;
+    std::unique_ptr<ThreadPool> scale_pool;  // encoding.threads bands, if more than one
+
+    // Dedup: frames skipped, and set when a frame was dropped after convert
+    // or a new consumer needs a picture, so the next frame is encoded even
+    // if it hashes the same
+    std::atomic<uint64_t> dedup_hits{0};
+    std::atomic<bool> resync{false};
+    uint64_t last_dedup_hits = 0;
+
+    // Cursor channel: the pointer as capture last saw it, in capture pixels,
+    // and a serial bumped whenever it changes. `polled` is the capture
+    // thread's own copy.
+    std::mutex cursor_mutex;
+    CursorState cursor;
+    uint64_t cursor_serial = 0;
+    CursorState cursor_polled;
+    int capture_width = 0;
+    int capture_height = 0;
+    std::atomic<uint64_t> cursor_updates{0};
+    uint64_t last_cursor_updates = 0;
+
+    std::atomic<bool> running{false};
+    std::vector<std::thread> threads;
+    StageStats stats[2];  // CAPTURE, CONVERT
+    uint64_t last_snapshot[2][4] = {};
+    uint64_t last_stats_us = 0;
+};
+
+#endif
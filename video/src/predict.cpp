@@ -0,0 +1,69 @@
+#include <vector>
+#include "predict.hpp"
+
+static inline uint8_t med(uint8_t a, uint8_t b, uint8_t c) {
+    uint8_t lo = a < b ? a : b;
+    uint8_t hi = a < b ? b : a;
+    if (c >= hi) return lo;
+    if (c <= lo) return hi;
+    return static_cast<uint8_t>(a + b - c);
+}
+
+// Prediction for channel value at (x, y) given the transformed row above
+// (null on the first row) and the current row
+static inline uint8_t predict(const uint8_t *up, const uint8_t *row, int x, int c) {
+    if (!up) {
+        return x ? row[(x - 1) * 3 + c] : 0;
+    }
+    if (!x) {
+        return up[c];
+    }
+    return med(row[(x - 1) * 3 + c], up[x * 3 + c], up[(x - 1) * 3 + c]);
+}
+
+void predict_encode(const uint8_t *data, size_t stride, int w, int h, int bpp, uint8_t *dst) {
+    // Two rows of color-transformed pixels
+    std::vector<uint8_t> rows(static_cast<size_t>(w) * 6);
+    uint8_t *cur = rows.data();
+    uint8_t *up = nullptr;
+
+    for (int y = 0; y < h; y++) {
+        const uint8_t *src = data + static_cast<size_t>(y) * stride;
+        for (int x = 0; x < w; x++, src += bpp) {
+            cur[x * 3 + 0] = static_cast<uint8_t>(src[0] - src[1]);
+            cur[x * 3 + 1] = src[1];
+            cur[x * 3 + 2] = static_cast<uint8_t>(src[2] - src[1]);
+        }
+        for (int x = 0; x < w; x++) {
+            for (int c = 0; c < 3; c++) {
+                *dst++ = static_cast<uint8_t>(cur[x * 3 + c] - predict(up, cur, x, c));
+            }
+        }
+        up = cur;
+        cur = cur == rows.data() ? rows.data() + static_cast<size_t>(w) * 3 : rows.data();
+    }
+}
+
+void predict_decode(const uint8_t *src, int w, int h, uint8_t *dst, size_t stride) {
+    std::vector<uint8_t> rows(static_cast<size_t>(w) * 6);
+    uint8_t *cur = rows.data();
+    uint8_t *up = nullptr;
+
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            for (int c = 0; c < 3; c++) {
+                cur[x * 3 + c] = static_cast<uint8_t>(*src++ + predict(up, cur, x, c));
+            }
+        }
+        uint8_t *out = dst + static_cast<size_t>(y) * stride;
+        for (int x = 0; x < w; x++, out += 4) {
+            uint8_t g = cur[x * 3 + 1];
+            out[0] = static_cast<uint8_t>(cur[x * 3 + 0] + g);
+            out[1] = g;
+            out[2] = static_cast<uint8_t>(cur[x * 3 + 2] + g);
+            out[3] = 0xFF;
+        }
+        up = cur;
+        cur = cur == rows.data() ? rows.data() + static_cast<size_t>(w) * 3 : rows.data();
+    }
+}
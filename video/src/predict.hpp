@@ -0,0 +1,27 @@
+#ifndef PREDICT_HPP
+#define PREDICT_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Lossless residual coding for photographic blocks, used for
+// TILE_ENCODING_PREDICTED records. Each pixel becomes three bytes:
+//
+//   colors are first decorrelated as B - G, G, R - G (mod 256), then each
+//   of those is predicted from its left (a), upper (b) and upper-left (c)
+//   neighbours with the LOCO-I median edge detector:
+//       c >= max(a, b) ? min(a, b) : c <= min(a, b) ? max(a, b) : a + b - c
+//   and the residual (value - prediction, mod 256) is stored. The first
+//   row predicts from the left only, the first column from above only,
+//   and the top-left pixel from 0.
+//
+// Residuals cluster around zero and compress well with a general-purpose
+// entropy coder; the output itself is always exactly 3 bytes per pixel.
+
+// Encode the w x h block at `data` (BGRA or BGR) into dst (w * h * 3 bytes)
+void predict_encode(const uint8_t *data, size_t stride, int w, int h, int bytes_per_pixel, uint8_t *dst);
+
+// Decode w * h * 3 residual bytes into a w x h BGRA block
+void predict_decode(const uint8_t *src, int w, int h, uint8_t *dst, size_t stride);
+
+#endif
@@ -0,0 +1,175 @@
+#include <cstdio>
+#include "rate_control.hpp"
+
+// JPEG size at quality 0, 5, ..., 100 relative to quality 75 (TurboJPEG,
+// 4:2:0, averaged over the desktop, text, window and media scenes; --bench
+// rate prints both). Noise-like video falls off faster below q50, which the
+// learned k absorbs.
+static const double QUALITY_CURVE[] = {
+    0.24, 0.30, 0.37, 0.43, 0.49, 0.56, 0.61, 0.66, 0.70, 0.73, 0.77,
+    0.80, 0.84, 0.89, 0.94, 1.00, 1.10, 1.22, 1.43, 1.88, 3.06,
+};
+// Added to the activity so flat frames still cost headers and DC terms
+constexpr double ACTIVITY_FLOOR = 1.0;
+
+// One row in this many is sampled for activity; the row's offset within
+// its block cycles through all phases so text lines and scrolls don't alias
+constexpr int ACTIVITY_ROW_STEP = 8;
+
+// k before the first frame: 0.012..0.016 over the synthetic scenes
+constexpr double DEFAULT_K = 0.013;
+
+// Weight of the newest frame in k
+constexpr double LEARN_RATE = 0.3;
+
+// Quality rises by at most this per frame, and only with this much of the
+// budget to spare; it holds while the frame is predicted within HOLD_MARGIN
+// over, the balance absorbing the difference
+constexpr int RISE_STEP = 2;
+constexpr double RISE_MARGIN = 0.1;
+constexpr double HOLD_MARGIN = 0.1;
+
+// Rises are judged against the busiest recent content rather than this
+// frame's, so cheap frames in a mixed stream don't climb a quality the next
+// busy one has to drop; the peak decays by this per frame
+constexpr double PEAK_DECAY = 0.98;
+
+// Share of the carried-over balance applied to one frame, and the most
+// that may be banked or owed, in frame budgets
+constexpr double PAYBACK_RATE = 0.25;
+constexpr double MAX_BANKED = 1.0;
+constexpr double MAX_OWED = 2.0;
+
+// Frame rate assumed until the unthrottled capture's interval is measured
+constexpr int UNTHROTTLED_FPS = 60;
+
+double jpeg_size_ratio(int quality) {
+    if (quality <= 0) return QUALITY_CURVE[0];
+    if (quality >= 100) return QUALITY_CURVE[20];
+    int i = quality / 5;
+    double t = (quality - i * 5) / 5.0;
+    return QUALITY_CURVE[i] + (QUALITY_CURVE[i + 1] - QUALITY_CURVE[i]) * t;
+}
+
+double frame_activity(const FrameBuffer &frame) {
+    // Luma, or green as its stand-in for raw pixels
+    const uint8_t *base = frame.data;
+    size_t stride = frame.stride;
+    int step = 1;
+    switch (frame.format) {
+    case PixelFormat::I420:
+    case PixelFormat::I444: break;
+    case PixelFormat::BGRA: base += 1; step = 4; break;
+    case PixelFormat::BGR:  base += 1; step = 3; break;
+    default: return 0;
+    }
+    if (frame.width < 2 || frame.height < 2) {
+        return 0;
+    }
+
+    uint64_t sum = 0, count = 0;
+    for (int block = 0; block * ACTIVITY_ROW_STEP + 1 < frame.height; block++) {
+        int y = block * ACTIVITY_ROW_STEP + (block * 3) % ACTIVITY_ROW_STEP;
+        if (y + 1 >= frame.height) {
+            break;
+        }
+        const uint8_t *row = base + static_cast<size_t>(y) * stride;
+        const uint8_t *below = row + stride;
+        int left = row[0];
+        uint32_t row_sum = 0;
+        for (int x = 1; x < frame.width; x++) {
+            int p = row[x * step];
+            int dx = p - left, dy = p - below[x * step];
+            row_sum += (dx < 0 ? -dx : dx) + (dy < 0 ? -dy : dy);
+            left = p;
+        }
+        sum += row_sum;
+        count += static_cast<uint64_t>(frame.width - 1) * 2;
+    }
+    return count ? static_cast<double>(sum) / count : 0;
+}
+
+bool RateController::init(const EncoderConfig &config) {
+    bitrate_kbps = config.rate_bitrate_kbps;
+    frame_bytes = config.rate_frame_kb > 0 ? static_cast<size_t>(config.rate_frame_kb) * 1024 : 0;
+    if (bitrate_kbps <= 0 && !frame_bytes) {
+        return false;
+    }
+    fps = config.fps;
+    workers = config.encode_workers > 1 ? config.encode_workers : 1;
+    min_quality = config.rate_min_quality < 1 ? 1 : config.rate_min_quality;
+    max_quality = config.rate_max_quality > 100 ? 100 : config.rate_max_quality;
+    if (max_quality < min_quality) {
+        max_quality = min_quality;
+    }
+    k = 0;
+    last_quality = config.quality < min_quality ? min_quality : config.quality > max_quality ? max_quality : config.quality;
+    balance = 0;
+    activity_peak = 0;
+    interval_us = 0;
+    last_timestamp_us = 0;
+
+    if (frame_bytes) {
+        printf("[RATE] %zu KB per frame, quality %d..%d\n", frame_bytes / 1024, min_quality, max_quality);
+    } else {
+        printf("[RATE] %d kbps, quality %d..%d\n", bitrate_kbps, min_quality, max_quality);
+    }
+    return true;
+}
+
+size_t RateController::frame_budget() const {
+    if (frame_bytes) {
+        return frame_bytes;
+    }
+    double seconds = fps > 0 ? 1.0 / fps : interval_us > 0 ? interval_us / 1e6 / workers : 1.0 / UNTHROTTLED_FPS;
+    return static_cast<size_t>(bitrate_kbps * 1000.0 / 8 * seconds);
+}
+
+double RateController::predict(int quality, size_t pixels, double activity) const {
+    return (k > 0 ? k : DEFAULT_K) * pixels * (activity + ACTIVITY_FLOOR) * jpeg_size_ratio(quality);
+}
+
+int RateController::choose(size_t pixels, double activity, uint64_t timestamp_us) {
+    if (fps <= 0 && timestamp_us > last_timestamp_us && last_timestamp_us) {
+        double interval = static_cast<double>(timestamp_us - last_timestamp_us);
+        interval_us = interval_us > 0 ? interval_us + (interval - interval_us) * LEARN_RATE : interval;
+    }
+    last_timestamp_us = timestamp_us;
+
+    activity_peak = activity > activity_peak * PEAK_DECAY ? activity : activity_peak * PEAK_DECAY;
+
+    double budget = static_cast<double>(frame_budget());
+    double carry = balance * PAYBACK_RATE;
+    if (carry > budget / 2) carry = budget / 2;
+    if (carry < -budget / 2) carry = -budget / 2;
+    double target = budget + carry;
+
+    int quality = min_quality;
+    for (int q = max_quality; q > min_quality; q--) {
+        if (predict(q, pixels, activity) <= target) {
+            quality = q;
+            break;
+        }
+    }
+    if (quality > last_quality) {
+        int up = quality < last_quality + RISE_STEP ? quality : last_quality + RISE_STEP;
+        quality = predict(up, pixels, activity_peak) <= target * (1 - RISE_MARGIN) ? up : last_quality;
+    } else if (quality < last_quality && predict(last_quality, pixels, activity) <= target * (1 + HOLD_MARGIN)) {
+        quality = last_quality;
+    }
+    last_quality = quality;
+    return quality;
+}
+
+void RateController::update(int quality, size_t pixels, double activity, size_t bytes) {
+    if (!pixels) {
+        return;
+    }
+    double unit = bytes / (pixels * (activity + ACTIVITY_FLOOR) * jpeg_size_ratio(quality));
+    k = k > 0 ? k + (unit - k) * LEARN_RATE : unit;
+
+    double budget = static_cast<double>(frame_budget());
+    balance += budget - static_cast<double>(bytes);
+    if (balance > budget * MAX_BANKED) balance = budget * MAX_BANKED;
+    if (balance < -budget * MAX_OWED) balance = -budget * MAX_OWED;
+}
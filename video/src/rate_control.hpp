@@ -0,0 +1,69 @@
+#ifndef RATE_CONTROL_HPP
+#define RATE_CONTROL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "config.hpp"
+#include "frame.hpp"
+
+// Mean luma gradient of a raw or planar frame, 0..255, on a sparse set of
+// rows: how much detail a full-frame encode has to spend bytes on
+double frame_activity(const FrameBuffer &frame);
+
+// Model JPEG size at `quality` relative to quality 75, same content
+double jpeg_size_ratio(int quality);
+
+// Closed-loop JPEG quality per frame for a bitrate (encoding.rate.bitrate_kbps)
+// or a per-frame byte budget (encoding.rate.frame_kb).
+//
+// Output size is predicted as
+//     bytes = k * pixels * (activity + ACTIVITY_FLOOR) * jpeg_size_ratio(quality)
+// where jpeg_size_ratio() is JPEG size relative to quality 75 (measured over the
+// synthetic scenes, --bench rate) and k, the one unknown, is learned from
+// the frames actually encoded (moving average). A content change shows up
+// in the activity before the encode, so the first frame of a new scene is
+// already sized for it.
+//
+// Each encode worker runs its own controller on the frames it gets; the
+// per-frame budget is the same either way.
+//
+// Each frame gets the highest quality predicted to fit its budget. To keep
+// quality from oscillating around the target it holds within a band around
+// the budget (RISE_MARGIN under, HOLD_MARGIN over), drops at once past it,
+// and rises at most RISE_STEP per frame, only when the recent activity peak
+// would fit too. Misses of the model are paid back (or banked) over the
+// following frames, bounded, so the average bitrate converges on the target.
+class RateController {
+public:
+    // False when rate control is off (no target configured)
+    bool init(const EncoderConfig &config);
+
+    // Quality for the next frame; `timestamp_us` paces the budget when the
+    // capture is unthrottled (fps 0)
+    int choose(size_t pixels, double activity, uint64_t timestamp_us);
+
+    // What the frame chosen for cost
+    void update(int quality, size_t pixels, double activity, size_t bytes);
+
+    // Bytes the next frame may use, before carry-over
+    size_t frame_budget() const;
+
+private:
+    double predict(int quality, size_t pixels, double activity) const;
+
+    int bitrate_kbps = 0;
+    size_t frame_bytes = 0;  // fixed budget (frame_kb), overrides bitrate
+    int fps = 0;
+    int workers = 1;  // encode workers; each sees every workers-th frame
+    int min_quality = 20;
+    int max_quality = 90;
+
+    double k = 0;        // learned bytes per pixel per activity at quality 75
+    int last_quality = 0;
+    double activity_peak = 0;  // decaying maximum of recent frames
+    double balance = 0;  // budget not spent so far (negative: overspent)
+    double interval_us = 0;  // measured frame interval, unthrottled capture
+    uint64_t last_timestamp_us = 0;
+};
+
+#endif
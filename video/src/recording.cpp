@@ -0,0 +1,104 @@
+#include <cstring>
+#include "clock.hpp"
+#include "recording.hpp"
+
+static bool write_padding(FILE *file, uint64_t written) {
+    static const uint8_t zeros[RECORDING_ALIGN] = {};
+    uint64_t pad = (RECORDING_ALIGN - written % RECORDING_ALIGN) % RECORDING_ALIGN;
+    return pad == 0 || fwrite(zeros, 1, pad, file) == pad;
+}
+
+bool FrameRecorder::open(const std::string &path, int width, int height, int fps) {
+    close();
+
+    file = fopen(path.c_str(), "wb");
+    if (!file) {
+        printf("[RECORD] Could not open %s for writing\n", path.c_str());
+        return false;
+    }
+
+    memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+    header.width = width;
+    header.height = height;
+    header.stride = width * 4;
+    header.fps = fps;
+    header.frame_count = 0;
+    header.record_size = recording_record_size(header.stride, header.height);
+
+    if (fwrite(&header, sizeof(header), 1, file) != 1 || !write_padding(file, sizeof(header))) {
+        printf("[RECORD] Write failed: %s\n", path.c_str());
+        close();
+        return false;
+    }
+
+    row_buffer.resize(header.stride);
+    printf("[RECORD] Recording %dx%d raw frames to %s (%u bytes/frame)\n",
+           width, height, path.c_str(), header.record_size);
+    return true;
+}
+
+void FrameRecorder::close() {
+    if (!file) {
+        return;
+    }
+
+    // Patch the final frame count into the header
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+    fclose(file);
+    file = nullptr;
+
+    printf("[RECORD] Wrote %u frames\n", header.frame_count);
+}
+
+void FrameRecorder::write_frame(const FrameBuffer &frame) {
+    if (!file || (frame.format != PixelFormat::BGRA && frame.format != PixelFormat::BGR)) {
+        return;
+    }
+
+    const uint8_t *pixels = frame.data;
+    int width = frame.width;
+    int height = frame.height;
+    int stride = frame.stride;
+
+    if (static_cast<uint32_t>(width) != header.width || static_cast<uint32_t>(height) != header.height) {
+        printf("[RECORD] Frame size changed (%dx%d), stopping recording\n", width, height);
+        close();
+        return;
+    }
+
+    uint64_t now = frame.timestamp_us ? frame.timestamp_us : steady_now_us();
+    if (header.frame_count == 0) {
+        first_timestamp_us = now;
+    }
+
+    bool ok = true;
+    for (int y = 0; y < height && ok; y++) {
+        const uint8_t *row = pixels + static_cast<size_t>(y) * stride;
+        if (frame.format == PixelFormat::BGR) {
+            uint8_t *dst = row_buffer.data();
+            for (int x = 0; x < width; x++) {
+                dst[x * 4 + 0] = row[x * 3 + 0];
+                dst[x * 4 + 1] = row[x * 3 + 1];
+                dst[x * 4 + 2] = row[x * 3 + 2];
+                dst[x * 4 + 3] = 0xFF;
+            }
+            row = dst;
+        }
+        ok = fwrite(row, 1, header.stride, file) == header.stride;
+    }
+
+    RecordingFrameTrailer trailer = {};
+    trailer.timestamp_us = now - first_timestamp_us;
+    trailer.frame_index = header.frame_count;
+    ok = ok && fwrite(&trailer, sizeof(trailer), 1, file) == 1;
+    ok = ok && write_padding(file, static_cast<uint64_t>(header.stride) * height + sizeof(trailer));
+
+    if (!ok) {
+        printf("[RECORD] Write failed, stopping recording\n");
+        close();
+        return;
+    }
+
+    header.frame_count++;
+}
@@ -0,0 +1,65 @@
+#ifndef RECORDING_HPP
+#define RECORDING_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "frame.hpp"
+
+// Raw frame dump format written by --record and read by the replay backend.
+// All fields little-endian.
+//
+//   [RecordingHeader]                          padded to RECORDING_ALIGN
+//   [frame 0 pixels][RecordingFrameTrailer]    padded to RECORDING_ALIGN
+//   [frame 1 pixels][RecordingFrameTrailer]    ...
+//
+// Pixels are BGRA, top-down, `stride` bytes per row. Every frame starts on a
+// page boundary so a mapped recording can be fed to the encoder in place.
+constexpr char RECORDING_MAGIC[8] = {'D', 'S', 'T', 'R', 'E', 'C', '0', '1'};
+constexpr uint32_t RECORDING_ALIGN = 4096;
+
+struct RecordingHeader {
+    char     magic[8];
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t fps;          // nominal capture rate
+    uint32_t frame_count;  // 0 if the recorder didn't exit cleanly
+    uint32_t record_size;  // bytes per frame record, multiple of RECORDING_ALIGN
+};
+
+struct RecordingFrameTrailer {
+    uint64_t timestamp_us;  // since the first frame
+    uint32_t frame_index;
+    uint32_t _reserved;
+};
+
+inline uint32_t recording_record_size(uint32_t stride, uint32_t height) {
+    uint64_t bytes = static_cast<uint64_t>(stride) * height + sizeof(RecordingFrameTrailer);
+    return static_cast<uint32_t>((bytes + RECORDING_ALIGN - 1) / RECORDING_ALIGN * RECORDING_ALIGN);
+}
+
+// Appends raw captured frames to a recording file.
+class FrameRecorder {
+public:
+    FrameRecorder() = default;
+    ~FrameRecorder() { close(); }
+
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    bool open(const std::string &path, int width, int height, int fps);
+    void close();
+
+    // Append one raw (BGRA/BGR) frame; other formats are ignored
+    void write_frame(const FrameBuffer &frame);
+
+private:
+    FILE *file = nullptr;
+    RecordingHeader header = {};
+    std::vector<uint8_t> row_buffer;
+    uint64_t first_timestamp_us = 0;
+};
+
+#endif
@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "rate_control.hpp"
+#include "roi.hpp"
+
+bool Roi::active() const {
+    return (x >= 0 && radius > 0) || (focus.width > 0 && focus.height > 0);
+}
+
+bool Roi::touches(const CaptureRect &r) const {
+    if (focus.width > 0 && focus.height > 0 && r.x < focus.x + focus.width && focus.x < r.x + r.width &&
+        r.y < focus.y + focus.height && focus.y < r.y + r.height) {
+        return true;
+    }
+    if (x < 0 || radius <= 0) {
+        return false;
+    }
+    // Nearest point of the rectangle to the pointer
+    long long nx = x < r.x ? r.x : x >= r.x + r.width ? r.x + r.width - 1 : x;
+    long long ny = y < r.y ? r.y : y >= r.y + r.height ? r.y + r.height - 1 : y;
+    return (nx - x) * (nx - x) + (ny - y) * (ny - y) <= static_cast<long long>(radius) * radius;
+}
+
+int Roi::row_spans(int row, int width, int x0[2], int x1[2]) const {
+    int count = 0;
+    auto add = [&](int a, int b) {
+        a = a < 0 ? 0 : a;
+        b = b > width ? width : b;
+        if (a < b) {
+            x0[count] = a;
+            x1[count] = b;
+            count++;
+        }
+    };
+    if (x >= 0 && radius > 0 && row >= y - radius && row <= y + radius) {
+        int dy = row - y;
+        int half = static_cast<int>(std::sqrt(static_cast<double>(radius) * radius - static_cast<double>(dy) * dy));
+        add(x - half, x + half + 1);
+    }
+    if (focus.width > 0 && row >= focus.y && row < focus.y + focus.height) {
+        add(focus.x, focus.x + focus.width);
+        // Overlapping spans merge, so no pixel counts twice
+        if (count == 2 && x0[1] <= x1[0] && x0[0] <= x1[1]) {
+            x0[0] = x0[0] < x0[1] ? x0[0] : x0[1];
+            x1[0] = x1[0] > x1[1] ? x1[0] : x1[1];
+            count = 1;
+        }
+    }
+    return count;
+}
+
+double Roi::share(int width, int height) const {
+    if (width <= 0 || height <= 0) {
+        return 0;
+    }
+    long long pixels = 0;
+    for (int row = 0; row < height; row++) {
+        int x0[2], x1[2];
+        int n = row_spans(row, width, x0, x1);
+        for (int i = 0; i < n; i++) pixels += x1[i] - x0[i];
+    }
+    return static_cast<double>(pixels) / (static_cast<double>(width) * height);
+}
+
+Roi frame_roi(const FrameBuffer &frame, int radius, bool focus) {
+    Roi roi;
+    if (radius > 0 && frame.cursor_x >= 0 && frame.cursor_x < frame.width && frame.cursor_y >= 0 &&
+        frame.cursor_y < frame.height) {
+        roi.x = frame.cursor_x;
+        roi.y = frame.cursor_y;
+        roi.radius = radius;
+    }
+    if (focus) {
+        roi.focus = frame.focus;
+    }
+    return roi;
+}
+
+static int clamp_quality(int q) {
+    return q < 1 ? 1 : q > 100 ? 100 : q;
+}
+
+RoiQuality roi_quality(int quality, int boost, double share, int min_quality) {
+    quality = clamp_quality(quality);
+    int top = clamp_quality(quality + (boost > 0 ? boost : 0));
+    int floor = min_quality < 1 ? 1 : min_quality > quality ? quality : min_quality;
+    // All periphery has nothing to boost, all region nothing to pay with
+    if (share <= 0 || share >= 1) {
+        return {quality, quality};
+    }
+    double budget = jpeg_size_ratio(quality);
+    for (int inside = top; inside > quality; inside--) {
+        double left = (budget - share * jpeg_size_ratio(inside)) / (1 - share);
+        for (int outside = quality; outside >= floor; outside--) {
+            if (jpeg_size_ratio(outside) <= left) {
+                return {inside, outside};
+            }
+        }
+    }
+    return {quality, quality};
+}
+
+// Size of a JPEG with the periphery smoothed at strength 0, 64, ..., 256
+// over without: the most over the synthetic scenes at q50..q90, from BGRA
+// and I420 (--bench roi). Little goes until the low-pass is nearly whole.
+static const double SMOOTHED_COST[] = {1.0, 0.96, 0.91, 0.83, 0.71};
+
+double roi_smoothed_cost(int strength) {
+    strength = strength < 0 ? 0 : strength > ROI_FULL_STRENGTH ? ROI_FULL_STRENGTH : strength;
+    int i = strength / 64;
+    if (i >= 4) return SMOOTHED_COST[4];
+    double t = (strength - i * 64) / 64.0;
+    return SMOOTHED_COST[i] + (SMOOTHED_COST[i + 1] - SMOOTHED_COST[i]) * t;
+}
+
+RoiSmoothing roi_smoothing(int quality, int boost, double share) {
+    quality = clamp_quality(quality);
+    int top = clamp_quality(quality + (boost > 0 ? boost : 0));
+    if (share <= 0 || share >= 1) {
+        return {quality, 0};
+    }
+    double budget = jpeg_size_ratio(quality);
+    for (int inside = top; inside > quality; inside--) {
+        // What the periphery may cost, relative to it unsmoothed at `inside`
+        double cost = (budget / jpeg_size_ratio(inside) - share) / (1 - share);
+        if (cost < roi_smoothed_cost(ROI_FULL_STRENGTH)) {
+            continue;
+        }
+        int strength = 0;
+        while (roi_smoothed_cost(strength) > cost) strength += 8;
+        return {inside, strength};
+    }
+    return {quality, 0};
+}
+
+// Rows [y0, y1): vertical [1 2 1] into `column`, then horizontal and the
+// blend towards it, then the region's spans copied back over the result
+template <int CH>
+static void smooth_rows(const uint8_t *src, size_t src_stride, int width, int height, const Roi &roi, int strength,
+                        uint8_t *dst, size_t dst_stride, int y0, int y1, std::vector<uint16_t> &column) {
+    int row_bytes = width * CH;
+    column.resize(row_bytes);
+    uint16_t *c = column.data();
+    auto blend = [strength](int pixel, int low) {
+        return static_cast<uint8_t>(pixel + (((low - pixel) * strength + 128) >> 8));
+    };
+    for (int y = y0; y < y1; y++) {
+        const uint8_t *above = src + static_cast<size_t>(y > 0 ? y - 1 : 0) * src_stride;
+        const uint8_t *row = src + static_cast<size_t>(y) * src_stride;
+        const uint8_t *below = src + static_cast<size_t>(y + 1 < height ? y + 1 : y) * src_stride;
+        for (int i = 0; i < row_bytes; i++) {
+            c[i] = static_cast<uint16_t>(above[i] + 2 * row[i] + below[i]);
+        }
+
+        uint8_t *out = dst + static_cast<size_t>(y) * dst_stride;
+        if (width < 2) {
+            for (int i = 0; i < row_bytes; i++) out[i] = blend(row[i], (c[i] + 2) >> 2);
+        } else {
+            for (int i = 0; i < CH; i++) {
+                out[i] = blend(row[i], (3 * c[i] + c[i + CH] + 8) >> 4);
+                int last = row_bytes - CH + i;
+                out[last] = blend(row[last], (c[last - CH] + 3 * c[last] + 8) >> 4);
+            }
+            for (int i = CH; i < row_bytes - CH; i++) {
+                out[i] = blend(row[i], (c[i - CH] + 2 * c[i] + c[i + CH] + 8) >> 4);
+            }
+        }
+
+        int x0[2], x1[2];
+        int spans = roi.row_spans(y, width, x0, x1);
+        for (int s = 0; s < spans; s++) {
+            std::copy(row + x0[s] * CH, row + x1[s] * CH, out + x0[s] * CH);
+        }
+    }
+}
+
+void roi_smooth(const uint8_t *src, size_t src_stride, int width, int height, int channels, const Roi &roi,
+                int strength, uint8_t *dst, size_t dst_stride, ThreadPool *pool) {
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    int count = pool ? pool->size() : 1;
+    count = count > height ? height : count;
+    auto band = [&](int i) {
+        std::vector<uint16_t> column;
+        int y0 = height * i / count, y1 = height * (i + 1) / count;
+        switch (channels) {
+        case 1: smooth_rows<1>(src, src_stride, width, height, roi, strength, dst, dst_stride, y0, y1, column); break;
+        case 3: smooth_rows<3>(src, src_stride, width, height, roi, strength, dst, dst_stride, y0, y1, column); break;
+        default: smooth_rows<4>(src, src_stride, width, height, roi, strength, dst, dst_stride, y0, y1, column); break;
+        }
+    };
+    if (count > 1) {
+        pool->parallel_for(count, band);
+    } else {
+        band(0);
+    }
+}
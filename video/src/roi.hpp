@@ -0,0 +1,78 @@
+#ifndef ROI_HPP
+#define ROI_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "frame.hpp"
+#include "thread_pool.hpp"
+
+// Region of interest of one frame: a circle around the pointer and,
+// optionally, the focused window. What is under the pointer is what gets
+// looked at, so encoders spend bytes there first (encoding.roi).
+//
+// The frame's total stays what it would have been without: the quality
+// split is chosen so that, with JPEG size modeled by jpeg_size_ratio()
+// (rate_control.hpp), the region's extra bytes are taken back from the
+// periphery. Under rate control the controller's quality is the one kept
+// neutral, so the bitrate target holds as before.
+struct Roi {
+    int x = -1;  // pointer, x < 0: none
+    int y = -1;
+    int radius = 0;
+    CaptureRect focus = {0, 0, 0, 0};  // empty: none
+
+    bool active() const;
+
+    // Whether any pixel of `r` is in the region
+    bool touches(const CaptureRect &r) const;
+
+    // Up to two spans [x0, x1) of row `row` in the region, clipped to
+    // [0, width); returns how many
+    int row_spans(int row, int width, int x0[2], int x1[2]) const;
+
+    // Share of a width x height frame's pixels in the region
+    double share(int width, int height) const;
+};
+
+// The region of `frame` from its pointer and focus metadata. Inactive when
+// radius is 0 and focus is off, or the backend reported neither.
+Roi frame_roi(const FrameBuffer &frame, int radius, bool focus);
+
+// Per-region JPEG quality for coders that can vary it (tile runs)
+struct RoiQuality {
+    int inside;
+    int outside;
+};
+
+// Inside as close to quality + boost as the budget allows, outside as high
+// as keeps share * size(inside) + (1 - share) * size(outside) within
+// size(quality), not below min_quality. A region too large to pay for gets
+// less of the boost.
+RoiQuality roi_quality(int quality, int boost, double share, int min_quality);
+
+// Single-quality JPEG (the frame path): quality for the whole frame and
+// how strongly roi_smooth() low-passes the periphery to pay for it
+struct RoiSmoothing {
+    int quality;
+    int strength;  // 0 (none) .. ROI_FULL_STRENGTH
+};
+
+constexpr int ROI_FULL_STRENGTH = 256;
+
+// Size of a JPEG whose periphery went through roi_smooth() at `strength`
+// over the same frame unsmoothed, at the same quality
+double roi_smoothed_cost(int strength);
+
+// The highest quality up to quality + boost whose extra bytes the
+// periphery can pay for by smoothing, and the least strength that does
+RoiSmoothing roi_smoothing(int quality, int boost, double share);
+
+// Copy `height` rows of interleaved `channels`-byte pixels from src to dst,
+// moving everything outside the region `strength` / ROI_FULL_STRENGTH of
+// the way to its [1 2 1] low-pass (both ways). The periphery loses the
+// detail JPEG spends most of its bytes on; the region is copied as is.
+// With a ThreadPool the rows are split into one band per thread.
+void roi_smooth(const uint8_t *src, size_t src_stride, int width, int height, int channels, const Roi &roi,
+                int strength, uint8_t *dst, size_t dst_stride, ThreadPool *pool = nullptr);
+
+#endif
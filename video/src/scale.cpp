@@ -0,0 +1,469 @@
+#include <cmath>
+#include <cstring>
+#include "scale.hpp"
+#include "simd.hpp"
+
+// Weights are 2.14 fixed point: products of a byte and a weight, summed
+// over every tap, stay well inside 32 bits
+constexpr int WEIGHT_BITS = 14;
+constexpr int WEIGHT_ONE = 1 << WEIGHT_BITS;
+constexpr int32_t WEIGHT_ROUND = 1 << (WEIGHT_BITS - 1);
+
+// Smallest output side; below it a tap window could cover the whole source
+constexpr int MIN_OUTPUT = 16;
+
+constexpr double PI = 3.14159265358979323846;
+
+bool parse_scale_filter(const std::string &name, ScaleFilter &out) {
+    if (name == "box") out = ScaleFilter::BOX;
+    else if (name == "bilinear") out = ScaleFilter::BILINEAR;
+    else if (name == "lanczos") out = ScaleFilter::LANCZOS;
+    else return false;
+    return true;
+}
+
+const char* scale_filter_name(ScaleFilter filter) {
+    switch (filter) {
+        case ScaleFilter::BOX: return "box";
+        case ScaleFilter::BILINEAR: return "bilinear";
+        case ScaleFilter::LANCZOS: return "lanczos";
+    }
+    return "?";
+}
+
+bool fit_output_size(int src_w, int src_h, int max_w, int max_h, int &out_w, int &out_h) {
+    out_w = src_w;
+    out_h = src_h;
+    if (max_w <= 0 || max_h <= 0 || (max_w >= src_w && max_h >= src_h)) {
+        return false;
+    }
+    // Scale by the tighter of the two ratios
+    long long w = max_w, h = max_h;
+    if (static_cast<long long>(max_w) * src_h < static_cast<long long>(max_h) * src_w) {
+        h = static_cast<long long>(max_w) * src_h / src_w;
+    } else {
+        w = static_cast<long long>(max_h) * src_w / src_h;
+    }
+    w &= ~1LL;
+    h &= ~1LL;
+    if (w < MIN_OUTPUT || h < MIN_OUTPUT) {
+        return false;
+    }
+    out_w = static_cast<int>(w);
+    out_h = static_cast<int>(h);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Filters, as functions of the distance in output pixels
+// ---------------------------------------------------------------------------
+struct FilterShape {
+    double support;  // weight is zero beyond this distance
+    double (*weight)(double);
+};
+
+static double box_weight(double x) {
+    return x > -0.5 && x <= 0.5 ? 1.0 : 0.0;
+}
+
+static double bilinear_weight(double x) {
+    x = std::fabs(x);
+    return x < 1.0 ? 1.0 - x : 0.0;
+}
+
+static double sinc(double x) {
+    if (x == 0.0) {
+        return 1.0;
+    }
+    x *= PI;
+    return std::sin(x) / x;
+}
+
+static double lanczos_weight(double x) {
+    return std::fabs(x) < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+}
+
+static FilterShape shape_of(ScaleFilter filter) {
+    switch (filter) {
+        case ScaleFilter::BOX: return {0.5, box_weight};
+        case ScaleFilter::BILINEAR: return {1.0, bilinear_weight};
+        case ScaleFilter::LANCZOS: return {3.0, lanczos_weight};
+    }
+    return {1.0, bilinear_weight};
+}
+
+// ---------------------------------------------------------------------------
+// Kernels
+// ---------------------------------------------------------------------------
+
+// dst[i] = sum over k of weights[k] * rows[k][i], for i < bytes. `taps` is even.
+typedef void (*VerticalFn)(const uint8_t *const *rows, const int16_t *weights, int taps, size_t bytes,
+                           uint8_t *dst);
+
+// dst pixel x = sum over k of weights[x * taps + k] * src pixel (start[x] + k),
+// per channel, for x < width. `taps` is even.
+typedef void (*HorizontalFn)(const uint8_t *src, const int *start, const int16_t *weights, int taps,
+                             int width, int bpp, uint8_t *dst);
+
+static inline uint8_t clamp_byte(int32_t acc) {
+    acc = (acc + WEIGHT_ROUND) >> WEIGHT_BITS;
+    return static_cast<uint8_t>(acc < 0 ? 0 : acc > 255 ? 255 : acc);
+}
+
+static void vertical_range(const uint8_t *const *rows, const int16_t *weights, int taps, size_t from,
+                           size_t bytes, uint8_t *dst) {
+    for (size_t i = from; i < bytes; i++) {
+        int32_t acc = 0;
+        for (int k = 0; k < taps; k++) {
+            acc += weights[k] * rows[k][i];
+        }
+        dst[i] = clamp_byte(acc);
+    }
+}
+
+static void vertical_scalar(const uint8_t *const *rows, const int16_t *weights, int taps, size_t bytes,
+                            uint8_t *dst) {
+    vertical_range(rows, weights, taps, 0, bytes, dst);
+}
+
+static void horizontal_scalar(const uint8_t *src, const int *start, const int16_t *weights, int taps,
+                              int width, int bpp, uint8_t *dst) {
+    for (int x = 0; x < width; x++, weights += taps, dst += bpp) {
+        const uint8_t *p = src + static_cast<size_t>(start[x]) * bpp;
+        for (int c = 0; c < bpp; c++) {
+            int32_t acc = 0;
+            for (int k = 0; k < taps; k++) {
+                acc += weights[k] * p[k * bpp + c];
+            }
+            dst[c] = clamp_byte(acc);
+        }
+    }
+}
+
+// Two adjacent 16-bit weights as one 32-bit lane, for multiply-add pairs
+static inline int32_t weight_pair(const int16_t *w) {
+    int32_t pair;
+    memcpy(&pair, w, sizeof(pair));
+    return pair;
+}
+
+#ifdef SIMD_X86
+// Two taps per step: bytes of both rows widened and interleaved, so one
+// madd gives a * w0 + b * w1 per byte position
+static void vertical_sse2(const uint8_t *const *rows, const int16_t *weights, int taps, size_t bytes,
+                          uint8_t *dst) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(WEIGHT_ROUND);
+    size_t i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i acc0 = round, acc1 = round, acc2 = round, acc3 = round;
+        for (int k = 0; k < taps; k += 2) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[k] + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[k + 1] + i));
+            __m128i w = _mm_set1_epi32(weight_pair(weights + k));
+            __m128i alo = _mm_unpacklo_epi8(a, zero), ahi = _mm_unpackhi_epi8(a, zero);
+            __m128i blo = _mm_unpacklo_epi8(b, zero), bhi = _mm_unpackhi_epi8(b, zero);
+            acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi16(alo, blo), w));
+            acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi16(alo, blo), w));
+            acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi16(ahi, bhi), w));
+            acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi16(ahi, bhi), w));
+        }
+        __m128i lo = _mm_packs_epi32(_mm_srai_epi32(acc0, WEIGHT_BITS), _mm_srai_epi32(acc1, WEIGHT_BITS));
+        __m128i hi = _mm_packs_epi32(_mm_srai_epi32(acc2, WEIGHT_BITS), _mm_srai_epi32(acc3, WEIGHT_BITS));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    vertical_range(rows, weights, taps, i, bytes, dst);
+}
+
+// One BGRA output pixel per step, channels in the four lanes; two taps per
+// madd, the pixels' channels interleaved
+static void horizontal_sse2(const uint8_t *src, const int *start, const int16_t *weights, int taps,
+                            int width, int bpp, uint8_t *dst) {
+    if (bpp != 4) {
+        horizontal_scalar(src, start, weights, taps, width, bpp, dst);
+        return;
+    }
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(WEIGHT_ROUND);
+    for (int x = 0; x < width; x++, weights += taps, dst += 4) {
+        const uint8_t *p = src + static_cast<size_t>(start[x]) * 4;
+        __m128i acc = round;
+        for (int k = 0; k < taps; k += 2) {
+            __m128i px = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p + k * 4)), zero);
+            __m128i pair = _mm_unpacklo_epi16(px, _mm_srli_si128(px, 8));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(pair, _mm_set1_epi32(weight_pair(weights + k))));
+        }
+        acc = _mm_srai_epi32(acc, WEIGHT_BITS);
+        int32_t out = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(acc, acc), zero));
+        memcpy(dst, &out, sizeof(out));
+    }
+}
+
+// Same as sse2 on 32 bytes; unpack and pack both work within 128-bit lanes,
+// so bytes come back in order
+SIMD_TARGET("avx2")
+static void vertical_avx2(const uint8_t *const *rows, const int16_t *weights, int taps, size_t bytes,
+                          uint8_t *dst) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i round = _mm256_set1_epi32(WEIGHT_ROUND);
+    size_t i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        __m256i acc0 = round, acc1 = round, acc2 = round, acc3 = round;
+        for (int k = 0; k < taps; k += 2) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows[k] + i));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows[k + 1] + i));
+            __m256i w = _mm256_set1_epi32(weight_pair(weights + k));
+            __m256i alo = _mm256_unpacklo_epi8(a, zero), ahi = _mm256_unpackhi_epi8(a, zero);
+            __m256i blo = _mm256_unpacklo_epi8(b, zero), bhi = _mm256_unpackhi_epi8(b, zero);
+            acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_unpacklo_epi16(alo, blo), w));
+            acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(_mm256_unpackhi_epi16(alo, blo), w));
+            acc2 = _mm256_add_epi32(acc2, _mm256_madd_epi16(_mm256_unpacklo_epi16(ahi, bhi), w));
+            acc3 = _mm256_add_epi32(acc3, _mm256_madd_epi16(_mm256_unpackhi_epi16(ahi, bhi), w));
+        }
+        __m256i lo = _mm256_packs_epi32(_mm256_srai_epi32(acc0, WEIGHT_BITS), _mm256_srai_epi32(acc1, WEIGHT_BITS));
+        __m256i hi = _mm256_packs_epi32(_mm256_srai_epi32(acc2, WEIGHT_BITS), _mm256_srai_epi32(acc3, WEIGHT_BITS));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_packus_epi16(lo, hi));
+    }
+    vertical_range(rows, weights, taps, i, bytes, dst);
+}
+
+// Two output pixels per step, one per 128-bit lane
+SIMD_TARGET("avx2")
+static void horizontal_avx2(const uint8_t *src, const int *start, const int16_t *weights, int taps,
+                            int width, int bpp, uint8_t *dst) {
+    if (bpp != 4) {
+        horizontal_scalar(src, start, weights, taps, width, bpp, dst);
+        return;
+    }
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i round = _mm256_set1_epi32(WEIGHT_ROUND);
+    int x = 0;
+    for (; x + 2 <= width; x += 2, weights += 2 * taps, dst += 8) {
+        const uint8_t *p0 = src + static_cast<size_t>(start[x]) * 4;
+        const uint8_t *p1 = src + static_cast<size_t>(start[x + 1]) * 4;
+        const int16_t *w1 = weights + taps;
+        __m256i acc = round;
+        for (int k = 0; k < taps; k += 2) {
+            __m256i px = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p0 + k * 4))),
+                _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p1 + k * 4)), 1);
+            px = _mm256_unpacklo_epi8(px, zero);
+            __m256i pair = _mm256_unpacklo_epi16(px, _mm256_srli_si256(px, 8));
+            __m256i w = _mm256_setr_epi32(weight_pair(weights + k), weight_pair(weights + k),
+                                          weight_pair(weights + k), weight_pair(weights + k),
+                                          weight_pair(w1 + k), weight_pair(w1 + k),
+                                          weight_pair(w1 + k), weight_pair(w1 + k));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(pair, w));
+        }
+        acc = _mm256_srai_epi32(acc, WEIGHT_BITS);
+        __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(acc, acc), zero);
+        int32_t out0 = _mm256_extract_epi32(packed, 0);
+        int32_t out1 = _mm256_extract_epi32(packed, 4);
+        memcpy(dst, &out0, sizeof(out0));
+        memcpy(dst + 4, &out1, sizeof(out1));
+    }
+    if (x < width) {
+        horizontal_sse2(src, start + x, weights, taps, width - x, 4, dst);
+    }
+}
+#endif // SIMD_X86
+
+#ifdef SIMD_NEON
+static void vertical_neon(const uint8_t *const *rows, const int16_t *weights, int taps, size_t bytes,
+                          uint8_t *dst) {
+    size_t i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        int32x4_t acc0 = vdupq_n_s32(0), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+        for (int k = 0; k < taps; k++) {
+            uint8x16_t v = vld1q_u8(rows[k] + i);
+            int16x8_t lo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(v)));
+            int16x8_t hi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(v)));
+            acc0 = vmlal_n_s16(acc0, vget_low_s16(lo), weights[k]);
+            acc1 = vmlal_n_s16(acc1, vget_high_s16(lo), weights[k]);
+            acc2 = vmlal_n_s16(acc2, vget_low_s16(hi), weights[k]);
+            acc3 = vmlal_n_s16(acc3, vget_high_s16(hi), weights[k]);
+        }
+        // Rounding shift with unsigned saturation, then down to bytes
+        uint16x8_t lo = vcombine_u16(vqrshrun_n_s32(acc0, WEIGHT_BITS), vqrshrun_n_s32(acc1, WEIGHT_BITS));
+        uint16x8_t hi = vcombine_u16(vqrshrun_n_s32(acc2, WEIGHT_BITS), vqrshrun_n_s32(acc3, WEIGHT_BITS));
+        vst1q_u8(dst + i, vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi)));
+    }
+    vertical_range(rows, weights, taps, i, bytes, dst);
+}
+
+static void horizontal_neon(const uint8_t *src, const int *start, const int16_t *weights, int taps,
+                            int width, int bpp, uint8_t *dst) {
+    if (bpp != 4) {
+        horizontal_scalar(src, start, weights, taps, width, bpp, dst);
+        return;
+    }
+    for (int x = 0; x < width; x++, weights += taps, dst += 4) {
+        const uint8_t *p = src + static_cast<size_t>(start[x]) * 4;
+        int32x4_t acc = vdupq_n_s32(0);
+        for (int k = 0; k < taps; k++) {
+            uint32_t px;
+            memcpy(&px, p + k * 4, sizeof(px));
+            uint8x8_t v = vreinterpret_u8_u32(vdup_n_u32(px));
+            acc = vmlal_n_s16(acc, vget_low_s16(vreinterpretq_s16_u16(vmovl_u8(v))), weights[k]);
+        }
+        uint16x4_t s = vqrshrun_n_s32(acc, WEIGHT_BITS);
+        vst1_lane_u32(reinterpret_cast<uint32_t *>(dst), vreinterpret_u32_u8(vqmovn_u16(vcombine_u16(s, s))), 0);
+    }
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Runtime dispatch
+// ---------------------------------------------------------------------------
+struct Kernel {
+    const char *name;
+    VerticalFn vertical;
+    HorizontalFn horizontal;
+};
+
+// Best first
+static const Kernel KERNELS[] = {
+#ifdef SIMD_X86
+    {"avx2", vertical_avx2, horizontal_avx2},
+    {"sse2", vertical_sse2, horizontal_sse2},
+#endif
+#ifdef SIMD_NEON
+    {"neon", vertical_neon, horizontal_neon},
+#endif
+    {"scalar", vertical_scalar, horizontal_scalar},
+};
+
+static KernelTable kernel_table(KERNELS);
+
+const char* scale_kernel() {
+    return kernel_table.name();
+}
+
+std::vector<const char*> scale_kernels() {
+    return kernel_table.usable();
+}
+
+bool scale_select(const char *name) {
+    return kernel_table.select(name);
+}
+
+// ---------------------------------------------------------------------------
+// Scaler
+// ---------------------------------------------------------------------------
+
+// Weights of the filter stretched over `ratio` source pixels per output
+// pixel, each output's window shifted to lie inside the source and padded
+// with zeros to a common, even tap count
+void Scaler::make_taps(int src, int dst, ScaleFilter filter, Taps &out) {
+    FilterShape shape = shape_of(filter);
+    double ratio = static_cast<double>(src) / dst;
+    double support = shape.support * ratio;
+
+    std::vector<int> first(dst);
+    std::vector<std::vector<double>> real(dst);
+    int taps = 0;
+    for (int i = 0; i < dst; i++) {
+        double center = (i + 0.5) * ratio;
+        int lo = static_cast<int>(center - support + 0.5);
+        int hi = static_cast<int>(center + support + 0.5);
+        if (lo < 0) lo = 0;
+        if (hi > src) hi = src;
+
+        double sum = 0.0;
+        for (int s = lo; s < hi; s++) {
+            double w = shape.weight((s + 0.5 - center) / ratio);
+            real[i].push_back(w);
+            sum += w;
+        }
+        for (double &w : real[i]) {
+            w = sum != 0.0 ? w / sum : 0.0;
+        }
+        first[i] = lo;
+        if (hi - lo > taps) taps = hi - lo;
+    }
+    taps = (taps + 1) & ~1;
+
+    out.taps = taps;
+    out.start.assign(dst, 0);
+    out.weights.assign(static_cast<size_t>(dst) * taps, 0);
+    for (int i = 0; i < dst; i++) {
+        int start = first[i];
+        int shift = start + taps > src ? start + taps - src : 0;
+        start -= shift;
+        out.start[i] = start;
+
+        // Round to fixed point, then put the rounding error on the largest
+        // weight so every output sums to exactly one
+        int16_t *w = &out.weights[static_cast<size_t>(i) * taps + shift];
+        int sum = 0, largest = 0;
+        for (size_t k = 0; k < real[i].size(); k++) {
+            w[k] = static_cast<int16_t>(std::lround(real[i][k] * WEIGHT_ONE));
+            sum += w[k];
+            if (w[k] > w[largest]) largest = static_cast<int>(k);
+        }
+        w[largest] = static_cast<int16_t>(w[largest] + WEIGHT_ONE - sum);
+    }
+}
+
+bool Scaler::init(int sw, int sh, int dw, int dh, ScaleFilter filter) {
+    if (dw < MIN_OUTPUT || dh < MIN_OUTPUT || dw > sw || dh > sh) {
+        return false;
+    }
+    src_w = sw;
+    src_h = sh;
+    dst_w = dw;
+    dst_h = dh;
+    reach = static_cast<int>(std::ceil(shape_of(filter).support)) + 1;
+    make_taps(sw, dw, filter, horizontal);
+    make_taps(sh, dh, filter, vertical);
+    bands.clear();
+    return true;
+}
+
+void Scaler::scale(const uint8_t *src, size_t src_stride, int bpp, uint8_t *dst, size_t dst_stride,
+                   ThreadPool *pool) {
+    int count = pool ? pool->size() : 1;
+    if (static_cast<int>(bands.size()) < count) {
+        bands.resize(count);
+        for (auto &b : bands) {
+            b.rows.resize(vertical.taps);
+            b.column.resize(static_cast<size_t>(src_w) * 4);
+        }
+    }
+    auto band = [&](int i) {
+        scale_rows(src, src_stride, bpp, dst, dst_stride, dst_h * i / count, dst_h * (i + 1) / count, bands[i]);
+    };
+    if (count > 1) {
+        pool->parallel_for(count, band);
+    } else {
+        band(0);
+    }
+}
+
+void Scaler::scale_rows(const uint8_t *src, size_t src_stride, int bpp, uint8_t *dst, size_t dst_stride,
+                        int y0, int y1, Scratch &scratch) {
+    const Kernel *k = &kernel_table.active();
+    size_t row_bytes = static_cast<size_t>(src_w) * bpp;
+    for (int y = y0; y < y1; y++) {
+        const uint8_t *base = src + static_cast<size_t>(vertical.start[y]) * src_stride;
+        for (int t = 0; t < vertical.taps; t++) {
+            scratch.rows[t] = base + static_cast<size_t>(t) * src_stride;
+        }
+        k->vertical(scratch.rows.data(), &vertical.weights[static_cast<size_t>(y) * vertical.taps], vertical.taps,
+                    row_bytes, scratch.column.data());
+        k->horizontal(scratch.column.data(), horizontal.start.data(), horizontal.weights.data(), horizontal.taps,
+                      dst_w, bpp, dst + static_cast<size_t>(y) * dst_stride);
+    }
+}
+
+CaptureRect Scaler::map_rect(const CaptureRect &r) const {
+    long long x0 = static_cast<long long>(r.x) * dst_w / src_w - reach;
+    long long y0 = static_cast<long long>(r.y) * dst_h / src_h - reach;
+    long long x1 = (static_cast<long long>(r.x + r.width) * dst_w + src_w - 1) / src_w + reach;
+    long long y1 = (static_cast<long long>(r.y + r.height) * dst_h + src_h - 1) / src_h + reach;
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > dst_w) x1 = dst_w;
+    if (y1 > dst_h) y1 = dst_h;
+    return {static_cast<int>(x0), static_cast<int>(y0), static_cast<int>(x1 - x0), static_cast<int>(y1 - y0)};
+}
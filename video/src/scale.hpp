@@ -0,0 +1,91 @@
+#ifndef SCALE_HPP
+#define SCALE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "frame.hpp"
+#include "thread_pool.hpp"
+
+// Resampling filter for downscaling, cheapest first
+enum class ScaleFilter {
+    BOX,       // area average, the right choice for integer ratios
+    BILINEAR,  // triangle, widened to the scale ratio
+    LANCZOS,   // 3-lobe Lanczos, sharpest text
+};
+
+// "box", "bilinear" or "lanczos"
+bool parse_scale_filter(const std::string &name, ScaleFilter &out);
+const char* scale_filter_name(ScaleFilter filter);
+
+// Largest size within max_w x max_h with the aspect ratio of the source,
+// rounded down to even (4:2:0 codecs need it). Returns false, leaving the
+// source size, if that is not smaller than the source (no upscaling) or
+// max_w / max_h is 0 (keep native size).
+bool fit_output_size(int src_w, int src_h, int max_w, int max_h, int &out_w, int &out_h);
+
+// Separable downscaler for raw frames (BGRA or BGR, output in the same
+// format as the input). Filter weights are computed once per geometry, as
+// 2.14 fixed point, each output pixel reading a fixed number of taps
+// (zero-padded).
+// Every output row is a vertical pass over the source rows it depends on
+// into one intermediate row, then a horizontal pass over that row, so the
+// intermediate never leaves L1/L2 and the source is read once.
+//
+// Both passes are vectorized with the widest SIMD the CPU supports, picked
+// once at runtime; every kernel gives the same bytes. With a ThreadPool the
+// output rows are split into one band per thread.
+class Scaler {
+public:
+    // False for an unsupported geometry (upscaling, output under 16 px)
+    bool init(int src_w, int src_h, int dst_w, int dst_h, ScaleFilter filter);
+
+    void scale(const uint8_t *src, size_t src_stride, int bytes_per_pixel, uint8_t *dst, size_t dst_stride,
+               ThreadPool *pool = nullptr);
+
+    // Output pixels affected by a change to `r` (source pixels)
+    CaptureRect map_rect(const CaptureRect &r) const;
+
+    int src_width() const { return src_w; }
+    int src_height() const { return src_h; }
+    int width() const { return dst_w; }
+    int height() const { return dst_h; }
+
+    // Source pixels read per output pixel, horizontally and vertically
+    int horizontal_taps() const { return horizontal.taps; }
+    int vertical_taps() const { return vertical.taps; }
+
+private:
+    // Per output position: first source position read and `taps` weights
+    struct Taps {
+        int taps = 0;
+        std::vector<int> start;
+        std::vector<int16_t> weights;
+    };
+    // Per band: the tap rows of the current output row and the vertical
+    // pass output, one source row
+    struct Scratch {
+        std::vector<const uint8_t *> rows;
+        std::vector<uint8_t> column;
+    };
+    static void make_taps(int src, int dst, ScaleFilter filter, Taps &out);
+    void scale_rows(const uint8_t *src, size_t src_stride, int bpp, uint8_t *dst, size_t dst_stride,
+                    int y0, int y1, Scratch &scratch);
+
+    int src_w = 0, src_h = 0, dst_w = 0, dst_h = 0;
+    int reach = 0;  // output pixels a source pixel can affect on each side
+    Taps horizontal, vertical;
+    std::vector<Scratch> bands;
+};
+
+// Name of the kernel Scaler uses ("avx2", "sse2", "neon", "scalar")
+const char* scale_kernel();
+
+// Kernels usable on this CPU, best first
+std::vector<const char*> scale_kernels();
+
+// Force a kernel by name (benchmarks). Returns false if not usable here.
+bool scale_select(const char *name);
+
+#endif
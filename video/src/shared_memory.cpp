@@ -1,10 +1,47 @@
+#include <atomic>
 #include <cstdio>
 #include <cstring>
+#include "frame_message.hpp"
 #include "shared_memory.hpp"
 
+#if defined(_WIN32) || defined(__linux__)
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+void SharedMemory::init_header() {
+    buffer->magic = MAGIC_NUMBER;
+    buffer->sequence = 0;
+    buffer->frame_size = 0;
+    buffer->layout = FRAME_LAYOUT_JPEG;
+    buffer->unchanged = 0;
+    buffer->keyframe = 0;
+    buffer->codec_config_size[0] = 0;
+    buffer->codec_config_size[1] = 0;
+    buffer->subsampling = 0xFF;
+    buffer->frame_slot = 0;
+    // Spelled out: windows.h defines min/max macros
+    int slot_size = size > HEADER_SIZE ? (size - HEADER_SIZE) / slots : 0;
+    buffer->slot_size = static_cast<uint32_t>(slots > 1 && slot_size > DEFAULT_FRAME_SIZE ? DEFAULT_FRAME_SIZE : slot_size);
+    buffer->join_sequence = 0;
+    buffer->refresh_request = 0;
+    buffer->partial_sequence = 0;
+    buffer->partial_size = 0;
+    buffer->copy_count = 0;
+    buffer->copy_dx = 0;
+    buffer->copy_dy = 0;
+    buffer->state = SHM_STATE_RUNNING;
+    buffer->error_code = SHM_ERR_NONE;
+}
+
 #ifdef _WIN32
 
-SharedMemory::SharedMemory(const std::string &name, int size) : size(size), name(name) {
+SharedMemory::SharedMemory(const std::string &name, int size, int slots)
+    : size(size), slots(slots), name(name) {
     if (name.empty() || size <= 0) {
         return;
     }
@@ -41,12 +78,7 @@ SharedMemory::SharedMemory(const std::string &name, int size) : size(size), name
 
     buffer = static_cast<SharedFrameBuffer *>(buf);
 
-    // Initialize header
-    buffer->magic = MAGIC_NUMBER;
-    buffer->sequence = 0;
-    buffer->frame_size = 0;
-    buffer->state = SHM_STATE_RUNNING;
-    buffer->error_code = SHM_ERR_NONE;
+    init_header();
 
     printf("[SHM] Created: %s (%d bytes)\n", name.c_str(), size);
 }
@@ -65,21 +97,122 @@ SharedMemory::~SharedMemory() {
     printf("[SHM] Closed\n");
 }
 
+#else // __linux__
+
+SharedMemory::SharedMemory(const std::string &name, int size, int slots)
+    : size(size), slots(slots), name(name) {
+    if (name.empty() || size <= 0) {
+        return;
+    }
+
+    // POSIX shm names must start with a single slash
+    std::string shm_path = name[0] == '/' ? name : "/" + name;
+
+    fd = shm_open(shm_path.c_str(), O_CREAT | O_RDWR, 0600);
+    if (fd < 0) {
+        perror("[SHM] shm_open");
+        return;
+    }
+
+    if (ftruncate(fd, size) != 0) {
+        perror("[SHM] ftruncate");
+        close(fd);
+        fd = -1;
+        return;
+    }
+
+    void *buf = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (buf == MAP_FAILED) {
+        perror("[SHM] mmap");
+        close(fd);
+        fd = -1;
+        return;
+    }
+
+    buffer = static_cast<SharedFrameBuffer *>(buf);
+
+    init_header();
+
+    printf("[SHM] Created: %s (%d bytes)\n", shm_path.c_str(), size);
+}
+
+SharedMemory::~SharedMemory() {
+    if (buffer) {
+        munmap(buffer, size);
+        buffer = nullptr;
+    }
+
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+        shm_unlink((name[0] == '/' ? name : "/" + name).c_str());
+    }
+
+    printf("[SHM] Closed\n");
+}
+
+#endif // _WIN32
+
+static float now_seconds() {
+#ifdef _WIN32
+    return static_cast<float>(GetTickCount()) / 1000.0f;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<float>(ts.tv_sec) + ts.tv_nsec / 1e9f;
+#endif
+}
+
 int SharedMemory::write_frame(const uint8_t *frame_data, uint32_t size,
                                uint32_t width, uint32_t height, uint32_t fps, uint32_t quality,
-                               uint32_t monitor) {
+                               uint32_t monitor, uint8_t layout, bool keyframe, const SharedFrameInfo &info) {
     if (!buffer || !frame_data || size == 0) {
         return -1;
     }
 
     // Validate frame size
-    if (size > DEFAULT_FRAME_SIZE) {
-        printf("[SHM] Frame too large: %u bytes (max %u)\n", size, DEFAULT_FRAME_SIZE);
+    if (size > buffer->slot_size) {
+        printf("[SHM] Frame too large: %u bytes (max %u)\n", size, buffer->slot_size);
         return -1;
     }
 
-    // Copy frame data
-    memcpy(buffer->frame_data, frame_data, size);
+    // Copy frame data into the slot readers aren't using
+    memcpy(free_slot(), frame_data, size);
+
+    return commit_frame(size, width, height, fps, quality, monitor, layout, keyframe, info);
+}
+
+int SharedMemory::write_slice(const uint8_t *data, uint32_t offset, uint32_t size) {
+    if (!buffer || static_cast<uint64_t>(offset) + size > buffer->slot_size) {
+        return -1;
+    }
+
+    memcpy(free_slot() + offset, data, size);
+    // The bytes before the size that covers them
+    std::atomic_thread_fence(std::memory_order_release);
+    buffer->partial_sequence = buffer->sequence + 1;
+    buffer->partial_size = offset + size;
+    return 0;
+}
+
+int SharedMemory::commit_frame(uint32_t size, uint32_t width, uint32_t height, uint32_t fps, uint32_t quality,
+                               uint32_t monitor, uint8_t layout, bool keyframe, const SharedFrameInfo &info) {
+    if (!buffer || size == 0 || size > buffer->slot_size) {
+        return -1;
+    }
+
+    // Decoder setup goes with the slot, like the payload: the current
+    // frame's copy stays intact while readers may still be using it
+    uint8_t slot = buffer->frame_slot ^ 1;
+    size_t config_size = info.codec_config_size;
+    if (config_size > SHM_CODEC_CONFIG_SIZE) {
+        printf("[SHM] Codec config too large: %zu bytes (max %d)\n", config_size, SHM_CODEC_CONFIG_SIZE);
+        config_size = 0;
+    }
+    if (config_size > 0) {
+        memcpy(buffer->codec_config[slot], info.codec_config, config_size);
+    }
+    buffer->codec_config_size[slot] = static_cast<uint8_t>(config_size);
 
     // Update header (atomic-ish, increment sequence last)
     buffer->frame_size = size;
@@ -88,9 +221,71 @@ int SharedMemory::write_frame(const uint8_t *frame_data, uint32_t size,
     buffer->fps = fps;
     buffer->quality = quality;
     buffer->monitor = monitor;
-    buffer->timestamp = static_cast<float>(GetTickCount()) / 1000.0f;
+    buffer->layout = layout;
+    buffer->unchanged = 0;
+    buffer->keyframe = keyframe ? 1 : 0;
+    buffer->subsampling = info.subsampling < 0 ? 0xFF : static_cast<uint8_t>(info.subsampling);
+    buffer->copy_count = static_cast<uint16_t>(info.copy_count);
+    buffer->copy_dx = static_cast<int16_t>(info.copy_dx);
+    buffer->copy_dy = static_cast<int16_t>(info.copy_dy);
+    buffer->frame_slot = slot;
+    buffer->partial_size = 0;
+    buffer->timestamp = now_seconds();
+
+    // Increment sequence to signal new frame, after everything it covers
+    std::atomic_thread_fence(std::memory_order_release);
+    buffer->sequence++;
+
+    return 0;
+}
+
+void SharedMemory::abort_frame() {
+    if (!buffer) {
+        return;
+    }
+    // The slices went to the free slot, so nothing readers see changes
+    buffer->partial_sequence = 0;
+    buffer->partial_size = 0;
+}
 
-    // Increment sequence to signal new frame
+void SharedMemory::set_layer(int layer, int count) {
+    if (!buffer) {
+        return;
+    }
+    buffer->layer = static_cast<uint8_t>(layer);
+    buffer->layer_count = static_cast<uint8_t>(count);
+}
+
+int SharedMemory::mark_unchanged() {
+    if (!buffer || buffer->frame_size == 0) {
+        return -1;
+    }
+
+    // Payload, size and layout stay as they are
+    buffer->unchanged = 1;
+    buffer->timestamp = now_seconds();
+    std::atomic_thread_fence(std::memory_order_release);
+    buffer->sequence++;
+
+    return 0;
+}
+
+int SharedMemory::write_run(const uint8_t *data, uint32_t offset, uint32_t size, uint32_t covers) {
+    if (!buffer || static_cast<uint64_t>(offset) + size > buffer->slot_size) {
+        return -1;
+    }
+
+    // Odd while readers would see a mix of old and new
+    buffer->sequence++;
+    std::atomic_thread_fence(std::memory_order_release);
+    if (size > 0) {
+        memcpy(slot(0) + offset, data, size);
+    }
+    buffer->frame_size = offset + size;
+    buffer->join_sequence = covers;
+    buffer->keyframe = 1;
+    buffer->timestamp = now_seconds();
+    std::atomic_thread_fence(std::memory_order_release);
     buffer->sequence++;
 
     return 0;
@@ -119,4 +314,18 @@ uint32_t SharedMemory::get_sequence() const {
     return buffer->sequence;
 }
 
-#endif // _WIN32
+bool SharedMemory::take_refresh_request() {
+    if (!buffer) {
+        return false;
+    }
+    // A counter rather than a flag, so a reader can't lose a request to the
+    // writer clearing it; volatile as another process writes it
+    uint32_t request = *reinterpret_cast<volatile uint32_t *>(&buffer->refresh_request);
+    if (request == refresh_seen) {
+        return false;
+    }
+    refresh_seen = request;
+    return true;
+}
+
+#endif // _WIN32 || __linux__
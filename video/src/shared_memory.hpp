@@ -1,6 +1,7 @@
 #ifndef SHARED_MEMORY_HPP
 #define SHARED_MEMORY_HPP
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 
@@ -11,7 +12,18 @@
 constexpr uint32_t MAGIC_NUMBER = 0xDEADBEEF;
 constexpr int HEADER_SIZE = 256;
 constexpr int DEFAULT_FRAME_SIZE = 10 * 1024 * 1024;  // 10MB max frame
-
+constexpr int SHM_CODEC_CONFIG_SIZE = 90;  // decoder setup per slot (x264's SPS + PPS: under 40)
+
+// The frame data follows the header at HEADER_SIZE: two slots of slot_size
+// bytes, (block size - HEADER_SIZE) / 2 but at most DEFAULT_FRAME_SIZE.
+// frame_slot names the one with the current frame while the next is written
+// into the other, so a frame being encoded never overwrites the one readers
+// are copying. To read: note `sequence`, copy the header fields you need and
+// frame_size bytes from slot frame_slot, then check `sequence` again. If it
+// moved, the copy may be torn (the writer can reuse a slot once it has
+// published the other one); start over with the newer frame. Decoder setup
+// is double-buffered the same way: codec_config[frame_slot] holds
+// codec_config_size[frame_slot] bytes for the frame in that slot.
 struct SharedFrameBuffer {
     uint32_t magic;
     uint32_t sequence;
@@ -24,8 +36,43 @@ struct SharedFrameBuffer {
     uint32_t monitor;
     uint32_t state;
     uint8_t  error_code;
-    uint8_t  _reserved[215];
-    uint8_t  frame_data[DEFAULT_FRAME_SIZE];
+    uint8_t  layout;        // FRAME_LAYOUT_* (frame_message.hpp)
+    uint8_t  unchanged;     // 1: this sequence repeats the frame in frame_slot
+    uint8_t  keyframe;      // 1: the frame decodes without earlier frames
+    uint8_t  codec_config_size[2];                    // per slot, bytes of codec_config
+    uint8_t  codec_config[2][SHM_CODEC_CONFIG_SIZE];  // per slot, H.264: Annex B SPS + PPS
+    uint8_t  subsampling;       // JPEG chroma, FrameBuffer::subsampling; 0xFF: no JPEG data
+    uint8_t  frame_slot;        // slot with the current frame, 0 or 1
+    uint32_t slot_size;         // bytes per slot; slot 1 starts at HEADER_SIZE + slot_size
+    uint32_t join_sequence;     // join block: frame block sequence its run brings a reader up to
+    uint32_t refresh_request;   // written by readers: add 1 to ask for a keyframe / full refresh
+    uint32_t partial_sequence;  // sequence the frame being written will get
+    uint32_t partial_size;      // bytes of it already in the other slot (slices)
+    uint16_t copy_count;        // tile copy records leading the frame (scroll, window move)
+    int16_t  copy_dx;           // offset they move content by
+    int16_t  copy_dy;
+    uint8_t  layer;             // simulcast layer in this block, 0 = main
+    uint8_t  layer_count;       // layers the encoder publishes (names: config.hpp)
+    // Frame data at HEADER_SIZE; its size comes from the block, not this struct
+};
+
+static_assert(sizeof(SharedFrameBuffer) <= HEADER_SIZE, "SharedFrameBuffer header layout");
+
+// The join block (<shm_name>_join, output.join_cache_kb) uses the same
+// header with a single slot holding the join cache's run (join_cache.hpp).
+// Its `sequence` is odd while the run is being rewritten: copy frame_size
+// bytes and join_sequence while it is even, then check it didn't change.
+
+// Header fields describing one frame beyond its size and geometry.
+// write_frame() and commit_frame() store them with the rest of the header,
+// before the sequence bump, so a reader never sees them ahead of the frame.
+struct SharedFrameInfo {
+    const uint8_t *codec_config = nullptr;  // decoder setup (H.264 SPS/PPS), none if empty
+    size_t codec_config_size = 0;
+    int subsampling = -1;  // JPEG chroma as TJSAMP_*, -1 for no JPEG data
+    int copy_count = 0;  // tile copy records leading the frame
+    int copy_dx = 0;     // offset they move content by
+    int copy_dy = 0;
 };
 
 // State flags
@@ -39,11 +86,13 @@ constexpr uint8_t SHM_ERR_NO_DISPLAY  = 0x01;
 constexpr uint8_t SHM_ERR_DXGI_FAIL   = 0x02;
 constexpr uint8_t SHM_ERR_ENCODE_FAIL = 0x03;
 
-#ifdef _WIN32
+#if defined(_WIN32) || defined(__linux__)
 
+// Windows: named file mapping. Linux: POSIX shm object at /dev/shm/<name>.
 class SharedMemory {
 public:
-    SharedMemory(const std::string &name, int size);
+    // `slots`: 2 for frame blocks, 1 for the join block
+    SharedMemory(const std::string &name, int size, int slots = 2);
     ~SharedMemory();
 
     SharedMemory(const SharedMemory&) = delete;
@@ -53,40 +102,58 @@ public:
 
     int write_frame(const uint8_t *frame_data, uint32_t size,
                     uint32_t width, uint32_t height, uint32_t fps, uint32_t quality,
-                    uint32_t monitor);
+                    uint32_t monitor, uint8_t layout, bool keyframe, const SharedFrameInfo &info = {});
+
+    // Which simulcast layer this block carries, out of how many
+    void set_layer(int layer, int count);
+
+    // Copy part of the next frame into the free slot at `offset` ahead of
+    // commit_frame(), advancing partial_size. The current frame stays
+    // intact until the commit.
+    int write_slice(const uint8_t *data, uint32_t offset, uint32_t size);
+
+    // Publish the frame write_slice() assembled in the free slot
+    int commit_frame(uint32_t size, uint32_t width, uint32_t height, uint32_t fps, uint32_t quality,
+                     uint32_t monitor, uint8_t layout, bool keyframe, const SharedFrameInfo &info = {});
+
+    // Drop the slices written since the last commit (failed encode); the
+    // current frame stays published
+    void abort_frame();
+
+    // Signal a new frame identical to the current one
+    int mark_unchanged();
+
+    // Join block: replace its run from `offset` on with `size` bytes and
+    // record that it covers the frame block up to sequence `covers`
+    int write_run(const uint8_t *data, uint32_t offset, uint32_t size, uint32_t covers);
 
     void set_state(uint32_t state, uint8_t error_code);
     uint32_t get_sequence() const;
 
+    // True once each time a reader has bumped refresh_request: it missed a
+    // sequence of a codec whose frames build on each other (tiles, H.264)
+    // and can't go on until the next keyframe
+    bool take_refresh_request();
+
 private:
+#ifdef _WIN32
     HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+    void init_header();
+    uint8_t* slot(int index) {
+        return reinterpret_cast<uint8_t *>(buffer) + HEADER_SIZE + static_cast<size_t>(index) * buffer->slot_size;
+    }
+    uint8_t* free_slot() { return slot(buffer->frame_slot ^ 1); }
+
     SharedFrameBuffer *buffer = nullptr;
     int size = 0;
+    int slots = 2;
+    uint32_t refresh_seen = 0;  // refresh_request already acted on
     std::string name;
 };
 
-#else // !_WIN32
-
-// On non-Windows platforms IPC is handled by the platform capture backend
-// (e.g. Unix domain socket in macos.mm). Provide a no-op stub so main.cpp
-// compiles without changes.
-class SharedMemory {
-public:
-    SharedMemory(const std::string &, int) {}
-    ~SharedMemory() {}
-
-    SharedMemory(const SharedMemory&) = delete;
-    SharedMemory& operator=(const SharedMemory&) = delete;
-
-    bool is_valid() const { return true; }
-
-    int write_frame(const uint8_t *, uint32_t, uint32_t, uint32_t,
-                    uint32_t, uint32_t, uint32_t) { return 0; }
-
-    void set_state(uint32_t, uint8_t) {}
-    uint32_t get_sequence() const { return 0; }
-};
-
-#endif // _WIN32
+#endif // _WIN32 || __linux__
 
 #endif // SHARED_MEMORY_HPP
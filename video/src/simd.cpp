@@ -0,0 +1,33 @@
+#include <cstring>
+#include "simd.hpp"
+
+bool cpu_has(const char *isa) {
+    if (strcmp(isa, "scalar") == 0) {
+        return true;
+    }
+#if defined(SIMD_X86)
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    if (strcmp(isa, "avx512") == 0) return __builtin_cpu_supports("avx512f");
+    if (strcmp(isa, "avx2") == 0) return __builtin_cpu_supports("avx2");
+    return strcmp(isa, "sse2") == 0;  // part of x86-64
+#elif defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 0);
+    if (regs[0] < 7) return strcmp(isa, "sse2") == 0;
+    __cpuid(regs, 1);
+    bool osxsave = (regs[2] >> 27) & 1;
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    __cpuidex(regs, 7, 0);
+    if (strcmp(isa, "avx512") == 0) return ((regs[1] >> 16) & 1) && (xcr0 & 0xE6) == 0xE6;
+    if (strcmp(isa, "avx2") == 0) return ((regs[1] >> 5) & 1) && (xcr0 & 0x6) == 0x6;
+    return strcmp(isa, "sse2") == 0;
+#else
+    return strcmp(isa, "sse2") == 0;
+#endif
+#elif defined(SIMD_NEON)
+    return strcmp(isa, "neon") == 0;  // baseline on ARMv8
+#else
+    return false;
+#endif
+}
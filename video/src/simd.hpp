@@ -0,0 +1,82 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+// Shared plumbing for the hand-vectorized kernels (tile_diff, frame_hash,
+// scale, yuv): which instruction set family we are building for, a way to
+// compile single functions for a wider ISA than the build baseline, a
+// runtime check before calling them, and the table each module picks its
+// kernel from.
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+#define SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+// GCC/Clang compile individual functions for a wider ISA than the build
+// baseline; MSVC accepts the intrinsics anywhere.
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SIMD_TARGET(isa)
+#endif
+
+// True if this CPU (and OS) can run code for `isa`: "avx512", "avx2",
+// "sse2", "neon" or "scalar"
+bool cpu_has(const char *isa);
+
+// A module's kernels and the one in use. `Kernel` is the module's own
+// struct, whose first member is `const char *name` (an ISA for cpu_has())
+// followed by its function pointers. The table lists them default first;
+// the first one this CPU can run is used until select() picks another.
+template <typename Kernel, size_t N>
+class KernelTable {
+public:
+    explicit KernelTable(const Kernel (&kernels)[N]) : kernels(kernels), current(&kernels[0]) {
+        for (const auto &k : kernels) {
+            if (cpu_has(k.name)) {
+                current = &k;
+                break;
+            }
+        }
+    }
+
+    const Kernel &active() const { return *current; }
+
+    const char* name() const { return current->name; }
+
+    // Names usable on this CPU, in table order
+    std::vector<const char*> usable() const {
+        std::vector<const char*> names;
+        for (const auto &k : kernels) {
+            if (cpu_has(k.name)) names.push_back(k.name);
+        }
+        return names;
+    }
+
+    // Returns false if `name` is unknown or not usable here
+    bool select(const char *name) {
+        for (const auto &k : kernels) {
+            if (strcmp(k.name, name) == 0 && cpu_has(k.name)) {
+                current = &k;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    const Kernel (&kernels)[N];
+    const Kernel *current;
+};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Bounded single-producer/single-consumer ring buffer. push/pop are
+// lock-free; the *_wait variants only touch the mutex when the other side
+// has to sleep, so a busy pipeline never takes a lock.
+template <typename T>
+class SpscQueue {
+public:
+    // Capacity is rounded up to a power of two
+    explicit SpscQueue(size_t capacity) {
+        size_t cap = 1;
+        while (cap < capacity) cap <<= 1;
+        slots.resize(cap);
+        mask = cap - 1;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    bool try_push(T &item) {
+        if (!push_now(item)) return false;
+        wake(not_empty);
+        return true;
+    }
+
+    bool try_pop(T &item) {
+        if (!pop_now(item)) return false;
+        wake(not_full);
+        return true;
+    }
+
+    // Block up to timeout_ms for space. Returns false on timeout.
+    bool push_wait(T &item, int timeout_ms) {
+        if (!wait_for([&] { return push_now(item); }, not_full, timeout_ms)) return false;
+        wake(not_empty);
+        return true;
+    }
+
+    // Block up to timeout_ms for an item. Returns false on timeout.
+    bool pop_wait(T &item, int timeout_ms) {
+        if (!wait_for([&] { return pop_now(item); }, not_empty, timeout_ms)) return false;
+        wake(not_full);
+        return true;
+    }
+
+    size_t size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+private:
+    // One side sleeping on a condition the other side makes true
+    struct Waiter {
+        std::atomic<bool> sleeping{false};
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
+
+    bool push_now(T &item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) > mask) {
+            return false;
+        }
+        slots[tail & mask] = std::move(item);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop_now(T &item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = std::move(slots[head & mask]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <typename Fn>
+    bool wait_for(Fn &&attempt, Waiter &w, int timeout_ms) {
+        if (attempt()) return true;
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        std::unique_lock<std::mutex> lock(w.mutex);
+        while (true) {
+            // Publish that we're about to sleep, then re-check so a wake-up
+            // between the failed attempt and the wait isn't lost.
+            w.sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (attempt()) {
+                w.sleeping.store(false, std::memory_order_relaxed);
+                return true;
+            }
+            if (w.cv.wait_until(lock, deadline) == std::cv_status::timeout) {
+                w.sleeping.store(false, std::memory_order_relaxed);
+                return attempt();
+            }
+        }
+    }
+
+    void wake(Waiter &w) {
+        // Pairs with the fence in wait_for(): either the sleeper sees our
+        // update, or we see its flag.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (w.sleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(w.mutex);
+            w.sleeping.store(false, std::memory_order_relaxed);
+            w.cv.notify_one();
+        }
+    }
+
+    std::vector<T> slots;
+    size_t mask = 0;
+
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+
+    Waiter not_empty;
+    Waiter not_full;
+};
+
+#endif
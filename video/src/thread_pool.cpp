@@ -0,0 +1,91 @@
+#include "thread_pool.hpp"
+
+ThreadPool::ThreadPool(int threads) {
+    for (int i = 1; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    job_ready.notify_all();
+    for (auto &t : workers) {
+        t.join();
+    }
+}
+
+void ThreadPool::parallel_for(int count, const std::function<void(int)> &fn) {
+    if (count <= 0) {
+        return;
+    }
+    if (workers.empty() || count == 1) {
+        for (int i = 0; i < count; i++) fn(i);
+        return;
+    }
+
+    uint32_t gen;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        gen = ++generation;
+        job = &fn;
+        task_count = count;
+        tasks_left = count;
+        next_task.store(static_cast<uint64_t>(gen) << 32, std::memory_order_release);
+    }
+    job_ready.notify_all();
+
+    run_tasks(gen, fn, count);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    job_done.wait(lock, [this] { return tasks_left == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::worker_loop() {
+    uint32_t seen = 0;
+    for (;;) {
+        const std::function<void(int)> *fn;
+        int count;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            job_ready.wait(lock, [&] { return stopping || (job && generation != seen); });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+            fn = job;
+            count = task_count;
+        }
+        run_tasks(seen, *fn, count);
+    }
+}
+
+// Claim tasks of job `gen` until none are left, then report how many this
+// thread ran
+void ThreadPool::run_tasks(uint32_t gen, const std::function<void(int)> &fn, int count) {
+    int done = 0;
+    uint64_t cur = next_task.load(std::memory_order_acquire);
+    for (;;) {
+        if (static_cast<uint32_t>(cur >> 32) != gen || static_cast<int>(cur & 0xFFFFFFFFu) >= count) {
+            break;
+        }
+        if (!next_task.compare_exchange_weak(cur, cur + 1, std::memory_order_acq_rel)) {
+            continue;
+        }
+        fn(static_cast<int>(cur & 0xFFFFFFFFu));
+        done++;
+        cur = next_task.load(std::memory_order_acquire);
+    }
+    if (done == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks_left -= done;
+    if (tasks_left == 0) {
+        job_done.notify_one();
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for fork/join work inside one pipeline stage
+// (e.g. the strips of one frame). The calling thread takes part in every
+// job, so a pool of N runs N tasks at once with N-1 extra threads.
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return static_cast<int>(workers.size()) + 1; }
+
+    // Run fn(i) for every i in [0, count) across the pool and return once
+    // all of them have finished. Not reentrant: one job at a time.
+    void parallel_for(int count, const std::function<void(int)> &fn);
+
+private:
+    void worker_loop();
+    void run_tasks(uint32_t gen, const std::function<void(int)> &fn, int count);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable job_ready;
+    std::condition_variable job_done;
+    bool stopping = false;
+
+    // Current job, guarded by mutex
+    const std::function<void(int)> *job = nullptr;
+    uint32_t generation = 0;
+    int task_count = 0;
+    int tasks_left = 0;
+
+    // Next task index in the low 32 bits, tagged with the job generation in
+    // the high 32 so a worker that wakes late can't claim a task of the
+    // following job.
+    std::atomic<uint64_t> next_task{0};
+};
+
+#endif
@@ -0,0 +1,131 @@
+#include <cstring>
+#include "tile_classify.hpp"
+
+// Luma step between neighbours counted as an edge (glyph strokes, borders)
+constexpr int EDGE_STEP = 48;
+
+// Largest luma step still counted as smooth shading
+constexpr int SMOOTH_STEP = 12;
+
+// Edge density above which a tile is text or line art even when it is not
+// mostly flat (dense small text, code), as long as some background shows
+constexpr float TEXT_EDGES = 0.12f;
+constexpr float TEXT_FLAT = 0.25f;
+
+// Open-addressed color set; power of two, comfortably above TILE_MAX_COLORS
+constexpr int COLOR_SLOTS = 1024;
+constexpr uint32_t EMPTY_SLOT = 0xFFFFFFFFu;
+
+static inline uint32_t load_color(const uint8_t *p, int bpp) {
+    uint32_t c;
+    if (bpp == 4) {
+        memcpy(&c, p, 4);
+        return c & 0x00FFFFFFu;
+    }
+    return p[0] | (p[1] << 8) | (p[2] << 16);
+}
+
+// Rough luma, (R + 2G + B) / 4
+static int luma(uint32_t c) {
+    return ((c & 0xFF) + ((c >> 7) & 0x1FE) + ((c >> 16) & 0xFF)) >> 2;
+}
+
+// Add a color to the set; false once the set holds more than TILE_MAX_COLORS
+static bool add_color(uint32_t *slots, int &count, uint32_t c) {
+    uint32_t i = (c * 0x9E3779B1u) >> 22;
+    while (slots[i] != EMPTY_SLOT) {
+        if (slots[i] == c) return true;
+        i = (i + 1) & (COLOR_SLOTS - 1);
+    }
+    slots[i] = c;
+    return ++count <= TILE_MAX_COLORS;
+}
+
+// Neighbour statistics over every other row; branch-free so the compiler
+// can vectorize it
+struct PairCounts {
+    int pairs = 0, flat = 0, edges = 0, smooth = 0;
+};
+
+template <int BPP>
+static PairCounts pair_stats(const uint8_t *data, size_t stride, int w, int h) {
+    // Local counters: through a reference they could alias the pixels and
+    // would be reloaded on every iteration
+    int flat = 0, edges = 0, smooth = 0;
+    for (int y = 0; y < h; y += 2) {
+        const uint8_t *row = data + static_cast<size_t>(y) * stride;
+        // Both pixels are loaded each time; carrying `left` over from the
+        // previous iteration would stop the loop from vectorizing
+        for (int x = 1; x < w; x++) {
+            uint32_t left = load_color(row + static_cast<size_t>(x - 1) * BPP, BPP);
+            uint32_t c = load_color(row + static_cast<size_t>(x) * BPP, BPP);
+            int step = luma(c) - luma(left);
+            step = step < 0 ? -step : step;
+            int same = c == left;
+            flat += same;
+            edges += step >= EDGE_STEP;
+            smooth += !same & (step <= SMOOTH_STEP);
+        }
+    }
+
+    PairCounts counts;
+    counts.pairs = (w - 1) * ((h + 1) / 2);
+    counts.flat = flat;
+    counts.edges = edges;
+    counts.smooth = smooth;
+    return counts;
+}
+
+// Rows apart the colors are counted on. An estimate is enough: the palette
+// coder sees every pixel and falls back to JPEG if the palette overflows.
+constexpr int COLOR_ROW_STEP = 4;
+
+// Distinct colors, looked up only where the color changes; stops as soon as
+// there are more than TILE_MAX_COLORS
+template <int BPP>
+static int count_colors(const uint8_t *data, size_t stride, int w, int h) {
+    uint32_t slots[COLOR_SLOTS];
+    memset(slots, 0xFF, sizeof(slots));
+
+    int colors = 0;
+    for (int y = 0; y < h; y += COLOR_ROW_STEP) {
+        const uint8_t *row = data + static_cast<size_t>(y) * stride;
+        uint32_t left = load_color(row, BPP);
+        if (!add_color(slots, colors, left)) return colors;
+        for (int x = 1; x < w; x++) {
+            uint32_t c = load_color(row + static_cast<size_t>(x) * BPP, BPP);
+            if (c == left) continue;
+            if (!add_color(slots, colors, c)) return colors;
+            left = c;
+        }
+    }
+    return colors;
+}
+
+TileClass classify_tile(const uint8_t *data, size_t stride, int w, int h, int bpp, TileStats *stats) {
+    PairCounts p = bpp == 4 ? pair_stats<4>(data, stride, w, h) : pair_stats<3>(data, stride, w, h);
+    int pairs = p.pairs, flat = p.flat, edges = p.edges, smooth = p.smooth;
+
+    // Dense hard edges over a flat background are text (JPEG rings around
+    // every stroke); otherwise more soft shading than flat runs means a
+    // gradient or an image
+    bool text = edges >= TEXT_EDGES * pairs && flat >= TEXT_FLAT * pairs;
+    bool synthetic = text || flat >= smooth;
+
+    // Only tiles that still look synthetic pay for the color count: more
+    // colors than a palette holds is photographic after all
+    int colors = 0;
+    if (synthetic || stats) {
+        colors = bpp == 4 ? count_colors<4>(data, stride, w, h) : count_colors<3>(data, stride, w, h);
+        synthetic = synthetic && colors <= TILE_MAX_COLORS;
+    }
+
+    if (stats) {
+        float n = pairs ? static_cast<float>(pairs) : 1.0f;
+        stats->colors = colors;
+        stats->flat = flat / n;
+        stats->edges = edges / n;
+        stats->smooth = smooth / n;
+    }
+    return synthetic ? TileClass::SYNTHETIC : TileClass::NATURAL;
+}
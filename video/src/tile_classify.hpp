@@ -0,0 +1,34 @@
+#ifndef TILE_CLASSIFY_HPP
+#define TILE_CLASSIFY_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// What kind of pixels a tile holds, which decides how it is encoded
+enum class TileClass : uint8_t {
+    SYNTHETIC,  // text, UI, line art: few colors, flat areas, hard edges -> lossless
+    NATURAL,    // photos, video, gradients: many colors, soft transitions -> JPEG
+};
+
+// Measurements the decision is made from, over the sampled rows
+struct TileStats {
+    int colors = 0;       // distinct colors, stops counting past TILE_MAX_COLORS
+    float flat = 0;       // neighbour pairs with identical color
+    float edges = 0;      // neighbour pairs with a large luma step
+    float smooth = 0;     // differing neighbour pairs with a small luma step
+};
+
+// More distinct colors than this and a tile is NATURAL; also the palette
+// limit of the lossless tile coding (palette_rle.hpp)
+constexpr int TILE_MAX_COLORS = 256;
+
+// Classify the w x h block at `data` (BGRA or BGR). Looks at every other
+// row, comparing each pixel with its left neighbour (a vectorized pass).
+// Colors are then counted on a sparser set of rows, only for tiles the
+// neighbour statistics call synthetic and only until the count overflows,
+// so photographic tiles cost one pass. Well under a tenth of the cost of
+// JPEG-encoding the same tile (--bench tile-classify).
+TileClass classify_tile(const uint8_t *data, size_t stride, int w, int h, int bytes_per_pixel,
+                        TileStats *stats = nullptr);
+
+#endif
@@ -0,0 +1,184 @@
+#include <cstring>
+#include "simd.hpp"
+#include "tile_diff.hpp"
+
+// True if the `n` bytes at a and b are identical
+typedef bool (*SpanEqualFn)(const uint8_t *a, const uint8_t *b, size_t n);
+
+// ---------------------------------------------------------------------------
+// Kernels. Each ORs together the XOR of both spans a vector at a time and
+// tests the accumulator once at the end; spans are a tile row (a few hundred
+// bytes), so an early exit per vector would cost more than it saves.
+// ---------------------------------------------------------------------------
+static bool span_equal_scalar(const uint8_t *a, const uint8_t *b, size_t n) {
+    return memcmp(a, b, n) == 0;
+}
+
+#ifdef SIMD_X86
+static bool span_equal_sse2(const uint8_t *a, const uint8_t *b, size_t n) {
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+        acc = _mm_or_si128(acc, _mm_xor_si128(va, vb));
+    }
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) != 0xFFFF) {
+        return false;
+    }
+    return memcmp(a + i, b + i, n - i) == 0;
+}
+
+SIMD_TARGET("avx2")
+static bool span_equal_avx2(const uint8_t *a, const uint8_t *b, size_t n) {
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+        acc = _mm256_or_si256(acc, _mm256_xor_si256(va, vb));
+    }
+    if (!_mm256_testz_si256(acc, acc)) {
+        return false;
+    }
+    return memcmp(a + i, b + i, n - i) == 0;
+}
+
+SIMD_TARGET("avx512f")
+static bool span_equal_avx512(const uint8_t *a, const uint8_t *b, size_t n) {
+    __m512i acc = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m512i va = _mm512_loadu_si512(a + i);
+        __m512i vb = _mm512_loadu_si512(b + i);
+        acc = _mm512_or_si512(acc, _mm512_xor_si512(va, vb));
+    }
+    if (_mm512_test_epi64_mask(acc, acc) != 0) {
+        return false;
+    }
+    return memcmp(a + i, b + i, n - i) == 0;
+}
+#endif // SIMD_X86
+
+#ifdef SIMD_NEON
+static bool span_equal_neon(const uint8_t *a, const uint8_t *b, size_t n) {
+    uint8x16_t acc = vdupq_n_u8(0);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc = vorrq_u8(acc, veorq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+    }
+    uint64x2_t folded = vreinterpretq_u64_u8(acc);
+    if ((vgetq_lane_u64(folded, 0) | vgetq_lane_u64(folded, 1)) != 0) {
+        return false;
+    }
+    return memcmp(a + i, b + i, n - i) == 0;
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Runtime dispatch
+// ---------------------------------------------------------------------------
+struct Kernel {
+    const char *name;
+    SpanEqualFn fn;
+};
+
+// Default first. memcmp leads: the scan is bound by memory bandwidth, and on
+// the single core measured so far (--bench tile-diff) the SIMD kernels were
+// no faster and sometimes slower. They stay selectable so a multi-core
+// machine can be measured before any of them becomes the default.
+static const Kernel KERNELS[] = {
+    {"scalar", span_equal_scalar},
+#ifdef SIMD_X86
+    {"avx512", span_equal_avx512},
+    {"avx2", span_equal_avx2},
+    {"sse2", span_equal_sse2},
+#endif
+#ifdef SIMD_NEON
+    {"neon", span_equal_neon},
+#endif
+};
+
+static KernelTable kernel_table(KERNELS);
+
+const char* tile_diff_kernel() {
+    return kernel_table.name();
+}
+
+std::vector<const char*> tile_diff_kernels() {
+    return kernel_table.usable();
+}
+
+bool tile_diff_select(const char *name) {
+    return kernel_table.select(name);
+}
+
+// ---------------------------------------------------------------------------
+
+// Tile rows wider than this many 64-tile words are not supported (65536
+// pixels at the minimum tile size)
+constexpr int MAX_ROW_WORDS = 64;
+
+static int lowest_bit(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return static_cast<int>(index);
+#else
+    int n = 0;
+    while (!(x & 1)) { x >>= 1; n++; }
+    return n;
+#endif
+}
+
+void tile_diff(const uint8_t *cur, size_t cur_stride,
+               const uint8_t *prev, size_t prev_stride,
+               int width, int height, int bytes_per_pixel, int tile_size,
+               const TileBitmap *candidates, TileBitmap &dirty,
+               int ty_begin, int ty_end) {
+    SpanEqualFn span_equal = kernel_table.active().fn;
+    size_t tile_bytes = static_cast<size_t>(tile_size) * bytes_per_pixel;
+    size_t last_bytes = static_cast<size_t>(width - (dirty.cols - 1) * tile_size) * bytes_per_pixel;
+    int words = dirty.words_per_row < MAX_ROW_WORDS ? dirty.words_per_row : MAX_ROW_WORDS;
+
+    for (int ty = ty_begin; ty < ty_end; ty++) {
+        uint64_t *dirty_row = &dirty.words[static_cast<size_t>(ty) * dirty.words_per_row];
+        const uint64_t *candidate_row = candidates ? &candidates->words[static_cast<size_t>(ty) * candidates->words_per_row] : nullptr;
+
+        // Tiles still to compare in this row; a tile drops out as soon as
+        // one of its rows differs
+        uint64_t todo[MAX_ROW_WORDS];
+        bool pending = false;
+        for (int w = 0; w < words; w++) {
+            uint64_t valid = w == words - 1 && dirty.cols % 64 ? (uint64_t(1) << (dirty.cols % 64)) - 1 : ~uint64_t(0);
+            todo[w] = (candidate_row ? candidate_row[w] : valid) & valid & ~dirty_row[w];
+            pending |= todo[w] != 0;
+        }
+
+        int y0 = ty * tile_size;
+        int y1 = y0 + tile_size > height ? height : y0 + tile_size;
+        for (int y = y0; y < y1 && pending; y++) {
+            const uint8_t *a = cur + static_cast<size_t>(y) * cur_stride;
+            const uint8_t *b = prev + static_cast<size_t>(y) * prev_stride;
+            pending = false;
+            for (int w = 0; w < words; w++) {
+                uint64_t bits = todo[w];
+                while (bits) {
+                    int tx = w * 64 + lowest_bit(bits);
+                    uint64_t bit = bits & (~bits + 1);
+                    bits ^= bit;
+
+                    size_t offset = static_cast<size_t>(tx) * tile_bytes;
+                    size_t n = tx == dirty.cols - 1 ? last_bytes : tile_bytes;
+                    if (!span_equal(a + offset, b + offset, n)) {
+                        dirty_row[w] |= bit;
+                        todo[w] ^= bit;
+                    }
+                }
+                pending |= todo[w] != 0;
+            }
+        }
+    }
+}
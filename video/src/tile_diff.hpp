@@ -0,0 +1,69 @@
+#ifndef TILE_DIFF_HPP
+#define TILE_DIFF_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One bit per tile. Every tile row starts on a fresh 64-bit word, so
+// different threads can fill different tile rows without sharing a word.
+struct TileBitmap {
+    int cols = 0;
+    int rows = 0;
+    int words_per_row = 0;
+    std::vector<uint64_t> words;
+
+    void resize(int tile_cols, int tile_rows) {
+        cols = tile_cols;
+        rows = tile_rows;
+        words_per_row = (tile_cols + 63) / 64;
+        words.assign(static_cast<size_t>(words_per_row) * tile_rows, 0);
+    }
+
+    void clear() { std::fill(words.begin(), words.end(), 0); }
+
+    // Set every tile (and no padding bits)
+    void fill() {
+        for (int ty = 0; ty < rows; ty++) {
+            for (int tx = 0; tx < cols; tx++) set(tx, ty);
+        }
+    }
+
+    bool test(int tx, int ty) const {
+        return (words[static_cast<size_t>(ty) * words_per_row + tx / 64] >> (tx % 64)) & 1;
+    }
+
+    void set(int tx, int ty) {
+        words[static_cast<size_t>(ty) * words_per_row + tx / 64] |= uint64_t(1) << (tx % 64);
+    }
+
+    void reset(int tx, int ty) {
+        words[static_cast<size_t>(ty) * words_per_row + tx / 64] &= ~(uint64_t(1) << (tx % 64));
+    }
+};
+
+// Compare tile rows [ty_begin, ty_end) of `cur` against `prev` and set the
+// bit in `dirty` of every tile with at least one differing byte. Only tiles
+// set in `candidates` are compared (all tiles if null); tiles already set in
+// `dirty` are skipped. Strides are independent and need not be aligned, so
+// DXGI RowPitch or CVPixelBuffer bytesPerRow can be passed straight in.
+//
+// Rows are compared with memcmp by default. AVX-512, AVX2, SSE2 and NEON
+// kernels can be selected at runtime but have not been measured faster.
+void tile_diff(const uint8_t *cur, size_t cur_stride,
+               const uint8_t *prev, size_t prev_stride,
+               int width, int height, int bytes_per_pixel, int tile_size,
+               const TileBitmap *candidates, TileBitmap &dirty,
+               int ty_begin, int ty_end);
+
+// Name of the kernel tile_diff() uses ("avx512", "avx2", "sse2", "neon", "scalar")
+const char* tile_diff_kernel();
+
+// Kernels usable on this CPU, default first
+std::vector<const char*> tile_diff_kernels();
+
+// Force a kernel by name (benchmarks). Returns false if not usable here.
+bool tile_diff_select(const char *name);
+
+#endif
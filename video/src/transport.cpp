@@ -0,0 +1,430 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "frame_message.hpp"
+#include "join_cache.hpp"
+#include "shared_memory.hpp"
+#include "transport.hpp"
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// Shapes a socket consumer is assumed to still have; older ones are sent
+// again if they come back
+constexpr size_t CURSOR_SHAPES_KEPT = 16;
+
+// FRAME_LAYOUT_* for an encoded frame
+static uint8_t frame_layout(const FrameBuffer &frame) {
+    switch (frame.format) {
+    case PixelFormat::TILES:     return FRAME_LAYOUT_TILES;
+    case PixelFormat::H264:      return FRAME_LAYOUT_H264;
+    case PixelFormat::UNCHANGED: return FRAME_LAYOUT_UNCHANGED;
+    default:                     return FRAME_LAYOUT_JPEG;
+    }
+}
+
+#if defined(_WIN32) || defined(__linux__)
+
+// Shared memory header fields of an encoded frame
+static SharedFrameInfo frame_info(const FrameBuffer &frame) {
+    SharedFrameInfo info;
+    info.codec_config = frame.codec_config.data();
+    info.codec_config_size = frame.codec_config.size();
+    info.subsampling = frame.subsampling;
+    info.copy_count = frame.copy_count;
+    info.copy_dx = frame.copy_dx;
+    info.copy_dy = frame.copy_dy;
+    return info;
+}
+
+// ---------------------------------------------------------------------------
+// ShmTransport: latest frame in a shared memory block (layout in
+// shared_memory.hpp). Consumers poll `sequence`; one that misses a
+// sequence of tiles or H.264 bumps `refresh_request` for a keyframe.
+// With the cursor channel, cursor messages go to a second, small block
+// (<shm_name>_cursor) so they never displace a frame.
+// With the join cache, a third block (<shm_name>_join) mirrors it for
+// readers that attach mid-stream.
+// ---------------------------------------------------------------------------
+class ShmTransport : public FrameTransport {
+public:
+    explicit ShmTransport(const EncoderConfig &config)
+        : shm(config.shm_name, config.shm_size),
+          cache(static_cast<size_t>(config.join_cache_kb > 0 ? config.join_cache_kb : 0) * 1024),
+          fps(config.fps), quality(config.quality), monitor(config.monitor) {
+        shm.set_layer(config.layer, layer_count(config));
+        if (config.join_cache_kb > 0) {
+            join_shm = std::make_unique<SharedMemory>(config.shm_name + "_join",
+                                                      HEADER_SIZE + config.join_cache_kb * 1024, 1);
+            join_shm->set_layer(config.layer, layer_count(config));
+        }
+        if (config.cursor) {
+            int size = HEADER_SIZE + 2 * (static_cast<int>(sizeof(CursorMessage)) + CURSOR_MAX_SIZE * CURSOR_MAX_SIZE * 4);
+            cursor_shm = std::make_unique<SharedMemory>(config.shm_name + "_cursor", size);
+            cursor_shm->set_layer(config.layer, layer_count(config));
+        }
+    }
+
+    const char* get_name() const override { return "shm"; }
+
+    bool is_valid() const override { return shm.is_valid(); }
+
+    bool take_refresh_request() override { return shm.take_refresh_request(); }
+
+    int publish(const FrameBuffer &frame) override {
+        int result;
+        if (frame.format == PixelFormat::UNCHANGED) {
+            result = shm.mark_unchanged();
+        } else {
+            result = shm.write_frame(frame.data, static_cast<uint32_t>(frame.size), frame.width, frame.height,
+                                     fps, quality, monitor, frame_layout(frame), frame.keyframe, frame_info(frame));
+        }
+        if (result == 0) {
+            update_join(frame);
+        }
+        return result;
+    }
+
+    // Slices go straight into the free slot; the last one commits the frame
+    int publish_slice(const FrameBuffer &frame, size_t offset, size_t size, uint16_t flags) override {
+        if (flags & SLICE_FLAG_ABORT) {
+            shm.abort_frame();
+            return 0;
+        }
+        if (size > 0 && shm.write_slice(frame.data + offset, static_cast<uint32_t>(offset),
+                                        static_cast<uint32_t>(size)) != 0) {
+            return -1;
+        }
+        if (!(flags & SLICE_FLAG_LAST)) {
+            return 0;
+        }
+        int result = shm.commit_frame(static_cast<uint32_t>(frame.size), frame.width, frame.height,
+                                      fps, quality, monitor, frame_layout(frame), frame.keyframe, frame_info(frame));
+        if (result == 0) {
+            update_join(frame);
+        }
+        return result;
+    }
+
+    // A reader may have missed any earlier message, so the shape always
+    // comes along; it only costs a local copy
+    int publish_cursor(const CursorState &cursor, int width, int height) override {
+        if (!cursor_shm || !cursor_shm->is_valid()) {
+            return 0;
+        }
+        size_t size = write_cursor_message(cursor, width, height, true, cursor_message);
+        return cursor_shm->write_frame(cursor_message.data(), static_cast<uint32_t>(size), width, height, fps,
+                                       quality, monitor, FRAME_LAYOUT_CURSOR, true);
+    }
+
+    void set_state(uint32_t state, uint8_t error_code) override {
+        shm.set_state(state, error_code);
+        if (cursor_shm) {
+            cursor_shm->set_state(state, error_code);
+        }
+        if (join_shm) {
+            join_shm->set_state(state, error_code);
+        }
+    }
+
+private:
+    // Bring the join block up to the frame just published. Between
+    // keyframes only the new message is copied; unchanged markers just move
+    // join_sequence along.
+    void update_join(const FrameBuffer &frame) {
+        if (!join_shm || !join_shm->is_valid()) {
+            return;
+        }
+        cache.add(frame);
+        if (cache.generation() != join_generation) {
+            join_generation = cache.generation();
+            join_bytes = 0;
+        }
+        join_shm->write_run(cache.data() + join_bytes, static_cast<uint32_t>(join_bytes),
+                            static_cast<uint32_t>(cache.bytes() - join_bytes), shm.get_sequence());
+        join_bytes = cache.bytes();
+    }
+
+    SharedMemory shm;
+    JoinCache cache;
+    std::unique_ptr<SharedMemory> join_shm;  // output.join_cache_kb
+    uint32_t join_generation = 0;
+    size_t join_bytes = 0;                   // of the cache's run already in join_shm
+    std::unique_ptr<SharedMemory> cursor_shm;  // capture.cursor
+    std::vector<uint8_t> cursor_message;
+    uint32_t fps;
+    uint32_t quality;
+    uint32_t monitor;
+};
+
+#endif // _WIN32 || __linux__
+
+#ifndef _WIN32
+
+// ---------------------------------------------------------------------------
+// SocketTransport: Unix domain socket server, one consumer at a time.
+// Wire format: 4-byte big-endian frame length + frame bytes. The payload
+// layout is self-describing (see frame_message.hpp).
+// Frames are dropped while no consumer is connected; a consumer that goes
+// away is replaced by the next one to connect. A new consumer is first sent
+// the join cache (join_cache.hpp), or asks for a keyframe if it is empty,
+// and the latest cursor message.
+// Cursor messages carry a shape's pixels the first time this consumer
+// sees it, its hash after that.
+// ---------------------------------------------------------------------------
+class SocketTransport : public FrameTransport {
+public:
+    explicit SocketTransport(const EncoderConfig &config)
+        : path(config.socket_path),
+          cache(static_cast<size_t>(config.join_cache_kb > 0 ? config.join_cache_kb : 0) * 1024) {
+        server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (server_fd < 0) { perror("[SOCKET] socket"); return; }
+
+        struct sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(path.c_str());
+
+        if (bind(server_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(server_fd, 1) < 0) {
+            perror("[SOCKET] bind/listen");
+            close(server_fd);
+            server_fd = -1;
+            return;
+        }
+
+        // Accept is polled from publish() and poll(), never blocks the pipeline
+        fcntl(server_fd, F_SETFL, fcntl(server_fd, F_GETFL) | O_NONBLOCK);
+        printf("[SOCKET] Listening on %s\n", path.c_str());
+    }
+
+    ~SocketTransport() override {
+        if (client_fd >= 0) close(client_fd);
+        if (server_fd >= 0) {
+            close(server_fd);
+            unlink(path.c_str());
+        }
+    }
+
+    const char* get_name() const override { return "socket"; }
+
+    bool take_refresh_request() override {
+        bool requested = refresh_requested;
+        refresh_requested = false;
+        return requested;
+    }
+
+    bool is_valid() const override { return server_fd >= 0; }
+
+    // Frames are kept in the cache whether or not anyone is listening, for
+    // whoever comes next
+    int publish(const FrameBuffer &frame) override {
+        send_frame(frame);
+        cache.add(frame);
+        return 0;
+    }
+
+    int publish_slice(const FrameBuffer &frame, size_t offset, size_t size, uint16_t flags) override {
+        send_slice(frame, offset, size, flags);
+        if ((flags & SLICE_FLAG_LAST) && !(flags & SLICE_FLAG_ABORT)) {
+            cache.add(frame);
+        }
+        return 0;
+    }
+
+    // Called between frames, so a consumer taken here starts from a whole
+    // frame like one taken in send_frame()
+    void poll() override {
+        if (client_fd < 0) {
+            accept_client();
+        }
+    }
+
+    // Send: [4-byte big-endian length][CursorMessage][shape pixels if new]
+    int publish_cursor(const CursorState &cursor, int width, int height) override {
+        last_cursor = cursor;
+        cursor_width = width;
+        cursor_height = height;
+        if (client_fd < 0) {
+            accept_client();  // sends last_cursor
+            return 0;
+        }
+        send_cursor();
+        return 0;
+    }
+
+private:
+    void send_frame(const FrameBuffer &frame) {
+        if (client_fd < 0 && !accept_client()) {
+            return;
+        }
+
+        // A consumer that just connected can only start from a keyframe
+        // (its own, or the cache's); one was requested when it connected
+        if (!has_frame && !frame.keyframe) {
+            return;
+        }
+        has_frame = true;
+        send_message(frame.data, frame.size);
+    }
+
+    // Send: [4-byte big-endian length][SliceMessageHeader][slice bytes]
+    void send_slice(const FrameBuffer &frame, size_t offset, size_t size, uint16_t flags) {
+        if (offset == 0) {
+            slice_frame_id++;
+        }
+        // Consumers join between frames, so the cache they start from ends
+        // right before the one about to stream
+        if (client_fd < 0 && (offset > 0 || !accept_client())) {
+            return;
+        }
+
+        // Same keyframe gating as send_frame(), decided on the first slice so a
+        // consumer never gets the tail of a frame it didn't see start
+        if (offset == 0) {
+            sending_slices = has_frame || frame.keyframe;
+            has_frame = has_frame || sending_slices;
+        }
+        if (!sending_slices) {
+            return;
+        }
+
+        SliceMessageHeader header = {};
+        header.magic = SLICE_MESSAGE_MAGIC;
+        header.flags = flags | (frame.keyframe ? SLICE_FLAG_KEYFRAME : 0);
+        header.layout = frame_layout(frame);
+        header.frame_id = slice_frame_id;
+        header.offset = static_cast<uint32_t>(offset);
+        header.width = frame.width;
+        header.height = frame.height;
+
+        uint32_t len_be = htonl(static_cast<uint32_t>(sizeof(header) + size));
+        if (!send_all(&len_be, 4) || !send_all(&header, sizeof(header)) ||
+            (size > 0 && !send_all(frame.data + offset, size))) {
+            printf("[SOCKET] Consumer disconnected\n");
+            close(client_fd);
+            client_fd = -1;
+            sending_slices = false;
+        }
+    }
+
+    void send_cursor() {
+        const CursorState &cursor = last_cursor;
+        uint64_t hash = cursor.shape ? cursor.shape->hash : 0;
+        bool new_shape = hash && std::find(shapes_sent.begin(), shapes_sent.end(), hash) == shapes_sent.end();
+        size_t size = write_cursor_message(cursor, cursor_width, cursor_height, new_shape, cursor_message);
+        if (!send_message(cursor_message.data(), size)) {
+            return;
+        }
+        if (new_shape) {
+            if (shapes_sent.size() == CURSOR_SHAPES_KEPT) {
+                shapes_sent.erase(shapes_sent.begin());
+            }
+            shapes_sent.push_back(hash);
+        }
+    }
+
+    // Send: [4-byte big-endian length][payload]; drops the consumer on error
+    bool send_message(const uint8_t *data, size_t size) {
+        uint32_t len_be = htonl(static_cast<uint32_t>(size));
+        if (!send_all(&len_be, 4) || !send_all(data, size)) {
+            printf("[SOCKET] Consumer disconnected\n");
+            close(client_fd);
+            client_fd = -1;
+            return false;
+        }
+        return true;
+    }
+
+    bool accept_client() {
+        client_fd = accept(server_fd, NULL, NULL);
+        if (client_fd < 0) {
+            return false;
+        }
+
+#ifdef SO_NOSIGPIPE
+        int opt = 1;
+        setsockopt(client_fd, SOL_SOCKET, SO_NOSIGPIPE, &opt, sizeof(opt));
+#endif
+        has_frame = false;
+        sending_slices = false;
+        shapes_sent.clear();
+
+        // Start from the cache if it has a keyframe run, else ask for a
+        // keyframe and drop frames until it arrives
+        size_t count = cache.count();
+        if (count > 0 && !send_all(cache.data(), cache.bytes())) {
+            printf("[SOCKET] Consumer disconnected\n");
+            close(client_fd);
+            client_fd = -1;
+            return false;
+        }
+        has_frame = count > 0;
+        refresh_requested = !has_frame;
+        if (has_frame) {
+            printf("[SOCKET] Consumer connected, sent %zu cached frames (%zu KB)\n", count, cache.bytes() / 1024);
+        } else {
+            printf("[SOCKET] Consumer connected\n");
+        }
+        if (last_cursor.shape || last_cursor.visible) {
+            send_cursor();
+        }
+        return client_fd >= 0;
+    }
+
+    bool send_all(const void *data, size_t len) {
+#ifdef MSG_NOSIGNAL
+        const int flags = MSG_NOSIGNAL;
+#else
+        const int flags = 0;
+#endif
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        while (len > 0) {
+            ssize_t sent = send(client_fd, p, len, flags);
+            if (sent < 0 && errno == EINTR) continue;
+            if (sent <= 0) return false;
+            p += sent;
+            len -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    std::string path;
+    int server_fd = -1;
+    int client_fd = -1;
+    bool has_frame = false;          // client_fd has been sent a keyframe
+    bool refresh_requested = false;
+    bool sending_slices = false;     // current sliced frame goes to client_fd
+    uint32_t slice_frame_id = 0;
+    JoinCache cache;
+    std::vector<uint64_t> shapes_sent;  // cursor shapes client_fd has, oldest first
+    std::vector<uint8_t> cursor_message;
+    CursorState last_cursor;  // latest publish_cursor(), for new consumers
+    int cursor_width = 0;
+    int cursor_height = 0;
+};
+
+#endif // !_WIN32
+
+std::unique_ptr<FrameTransport> create_transport(const EncoderConfig &config) {
+#if defined(_WIN32) || defined(__linux__)
+    if (config.transport == "shm") {
+        return std::make_unique<ShmTransport>(config);
+    }
+#endif
+
+#ifndef _WIN32
+    if (config.transport == "socket") {
+        return std::make_unique<SocketTransport>(config);
+    }
+#endif
+
+    printf("[TRANSPORT] Unknown or unsupported transport: %s\n", config.transport.c_str());
+    return nullptr;
+}
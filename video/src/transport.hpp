@@ -0,0 +1,61 @@
+#ifndef TRANSPORT_HPP
+#define TRANSPORT_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "config.hpp"
+#include "cursor.hpp"
+#include "frame.hpp"
+#include "frame_message.hpp"
+
+// Where encoded frames go once they leave the pipeline
+class FrameTransport {
+public:
+    virtual ~FrameTransport() = default;
+
+    // Get transport name
+    virtual const char* get_name() const = 0;
+
+    // False if setup failed
+    virtual bool is_valid() const = 0;
+
+    // Deliver one encoded frame. Returns 0 on success (including frames
+    // dropped because nobody is listening), -1 on error.
+    virtual int publish(const FrameBuffer &frame) = 0;
+
+    // Deliver bytes [offset, offset + size) of a frame still being encoded
+    // (see SliceProgress). Slices of one frame arrive in order and cover it
+    // exactly; SLICE_FLAG_LAST comes with the final one, after which size
+    // and metadata are final, SLICE_FLAG_ABORT if the encode failed.
+    // Transports that can't use partial frames publish on the last slice.
+    virtual int publish_slice(const FrameBuffer &frame, size_t offset, size_t size, uint16_t flags) {
+        (void)offset;
+        (void)size;
+        return flags & SLICE_FLAG_LAST ? publish(frame) : 0;
+    }
+
+    // Deliver the pointer (cursor channel, capture.cursor) with its position
+    // in this transport's width x height frames. Shape pixels go out only to
+    // consumers that may not have that shape yet. Returns 0 or -1 like
+    // publish().
+    virtual int publish_cursor(const CursorState &, int, int) { return 0; }
+
+    // True once after a consumer connects that has no frame to show yet, or
+    // one asks to start over after missing frames, so the pipeline encodes
+    // the next frame as a keyframe even if it is a duplicate
+    virtual bool take_refresh_request() { return false; }
+
+    // Called by the publish loop whenever it waited and had nothing to
+    // publish, so a consumer can join (and get the join cache) while the
+    // screen is static
+    virtual void poll() {}
+
+    // Report encoder state (SHM_STATE_* / SHM_ERR_*) to consumers
+    virtual void set_state(uint32_t, uint8_t) {}
+};
+
+// Create the transport named by config.transport ("shm", "socket")
+std::unique_ptr<FrameTransport> create_transport(const EncoderConfig &config);
+
+#endif
@@ -0,0 +1,550 @@
+#include <cstring>
+#include "simd.hpp"
+#include "yuv.hpp"
+
+// 8-bit fixed point weights of B, G and R per output channel
+struct Coefficients {
+    int16_t y[3];
+    int16_t u[3];
+    int16_t v[3];
+    int y_offset;
+};
+
+// JFIF (what TurboJPEG computes itself from RGB)
+static const Coefficients FULL_RANGE = {{29, 150, 77}, {128, -85, -43}, {-21, -107, 128}, 0};
+
+// BT.601 studio swing
+static const Coefficients LIMITED_RANGE = {{25, 129, 66}, {112, -74, -38}, {-18, -94, 112}, 16};
+
+size_t yuv_frame_size(PixelFormat layout, int width, int height) {
+    size_t pixels = static_cast<size_t>(width) * height;
+    if (layout == PixelFormat::I444) {
+        return pixels * 3;
+    }
+    size_t cw = (width + 1) / 2, ch = (height + 1) / 2;
+    return cw * ch * 6;
+}
+
+YuvPlanes yuv_planes(PixelFormat layout, uint8_t *data, int width, int height) {
+    YuvPlanes p;
+    if (layout == PixelFormat::I444) {
+        size_t plane = static_cast<size_t>(width) * height;
+        p.data[0] = data;
+        p.data[1] = data + plane;
+        p.data[2] = data + plane * 2;
+        p.stride[0] = p.stride[1] = p.stride[2] = width;
+        return p;
+    }
+    int cw = (width + 1) / 2, ch = (height + 1) / 2;
+    size_t chroma = static_cast<size_t>(cw) * ch;
+    p.data[0] = data;
+    p.data[1] = data + chroma * 4;
+    p.data[2] = data + chroma * 5;
+    p.stride[0] = cw * 2;
+    p.stride[1] = p.stride[2] = cw;
+    return p;
+}
+
+// ---------------------------------------------------------------------------
+// Kernels
+// ---------------------------------------------------------------------------
+
+// One pair of rows to 4:2:0: `width` luma samples on each row (the last
+// pixel repeated into the padding column if odd) and width / 2 rounded up
+// chroma samples of 2x2 averages. row1 may equal row0 on an odd last row.
+typedef void (*Row420Fn)(const uint8_t *row0, const uint8_t *row1, int width, int bpp, const Coefficients &c,
+                         uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v);
+
+// One row to 4:4:4
+typedef void (*Row444Fn)(const uint8_t *row, int width, int bpp, const Coefficients &c,
+                         uint8_t *y, uint8_t *u, uint8_t *v);
+
+static inline uint8_t clamp_byte(int v) {
+    return static_cast<uint8_t>(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+static inline uint8_t luma(const Coefficients &c, int b, int g, int r) {
+    return clamp_byte(((c.y[0] * b + c.y[1] * g + c.y[2] * r + 128) >> 8) + c.y_offset);
+}
+
+static inline uint8_t chroma(const int16_t *k, int b, int g, int r) {
+    return clamp_byte(((k[0] * b + k[1] * g + k[2] * r + 128) >> 8) + 128);
+}
+
+// Pixels [from, width) of a row pair; `from` is even
+static void row420_range(const uint8_t *row0, const uint8_t *row1, int from, int width, int bpp,
+                         const Coefficients &c, uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v) {
+    for (int x = from; x < width; x += 2) {
+        int x1 = x + 1 < width ? x + 1 : x;
+        const uint8_t *px[4] = {row0 + x * bpp, row0 + x1 * bpp, row1 + x * bpp, row1 + x1 * bpp};
+        int sum_b = 0, sum_g = 0, sum_r = 0;
+        for (int i = 0; i < 4; i++) {
+            int b = px[i][0], g = px[i][1], r = px[i][2];
+            (i < 2 ? y0 : y1)[x + (i & 1)] = luma(c, b, g, r);
+            sum_b += b;
+            sum_g += g;
+            sum_r += r;
+        }
+        int b = (sum_b + 2) >> 2, g = (sum_g + 2) >> 2, r = (sum_r + 2) >> 2;
+        u[x / 2] = chroma(c.u, b, g, r);
+        v[x / 2] = chroma(c.v, b, g, r);
+    }
+}
+
+static void row420_scalar(const uint8_t *row0, const uint8_t *row1, int width, int bpp, const Coefficients &c,
+                          uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v) {
+    row420_range(row0, row1, 0, width, bpp, c, y0, y1, u, v);
+}
+
+static void row444_range(const uint8_t *row, int from, int width, int bpp, const Coefficients &c,
+                         uint8_t *y, uint8_t *u, uint8_t *v) {
+    for (int x = from; x < width; x++) {
+        const uint8_t *p = row + x * bpp;
+        int b = p[0], g = p[1], r = p[2];
+        y[x] = luma(c, b, g, r);
+        u[x] = chroma(c.u, b, g, r);
+        v[x] = chroma(c.v, b, g, r);
+    }
+}
+
+static void row444_scalar(const uint8_t *row, int width, int bpp, const Coefficients &c,
+                          uint8_t *y, uint8_t *u, uint8_t *v) {
+    row444_range(row, 0, width, bpp, c, y, u, v);
+}
+
+// Two 16-bit weights as one 32-bit lane, low first
+static inline int32_t weight_pair(int16_t lo, int16_t hi) {
+    return static_cast<int32_t>(static_cast<uint16_t>(lo) | (static_cast<uint32_t>(static_cast<uint16_t>(hi)) << 16));
+}
+
+#ifdef SIMD_X86
+// BGRA pixels as 32-bit lanes split into (B, R) and (G, A) 16-bit pairs, so
+// a weighted sum is two madds: (B * kb + R * kr) + (G * kg + A * 0)
+struct Weights128 {
+    __m128i br, g;
+};
+
+static inline Weights128 weights128(const int16_t *k) {
+    return {_mm_set1_epi32(weight_pair(k[0], k[2])), _mm_set1_epi32(weight_pair(k[1], 0))};
+}
+
+// Rounded, shifted weighted sum of four pixels given as pairs, plus offset
+static inline __m128i dot_sse2(__m128i br, __m128i ga, const Weights128 &w, __m128i offset) {
+    __m128i s = _mm_add_epi32(_mm_madd_epi16(br, w.br), _mm_madd_epi16(ga, w.g));
+    s = _mm_srai_epi32(_mm_add_epi32(s, _mm_set1_epi32(128)), 8);
+    return _mm_add_epi32(s, offset);
+}
+
+// Eight 32-bit results to eight bytes, saturated
+static inline void store8_sse2(uint8_t *dst, __m128i lo, __m128i hi) {
+    __m128i words = _mm_packs_epi32(lo, hi);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst), _mm_packus_epi16(words, words));
+}
+
+// Four 32-bit results to four bytes, saturated
+static inline void store4_sse2(uint8_t *dst, __m128i v) {
+    __m128i words = _mm_packs_epi32(v, v);
+    int32_t out = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+    memcpy(dst, &out, sizeof(out));
+}
+
+// Eight pixels per step; chroma sums the (B, R) and (G, A) pairs of each
+// 2x2 block in 16-bit lanes before averaging, as the scalar code does
+static void row420_sse2(const uint8_t *row0, const uint8_t *row1, int width, int bpp, const Coefficients &c,
+                        uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v) {
+    if (bpp != 4) {
+        row420_scalar(row0, row1, width, bpp, c, y0, y1, u, v);
+        return;
+    }
+    const __m128i mask = _mm_set1_epi32(0x00FF00FF);
+    const __m128i two = _mm_set1_epi16(2);
+    const __m128i y_offset = _mm_set1_epi32(c.y_offset);
+    const __m128i c_offset = _mm_set1_epi32(128);
+    const Weights128 wy = weights128(c.y), wu = weights128(c.u), wv = weights128(c.v);
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m128i *p0 = reinterpret_cast<const __m128i *>(row0 + x * 4);
+        const __m128i *p1 = reinterpret_cast<const __m128i *>(row1 + x * 4);
+        __m128i a[2] = {_mm_loadu_si128(p0), _mm_loadu_si128(p0 + 1)};
+        __m128i b[2] = {_mm_loadu_si128(p1), _mm_loadu_si128(p1 + 1)};
+        __m128i abr[2], aga[2], bbr[2], bga[2];
+        for (int i = 0; i < 2; i++) {
+            abr[i] = _mm_and_si128(a[i], mask);
+            aga[i] = _mm_and_si128(_mm_srli_epi32(a[i], 8), mask);
+            bbr[i] = _mm_and_si128(b[i], mask);
+            bga[i] = _mm_and_si128(_mm_srli_epi32(b[i], 8), mask);
+        }
+        store8_sse2(y0 + x, dot_sse2(abr[0], aga[0], wy, y_offset), dot_sse2(abr[1], aga[1], wy, y_offset));
+        store8_sse2(y1 + x, dot_sse2(bbr[0], bga[0], wy, y_offset), dot_sse2(bbr[1], bga[1], wy, y_offset));
+
+        // Vertical then horizontal pair sums land in lanes 0 and 2
+        __m128i sbr[2], sga[2];
+        for (int i = 0; i < 2; i++) {
+            sbr[i] = _mm_add_epi16(abr[i], bbr[i]);
+            sga[i] = _mm_add_epi16(aga[i], bga[i]);
+            sbr[i] = _mm_shuffle_epi32(_mm_add_epi16(sbr[i], _mm_srli_si128(sbr[i], 4)), _MM_SHUFFLE(3, 1, 2, 0));
+            sga[i] = _mm_shuffle_epi32(_mm_add_epi16(sga[i], _mm_srli_si128(sga[i], 4)), _MM_SHUFFLE(3, 1, 2, 0));
+        }
+        __m128i br = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(sbr[0], sbr[1]), two), 2);
+        __m128i ga = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(sga[0], sga[1]), two), 2);
+        store4_sse2(u + x / 2, dot_sse2(br, ga, wu, c_offset));
+        store4_sse2(v + x / 2, dot_sse2(br, ga, wv, c_offset));
+    }
+    row420_range(row0, row1, x, width, 4, c, y0, y1, u, v);
+}
+
+static void row444_sse2(const uint8_t *row, int width, int bpp, const Coefficients &c,
+                        uint8_t *y, uint8_t *u, uint8_t *v) {
+    if (bpp != 4) {
+        row444_scalar(row, width, bpp, c, y, u, v);
+        return;
+    }
+    const __m128i mask = _mm_set1_epi32(0x00FF00FF);
+    const __m128i y_offset = _mm_set1_epi32(c.y_offset);
+    const __m128i c_offset = _mm_set1_epi32(128);
+    const Weights128 wy = weights128(c.y), wu = weights128(c.u), wv = weights128(c.v);
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m128i *p = reinterpret_cast<const __m128i *>(row + x * 4);
+        __m128i a0 = _mm_loadu_si128(p), a1 = _mm_loadu_si128(p + 1);
+        __m128i br0 = _mm_and_si128(a0, mask), ga0 = _mm_and_si128(_mm_srli_epi32(a0, 8), mask);
+        __m128i br1 = _mm_and_si128(a1, mask), ga1 = _mm_and_si128(_mm_srli_epi32(a1, 8), mask);
+        store8_sse2(y + x, dot_sse2(br0, ga0, wy, y_offset), dot_sse2(br1, ga1, wy, y_offset));
+        store8_sse2(u + x, dot_sse2(br0, ga0, wu, c_offset), dot_sse2(br1, ga1, wu, c_offset));
+        store8_sse2(v + x, dot_sse2(br0, ga0, wv, c_offset), dot_sse2(br1, ga1, wv, c_offset));
+    }
+    row444_range(row, x, width, 4, c, y, u, v);
+}
+
+struct Weights256 {
+    __m256i br, g;
+};
+
+SIMD_TARGET("avx2")
+static inline Weights256 weights256(const int16_t *k) {
+    return {_mm256_set1_epi32(weight_pair(k[0], k[2])), _mm256_set1_epi32(weight_pair(k[1], 0))};
+}
+
+SIMD_TARGET("avx2")
+static inline __m256i dot_avx2(__m256i br, __m256i ga, const Weights256 &w, __m256i offset) {
+    __m256i s = _mm256_add_epi32(_mm256_madd_epi16(br, w.br), _mm256_madd_epi16(ga, w.g));
+    s = _mm256_srai_epi32(_mm256_add_epi32(s, _mm256_set1_epi32(128)), 8);
+    return _mm256_add_epi32(s, offset);
+}
+
+// Sixteen 32-bit results in order to sixteen bytes. The packs work within
+// 128-bit lanes; the permute puts the four 32-bit groups back in order.
+SIMD_TARGET("avx2")
+static inline void store16_avx2(uint8_t *dst, __m256i lo, __m256i hi) {
+    __m256i words = _mm256_packs_epi32(lo, hi);
+    __m256i bytes = _mm256_packus_epi16(words, words);
+    bytes = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm256_castsi256_si128(bytes));
+}
+
+// Eight 32-bit results in order to eight bytes
+SIMD_TARGET("avx2")
+static inline void store8_avx2(uint8_t *dst, __m256i v) {
+    __m256i words = _mm256_packs_epi32(v, v);
+    __m256i bytes = _mm256_packus_epi16(words, words);
+    bytes = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 4, 0, 4, 0, 4, 0, 4));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst), _mm256_castsi256_si128(bytes));
+}
+
+// 2x2 sums of one 8-pixel register pair (rows 0 and 1), in lanes 0, 2, 4
+// and 6, gathered into the low 128 bits in order
+SIMD_TARGET("avx2")
+static inline __m256i block_sums_avx2(__m256i top, __m256i bottom) {
+    __m256i s = _mm256_add_epi16(top, bottom);
+    s = _mm256_add_epi16(s, _mm256_srli_si256(s, 4));
+    s = _mm256_shuffle_epi32(s, _MM_SHUFFLE(3, 1, 2, 0));
+    return _mm256_permute4x64_epi64(s, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+SIMD_TARGET("avx2")
+static void row420_avx2(const uint8_t *row0, const uint8_t *row1, int width, int bpp, const Coefficients &c,
+                        uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v) {
+    if (bpp != 4) {
+        row420_scalar(row0, row1, width, bpp, c, y0, y1, u, v);
+        return;
+    }
+    const __m256i mask = _mm256_set1_epi32(0x00FF00FF);
+    const __m256i two = _mm256_set1_epi16(2);
+    const __m256i y_offset = _mm256_set1_epi32(c.y_offset);
+    const __m256i c_offset = _mm256_set1_epi32(128);
+    const Weights256 wy = weights256(c.y), wu = weights256(c.u), wv = weights256(c.v);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m256i *p0 = reinterpret_cast<const __m256i *>(row0 + x * 4);
+        const __m256i *p1 = reinterpret_cast<const __m256i *>(row1 + x * 4);
+        __m256i a[2] = {_mm256_loadu_si256(p0), _mm256_loadu_si256(p0 + 1)};
+        __m256i b[2] = {_mm256_loadu_si256(p1), _mm256_loadu_si256(p1 + 1)};
+        __m256i abr[2], aga[2], bbr[2], bga[2];
+        for (int i = 0; i < 2; i++) {
+            abr[i] = _mm256_and_si256(a[i], mask);
+            aga[i] = _mm256_and_si256(_mm256_srli_epi32(a[i], 8), mask);
+            bbr[i] = _mm256_and_si256(b[i], mask);
+            bga[i] = _mm256_and_si256(_mm256_srli_epi32(b[i], 8), mask);
+        }
+        store16_avx2(y0 + x, dot_avx2(abr[0], aga[0], wy, y_offset), dot_avx2(abr[1], aga[1], wy, y_offset));
+        store16_avx2(y1 + x, dot_avx2(bbr[0], bga[0], wy, y_offset), dot_avx2(bbr[1], bga[1], wy, y_offset));
+
+        __m256i br = _mm256_permute2x128_si256(block_sums_avx2(abr[0], bbr[0]), block_sums_avx2(abr[1], bbr[1]), 0x20);
+        __m256i ga = _mm256_permute2x128_si256(block_sums_avx2(aga[0], bga[0]), block_sums_avx2(aga[1], bga[1]), 0x20);
+        br = _mm256_srli_epi16(_mm256_add_epi16(br, two), 2);
+        ga = _mm256_srli_epi16(_mm256_add_epi16(ga, two), 2);
+        store8_avx2(u + x / 2, dot_avx2(br, ga, wu, c_offset));
+        store8_avx2(v + x / 2, dot_avx2(br, ga, wv, c_offset));
+    }
+    row420_range(row0, row1, x, width, 4, c, y0, y1, u, v);
+}
+
+SIMD_TARGET("avx2")
+static void row444_avx2(const uint8_t *row, int width, int bpp, const Coefficients &c,
+                        uint8_t *y, uint8_t *u, uint8_t *v) {
+    if (bpp != 4) {
+        row444_scalar(row, width, bpp, c, y, u, v);
+        return;
+    }
+    const __m256i mask = _mm256_set1_epi32(0x00FF00FF);
+    const __m256i y_offset = _mm256_set1_epi32(c.y_offset);
+    const __m256i c_offset = _mm256_set1_epi32(128);
+    const Weights256 wy = weights256(c.y), wu = weights256(c.u), wv = weights256(c.v);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m256i *p = reinterpret_cast<const __m256i *>(row + x * 4);
+        __m256i a0 = _mm256_loadu_si256(p), a1 = _mm256_loadu_si256(p + 1);
+        __m256i br0 = _mm256_and_si256(a0, mask), ga0 = _mm256_and_si256(_mm256_srli_epi32(a0, 8), mask);
+        __m256i br1 = _mm256_and_si256(a1, mask), ga1 = _mm256_and_si256(_mm256_srli_epi32(a1, 8), mask);
+        store16_avx2(y + x, dot_avx2(br0, ga0, wy, y_offset), dot_avx2(br1, ga1, wy, y_offset));
+        store16_avx2(u + x, dot_avx2(br0, ga0, wu, c_offset), dot_avx2(br1, ga1, wu, c_offset));
+        store16_avx2(v + x, dot_avx2(br0, ga0, wv, c_offset), dot_avx2(br1, ga1, wv, c_offset));
+    }
+    row444_range(row, x, width, 4, c, y, u, v);
+}
+#endif // SIMD_X86
+
+#ifdef SIMD_NEON
+// Luma weights are all positive and sum to at most 256: 16-bit unsigned
+// products do, and the rounding narrow is exactly (sum + 128) >> 8
+static inline uint8x8_t luma_neon(uint8x8_t b, uint8x8_t g, uint8x8_t r, const Coefficients &c) {
+    uint16x8_t s = vmull_u8(b, vdup_n_u8(static_cast<uint8_t>(c.y[0])));
+    s = vmlal_u8(s, g, vdup_n_u8(static_cast<uint8_t>(c.y[1])));
+    s = vmlal_u8(s, r, vdup_n_u8(static_cast<uint8_t>(c.y[2])));
+    return vqadd_u8(vrshrn_n_u16(s, 8), vdup_n_u8(static_cast<uint8_t>(c.y_offset)));
+}
+
+// Chroma of eight samples in 32 bits (signed weights)
+static inline uint8x8_t chroma_neon(int16x8_t b, int16x8_t g, int16x8_t r, const int16_t *k) {
+    int32x4_t lo = vmull_n_s16(vget_low_s16(b), k[0]);
+    lo = vmlal_n_s16(lo, vget_low_s16(g), k[1]);
+    lo = vmlal_n_s16(lo, vget_low_s16(r), k[2]);
+    int32x4_t hi = vmull_n_s16(vget_high_s16(b), k[0]);
+    hi = vmlal_n_s16(hi, vget_high_s16(g), k[1]);
+    hi = vmlal_n_s16(hi, vget_high_s16(r), k[2]);
+    lo = vaddq_s32(vrshrq_n_s32(lo, 8), vdupq_n_s32(128));
+    hi = vaddq_s32(vrshrq_n_s32(hi, 8), vdupq_n_s32(128));
+    return vqmovn_u16(vcombine_u16(vqmovun_s32(lo), vqmovun_s32(hi)));
+}
+
+static inline int16x8_t widen(uint8x8_t v) {
+    return vreinterpretq_s16_u16(vmovl_u8(v));
+}
+
+// Sixteen pixels per step, channels deinterleaved by vld4
+static void row420_neon(const uint8_t *row0, const uint8_t *row1, int width, int bpp, const Coefficients &c,
+                        uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v) {
+    if (bpp != 4) {
+        row420_scalar(row0, row1, width, bpp, c, y0, y1, u, v);
+        return;
+    }
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x4_t a = vld4q_u8(row0 + x * 4);
+        uint8x16x4_t b = vld4q_u8(row1 + x * 4);
+        vst1q_u8(y0 + x, vcombine_u8(luma_neon(vget_low_u8(a.val[0]), vget_low_u8(a.val[1]), vget_low_u8(a.val[2]), c),
+                                     luma_neon(vget_high_u8(a.val[0]), vget_high_u8(a.val[1]), vget_high_u8(a.val[2]), c)));
+        vst1q_u8(y1 + x, vcombine_u8(luma_neon(vget_low_u8(b.val[0]), vget_low_u8(b.val[1]), vget_low_u8(b.val[2]), c),
+                                     luma_neon(vget_high_u8(b.val[0]), vget_high_u8(b.val[1]), vget_high_u8(b.val[2]), c)));
+
+        // Pairwise sums of both rows, then (sum + 2) >> 2
+        int16x8_t avg[3];
+        for (int ch = 0; ch < 3; ch++) {
+            uint16x8_t sum = vpadalq_u8(vpaddlq_u8(a.val[ch]), b.val[ch]);
+            avg[ch] = vreinterpretq_s16_u16(vrshrq_n_u16(sum, 2));
+        }
+        vst1_u8(u + x / 2, chroma_neon(avg[0], avg[1], avg[2], c.u));
+        vst1_u8(v + x / 2, chroma_neon(avg[0], avg[1], avg[2], c.v));
+    }
+    row420_range(row0, row1, x, width, 4, c, y0, y1, u, v);
+}
+
+static void row444_neon(const uint8_t *row, int width, int bpp, const Coefficients &c,
+                        uint8_t *y, uint8_t *u, uint8_t *v) {
+    if (bpp != 4) {
+        row444_scalar(row, width, bpp, c, y, u, v);
+        return;
+    }
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x4_t p = vld4q_u8(row + x * 4);
+        uint8x8_t b[2] = {vget_low_u8(p.val[0]), vget_high_u8(p.val[0])};
+        uint8x8_t g[2] = {vget_low_u8(p.val[1]), vget_high_u8(p.val[1])};
+        uint8x8_t r[2] = {vget_low_u8(p.val[2]), vget_high_u8(p.val[2])};
+        for (int h = 0; h < 2; h++) {
+            vst1_u8(y + x + 8 * h, luma_neon(b[h], g[h], r[h], c));
+            vst1_u8(u + x + 8 * h, chroma_neon(widen(b[h]), widen(g[h]), widen(r[h]), c.u));
+            vst1_u8(v + x + 8 * h, chroma_neon(widen(b[h]), widen(g[h]), widen(r[h]), c.v));
+        }
+    }
+    row444_range(row, x, width, 4, c, y, u, v);
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Runtime dispatch
+// ---------------------------------------------------------------------------
+struct Kernel {
+    const char *name;
+    Row420Fn row420;
+    Row444Fn row444;
+};
+
+// Best first
+static const Kernel KERNELS[] = {
+#ifdef SIMD_X86
+    {"avx2", row420_avx2, row444_avx2},
+    {"sse2", row420_sse2, row444_sse2},
+#endif
+#ifdef SIMD_NEON
+    {"neon", row420_neon, row444_neon},
+#endif
+    {"scalar", row420_scalar, row444_scalar},
+};
+
+static KernelTable kernel_table(KERNELS);
+
+const char* yuv_kernel() {
+    return kernel_table.name();
+}
+
+std::vector<const char*> yuv_kernels() {
+    return kernel_table.usable();
+}
+
+bool yuv_select(const char *name) {
+    return kernel_table.select(name);
+}
+
+// ---------------------------------------------------------------------------
+
+void yuv_convert(const uint8_t *src, size_t stride, int bpp, int width, int height,
+                 const CaptureRect &rect, PixelFormat layout, YuvRange range, const YuvPlanes &dst) {
+    const Coefficients &c = range == YuvRange::FULL ? FULL_RANGE : LIMITED_RANGE;
+    const Kernel *k = &kernel_table.active();
+    int x0 = rect.x < 0 ? 0 : rect.x, y0 = rect.y < 0 ? 0 : rect.y;
+    int x1 = rect.x + rect.width > width ? width : rect.x + rect.width;
+    int y1 = rect.y + rect.height > height ? height : rect.y + rect.height;
+
+    if (layout == PixelFormat::I444) {
+        for (int y = y0; y < y1; y++) {
+            size_t row = static_cast<size_t>(y);
+            k->row444(src + row * stride + static_cast<size_t>(x0) * bpp, x1 - x0, bpp, c,
+                      dst.data[0] + row * dst.stride[0] + x0, dst.data[1] + row * dst.stride[1] + x0,
+                      dst.data[2] + row * dst.stride[2] + x0);
+        }
+        return;
+    }
+
+    // Whole 2x2 blocks; only the frame's own odd edge is left half covered
+    x0 &= ~1;
+    y0 &= ~1;
+    x1 = (x1 + 1) & ~1;
+    y1 = (y1 + 1) & ~1;
+    if (x1 > width) x1 = width;
+    if (y1 > height) y1 = height;
+    for (int y = y0; y < y1; y += 2) {
+        const uint8_t *row0 = src + static_cast<size_t>(y) * stride + static_cast<size_t>(x0) * bpp;
+        const uint8_t *row1 = y + 1 < height ? row0 + stride : row0;
+        uint8_t *luma0 = dst.data[0] + static_cast<size_t>(y) * dst.stride[0] + x0;
+        size_t crow = static_cast<size_t>(y / 2);
+        k->row420(row0, row1, x1 - x0, bpp, c, luma0, luma0 + dst.stride[0],
+                  dst.data[1] + crow * dst.stride[1] + x0 / 2, dst.data[2] + crow * dst.stride[2] + x0 / 2);
+    }
+}
+
+void yuv_halve_chroma(const uint8_t *src, int src_stride, int width, int height, bool halve_rows,
+                      uint8_t *dst, int dst_stride) {
+    int cw = (width + 1) / 2;
+    int pairs = width / 2;  // full 2-pixel pairs; an odd last column stands alone
+    int rows = halve_rows ? (height + 1) / 2 : height;
+    for (int y = 0; y < rows; y++) {
+        const uint8_t *row0 = src + static_cast<size_t>(halve_rows ? y * 2 : y) * src_stride;
+        const uint8_t *row1 = halve_rows && y * 2 + 1 < height ? row0 + src_stride : row0;
+        uint8_t *out = dst + static_cast<size_t>(y) * dst_stride;
+        for (int x = 0; x < pairs; x++) {
+            out[x] = static_cast<uint8_t>((row0[2 * x] + row0[2 * x + 1] + row1[2 * x] + row1[2 * x + 1] + 2) >> 2);
+        }
+        if (pairs < cw) {
+            out[pairs] = static_cast<uint8_t>((row0[width - 1] + row1[width - 1] + 1) >> 1);
+        }
+    }
+}
+
+bool YuvConverter::init(int w, int h, YuvFormat format) {
+    if (format.layout != PixelFormat::I420 && format.layout != PixelFormat::I444) {
+        return false;
+    }
+    yuv = format;
+    width = w;
+    height = h;
+    valid = false;
+    planes.assign(yuv_frame_size(format.layout, w, h), 0);
+    return true;
+}
+
+size_t YuvConverter::update(const FrameBuffer &raw) {
+    if (raw.width != width || raw.height != height) {
+        init(raw.width, raw.height, yuv);
+    }
+    int bpp = raw.format == PixelFormat::BGR ? 3 : 4;
+    YuvPlanes dst = yuv_planes(yuv.layout, planes.data(), width, height);
+    if (!valid || raw.damage.empty()) {
+        yuv_convert(raw.data, raw.stride, bpp, width, height, {0, 0, width, height}, yuv.layout, yuv.range, dst);
+        valid = true;
+        return static_cast<size_t>(width) * height;
+    }
+
+    size_t converted = 0;
+    for (const auto &r : raw.damage) {
+        yuv_convert(raw.data, raw.stride, bpp, width, height, r, yuv.layout, yuv.range, dst);
+        converted += static_cast<size_t>(r.width) * r.height;
+    }
+    return converted;
+}
+
+bool YuvConverter::write_to(const FrameBuffer &raw, FrameBuffer &out) const {
+    if (out.capacity < planes.size()) {
+        return false;
+    }
+    if (!raw.duplicate) {
+        memcpy(out.data, planes.data(), planes.size());
+    }
+    out.format = yuv.layout;
+    out.width = width;
+    out.height = height;
+    out.stride = yuv_planes(yuv.layout, out.data, width, height).stride[0];
+    out.size = planes.size();
+    out.timestamp_us = raw.timestamp_us;
+    out.content_hash = raw.content_hash;
+    out.duplicate = raw.duplicate;
+    out.damage = raw.damage;
+    out.cursor_x = raw.cursor_x;
+    out.cursor_y = raw.cursor_y;
+    out.focus = raw.focus;
+    return true;
+}
@@ -0,0 +1,87 @@
+#ifndef YUV_HPP
+#define YUV_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "frame.hpp"
+
+// Value range of converted samples
+enum class YuvRange {
+    FULL,     // JFIF: 0..255 luma and chroma, what JPEG decoders expect
+    LIMITED,  // BT.601 video: luma 16..235, chroma 16..240
+};
+
+// Input an encoder wants: raw pixels (BGRA/BGR, the default) or planar
+// YCbCr, PixelFormat::I420 or I444, in the given range
+struct YuvFormat {
+    PixelFormat layout = PixelFormat::BGRA;
+    YuvRange range = YuvRange::FULL;
+};
+
+// Where the planes of an I420/I444 frame are. Planes lie back to back, Y
+// then Cb then Cr, rows without padding; 4:2:0 planes cover the size
+// rounded up to even, the extra row and column repeating the last ones.
+struct YuvPlanes {
+    uint8_t *data[3];
+    int stride[3];
+};
+
+// Bytes of an I420/I444 frame of width x height
+size_t yuv_frame_size(PixelFormat layout, int width, int height);
+
+YuvPlanes yuv_planes(PixelFormat layout, uint8_t *data, int width, int height);
+
+// Convert `rect` of a BGRA/BGR image into planes of the same geometry.
+// For 4:2:0 the rect is widened to even coordinates.
+void yuv_convert(const uint8_t *src, size_t stride, int bytes_per_pixel, int width, int height,
+                 const CaptureRect &rect, PixelFormat layout, YuvRange range, const YuvPlanes &dst);
+
+// Halve a full-resolution chroma plane (Cb or Cr of I444, width x height)
+// for a 4:2:2 encode, or both ways for 4:2:0, averaging with rounding. The
+// result is ceil(width / 2) wide and height (4:2:2) or ceil(height / 2)
+// (4:2:0) rows; an odd last column or row is averaged on its own.
+void yuv_halve_chroma(const uint8_t *src, int src_stride, int width, int height, bool halve_rows,
+                      uint8_t *dst, int dst_stride);
+
+// Persistent planes tracking a stream of raw frames. Each frame converts
+// only its damage rects (everything when it has none), so unchanged pixels
+// are converted once, not once per frame and not once per encoder; the
+// planes are then copied into a frame of their own for an encoder to take
+// (capture buffers may be read-only). Frames must arrive in order.
+class YuvConverter {
+public:
+    bool init(int width, int height, YuvFormat format);
+
+    // Bring the planes up to date with `raw` (BGRA/BGR). A new size starts
+    // over. Returns the number of pixels converted.
+    size_t update(const FrameBuffer &raw);
+
+    // Fill `out` with the planes and the metadata of `raw`, the frame just
+    // passed to update(), marking it I420/I444. Duplicates get the metadata
+    // only. False if the buffer of `out` is too small.
+    bool write_to(const FrameBuffer &raw, FrameBuffer &out) const;
+
+    // Convert everything on the next update (e.g. after a frame was lost)
+    void invalidate() { valid = false; }
+
+    const YuvFormat& format() const { return yuv; }
+
+private:
+    YuvFormat yuv;
+    int width = 0;
+    int height = 0;
+    bool valid = false;
+    std::vector<uint8_t> planes;
+};
+
+// Name of the kernel yuv_convert() uses ("avx2", "sse2", "neon", "scalar")
+const char* yuv_kernel();
+
+// Kernels usable on this CPU, best first
+std::vector<const char*> yuv_kernels();
+
+// Force a kernel by name (benchmarks). Returns false if not usable here.
+bool yuv_select(const char *name);
+
+#endif